@@ -91,7 +91,7 @@ do {                                                              \
 #define CHECK_COND_GOTO(cond, label)     \
 do {                                       \
     if ((cond)) {                          \
-        goto (label);                      \
+        goto label;                        \
     }                                      \
 } while (0)
 
@@ -101,11 +101,11 @@ do {                                       \
     @param[in] msg  A message string to print.
     @param[in] label  goto label
 */
-#define CHECK_COND_GOTO_MSG(cond, ret, msg)        \
+#define CHECK_COND_GOTO_MSG(cond, label, msg)      \
 do {                                               \
     if ((cond)) {                                  \
         LOGPRINT_ERROR("%s: " #cond, msg);         \
-        goto (label);                              \
+        goto label;                                \
     }                                              \
 } while (0)
 
@@ -30,7 +30,8 @@ Cobs_encode(
 /******************************************************************************
     [docexport Cobs_decode]
 *//**
-    @brief Decode a COBS encoded stream.
+    @brief Decode a COBS encoded stream. Decoding in place (buf_out == enc_in)
+    is allowed: output never runs ahead of input.
     @param[in] enc_in Pointer to encoded input byte stream.
     @param[in] enc_in_len  Length of the input stream.
     @param[in] buf_out  Pointer to decoded output buffer.
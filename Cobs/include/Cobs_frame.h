@@ -63,6 +63,28 @@ Cobs_deframer(
     uint8_t *buf_out,
     uint32_t max_buf_out);
 
+/******************************************************************************
+    [docexport Cobs_deframeInPlace]
+*//**
+    @brief Finds the next complete frame in a linear buffer and decodes it in
+    place (the decoded message is never longer than its encoding). No fifo or
+    work buffer is involved.
+    @param[in] buf  Pointer to the framed bytestream.
+    @param[in] len  Number of bytes in buf.
+    @param[out] msg  Set to the start of the decoded message (within buf).
+    @param[out] consumed  Number of bytes at the front of buf which are done
+    with: through the frame's EOF when a frame is returned, otherwise the
+    bytes preceding an incomplete frame (which must be kept).
+    @return Returns the size of the decoded message, 0 if no complete frame
+    is available, -1 on a bad frame (which is consumed).
+******************************************************************************/
+int
+Cobs_deframeInPlace(
+    uint8_t *buf,
+    uint32_t len,
+    uint8_t **msg,
+    uint32_t *consumed);
+
 /******************************************************************************
     [docexport Cobs_frame_init]
 *//**
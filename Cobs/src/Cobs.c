@@ -53,7 +53,16 @@ Cobs_encode(
             /* Advance code_word_idx by the curent count */
             code_word_idx += count;
 
-            if (count == 255)
+            if (count == 255 && byte == ESCAPED_BYTE)
+            {
+                /*  The zero follows a full block: it becomes an empty block
+                    of its own (code 0x01), never a literal zero. */
+                CHECK_OVERFLOW(code_word_idx >= max_enc_len);
+                enc_out[code_word_idx] = 1;
+                code_word_idx++;
+                count = 0;
+            }
+            else if (count == 255)
             {
                 /*  Since we're stuffing an 0xff byte, we need to still write
                     the current non-null byte. Advance to the next non-codeword
@@ -86,7 +95,8 @@ Cobs_encode(
 /******************************************************************************
     [docimport Cobs_decode]
 *//**
-    @brief Decode a COBS encoded stream.
+    @brief Decode a COBS encoded stream. Decoding in place (buf_out == enc_in)
+    is allowed: output never runs ahead of input.
     @param[in] enc_in Pointer to encoded input byte stream.
     @param[in] enc_in_len  Length of the input stream.
     @param[in] buf_out  Pointer to decoded output buffer.
@@ -103,13 +113,22 @@ Cobs_decode(
     uint8_t *pCode = enc_in;
     uint8_t *pData = enc_in + 1;
     uint8_t *pBuf = buf_out;
+    uint8_t *pEnd = enc_in + enc_in_len;
     uint8_t count;
+    uint8_t code;
     int num_out = 0;
     
     while (1)
     {
-        for (count = 1; count < *pCode; count++)
+        /* Read once: in place, the output overwrites the code byte. */
+        code = *pCode;
+        for (count = 1; count < code; count++)
         {
+            if (pData >= pEnd)
+            {
+                LOGPRINT_ERROR("Code byte runs past end of input.");
+                return -1;
+            }
             CHECK_OVERFLOW(num_out == max_buf_out);
             *pBuf++ = *pData++;
             num_out++;
@@ -118,7 +137,7 @@ Cobs_decode(
         pCode += count;
         pData = pCode + 1;
 
-        if (pCode == enc_in + enc_in_len)
+        if (pCode >= pEnd)
         {
             break;
         }
@@ -215,6 +215,74 @@ Cobs_deframer(
     return 0;
 }
 
+/******************************************************************************
+    [docimport Cobs_deframeInPlace]
+*//**
+    @brief Finds the next complete frame in a linear buffer and decodes it in
+    place (the decoded message is never longer than its encoding). No fifo or
+    work buffer is involved.
+    @param[in] buf  Pointer to the framed bytestream.
+    @param[in] len  Number of bytes in buf.
+    @param[out] msg  Set to the start of the decoded message (within buf).
+    @param[out] consumed  Number of bytes at the front of buf which are done
+    with: through the frame's EOF when a frame is returned, otherwise the
+    bytes preceding an incomplete frame (which must be kept).
+    @return Returns the size of the decoded message, 0 if no complete frame
+    is available, -1 on a bad frame (which is consumed).
+******************************************************************************/
+int
+Cobs_deframeInPlace(
+    uint8_t *buf,
+    uint32_t len,
+    uint8_t **msg,
+    uint32_t *consumed)
+{
+    uint32_t sof = 0;
+    uint32_t eof;
+    int num;
+
+    while (1)
+    {
+        /* Discard anything up to the start of frame. */
+        while (sof < len && buf[sof] != FRAMING_BYTE)
+        {
+            sof++;
+        }
+
+        for (eof = sof + 1; eof < len && buf[eof] != FRAMING_BYTE; eof++)
+        {
+        }
+
+        if (eof >= len)
+        {
+            /* No complete frame yet (or nothing at all). */
+            *consumed = (sof < len) ? sof : len;
+            return 0;
+        }
+
+        if (eof == sof + 1)
+        {
+            /* Empty frame: treat its EOF as the next SOF. */
+            sof = eof;
+            continue;
+        }
+        break;
+    }
+
+    *consumed = eof + 1;
+    *msg = buf + sof + 1;
+
+    num = Cobs_decode(buf + sof + 1, eof - sof - 1, buf + sof + 1,
+        eof - sof - 1);
+    if (num < 0)
+    {
+        LOGPRINT_ERROR("Error during in-place COBS decode.");
+        return -1;
+    }
+
+    return num;
+}
+
 /******************************************************************************
     [docimport Cobs_frame_init]
 *//**
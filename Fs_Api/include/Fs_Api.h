@@ -14,6 +14,7 @@ typedef enum {
     FSAPI_O_EXCL   = 0x1 << 5,           // Fail if a file already exists
     FSAPI_O_TRUNC  = 0x1 << 6,           // Truncate the existing file to zero size
     FSAPI_O_APPEND = 0x1 << 7,           // Move to end of file on every write
+    FSAPI_O_COMPRESS = 0x1 << 8,         // Write the file compressed (with TRUNC)
 } Fs_Api_open_flags;
 
 typedef enum {
@@ -22,6 +23,31 @@ typedef enum {
     FSAPI_SEEK_END,   // Seek relative to the end of the file
 } Fs_Api_seek_flags;
 
+/** @brief Contiguous piece of a mapped file. */
+typedef struct Fs_Api_Extent
+{
+    const char *data;
+    int size;
+} Fs_Api_Extent;
+
+/** @brief Read-only view of a file (see map). */
+typedef struct Fs_Api_Map
+{
+    Fs_Api_Extent *extents;
+    int num_extents;
+    /** @brief File size. */
+    int size;
+    /** @brief Implementation state. */
+    void *handle;
+} Fs_Api_Map;
+
+/** @brief One buffer of a vectored read or write. */
+typedef struct Fs_Api_Iovec
+{
+    char *buf;
+    int size;
+} Fs_Api_Iovec;
+
 #define FS_API_CONTENTS()                                 \
     /** @brief Opaque context object. */                  \
     void *ctx;                                            \
@@ -32,7 +58,26 @@ typedef enum {
     int (*read)(void *ctx, int fd, char *buf, int size);  \
     int (*write)(void *ctx, int fd, char *buf, int size); \
     int (*seek)(void *ctx, int fd, int offset, int mode); \
-    int (*fsize)(void *ctx, int fd);
+    int (*fsize)(void *ctx, int fd);                      \
+                                                          \
+    /** @brief Positional and vectored I/O: one call      \
+        transfers at offset and returns the byte count.   \
+        The file position is left after the data (unlike  \
+        POSIX), so sequential calls do not seek. */       \
+    int (*pread)(void *ctx, int fd, char *buf, int size,  \
+        int offset);                                      \
+    int (*pwrite)(void *ctx, int fd, char *buf, int size, \
+        int offset);                                      \
+    int (*preadv)(void *ctx, int fd,                      \
+        const Fs_Api_Iovec *iov, int iovcnt, int offset); \
+    int (*pwritev)(void *ctx, int fd,                     \
+        const Fs_Api_Iovec *iov, int iovcnt, int offset); \
+                                                          \
+    /** @brief Optional zero-copy read-only mapping of a  \
+        whole file (NULL if not supported). */            \
+    int (*map)(void *ctx, const char *path,               \
+        Fs_Api_Map *map);                                 \
+    void (*unmap)(void *ctx, Fs_Api_Map *map);
 
 /** @brief Fs_Api base object.
 */
@@ -0,0 +1,267 @@
+/*******************************************************************************
+ *  @file: Lfs_Api_bench.c
+ *
+ *  @brief: Compressed file benchmark for Lfs_Api: the same asset-like file
+ *  (Lua-style text) written plain and with FSAPI_O_COMPRESS, then loaded
+ *  whole and read at random offsets through the Fs_Api. With a RAM device
+ *  and simulated timings (see Lfs_Part_bench.c) it runs on the linux (host)
+ *  target. Reports flash size, wall time, simulated flash time and device
+ *  operation counts per test.
+ *
+ *  Usage (e.g. from app_main on the linux target, device registered):
+ *
+ *      #include "Lfs_Api_bench.h"
+ *      Lfs_Api_bench("bench");
+*******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_Api.h"
+#include "SwTimer.h"
+#include "Lfs_Api_bench.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_Api_bench";
+
+#define BENCH_FILE_SIZE         (64*1024)
+#define BENCH_IO_SIZE           512
+#define BENCH_RAND_IO_SIZE      256
+#define BENCH_RAND_OPS          256
+
+static Lfs_Part_t *bench_lp;
+static char io_buf[BENCH_IO_SIZE];
+static uint32_t rand_state;
+
+/** @brief Per test measurement. */
+typedef struct BenchMark
+{
+    SwTimer swt;
+    Lfs_PartDev_Stats start;
+
+} BenchMark;
+
+/******************************************************************************
+    bench_rand
+*//**
+    @brief Deterministic pseudo random numbers (LCG), for repeatable runs.
+******************************************************************************/
+static uint32_t
+bench_rand(void)
+{
+    rand_state = rand_state*1664525 + 1013904223;
+    return rand_state >> 8;
+}
+
+/******************************************************************************
+    mark_start
+*//**
+    @brief Starts a measurement.
+******************************************************************************/
+static void
+mark_start(BenchMark *m)
+{
+    Lfs_PartDev_getStats(bench_lp->dev, &m->start, false);
+    SwTimer_tic(&m->swt);
+}
+
+/******************************************************************************
+    mark_report
+*//**
+    @brief Ends a measurement and logs it.
+    @param[in] m  Measurement.
+    @param[in] name  Test name.
+    @param[in] ops  Number of operations in the test.
+******************************************************************************/
+static void
+mark_report(BenchMark *m, const char *name, uint32_t ops)
+{
+    uint64_t wall_us = SwTimer_toc(&m->swt);
+    Lfs_PartDev_Stats end;
+
+    Lfs_PartDev_getStats(bench_lp->dev, &end, false);
+    LOGPRINT_INFO("%-14s %6u ops %8u us wall %9u us flash (%u rd)",
+        name,
+        (unsigned)ops,
+        (unsigned)wall_us,
+        (unsigned)((end.sim_ns - m->start.sim_ns)/1000),
+        (unsigned)(end.reads - m->start.reads));
+}
+
+/******************************************************************************
+    make_asset
+*//**
+    @brief Fills data with Lua-like table text (compressible, like assets).
+******************************************************************************/
+static void
+make_asset(char *data, uint32_t size)
+{
+    static const char *words[] = {
+        "local", "function", "return", "end", "for", "in", "pairs", "led",
+        "color", "pattern", "step", "delay", "brightness", "frame", "if",
+        "then", "else", "table", "insert", "math", "floor", "self", "nil"
+    };
+    uint32_t num_words = sizeof(words)/sizeof(words[0]);
+    uint32_t pos = 0;
+    char line[96];
+    int len;
+
+    while (pos < size)
+    {
+        len = snprintf(line, sizeof(line), "  %s.%s = { %u, %u, %u } -- %s\n",
+            words[bench_rand() % num_words], words[bench_rand() % num_words],
+            (unsigned)(bench_rand() % 8)*32, (unsigned)(bench_rand() % 8)*32,
+            (unsigned)(bench_rand() % 8)*32, words[bench_rand() % num_words]);
+        if ((uint32_t)len > size - pos)
+        {
+            len = size - pos;
+        }
+        memcpy(&data[pos], line, len);
+        pos += len;
+    }
+}
+
+/******************************************************************************
+    bench_write
+*//**
+    @brief Writes data to path through the api.
+******************************************************************************/
+static int
+bench_write(Fs_Api *api, const char *path, const char *data, int flags,
+    const char *name)
+{
+    struct lfs_info info;
+    BenchMark m;
+    uint32_t i;
+    int fd, ret;
+
+    mark_start(&m);
+    fd = api->open(api->ctx, path, FSAPI_O_WRONLY | FSAPI_O_CREAT |
+        FSAPI_O_TRUNC | flags);
+    CHECK_COND_RETURN_MSG(fd < 0, fd, "open failed.");
+    for (i = 0; i < BENCH_FILE_SIZE; i += BENCH_IO_SIZE)
+    {
+        ret = api->write(api->ctx, fd, (char *)&data[i], BENCH_IO_SIZE);
+        CHECK_COND_RETURN_MSG(ret != BENCH_IO_SIZE, -1, "write failed.");
+    }
+    ret = api->close(api->ctx, fd);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "close failed.");
+    mark_report(&m, name, BENCH_FILE_SIZE/BENCH_IO_SIZE);
+
+    ret = lfs_stat(&bench_lp->lfs, path, &info);
+    CHECK_COND_RETURN(ret < 0, ret);
+    LOGPRINT_INFO("%-14s %u bytes on flash for %u", "",
+        (unsigned)info.size, (unsigned)BENCH_FILE_SIZE);
+    return 0;
+}
+
+/******************************************************************************
+    bench_load
+*//**
+    @brief Loads the whole file through the api and checks it.
+******************************************************************************/
+static int
+bench_load(Fs_Api *api, const char *path, const char *data, const char *name)
+{
+    BenchMark m;
+    uint32_t i;
+    int fd, ret;
+
+    mark_start(&m);
+    fd = api->open(api->ctx, path, FSAPI_O_RDONLY);
+    CHECK_COND_RETURN_MSG(fd < 0, fd, "open failed.");
+    CHECK_COND_RETURN_MSG(api->fsize(api->ctx, fd) != BENCH_FILE_SIZE, -1,
+        "Wrong file size.");
+    for (i = 0; i < BENCH_FILE_SIZE; i += BENCH_IO_SIZE)
+    {
+        ret = api->read(api->ctx, fd, io_buf, BENCH_IO_SIZE);
+        CHECK_COND_RETURN_MSG(ret != BENCH_IO_SIZE ||
+            memcmp(io_buf, &data[i], BENCH_IO_SIZE) != 0, -1,
+            "read failed.");
+    }
+    api->close(api->ctx, fd);
+    mark_report(&m, name, BENCH_FILE_SIZE/BENCH_IO_SIZE);
+    return 0;
+}
+
+/******************************************************************************
+    bench_random
+*//**
+    @brief Reads at random offsets through the api (pread) and checks.
+******************************************************************************/
+static int
+bench_random(Fs_Api *api, const char *path, const char *data,
+    const char *name)
+{
+    BenchMark m;
+    uint32_t i, off;
+    int fd, ret;
+
+    rand_state = 7;
+    mark_start(&m);
+    fd = api->open(api->ctx, path, FSAPI_O_RDONLY);
+    CHECK_COND_RETURN_MSG(fd < 0, fd, "open failed.");
+    for (i = 0; i < BENCH_RAND_OPS; i++)
+    {
+        off = bench_rand() % (BENCH_FILE_SIZE - BENCH_RAND_IO_SIZE);
+        ret = api->pread(api->ctx, fd, io_buf, BENCH_RAND_IO_SIZE, off);
+        CHECK_COND_RETURN_MSG(ret != BENCH_RAND_IO_SIZE ||
+            memcmp(io_buf, &data[off], BENCH_RAND_IO_SIZE) != 0, -1,
+            "read failed.");
+    }
+    api->close(api->ctx, fd);
+    mark_report(&m, name, BENCH_RAND_OPS);
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_Api_bench]
+*//**
+    @brief Runs the compressed file benchmark.
+    @param[in] part_label  Registered partition (needs about 128 KB free).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_Api_bench(const char *part_label)
+{
+    static const char *raw_path = "bench_raw.lua";
+    static const char *z_path = "bench_z.lua";
+    Fs_Api api;
+    char *data;
+    int ret;
+
+    ret = Lfs_Api_init(&api, part_label);
+    CHECK_COND_RETURN(ret < 0, ret);
+    bench_lp = (Lfs_Part_t *)api.ctx;
+
+    data = (char *)malloc(BENCH_FILE_SIZE);
+    CHECK_COND_RETURN_MSG(!data, -1, "No memory for the file.");
+    rand_state = 1;
+    make_asset(data, BENCH_FILE_SIZE);
+
+    LOGPRINT_INFO("Lfs_Api compressed file bench on %s: %u KB file",
+        part_label, (unsigned)(BENCH_FILE_SIZE/1024));
+
+    ret = bench_write(&api, raw_path, data, 0, "write raw");
+    CHECK_COND_GOTO(ret < 0, done);
+    ret = bench_write(&api, z_path, data, FSAPI_O_COMPRESS, "write lz");
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_load(&api, raw_path, data, "load raw");
+    CHECK_COND_GOTO(ret < 0, done);
+    ret = bench_load(&api, z_path, data, "load lz");
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_random(&api, raw_path, data, "random raw");
+    CHECK_COND_GOTO(ret < 0, done);
+    ret = bench_random(&api, z_path, data, "random lz");
+    CHECK_COND_GOTO(ret < 0, done);
+
+done:
+    lfs_remove(&bench_lp->lfs, raw_path);
+    lfs_remove(&bench_lp->lfs, z_path);
+    free(data);
+    return ret;
+}
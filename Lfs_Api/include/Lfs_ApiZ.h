@@ -0,0 +1,211 @@
+/*******************************************************************************
+ *  @file: Lfs_ApiZ.h
+ *
+ *  @brief: Header for Lfs_ApiZ, the compressed file mode of Lfs_Api
+ *  (FSAPI_O_COMPRESS).
+ *
+ *  A compressed file is cut into LFS_APIZ_BLOCK_SIZE blocks of file data,
+ *  each compressed on its own (LZ4 block format, a block that does not
+ *  shrink is stored as is), so memory is fixed: one block of file data, one
+ *  compressed block and, while writing, the match table. The blocks are
+ *  followed by the block index (end offset of each compressed block) and a
+ *  trailer, so a read anywhere in the file decompresses one block. The file
+ *  is marked with the LFS_APIZ_ATTR user attribute, written with the data
+ *  when the file is closed; reads of a marked file are decompressed whatever
+ *  the open flags.
+ *
+ *  A compressed file is written once, sequentially, from the start
+ *  (FSAPI_O_TRUNC is implied). File sizes and offsets are those of the file
+ *  data.
+ *
+ *  Layout (little endian):
+ *      block 0 .. block n-1
+ *      uint32_t index[n]       end offset of each block
+ *      Lfs_ApiZ_Trailer
+*******************************************************************************/
+#ifndef LFS_APIZ_H
+#define LFS_APIZ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief File data per compressed block. */
+#ifndef LFS_APIZ_BLOCK_SIZE
+#define LFS_APIZ_BLOCK_SIZE         4096
+#endif
+
+/** @brief Match table entries of the compressor (log2). */
+#define LFS_APIZ_HASH_BITS          10
+
+/** @brief Worst case compressed size of n bytes. */
+#define LFS_APIZ_BOUND(n)           ((n) + (n)/255 + 16)
+
+/** @brief User attribute marking a compressed file (value: codec). */
+#define LFS_APIZ_ATTR               0x5a
+#define LFS_APIZ_CODEC_LZ4          1
+
+/** @brief Trailer magic ("LZB1"). */
+#define LFS_APIZ_MAGIC              0x31425a4c
+
+/** @brief Trailer of a compressed file. */
+typedef struct Lfs_ApiZ_Trailer
+{
+    uint32_t magic;
+    /** @brief File data size. */
+    uint32_t size;
+    uint32_t block_size;
+    uint32_t num_blocks;
+
+} Lfs_ApiZ_Trailer;
+
+/** @brief Open compressed file (the lfs file is the Lfs_Part_t file). */
+typedef struct Lfs_ApiZ_File
+{
+    bool wr;
+    uint32_t block_size;
+    /** @brief File data size and position. */
+    uint32_t size;
+    uint32_t pos;
+    /** @brief Block index (end offsets). */
+    uint32_t *index;
+    uint32_t num_blocks;
+    uint32_t index_max;
+    /** @brief Block of file data: the decompressed block blk (read), the
+        block being filled (write). */
+    uint8_t *blk_buf;
+    uint32_t blk;
+    uint32_t blk_len;
+    /** @brief Compressed block. */
+    uint8_t *z_buf;
+    /** @brief Compressor match table (write). */
+    uint16_t *hash;
+    /** @brief Open config carrying the marker attribute (write). */
+    struct lfs_file_config cfg;
+    struct lfs_attr attr;
+    uint8_t codec;
+
+} Lfs_ApiZ_File;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_ApiZ_compress]
+*//**
+    @brief Compresses a buffer (LZ4 block format).
+    @param[in] src  Data.
+    @param[in] len  Data length (at most 64 KB).
+    @param[out] dst  Compressed data.
+    @param[in] max  Size of dst.
+    @param[in] hash  Match table of (1 << LFS_APIZ_HASH_BITS) entries.
+    @return Returns the compressed length, 0 if it is not smaller than len
+    or does not fit in max.
+******************************************************************************/
+uint32_t
+Lfs_ApiZ_compress(
+    const uint8_t *src,
+    uint32_t len,
+    uint8_t *dst,
+    uint32_t max,
+    uint16_t *hash);
+
+/******************************************************************************
+    [docexport Lfs_ApiZ_decompress]
+*//**
+    @brief Decompresses a buffer (LZ4 block format).
+    @param[in] src  Compressed data.
+    @param[in] len  Compressed length.
+    @param[out] dst  Data.
+    @param[in] max  Size of dst.
+    @return Returns the data length, LFS_ERR_CORRUPT if src is malformed or
+    does not fit in max.
+******************************************************************************/
+int
+Lfs_ApiZ_decompress(
+    const uint8_t *src,
+    uint32_t len,
+    uint8_t *dst,
+    uint32_t max);
+
+/******************************************************************************
+    [docexport Lfs_ApiZ_isCompressed]
+*//**
+    @brief Checks the marker attribute of a file.
+    @param[in] lfs  Mounted lfs.
+    @param[in] path  File.
+    @return Returns true if the file is compressed.
+******************************************************************************/
+bool
+Lfs_ApiZ_isCompressed(lfs_t *lfs, const char *path);
+
+/******************************************************************************
+    [docexport Lfs_ApiZ_open]
+*//**
+    @brief Opens a compressed file on the Lfs_Part_t file: created (and
+    truncated) for writing, or read.
+    @param[in] lp  Lfs_Part_t object.
+    @param[in] path  File.
+    @param[in] wr  Create and write (else read an existing compressed file).
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_open(struct Lfs_Part_t *lp, const char *path, bool wr);
+
+/******************************************************************************
+    [docexport Lfs_ApiZ_close]
+*//**
+    @brief Closes the compressed file (a written file gets its last block,
+    index and trailer, then its marker attribute on the close).
+    @param[in] lp  Lfs_Part_t object.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_close(struct Lfs_Part_t *lp);
+
+/******************************************************************************
+    [docexport Lfs_ApiZ_read]
+*//**
+    @brief Reads file data at the file position.
+    @param[in] lp  Lfs_Part_t object.
+    @param[out] buf  Buffer.
+    @param[in] size  Bytes to read.
+    @return Returns the number of bytes read (0 at end of file), negative
+    lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_read(struct Lfs_Part_t *lp, uint8_t *buf, uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_ApiZ_write]
+*//**
+    @brief Appends file data.
+    @param[in] lp  Lfs_Part_t object.
+    @param[in] buf  Data.
+    @param[in] size  Bytes to write.
+    @return Returns size, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_write(struct Lfs_Part_t *lp, const uint8_t *buf, uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_ApiZ_seek]
+*//**
+    @brief Sets the file position (a written file can only be at its end).
+    @param[in] lp  Lfs_Part_t object.
+    @param[in] off  Offset.
+    @param[in] whence  LFS_SEEK_SET, LFS_SEEK_CUR or LFS_SEEK_END.
+    @return Returns the new position, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_seek(struct Lfs_Part_t *lp, int off, int whence);
+
+/******************************************************************************
+    [docexport Lfs_ApiZ_size]
+*//**
+    @brief Gets the file data size.
+    @param[in] lp  Lfs_Part_t object.
+    @return Returns the size.
+******************************************************************************/
+int
+Lfs_ApiZ_size(struct Lfs_Part_t *lp);
+#endif
@@ -0,0 +1,19 @@
+/*******************************************************************************
+ *  @file: Lfs_Api_bench.h
+ *
+ *  @brief: Header for the Lfs_Api compressed file benchmark
+ *  (bench/Lfs_Api_bench.c). Built with CONFIG_LFS_API_BENCH.
+*******************************************************************************/
+#ifndef LFS_API_BENCH_H
+#define LFS_API_BENCH_H
+
+/******************************************************************************
+    [docexport Lfs_Api_bench]
+*//**
+    @brief Runs the compressed file benchmark.
+    @param[in] part_label  Registered partition (needs about 128 KB free).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_Api_bench(const char *part_label);
+#endif
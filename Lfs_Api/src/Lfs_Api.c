@@ -3,13 +3,28 @@
  *  
  *  @brief: API for interacting with an LFS file system.
 *******************************************************************************/
+#include <stdlib.h>
+#include <stdbool.h>
 #include "Lfs_Part.h"
+#include "Lfs_PartMap.h"
 #include "Lfs_Api.h"
+#include "Lfs_ApiZ.h"
 #include "LogPrint.h"
 #include "LogPrint_local.h"
 
 static const char *TAG = "Lfs_Api";
 
+/** @brief Trace handle of the open file (see Lfs_PartTrace.h). */
+#define TRACE_HANDLE(file)  ((unsigned int)(uintptr_t)(file))
+
+/** @brief Trace record of a plain file operation (compressed files are not
+    traced: their lfs operations differ from the calls). */
+#define TRACE_LOG(lp, ...)                                    \
+if (!(lp)->file_z)                                            \
+{                                                             \
+    Lfs_PartTrace_log((lp), __VA_ARGS__);                     \
+}
+
 #define CHECK_RETURN(call, ret)                               \
 if ((ret) < 0)                                                \
 {                                                             \
@@ -30,6 +45,8 @@ if ((ret) < 0)                                                \
         FSAPI_O_EXCL,        Fail if a file already exists
         FSAPI_O_TRUNC,       Truncate the existing file to zero size
         FSAPI_O_APPEND,      Move to end of file on every write
+        FSAPI_O_COMPRESS,    Write the file compressed (see Lfs_ApiZ.h)
+    A compressed file is read decompressed whatever the flags.
 ******************************************************************************/
 static int
 open(void *ctx, const char *path, int flags)
@@ -47,8 +64,40 @@ open(void *ctx, const char *path, int flags)
     if (flags & FSAPI_O_TRUNC)  _flags |= LFS_O_TRUNC;
     if (flags & FSAPI_O_APPEND) _flags |= LFS_O_APPEND;
 
-    int ret = lfs_file_open(lfs, file, path, _flags);
+    bool wr = (_flags & LFS_O_WRONLY) != 0;
+    int ret;
+
+    if (flags & FSAPI_O_COMPRESS)
+    {
+        ret = wr ? Lfs_ApiZ_open(lp, path, true) : LFS_ERR_INVAL;
+        CHECK_RETURN("open", ret);
+        return ret;
+    }
+    if (Lfs_ApiZ_isCompressed(lfs, path))
+    {
+        if (!wr)
+        {
+            ret = Lfs_ApiZ_open(lp, path, false);
+            CHECK_RETURN("open", ret);
+            return ret;
+        }
+        /* Only a rewrite can turn it back into a plain file. */
+        if (!(_flags & LFS_O_TRUNC))
+        {
+            LOGPRINT_ERROR("%s is compressed, open it for reading or with "
+                "truncate.", path);
+            return LFS_ERR_INVAL;
+        }
+        lfs_removeattr(lfs, path, LFS_APIZ_ATTR);
+    }
+
+    ret = lfs_file_open(lfs, file, path, _flags);
     CHECK_RETURN("open", ret);
+    if (ret >= 0)
+    {
+        Lfs_PartTrace_log(lp, "o %x %x %s", TRACE_HANDLE(file),
+            (unsigned int)_flags, path);
+    }
     return ret;
 }
 
@@ -67,8 +116,16 @@ close(void *ctx, int fd)
     lfs_file_t *file = &lp->file;
     (void)fd;
 
+    if (lp->file_z)
+    {
+        int ret = Lfs_ApiZ_close(lp);
+        CHECK_RETURN("close", ret);
+        return ret;
+    }
+
     int ret = lfs_file_close(lfs, file);
     CHECK_RETURN("close", ret);
+    Lfs_PartTrace_log(lp, "c %x", TRACE_HANDLE(file));
     return ret;
 }
 
@@ -98,8 +155,10 @@ seek(void *ctx, int fd, int off, int mode)
     case FSAPI_SEEK_END: whence = LFS_SEEK_END; break;
     default: return 1;
     }
-    new_off = lfs_file_seek(lfs, file, off, whence);
+    new_off = lp->file_z ? Lfs_ApiZ_seek(lp, off, whence) :
+        lfs_file_seek(lfs, file, off, whence);
     CHECK_RETURN("seek", new_off);
+    TRACE_LOG(lp, "s %x %d %d", TRACE_HANDLE(file), off, whence);
     return new_off;
 }
 
@@ -120,8 +179,10 @@ read(void *ctx, int fd, char *buf, int size)
     lfs_file_t *file = &lp->file;
     (void)fd;
 
-    int ret = lfs_file_read(lfs, file, buf, size);
+    int ret = lp->file_z ? Lfs_ApiZ_read(lp, (uint8_t *)buf, size) :
+        lfs_file_read(lfs, file, buf, size);
     CHECK_RETURN("read", ret);
+    TRACE_LOG(lp, "r %x %d", TRACE_HANDLE(file), size);
     return ret;
 }
 
@@ -142,8 +203,10 @@ write(void *ctx, int fd, char *buf, int size)
     lfs_file_t *file = &lp->file;
     (void)fd;
 
-    int ret = lfs_file_write(lfs, file, buf, size);
+    int ret = lp->file_z ? Lfs_ApiZ_write(lp, (const uint8_t *)buf, size) :
+        lfs_file_write(lfs, file, buf, size);
     CHECK_RETURN("write", ret);
+    TRACE_LOG(lp, "w %x %d", TRACE_HANDLE(file), size);
     return ret;
 }
 
@@ -163,11 +226,228 @@ fsize(void *ctx, int fd)
     lfs_file_t *file = &lp->file;
     (void)fd;
 
-    int ret = lfs_file_size(lfs, file);
+    int ret = lp->file_z ? Lfs_ApiZ_size(lp) : lfs_file_size(lfs, file);
     CHECK_RETURN("fsize", ret);
     return ret;
 }
 
+/******************************************************************************
+    prw
+*//**
+    @brief Positional vectored read or write, under one lock acquisition
+    (the seek and the transfers are one locked sequence).
+    @param[in] lp  Lfs_Part_t object.
+    @param[in] iov  Buffers.
+    @param[in] iovcnt  Number of buffers.
+    @param[in] offset  File offset.
+    @param[in] wr  Write (else read).
+    @return Returns the number of bytes transferred (less than requested at
+    end of file), or negative on error before any byte was transferred.
+******************************************************************************/
+static int
+prw(Lfs_Part_t *lp, const Fs_Api_Iovec *iov, int iovcnt, int offset, bool wr)
+{
+    lfs_t *lfs = &lp->lfs;
+    lfs_file_t *file = &lp->file;
+    int total = 0;
+    int ret;
+    int i;
+
+    RTOS_MUTEX_GET_RECURSIVE(lp->lock);
+    ret = lp->file_z ? Lfs_ApiZ_seek(lp, offset, LFS_SEEK_SET) :
+        lfs_file_seek(lfs, file, offset, LFS_SEEK_SET);
+    if (ret >= 0)
+    {
+        TRACE_LOG(lp, "s %x %d %d", TRACE_HANDLE(file), offset,
+            LFS_SEEK_SET);
+    }
+    for (i = 0; ret >= 0 && i < iovcnt; i++)
+    {
+        if (lp->file_z)
+        {
+            ret = wr ?
+                Lfs_ApiZ_write(lp, (const uint8_t *)iov[i].buf, iov[i].size) :
+                Lfs_ApiZ_read(lp, (uint8_t *)iov[i].buf, iov[i].size);
+        }
+        else if (wr)
+        {
+            ret = lfs_file_write(lfs, file, iov[i].buf, iov[i].size);
+        }
+        else
+        {
+            ret = lfs_file_read(lfs, file, iov[i].buf, iov[i].size);
+        }
+        if (ret < 0)
+        {
+            break;
+        }
+        TRACE_LOG(lp, "%c %x %d", wr ? 'w' : 'r', TRACE_HANDLE(file),
+            iov[i].size);
+        total += ret;
+        if (ret < iov[i].size)
+        {
+            break;
+        }
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lp->lock);
+
+    CHECK_RETURN(wr ? "pwrite" : "pread", ret);
+    return (ret < 0 && !total) ? ret : total;
+}
+
+/******************************************************************************
+    pread
+*//**
+    @brief File read at an offset.
+    @param[in] ctx  Context object holding Lfs_Part_t object.
+    @param[in] fd  Unused.
+    @param[in] buf  Pointer to buffer to copy bytes into.
+    @param[in] size  Number of bytes to read.
+    @param[in] offset  File offset.
+******************************************************************************/
+static int
+pread(void *ctx, int fd, char *buf, int size, int offset)
+{
+    Fs_Api_Iovec iov = {buf, size};
+    (void)fd;
+
+    return prw((Lfs_Part_t *)ctx, &iov, 1, offset, false);
+}
+
+/******************************************************************************
+    pwrite
+*//**
+    @brief File write at an offset.
+    @param[in] ctx  Context object holding Lfs_Part_t object.
+    @param[in] fd  Unused.
+    @param[in] buf  Pointer to buffer holding bytes to write.
+    @param[in] size  Number of bytes to write.
+    @param[in] offset  File offset.
+******************************************************************************/
+static int
+pwrite(void *ctx, int fd, char *buf, int size, int offset)
+{
+    Fs_Api_Iovec iov = {buf, size};
+    (void)fd;
+
+    return prw((Lfs_Part_t *)ctx, &iov, 1, offset, true);
+}
+
+/******************************************************************************
+    preadv
+*//**
+    @brief Vectored file read at an offset.
+    @param[in] ctx  Context object holding Lfs_Part_t object.
+    @param[in] fd  Unused.
+    @param[in] iov  Buffers to fill, in order.
+    @param[in] iovcnt  Number of buffers.
+    @param[in] offset  File offset.
+******************************************************************************/
+static int
+preadv(void *ctx, int fd, const Fs_Api_Iovec *iov, int iovcnt, int offset)
+{
+    (void)fd;
+
+    return prw((Lfs_Part_t *)ctx, iov, iovcnt, offset, false);
+}
+
+/******************************************************************************
+    pwritev
+*//**
+    @brief Vectored file write at an offset.
+    @param[in] ctx  Context object holding Lfs_Part_t object.
+    @param[in] fd  Unused.
+    @param[in] iov  Buffers to write, in order.
+    @param[in] iovcnt  Number of buffers.
+    @param[in] offset  File offset.
+******************************************************************************/
+static int
+pwritev(void *ctx, int fd, const Fs_Api_Iovec *iov, int iovcnt, int offset)
+{
+    (void)fd;
+
+    return prw((Lfs_Part_t *)ctx, iov, iovcnt, offset, true);
+}
+
+/******************************************************************************
+    map
+*//**
+    @brief Maps a whole file read-only (see Lfs_PartMap).
+    @param[in] ctx  Context object holding Lfs_Part_t object.
+    @param[in] path  File path.
+    @param[out] fmap  Map to fill.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+static int
+map(void *ctx, const char *path, Fs_Api_Map *fmap)
+{
+    Lfs_Part_t *lp = (Lfs_Part_t *)ctx;
+    Lfs_PartMap *lmap;
+    uint32_t i;
+    int ret;
+
+    /* The flash holds compressed data: callers fall back to read. */
+    if (Lfs_ApiZ_isCompressed(&lp->lfs, path))
+    {
+        LOGPRINT_DEBUG("%s is compressed, not mapped.", path);
+        return LFS_ERR_INVAL;
+    }
+
+    lmap = (Lfs_PartMap *)malloc(sizeof(Lfs_PartMap));
+    if (!lmap)
+    {
+        return -1;
+    }
+
+    ret = Lfs_PartMap_open(lmap, lp, path, 0);
+    CHECK_RETURN("map", ret);
+    if (ret < 0)
+    {
+        free(lmap);
+        return ret;
+    }
+
+    fmap->extents = (Fs_Api_Extent *)malloc(
+        (lmap->num_extents ? lmap->num_extents : 1)*sizeof(Fs_Api_Extent));
+    if (!fmap->extents)
+    {
+        Lfs_PartMap_close(lmap);
+        free(lmap);
+        return -1;
+    }
+
+    for (i = 0; i < lmap->num_extents; i++)
+    {
+        fmap->extents[i].data = (const char *)lmap->extents[i].data;
+        fmap->extents[i].size = lmap->extents[i].size;
+    }
+    fmap->num_extents = lmap->num_extents;
+    fmap->size = lmap->size;
+    fmap->handle = (void *)lmap;
+    return 0;
+}
+
+/******************************************************************************
+    unmap
+*//**
+    @brief Releases a map.
+    @param[in] ctx  Context object holding Lfs_Part_t object.
+    @param[in] fmap  Map filled by map.
+******************************************************************************/
+static void
+unmap(void *ctx, Fs_Api_Map *fmap)
+{
+    Lfs_PartMap *lmap = (Lfs_PartMap *)fmap->handle;
+    (void)ctx;
+
+    Lfs_PartMap_close(lmap);
+    free(lmap);
+    free(fmap->extents);
+    fmap->extents = NULL;
+    fmap->num_extents = 0;
+    fmap->handle = NULL;
+}
+
 /******************************************************************************
     [docimport Lfs_Api_init]
 *//**
@@ -185,13 +465,19 @@ Lfs_Api_init(Fs_Api *api, const char *part_label)
         return -1;
     }
 
-    api->ctx   = (void *)part;
-    api->open  = open;
-    api->close = close;
-    api->read  = read;
-    api->seek  = seek;
-    api->write = write;
-    api->fsize = fsize;
+    api->ctx     = (void *)part;
+    api->open    = open;
+    api->close   = close;
+    api->read    = read;
+    api->seek    = seek;
+    api->write   = write;
+    api->fsize   = fsize;
+    api->pread   = pread;
+    api->pwrite  = pwrite;
+    api->preadv  = preadv;
+    api->pwritev = pwritev;
+    api->map     = map;
+    api->unmap   = unmap;
 
     return 0;
 }
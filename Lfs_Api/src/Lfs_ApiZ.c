@@ -0,0 +1,723 @@
+/*******************************************************************************
+ *  @file: Lfs_ApiZ.c
+ *
+ *  @brief: Compressed file mode of Lfs_Api: block compressed files with a
+ *  block index for random reads.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_ApiZ.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_ApiZ";
+
+/** @brief LZ4 block format limits: shortest match, and the last match
+    starts LZ4_MFLIMIT bytes and ends LZ4_LAST_LITERALS bytes before the
+    end. */
+#define LZ4_MIN_MATCH           4
+#define LZ4_MFLIMIT             12
+#define LZ4_LAST_LITERALS       5
+
+#define ZFILE(lp)               ((Lfs_ApiZ_File *)(lp)->file_z)
+
+/******************************************************************************
+    read32
+*//**
+    @brief Unaligned 32 bit load.
+******************************************************************************/
+static inline uint32_t
+read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/******************************************************************************
+    hash4
+*//**
+    @brief Match table slot of the 4 bytes at p.
+******************************************************************************/
+static inline uint32_t
+hash4(const uint8_t *p)
+{
+    return (read32(p)*2654435761u) >> (32 - LFS_APIZ_HASH_BITS);
+}
+
+/******************************************************************************
+    put_len
+*//**
+    @brief Emits the length bytes following a token nibble of 15.
+******************************************************************************/
+static uint8_t *
+put_len(uint8_t *op, uint8_t *end, uint32_t len)
+{
+    for (; len >= 255; len -= 255)
+    {
+        if (op >= end)
+        {
+            return NULL;
+        }
+        *op++ = 255;
+    }
+    if (op >= end)
+    {
+        return NULL;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/******************************************************************************
+    put_seq
+*//**
+    @brief Emits one sequence: literals, then (if mlen) a match.
+    @return Returns the new output position, NULL if dst is full.
+******************************************************************************/
+static uint8_t *
+put_seq(
+    uint8_t *op,
+    uint8_t *end,
+    const uint8_t *lit,
+    uint32_t llen,
+    uint32_t offset,
+    uint32_t mlen)
+{
+    uint32_t m = mlen ? mlen - LZ4_MIN_MATCH : 0;
+    uint8_t *token;
+
+    CHECK_COND_RETURN(op >= end, NULL);
+    token = op++;
+    *token = (uint8_t)(((llen < 15 ? llen : 15) << 4) | (m < 15 ? m : 15));
+    if (llen >= 15)
+    {
+        op = put_len(op, end, llen - 15);
+        CHECK_COND_RETURN(!op, NULL);
+    }
+    CHECK_COND_RETURN((uint32_t)(end - op) < llen, NULL);
+    memcpy(op, lit, llen);
+    op += llen;
+    if (!mlen)
+    {
+        return op;
+    }
+
+    CHECK_COND_RETURN(end - op < 2, NULL);
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    if (m >= 15)
+    {
+        op = put_len(op, end, m - 15);
+    }
+    return op;
+}
+
+/******************************************************************************
+    [docimport Lfs_ApiZ_compress]
+*//**
+    @brief Compresses a buffer (LZ4 block format).
+    @param[in] src  Data.
+    @param[in] len  Data length (at most 64 KB).
+    @param[out] dst  Compressed data.
+    @param[in] max  Size of dst.
+    @param[in] hash  Match table of (1 << LFS_APIZ_HASH_BITS) entries.
+    @return Returns the compressed length, 0 if it is not smaller than len
+    or does not fit in max.
+******************************************************************************/
+uint32_t
+Lfs_ApiZ_compress(
+    const uint8_t *src,
+    uint32_t len,
+    uint8_t *dst,
+    uint32_t max,
+    uint16_t *hash)
+{
+    uint8_t *op = dst;
+    uint8_t *end = dst + (max < len ? max : len);
+    uint32_t ip = 0, anchor = 0;
+    uint32_t ref, h, mlen;
+
+    CHECK_COND_RETURN(len > 0x10000, 0);
+    memset(hash, 0, sizeof(uint16_t) << LFS_APIZ_HASH_BITS);
+
+    while (len >= LZ4_MFLIMIT + 1 && ip <= len - LZ4_MFLIMIT)
+    {
+        h = hash4(&src[ip]);
+        ref = hash[h];
+        hash[h] = (uint16_t)ip;
+        if (ref >= ip || read32(&src[ref]) != read32(&src[ip]))
+        {
+            ip++;
+            continue;
+        }
+
+        mlen = LZ4_MIN_MATCH;
+        while (ip + mlen < len - LZ4_LAST_LITERALS &&
+            src[ref + mlen] == src[ip + mlen])
+        {
+            mlen++;
+        }
+        op = put_seq(op, end, &src[anchor], ip - anchor, ip - ref, mlen);
+        if (!op)
+        {
+            return 0;
+        }
+        ip += mlen;
+        anchor = ip;
+    }
+
+    op = put_seq(op, end, &src[anchor], len - anchor, 0, 0);
+    if (!op || op >= end)
+    {
+        return 0;
+    }
+    return (uint32_t)(op - dst);
+}
+
+/******************************************************************************
+    get_len
+*//**
+    @brief Adds the length bytes following a token nibble of 15.
+******************************************************************************/
+static int
+get_len(const uint8_t *src, uint32_t len, uint32_t *ip, uint32_t *n)
+{
+    uint8_t b;
+
+    do
+    {
+        CHECK_COND_RETURN(*ip >= len, LFS_ERR_CORRUPT);
+        b = src[(*ip)++];
+        *n += b;
+    } while (b == 255);
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_ApiZ_decompress]
+*//**
+    @brief Decompresses a buffer (LZ4 block format).
+    @param[in] src  Compressed data.
+    @param[in] len  Compressed length.
+    @param[out] dst  Data.
+    @param[in] max  Size of dst.
+    @return Returns the data length, LFS_ERR_CORRUPT if src is malformed or
+    does not fit in max.
+******************************************************************************/
+int
+Lfs_ApiZ_decompress(
+    const uint8_t *src,
+    uint32_t len,
+    uint8_t *dst,
+    uint32_t max)
+{
+    uint32_t ip = 0, op = 0;
+    uint32_t n, offset;
+    uint8_t token;
+
+    while (ip < len)
+    {
+        token = src[ip++];
+
+        n = token >> 4;
+        if (n == 15 && get_len(src, len, &ip, &n) < 0)
+        {
+            return LFS_ERR_CORRUPT;
+        }
+        CHECK_COND_RETURN(n > len - ip || n > max - op, LFS_ERR_CORRUPT);
+        memcpy(&dst[op], &src[ip], n);
+        ip += n;
+        op += n;
+        if (ip == len)
+        {
+            break;
+        }
+
+        CHECK_COND_RETURN(len - ip < 2, LFS_ERR_CORRUPT);
+        offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        CHECK_COND_RETURN(!offset || offset > op, LFS_ERR_CORRUPT);
+
+        n = token & 15;
+        if (n == 15 && get_len(src, len, &ip, &n) < 0)
+        {
+            return LFS_ERR_CORRUPT;
+        }
+        n += LZ4_MIN_MATCH;
+        CHECK_COND_RETURN(n > max - op, LFS_ERR_CORRUPT);
+        /* Byte copy: the match may overlap the output. */
+        for (; n; n--, op++)
+        {
+            dst[op] = dst[op - offset];
+        }
+    }
+    return (int)op;
+}
+
+/******************************************************************************
+    [docimport Lfs_ApiZ_isCompressed]
+*//**
+    @brief Checks the marker attribute of a file.
+    @param[in] lfs  Mounted lfs.
+    @param[in] path  File.
+    @return Returns true if the file is compressed.
+******************************************************************************/
+bool
+Lfs_ApiZ_isCompressed(lfs_t *lfs, const char *path)
+{
+    uint8_t codec = 0;
+
+    return lfs_getattr(lfs, path, LFS_APIZ_ATTR, &codec, sizeof(codec)) ==
+        sizeof(codec) && codec == LFS_APIZ_CODEC_LZ4;
+}
+
+/******************************************************************************
+    zfile_free
+*//**
+    @brief Frees the compressed file state.
+******************************************************************************/
+static void
+zfile_free(Lfs_Part_t *lp)
+{
+    Lfs_ApiZ_File *zf = ZFILE(lp);
+
+    if (zf)
+    {
+        free(zf->index);
+        free(zf->blk_buf);
+        free(zf->z_buf);
+        free(zf->hash);
+        free(zf);
+        lp->file_z = NULL;
+    }
+}
+
+/******************************************************************************
+    blk_raw_len
+*//**
+    @brief File data length of block b.
+******************************************************************************/
+static uint32_t
+blk_raw_len(Lfs_ApiZ_File *zf, uint32_t b)
+{
+    uint32_t start = b*zf->block_size;
+
+    return (zf->size - start < zf->block_size) ?
+        zf->size - start : zf->block_size;
+}
+
+/******************************************************************************
+    load_index
+*//**
+    @brief Reads and checks the trailer and block index of an open file.
+******************************************************************************/
+static int
+load_index(Lfs_Part_t *lp, Lfs_ApiZ_File *zf)
+{
+    lfs_t *lfs = &lp->lfs;
+    lfs_file_t *file = &lp->file;
+    Lfs_ApiZ_Trailer tr;
+    lfs_soff_t fsize;
+    uint32_t index_off;
+    uint32_t i;
+    int ret;
+
+    fsize = lfs_file_size(lfs, file);
+    CHECK_COND_RETURN(fsize < (lfs_soff_t)sizeof(tr), LFS_ERR_CORRUPT);
+    ret = lfs_file_seek(lfs, file, fsize - sizeof(tr), LFS_SEEK_SET);
+    CHECK_COND_RETURN(ret < 0, ret);
+    ret = lfs_file_read(lfs, file, &tr, sizeof(tr));
+    CHECK_COND_RETURN(ret != sizeof(tr), ret < 0 ? ret : LFS_ERR_CORRUPT);
+
+    CHECK_COND_RETURN_MSG(tr.magic != LFS_APIZ_MAGIC ||
+        !tr.block_size || tr.block_size > LFS_APIZ_BLOCK_SIZE ||
+        tr.num_blocks != (tr.size + tr.block_size - 1)/tr.block_size ||
+        tr.num_blocks > (fsize - sizeof(tr))/sizeof(uint32_t),
+        LFS_ERR_CORRUPT, "Bad compressed file trailer.");
+
+    zf->size = tr.size;
+    zf->block_size = tr.block_size;
+    zf->num_blocks = tr.num_blocks;
+    zf->index_max = tr.num_blocks;
+    index_off = fsize - sizeof(tr) - tr.num_blocks*sizeof(uint32_t);
+    if (!tr.num_blocks)
+    {
+        return 0;
+    }
+
+    zf->index = (uint32_t *)malloc(tr.num_blocks*sizeof(uint32_t));
+    CHECK_COND_RETURN(!zf->index, LFS_ERR_NOMEM);
+    ret = lfs_file_seek(lfs, file, index_off, LFS_SEEK_SET);
+    CHECK_COND_RETURN(ret < 0, ret);
+    ret = lfs_file_read(lfs, file, zf->index,
+        tr.num_blocks*sizeof(uint32_t));
+    CHECK_COND_RETURN(ret != (int)(tr.num_blocks*sizeof(uint32_t)),
+        ret < 0 ? ret : LFS_ERR_CORRUPT);
+
+    /* Blocks are never larger than their data and end at the index. */
+    for (i = 0; i < tr.num_blocks; i++)
+    {
+        uint32_t start = i ? zf->index[i - 1] : 0;
+
+        CHECK_COND_RETURN_MSG(zf->index[i] <= start ||
+            zf->index[i] - start > blk_raw_len(zf, i), LFS_ERR_CORRUPT,
+            "Bad compressed file index.");
+    }
+    CHECK_COND_RETURN_MSG(zf->index[tr.num_blocks - 1] != index_off,
+        LFS_ERR_CORRUPT, "Bad compressed file index.");
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_ApiZ_open]
+*//**
+    @brief Opens a compressed file on the Lfs_Part_t file: created (and
+    truncated) for writing, or read.
+    @param[in] lp  Lfs_Part_t object.
+    @param[in] path  File.
+    @param[in] wr  Create and write (else read an existing compressed file).
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_open(Lfs_Part_t *lp, const char *path, bool wr)
+{
+    lfs_t *lfs = &lp->lfs;
+    Lfs_ApiZ_File *zf;
+    int ret;
+
+    CHECK_COND_RETURN_MSG(lp->file_z, LFS_ERR_INVAL,
+        "Compressed file already open.");
+    zf = (Lfs_ApiZ_File *)calloc(1, sizeof(Lfs_ApiZ_File));
+    CHECK_COND_RETURN(!zf, LFS_ERR_NOMEM);
+    lp->file_z = zf;
+
+    zf->wr = wr;
+    zf->block_size = LFS_APIZ_BLOCK_SIZE;
+    zf->blk_buf = (uint8_t *)malloc(LFS_APIZ_BLOCK_SIZE);
+    zf->z_buf = (uint8_t *)malloc(LFS_APIZ_BOUND(LFS_APIZ_BLOCK_SIZE));
+    if (wr)
+    {
+        zf->hash = (uint16_t *)malloc(sizeof(uint16_t) << LFS_APIZ_HASH_BITS);
+    }
+    if (!zf->blk_buf || !zf->z_buf || (wr && !zf->hash))
+    {
+        zfile_free(lp);
+        return LFS_ERR_NOMEM;
+    }
+
+    if (wr)
+    {
+        /* The marker is committed with the data on close. */
+        zf->codec = LFS_APIZ_CODEC_LZ4;
+        zf->attr.type = LFS_APIZ_ATTR;
+        zf->attr.buffer = &zf->codec;
+        zf->attr.size = sizeof(zf->codec);
+        zf->cfg.attrs = &zf->attr;
+        zf->cfg.attr_count = 1;
+        ret = lfs_file_opencfg(lfs, &lp->file, path,
+            LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC, &zf->cfg);
+        if (ret < 0)
+        {
+            zfile_free(lp);
+        }
+        return ret;
+    }
+
+    ret = lfs_file_open(lfs, &lp->file, path, LFS_O_RDONLY);
+    if (ret < 0)
+    {
+        zfile_free(lp);
+        return ret;
+    }
+    RTOS_MUTEX_GET_RECURSIVE(lp->lock);
+    ret = load_index(lp, zf);
+    RTOS_MUTEX_PUT_RECURSIVE(lp->lock);
+    if (ret < 0)
+    {
+        lfs_file_close(lfs, &lp->file);
+        zfile_free(lp);
+        return ret;
+    }
+    zf->blk = zf->num_blocks;
+    return 0;
+}
+
+/******************************************************************************
+    flush_block
+*//**
+    @brief Compresses and writes the block being filled, and indexes it.
+******************************************************************************/
+static int
+flush_block(Lfs_Part_t *lp, Lfs_ApiZ_File *zf)
+{
+    lfs_t *lfs = &lp->lfs;
+    const uint8_t *out = zf->blk_buf;
+    uint32_t *index;
+    uint32_t len;
+    int ret;
+
+    if (zf->num_blocks == zf->index_max)
+    {
+        index = (uint32_t *)realloc(zf->index,
+            (zf->index_max + 16)*sizeof(uint32_t));
+        CHECK_COND_RETURN(!index, LFS_ERR_NOMEM);
+        zf->index = index;
+        zf->index_max += 16;
+    }
+
+    len = Lfs_ApiZ_compress(zf->blk_buf, zf->blk_len, zf->z_buf,
+        LFS_APIZ_BOUND(LFS_APIZ_BLOCK_SIZE), zf->hash);
+    if (len)
+    {
+        out = zf->z_buf;
+    }
+    else
+    {
+        len = zf->blk_len;
+    }
+
+    ret = lfs_file_write(lfs, &lp->file, out, len);
+    CHECK_COND_RETURN(ret < 0, ret);
+    zf->index[zf->num_blocks] = (zf->num_blocks ?
+        zf->index[zf->num_blocks - 1] : 0) + len;
+    zf->num_blocks++;
+    zf->blk_len = 0;
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_ApiZ_close]
+*//**
+    @brief Closes the compressed file (a written file gets its last block,
+    index and trailer, then its marker attribute on the close).
+    @param[in] lp  Lfs_Part_t object.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_close(Lfs_Part_t *lp)
+{
+    Lfs_ApiZ_File *zf = ZFILE(lp);
+    lfs_t *lfs = &lp->lfs;
+    Lfs_ApiZ_Trailer tr;
+    int ret = 0;
+
+    CHECK_COND_RETURN(!zf, LFS_ERR_BADF);
+
+    if (zf->wr)
+    {
+        RTOS_MUTEX_GET_RECURSIVE(lp->lock);
+        if (zf->blk_len)
+        {
+            ret = flush_block(lp, zf);
+        }
+        if (ret >= 0 && zf->num_blocks)
+        {
+            ret = lfs_file_write(lfs, &lp->file, zf->index,
+                zf->num_blocks*sizeof(uint32_t));
+        }
+        if (ret >= 0)
+        {
+            tr.magic = LFS_APIZ_MAGIC;
+            tr.size = zf->size;
+            tr.block_size = zf->block_size;
+            tr.num_blocks = zf->num_blocks;
+            ret = lfs_file_write(lfs, &lp->file, &tr, sizeof(tr));
+        }
+        RTOS_MUTEX_PUT_RECURSIVE(lp->lock);
+        if (ret < 0)
+        {
+            LOGPRINT_ERROR("Error %d finishing compressed file.", ret);
+        }
+        else if (zf->size)
+        {
+            LOGPRINT_DEBUG("Compressed %u bytes to %u.",
+                (unsigned int)zf->size, (unsigned int)(zf->num_blocks ?
+                zf->index[zf->num_blocks - 1] : 0));
+        }
+    }
+
+    /* The close commits the data and the marker together; a file left
+       incomplete by an error fails the trailer and index checks on open. */
+    if (ret < 0)
+    {
+        lfs_file_close(lfs, &lp->file);
+    }
+    else
+    {
+        ret = lfs_file_close(lfs, &lp->file);
+    }
+    zfile_free(lp);
+    return ret;
+}
+
+/******************************************************************************
+    load_block
+*//**
+    @brief Reads and decompresses block b into blk_buf.
+******************************************************************************/
+static int
+load_block(Lfs_Part_t *lp, Lfs_ApiZ_File *zf, uint32_t b)
+{
+    lfs_t *lfs = &lp->lfs;
+    uint32_t start = b ? zf->index[b - 1] : 0;
+    uint32_t len = zf->index[b] - start;
+    uint32_t raw_len = blk_raw_len(zf, b);
+    int ret;
+
+    if (zf->blk == b)
+    {
+        return 0;
+    }
+    zf->blk = zf->num_blocks;
+
+    ret = lfs_file_seek(lfs, &lp->file, start, LFS_SEEK_SET);
+    CHECK_COND_RETURN(ret < 0, ret);
+    /* A block that did not shrink is stored as is. */
+    ret = lfs_file_read(lfs, &lp->file,
+        (len == raw_len) ? zf->blk_buf : zf->z_buf, len);
+    CHECK_COND_RETURN(ret != (int)len, ret < 0 ? ret : LFS_ERR_CORRUPT);
+    if (len != raw_len)
+    {
+        ret = Lfs_ApiZ_decompress(zf->z_buf, len, zf->blk_buf, raw_len);
+        CHECK_COND_RETURN_MSG(ret != (int)raw_len, LFS_ERR_CORRUPT,
+            "Bad compressed block.");
+    }
+    zf->blk = b;
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_ApiZ_read]
+*//**
+    @brief Reads file data at the file position.
+    @param[in] lp  Lfs_Part_t object.
+    @param[out] buf  Buffer.
+    @param[in] size  Bytes to read.
+    @return Returns the number of bytes read (0 at end of file), negative
+    lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_read(Lfs_Part_t *lp, uint8_t *buf, uint32_t size)
+{
+    Lfs_ApiZ_File *zf = ZFILE(lp);
+    uint32_t done = 0;
+    uint32_t b, off, n;
+    int ret = 0;
+
+    CHECK_COND_RETURN(!zf || zf->wr, LFS_ERR_BADF);
+
+    RTOS_MUTEX_GET_RECURSIVE(lp->lock);
+    while (done < size && zf->pos < zf->size)
+    {
+        b = zf->pos/zf->block_size;
+        ret = load_block(lp, zf, b);
+        if (ret < 0)
+        {
+            break;
+        }
+        off = zf->pos - b*zf->block_size;
+        n = blk_raw_len(zf, b) - off;
+        n = (n < size - done) ? n : size - done;
+        memcpy(&buf[done], &zf->blk_buf[off], n);
+        done += n;
+        zf->pos += n;
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lp->lock);
+
+    return (ret < 0 && !done) ? ret : (int)done;
+}
+
+/******************************************************************************
+    [docimport Lfs_ApiZ_write]
+*//**
+    @brief Appends file data.
+    @param[in] lp  Lfs_Part_t object.
+    @param[in] buf  Data.
+    @param[in] size  Bytes to write.
+    @return Returns size, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_write(Lfs_Part_t *lp, const uint8_t *buf, uint32_t size)
+{
+    Lfs_ApiZ_File *zf = ZFILE(lp);
+    uint32_t done = 0;
+    uint32_t n;
+    int ret = 0;
+
+    CHECK_COND_RETURN(!zf || !zf->wr, LFS_ERR_BADF);
+
+    RTOS_MUTEX_GET_RECURSIVE(lp->lock);
+    while (done < size)
+    {
+        n = zf->block_size - zf->blk_len;
+        n = (n < size - done) ? n : size - done;
+        memcpy(&zf->blk_buf[zf->blk_len], &buf[done], n);
+        zf->blk_len += n;
+        done += n;
+        if (zf->blk_len == zf->block_size)
+        {
+            ret = flush_block(lp, zf);
+            if (ret < 0)
+            {
+                break;
+            }
+        }
+    }
+    zf->size += done;
+    zf->pos = zf->size;
+    RTOS_MUTEX_PUT_RECURSIVE(lp->lock);
+
+    return (ret < 0) ? ret : (int)size;
+}
+
+/******************************************************************************
+    [docimport Lfs_ApiZ_seek]
+*//**
+    @brief Sets the file position (a written file can only be at its end).
+    @param[in] lp  Lfs_Part_t object.
+    @param[in] off  Offset.
+    @param[in] whence  LFS_SEEK_SET, LFS_SEEK_CUR or LFS_SEEK_END.
+    @return Returns the new position, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_ApiZ_seek(Lfs_Part_t *lp, int off, int whence)
+{
+    Lfs_ApiZ_File *zf = ZFILE(lp);
+    int64_t pos;
+
+    CHECK_COND_RETURN(!zf, LFS_ERR_BADF);
+
+    switch (whence)
+    {
+    case LFS_SEEK_SET: pos = off; break;
+    case LFS_SEEK_CUR: pos = (int64_t)zf->pos + off; break;
+    case LFS_SEEK_END: pos = (int64_t)zf->size + off; break;
+    default: return LFS_ERR_INVAL;
+    }
+    CHECK_COND_RETURN(pos < 0 || pos > INT32_MAX, LFS_ERR_INVAL);
+    CHECK_COND_RETURN_MSG(zf->wr && pos != zf->size, LFS_ERR_INVAL,
+        "Compressed files are written sequentially.");
+
+    zf->pos = (uint32_t)pos;
+    return (int)pos;
+}
+
+/******************************************************************************
+    [docimport Lfs_ApiZ_size]
+*//**
+    @brief Gets the file data size.
+    @param[in] lp  Lfs_Part_t object.
+    @return Returns the size.
+******************************************************************************/
+int
+Lfs_ApiZ_size(Lfs_Part_t *lp)
+{
+    Lfs_ApiZ_File *zf = ZFILE(lp);
+
+    CHECK_COND_RETURN(!zf, LFS_ERR_BADF);
+    return (int)zf->size;
+}
@@ -0,0 +1,1012 @@
+/*******************************************************************************
+ *  @file: Lfs_Part_bench.c
+ *
+ *  @brief: Filesystem benchmark suite for Lfs_Part on any Lfs_PartDev. With
+ *  a RAM or file device and simulated timings it runs on the linux (host)
+ *  target, so the stack can be measured off-target. Reports wall time,
+ *  simulated flash time and device operation counts per test. Directory
+ *  listing and lfs_stat are also run with the block read cache enabled
+ *  (tags: nc uncached, c1 cold cache, c2 warm cache), and file rewrites
+ *  with and without the pre-erased block pool. Paged listing (Lfs_PartRpc
+ *  dirlist) is run re-reading the directory per page, with a cursor, and
+ *  from a snapshot. Small settings/counters updates are run as one file per
+ *  key (lfs_helpers lfs_write_full) and in an Lfs_PartKv store, committed
+ *  per update and in batches. Telemetry appends are run with
+ *  lfs_write_full_append per record and through an Lfs_PartRing circular
+ *  log, with and without periodic syncs (write amplification: bytes
+ *  programmed per byte appended).
+ *
+ *  Usage (e.g. from app_main on the linux target):
+ *
+ *      #include "Lfs_Part_bench.h"
+ *      static Lfs_PartDev dev;
+ *      const Lfs_PartDev_Timing nor = LFS_PARTDEV_TIMING_SPI_NOR;
+ *      Lfs_PartDev_initRam(&dev, "bench", 2*1024*1024, LFS_PART_BLOCK_SIZE);
+ *      Lfs_PartDev_setTiming(&dev, &nor);
+ *      Lfs_Part_bench(&dev);
+*******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartWb.h"
+#include "Lfs_PartDir.h"
+#include "Lfs_PartKv.h"
+#include "Lfs_PartRing.h"
+#include "lfs_helpers.h"
+#include "SwTimer.h"
+#include "Lfs_Part_bench.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_Part_bench";
+
+/** @brief Minimum device size for the suite. */
+#define BENCH_MIN_DEV_SIZE      (1024*1024)
+#define BENCH_SEQ_FILE_SIZE     (128*1024)
+#define BENCH_IO_SIZE           512
+#define BENCH_RAND_IO_SIZE      256
+#define BENCH_RAND_OPS          256
+#define BENCH_SMALL_FILES       100
+#define BENCH_SMALL_FILE_SIZE   64
+#define BENCH_CACHE_BUDGET      (16*1024)
+/** @brief Maintenance test: files rewritten, with an idle period (one
+    Lfs_PartGc_step) after each. */
+#define BENCH_GC_FILES          32
+#define BENCH_GC_FILE_SIZE      (16*1024)
+#define BENCH_GC_SLOTS          8
+/** @brief Lfs_PartRpc dirlist page size (DirList_reply info_array). */
+#define BENCH_LIST_PAGE         8
+/** @brief Lfs_PartRpc filewrite chunk size. */
+#define BENCH_UPLOAD_CHUNK      1000
+/** @brief Key/value test: counters updated in turn, and updates per
+    commit in the batched run. */
+#define BENCH_KV_KEYS           32
+#define BENCH_KV_UPDATES        512
+#define BENCH_KV_BATCH          16
+/** @brief Circular log test: records appended, per record file appends
+    (slow, fewer), and bytes between syncs in the periodic sync run (1 s
+    at 1 KB/s). */
+#define BENCH_RING_REC_SIZE     64
+#define BENCH_RING_BYTES        (256*1024)
+#define BENCH_RING_FILE_BYTES   (16*1024)
+#define BENCH_RING_SYNC_BYTES   1024
+
+static Lfs_Part_t bench_fs;
+static uint8_t io_buf[BENCH_IO_SIZE];
+static uint8_t chunk_buf[BENCH_UPLOAD_CHUNK];
+static uint32_t rand_state;
+static Lfs_PartKv bench_kv_store;
+static Lfs_PartRing bench_ring_log;
+
+/** @brief Per test measurement. */
+typedef struct BenchMark
+{
+    SwTimer swt;
+    Lfs_PartDev_Stats start;
+
+} BenchMark;
+
+/******************************************************************************
+    bench_rand
+*//**
+    @brief Deterministic pseudo random numbers (LCG), for repeatable runs.
+******************************************************************************/
+static uint32_t
+bench_rand(void)
+{
+    rand_state = rand_state*1664525 + 1013904223;
+    return rand_state >> 8;
+}
+
+/******************************************************************************
+    mark_start
+*//**
+    @brief Starts a measurement.
+******************************************************************************/
+static void
+mark_start(BenchMark *m)
+{
+    Lfs_PartDev_getStats(bench_fs.dev, &m->start, false);
+    SwTimer_tic(&m->swt);
+}
+
+/******************************************************************************
+    mark_report
+*//**
+    @brief Ends a measurement and logs it.
+    @param[in] m  Measurement.
+    @param[in] name  Test name.
+    @param[in] ops  Number of operations in the test.
+    @param[in] bytes  Payload bytes moved (0 if not applicable).
+******************************************************************************/
+static void
+mark_report(BenchMark *m, const char *name, uint32_t ops, uint32_t bytes)
+{
+    uint64_t wall_us = SwTimer_toc(&m->swt);
+    Lfs_PartDev_Stats end;
+    uint64_t flash_us;
+
+    Lfs_PartDev_getStats(bench_fs.dev, &end, false);
+    flash_us = (end.sim_ns - m->start.sim_ns)/1000;
+
+    LOGPRINT_INFO("%-14s %6u ops %8u us wall %9u us flash "
+        "(%u rd %u pr %u er)",
+        name,
+        (unsigned)ops,
+        (unsigned)wall_us,
+        (unsigned)flash_us,
+        (unsigned)(end.reads - m->start.reads),
+        (unsigned)(end.progs - m->start.progs),
+        (unsigned)(end.erases - m->start.erases));
+
+    if (bytes && flash_us)
+    {
+        LOGPRINT_INFO("%-14s %u KB/s at simulated flash speed", "",
+            (unsigned)((uint64_t)bytes*1000000/1024/flash_us));
+    }
+}
+
+/******************************************************************************
+    bench_seq
+*//**
+    @brief Sequential write then read of one file.
+******************************************************************************/
+static int
+bench_seq(lfs_t *lfs)
+{
+    lfs_file_t file;
+    BenchMark m;
+    uint32_t i, n = BENCH_SEQ_FILE_SIZE/BENCH_IO_SIZE;
+    int ret;
+
+    memset(io_buf, 0x5a, sizeof(io_buf));
+
+    mark_start(&m);
+    ret = lfs_file_open(lfs, &file, "seq.bin",
+        LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+    for (i = 0; i < n; i++)
+    {
+        ret = lfs_file_write(lfs, &file, io_buf, BENCH_IO_SIZE);
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "write failed.");
+    }
+    lfs_file_close(lfs, &file);
+    mark_report(&m, "seq write", n, BENCH_SEQ_FILE_SIZE);
+
+    mark_start(&m);
+    ret = lfs_file_open(lfs, &file, "seq.bin", LFS_O_RDONLY);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+    for (i = 0; i < n; i++)
+    {
+        ret = lfs_file_read(lfs, &file, io_buf, BENCH_IO_SIZE);
+        CHECK_COND_RETURN_MSG(ret != BENCH_IO_SIZE, -1, "read failed.");
+    }
+    lfs_file_close(lfs, &file);
+    mark_report(&m, "seq read", n, BENCH_SEQ_FILE_SIZE);
+
+    return 0;
+}
+
+/******************************************************************************
+    bench_upload
+*//**
+    @brief RPC style upload: the seq file size in filewrite sized chunks,
+    written directly without program coalescing, then through a block sized
+    write-behind buffer with coalescing.
+******************************************************************************/
+static int
+bench_upload(lfs_t *lfs)
+{
+    uint32_t n = BENCH_SEQ_FILE_SIZE/BENCH_UPLOAD_CHUNK;
+    lfs_file_t file;
+    Lfs_PartWb wb;
+    BenchMark m;
+    uint32_t pass, i;
+    int ret;
+
+    memset(chunk_buf, 0xa5, sizeof(chunk_buf));
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        Lfs_Part_setCoalesce(&bench_fs, pass == 1);
+
+        mark_start(&m);
+        ret = lfs_file_open(lfs, &file, "up.bin",
+            LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+        if (pass == 1)
+        {
+            ret = Lfs_PartWb_init(&wb, lfs, &file, LFS_PART_BLOCK_SIZE);
+            CHECK_COND_RETURN_MSG(ret < 0, ret, "Error allocating buffer.");
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            ret = (pass == 1) ?
+                Lfs_PartWb_write(&wb, chunk_buf, BENCH_UPLOAD_CHUNK) :
+                lfs_file_write(lfs, &file, chunk_buf, BENCH_UPLOAD_CHUNK);
+            CHECK_COND_RETURN_MSG(ret < 0, ret, "write failed.");
+        }
+
+        if (pass == 1)
+        {
+            ret = Lfs_PartWb_deinit(&wb);
+            CHECK_COND_RETURN_MSG(ret < 0, ret, "flush failed.");
+        }
+        lfs_file_close(lfs, &file);
+        mark_report(&m, (pass == 1) ? "upload wb" : "upload direct", n,
+            n*BENCH_UPLOAD_CHUNK);
+
+        ret = lfs_remove(lfs, "up.bin");
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "remove failed.");
+    }
+
+    Lfs_Part_setCoalesce(&bench_fs, LFS_PART_COALESCE_PROGS);
+    return 0;
+}
+
+/******************************************************************************
+    bench_random
+*//**
+    @brief Random reads, then random in-place writes, within the seq file.
+******************************************************************************/
+static int
+bench_random(lfs_t *lfs)
+{
+    uint32_t slots = BENCH_SEQ_FILE_SIZE/BENCH_RAND_IO_SIZE;
+    lfs_file_t file;
+    BenchMark m;
+    uint32_t i;
+    int ret;
+
+    mark_start(&m);
+    ret = lfs_file_open(lfs, &file, "seq.bin", LFS_O_RDONLY);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+    for (i = 0; i < BENCH_RAND_OPS; i++)
+    {
+        lfs_file_seek(lfs, &file, (bench_rand() % slots)*BENCH_RAND_IO_SIZE,
+            LFS_SEEK_SET);
+        ret = lfs_file_read(lfs, &file, io_buf, BENCH_RAND_IO_SIZE);
+        CHECK_COND_RETURN_MSG(ret != BENCH_RAND_IO_SIZE, -1, "read failed.");
+    }
+    lfs_file_close(lfs, &file);
+    mark_report(&m, "rand read", BENCH_RAND_OPS,
+        BENCH_RAND_OPS*BENCH_RAND_IO_SIZE);
+
+    mark_start(&m);
+    ret = lfs_file_open(lfs, &file, "seq.bin", LFS_O_RDWR);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+    for (i = 0; i < BENCH_RAND_OPS/4; i++)
+    {
+        lfs_file_seek(lfs, &file, (bench_rand() % slots)*BENCH_RAND_IO_SIZE,
+            LFS_SEEK_SET);
+        ret = lfs_file_write(lfs, &file, io_buf, BENCH_RAND_IO_SIZE);
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "write failed.");
+    }
+    lfs_file_close(lfs, &file);
+    mark_report(&m, "rand write", BENCH_RAND_OPS/4,
+        BENCH_RAND_OPS/4*BENCH_RAND_IO_SIZE);
+
+    return lfs_remove(lfs, "seq.bin");
+}
+
+/******************************************************************************
+    bench_small_files
+*//**
+    @brief Small file create then delete.
+******************************************************************************/
+static int
+bench_small_files(lfs_t *lfs)
+{
+    lfs_file_t file;
+    BenchMark m;
+    char path[32];
+    uint32_t i;
+    int ret;
+
+    ret = lfs_mkdir(lfs, "small");
+    CHECK_COND_RETURN_MSG(ret < 0 && ret != LFS_ERR_EXIST, ret, "mkdir failed.");
+
+    mark_start(&m);
+    for (i = 0; i < BENCH_SMALL_FILES; i++)
+    {
+        snprintf(path, sizeof(path), "small/f%u", (unsigned)i);
+        ret = lfs_file_open(lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT);
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+        lfs_file_write(lfs, &file, io_buf, BENCH_SMALL_FILE_SIZE);
+        lfs_file_close(lfs, &file);
+    }
+    mark_report(&m, "small create", BENCH_SMALL_FILES, 0);
+
+    mark_start(&m);
+    for (i = 0; i < BENCH_SMALL_FILES; i++)
+    {
+        snprintf(path, sizeof(path), "small/f%u", (unsigned)i);
+        ret = lfs_remove(lfs, path);
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "remove failed.");
+    }
+    mark_report(&m, "small delete", BENCH_SMALL_FILES, 0);
+
+    return lfs_remove(lfs, "small");
+}
+
+/******************************************************************************
+    list_dir
+*//**
+    @brief Timed listing of directory d<num>.
+******************************************************************************/
+static int
+list_dir(lfs_t *lfs, uint32_t num, const char *tag)
+{
+    struct lfs_info info;
+    lfs_dir_t dir;
+    BenchMark m;
+    char dirname[16];
+    char name[24];
+    uint32_t found = 0;
+    int ret;
+
+    snprintf(dirname, sizeof(dirname), "d%u", (unsigned)num);
+
+    mark_start(&m);
+    ret = lfs_dir_open(lfs, &dir, dirname);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "dir open failed.");
+    while (lfs_dir_read(lfs, &dir, &info) > 0)
+    {
+        found += (info.type == LFS_TYPE_REG);
+    }
+    lfs_dir_close(lfs, &dir);
+    snprintf(name, sizeof(name), "dirlist %u%s", (unsigned)num, tag);
+    mark_report(&m, name, found, 0);
+
+    CHECK_COND_RETURN_MSG(found != num, -1, "Directory listing mismatch.");
+    return 0;
+}
+
+/******************************************************************************
+    bench_dirlist
+*//**
+    @brief Lists a directory holding num empty files (creation not timed).
+******************************************************************************/
+static int
+bench_dirlist(lfs_t *lfs, uint32_t num)
+{
+    lfs_file_t file;
+    char dirname[16];
+    char path[32];
+    uint32_t i;
+    int ret;
+
+    snprintf(dirname, sizeof(dirname), "d%u", (unsigned)num);
+    ret = lfs_mkdir(lfs, dirname);
+    CHECK_COND_RETURN_MSG(ret < 0 && ret != LFS_ERR_EXIST, ret, "mkdir failed.");
+    for (i = 0; i < num; i++)
+    {
+        snprintf(path, sizeof(path), "%s/e%u", dirname, (unsigned)i);
+        ret = lfs_file_open(lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT);
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+        lfs_file_close(lfs, &file);
+    }
+
+    return list_dir(lfs, num, "");
+}
+
+/******************************************************************************
+    count_entry
+*//**
+    @brief Lfs_PartDir_list callback counting listed files.
+******************************************************************************/
+static void
+count_entry(
+    void *ctx,
+    uint32_t idx,
+    uint8_t type,
+    uint32_t size,
+    const char *name)
+{
+    (void)idx;
+    (void)size;
+    (void)name;
+    *(uint32_t *)ctx += (type == LFS_TYPE_REG);
+}
+
+/******************************************************************************
+    list_pages_restart
+*//**
+    @brief Paged listing as dirlist did without cursors: every page opens
+    the directory and skips to start_idx.
+******************************************************************************/
+static int
+list_pages_restart(lfs_t *lfs, const char *path, uint32_t *found)
+{
+    struct lfs_info info;
+    lfs_dir_t dir;
+    uint32_t start_idx = 0;
+    uint32_t idx, listed;
+    int ret;
+
+    do
+    {
+        ret = lfs_dir_open(lfs, &dir, path);
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "dir open failed.");
+        idx = 0;
+        listed = 0;
+        while ((ret = lfs_dir_read(lfs, &dir, &info)) > 0)
+        {
+            if (idx++ >= start_idx && listed < BENCH_LIST_PAGE)
+            {
+                listed++;
+                *found += (info.type == LFS_TYPE_REG);
+            }
+        }
+        lfs_dir_close(lfs, &dir);
+        CHECK_COND_RETURN(ret < 0, ret);
+        start_idx += listed;
+    } while (start_idx < idx);
+    return 0;
+}
+
+/******************************************************************************
+    list_pages
+*//**
+    @brief Paged listing through Lfs_PartDir, as the dirlist RPC client
+    does it.
+******************************************************************************/
+static int
+list_pages(const char *path, uint32_t *found)
+{
+    Lfs_PartDir_Page page = {0};
+    uint32_t start_idx = 0;
+    int ret;
+
+    do
+    {
+        ret = Lfs_PartDir_list(&bench_fs, path, start_idx, page.cursor,
+            BENCH_LIST_PAGE, count_entry, found, &page);
+        CHECK_COND_RETURN(ret < 0, ret);
+        start_idx += page.count;
+    } while (page.count && (page.cursor || start_idx < page.num_entries));
+    return 0;
+}
+
+/******************************************************************************
+    bench_list_pages
+*//**
+    @brief Timed paged listing of directory d<num> (from bench_dirlist):
+    re-reading per page, with a cursor, and from a snapshot (cold, warm).
+******************************************************************************/
+static int
+bench_list_pages(lfs_t *lfs, uint32_t num)
+{
+    static const char *const tags[] = {"restart", "cursor", "snap c1",
+        "snap c2"};
+    BenchMark m;
+    char dirname[16];
+    char name[24];
+    uint32_t found;
+    uint32_t i;
+    int ret = 0;
+
+    snprintf(dirname, sizeof(dirname), "d%u", (unsigned)num);
+
+    for (i = 0; i < sizeof(tags)/sizeof(tags[0]); i++)
+    {
+        if (i == 0 || i == 2)
+        {
+            Lfs_PartDir_setSnapshotSize(i ? LFS_PARTDIR_SNAPSHOT_SIZE : 0);
+        }
+        found = 0;
+        mark_start(&m);
+        ret = (i == 0) ? list_pages_restart(lfs, dirname, &found) :
+            list_pages(dirname, &found);
+        snprintf(name, sizeof(name), "ls %u %s", (unsigned)num, tags[i]);
+        mark_report(&m, name, found, 0);
+        CHECK_COND_GOTO(ret < 0, done);
+        CHECK_COND_GOTO_MSG(found != num, done, "Paged listing mismatch.");
+    }
+
+done:
+    Lfs_PartDir_release(&bench_fs);
+    Lfs_PartDir_setSnapshotSize(LFS_PARTDIR_SNAPSHOT_SIZE);
+    return (ret < 0) ? ret : ((found != num) ? -1 : 0);
+}
+
+/******************************************************************************
+    bench_exists
+*//**
+    @brief Timed existence checks (lfs_stat) in directory d<num>: every entry
+    plus as many missing names.
+******************************************************************************/
+static int
+bench_exists(lfs_t *lfs, uint32_t num, const char *tag)
+{
+    struct lfs_info info;
+    BenchMark m;
+    char path[32];
+    char name[24];
+    uint32_t i, found = 0;
+
+    mark_start(&m);
+    for (i = 0; i < 2*num; i++)
+    {
+        snprintf(path, sizeof(path), "d%u/e%u", (unsigned)num, (unsigned)i);
+        found += (lfs_stat(lfs, path, &info) == 0);
+    }
+    snprintf(name, sizeof(name), "exists %u%s", (unsigned)num, tag);
+    mark_report(&m, name, 2*num, 0);
+
+    CHECK_COND_RETURN_MSG(found != num, -1, "Existence check mismatch.");
+    return 0;
+}
+
+/******************************************************************************
+    bench_cache
+*//**
+    @brief Directory listing and lfs_stat latency without, then with, the
+    block read cache (directories from bench_dirlist).
+******************************************************************************/
+static int
+bench_cache(lfs_t *lfs, uint32_t budget)
+{
+    static const uint32_t dir_sizes[] = {100, 1000};
+    static const char *tags[] = {" nc", " c1", " c2"};
+    Lfs_PartCache_Stats cs;
+    uint32_t pass, i;
+    int ret;
+
+    /* Pass 0 uncached, pass 1 warms the cache, pass 2 runs hot. */
+    for (pass = 0; pass < 3; pass++)
+    {
+        if (pass == 1)
+        {
+            ret = Lfs_Part_enableCache(&bench_fs, budget, 0);
+            CHECK_COND_RETURN_MSG(ret != ESP_OK, -1, "Error enabling cache.");
+        }
+
+        for (i = 0; i < sizeof(dir_sizes)/sizeof(dir_sizes[0]); i++)
+        {
+            ret = list_dir(lfs, dir_sizes[i], tags[pass]);
+            CHECK_COND_RETURN(ret < 0, ret);
+            ret = bench_exists(lfs, dir_sizes[i], tags[pass]);
+            CHECK_COND_RETURN(ret < 0, ret);
+        }
+
+        if (pass > 0)
+        {
+            Lfs_Part_getCacheStats(&bench_fs, &cs, true);
+            LOGPRINT_INFO("Cache %u B pass %u: %u hits %u misses "
+                "(%u%% hit) %u evictions",
+                (unsigned)budget, (unsigned)pass,
+                (unsigned)cs.hits, (unsigned)cs.misses,
+                (unsigned)((uint64_t)cs.hits*100 /
+                    ((cs.hits + cs.misses) ? (cs.hits + cs.misses) : 1)),
+                (unsigned)cs.evictions);
+        }
+    }
+
+    Lfs_Part_enableCache(&bench_fs, 0, 0);
+    return 0;
+}
+
+/******************************************************************************
+    bench_gc
+*//**
+    @brief Foreground write latency without, then with, the pre-erased
+    block pool. Files are rewritten in turn, and the application is idle
+    (one maintenance pass) between files; only the writes are timed.
+******************************************************************************/
+static int
+bench_gc(lfs_t *lfs)
+{
+    Lfs_PartGc_Config config = LFS_PARTGC_CONFIG_DEFAULT;
+    Lfs_PartDev_Stats before, after;
+    Lfs_PartGc_Stats gs;
+    lfs_file_t file;
+    uint64_t fg_ns;
+    uint32_t erases;
+    char path[32];
+    uint32_t pass, i, n;
+    int ret;
+
+    /* The application drives the passes; the pool covers one file. */
+    config.period_ms = 0;
+    config.pool_blocks = BENCH_GC_FILE_SIZE/LFS_PART_BLOCK_SIZE + 2;
+    config.erase_budget = config.pool_blocks;
+
+    memset(io_buf, 0x3c, sizeof(io_buf));
+    for (pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+        {
+            ret = Lfs_PartGc_start(&bench_fs, &config);
+            CHECK_COND_RETURN_MSG(ret < 0, ret, "Error starting gc.");
+        }
+
+        fg_ns = 0;
+        erases = 0;
+        for (i = 0; i < BENCH_GC_FILES; i++)
+        {
+            snprintf(path, sizeof(path), "gc%u.bin",
+                (unsigned)(i % BENCH_GC_SLOTS));
+
+            Lfs_PartDev_getStats(bench_fs.dev, &before, false);
+            ret = lfs_file_open(lfs, &file, path,
+                LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+            CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+            for (n = 0; n < BENCH_GC_FILE_SIZE/BENCH_IO_SIZE; n++)
+            {
+                ret = lfs_file_write(lfs, &file, io_buf, BENCH_IO_SIZE);
+                CHECK_COND_RETURN_MSG(ret < 0, ret, "write failed.");
+            }
+            lfs_file_close(lfs, &file);
+            Lfs_PartDev_getStats(bench_fs.dev, &after, false);
+            fg_ns += after.sim_ns - before.sim_ns;
+            erases += after.erases - before.erases;
+
+            ret = Lfs_PartGc_step(&bench_fs);
+            CHECK_COND_RETURN_MSG(ret < 0, ret, "gc pass failed.");
+        }
+
+        LOGPRINT_INFO("%-14s %6u ops %9u us flash (%u er inline)",
+            (pass == 1) ? "rewrite gc" : "rewrite",
+            (unsigned)BENCH_GC_FILES,
+            (unsigned)(fg_ns/1000),
+            (unsigned)erases);
+    }
+
+    Lfs_PartGc_getStats(&bench_fs, &gs, true);
+    LOGPRINT_INFO("Gc: %u passes, %u pre-erased, %u hits %u misses",
+        (unsigned)gs.passes, (unsigned)gs.pre_erases,
+        (unsigned)gs.hits, (unsigned)gs.misses);
+
+    Lfs_PartGc_stop(&bench_fs);
+    for (i = 0; i < BENCH_GC_SLOTS; i++)
+    {
+        snprintf(path, sizeof(path), "gc%u.bin", (unsigned)i);
+        lfs_remove(lfs, path);
+    }
+    return 0;
+}
+
+/******************************************************************************
+    kv_run
+*//**
+    @brief Timed counter updates (commit every batch updates), read back,
+    then a timed reopen (index rebuild).
+******************************************************************************/
+static int
+kv_run(uint32_t batch, const char *name)
+{
+    Lfs_PartKv *kv = &bench_kv_store;
+    Lfs_PartKv_Stats ks;
+    uint32_t i, value;
+    char key[16];
+    BenchMark m;
+    int ret;
+
+    ret = Lfs_PartKv_open(kv, &bench_fs, "bench.kv", BENCH_KV_KEYS);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+
+    mark_start(&m);
+    for (i = 0; i < BENCH_KV_UPDATES; i++)
+    {
+        snprintf(key, sizeof(key), "cnt%u", (unsigned)(i % BENCH_KV_KEYS));
+        ret = Lfs_PartKv_set(kv, key, &i, sizeof(i));
+        if (ret >= 0 && (i + 1) % batch == 0)
+        {
+            ret = Lfs_PartKv_commit(kv);
+        }
+        CHECK_COND_GOTO(ret < 0, done);
+    }
+    mark_report(&m, name, BENCH_KV_UPDATES, 0);
+
+    mark_start(&m);
+    for (i = 0; i < BENCH_KV_KEYS; i++)
+    {
+        snprintf(key, sizeof(key), "cnt%u", (unsigned)i);
+        ret = Lfs_PartKv_get(kv, key, &value, sizeof(value));
+        if (ret != sizeof(value) ||
+            value != BENCH_KV_UPDATES - BENCH_KV_KEYS + i)
+        {
+            LOGPRINT_ERROR("get failed.");
+            ret = -1;
+            goto done;
+        }
+    }
+    mark_report(&m, "kv get", BENCH_KV_KEYS, 0);
+
+    Lfs_PartKv_getStats(kv, &ks, true);
+    LOGPRINT_INFO("%-14s %u commits, %u compactions, log %u bytes", "",
+        (unsigned)ks.commits, (unsigned)ks.compactions,
+        (unsigned)ks.log_size);
+    Lfs_PartKv_close(kv);
+
+    mark_start(&m);
+    ret = Lfs_PartKv_open(kv, &bench_fs, "bench.kv", BENCH_KV_KEYS);
+    mark_report(&m, "kv reopen", 1, 0);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "reopen failed.");
+
+done:
+    Lfs_PartKv_close(kv);
+    lfs_remove(&bench_fs.lfs, "bench.kv");
+    return (ret < 0) ? ret : 0;
+}
+
+/******************************************************************************
+    bench_kv
+*//**
+    @brief Counter updates as one file per key (lfs_write_full, the way
+    settings are stored without a store), then in a key/value store with a
+    commit per update and per BENCH_KV_BATCH updates.
+******************************************************************************/
+static int
+bench_kv(lfs_t *lfs)
+{
+    uint32_t i, value;
+    char path[32];
+    BenchMark m;
+    int ret;
+
+    ret = lfs_mkdir(lfs, "cfg");
+    CHECK_COND_RETURN_MSG(ret < 0 && ret != LFS_ERR_EXIST, ret, "mkdir failed.");
+
+    mark_start(&m);
+    for (i = 0; i < BENCH_KV_UPDATES; i++)
+    {
+        snprintf(path, sizeof(path), "cfg/cnt%u",
+            (unsigned)(i % BENCH_KV_KEYS));
+        ret = lfs_write_full(lfs, path, 0, LFS_SEEK_SET, &i, sizeof(i));
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "write failed.");
+    }
+    mark_report(&m, "file per key", BENCH_KV_UPDATES, 0);
+
+    mark_start(&m);
+    for (i = 0; i < BENCH_KV_KEYS; i++)
+    {
+        snprintf(path, sizeof(path), "cfg/cnt%u", (unsigned)i);
+        ret = lfs_read_full(lfs, path, 0, LFS_SEEK_SET, &value,
+            sizeof(value));
+        CHECK_COND_RETURN_MSG(ret < 0 ||
+            value != BENCH_KV_UPDATES - BENCH_KV_KEYS + i, -1, "read failed.");
+    }
+    mark_report(&m, "file get", BENCH_KV_KEYS, 0);
+
+    for (i = 0; i < BENCH_KV_KEYS; i++)
+    {
+        snprintf(path, sizeof(path), "cfg/cnt%u", (unsigned)i);
+        lfs_remove(lfs, path);
+    }
+    lfs_remove(lfs, "cfg");
+
+    ret = kv_run(1, "kv commit");
+    CHECK_COND_RETURN(ret < 0, ret);
+    return kv_run(BENCH_KV_BATCH, "kv batch");
+}
+
+/******************************************************************************
+    report_amp
+*//**
+    @brief Logs the write amplification since the start of a measurement.
+******************************************************************************/
+static void
+report_amp(BenchMark *m, uint32_t bytes)
+{
+    Lfs_PartDev_Stats end;
+    uint64_t amp;
+
+    Lfs_PartDev_getStats(bench_fs.dev, &end, false);
+    amp = (end.prog_bytes - m->start.prog_bytes)*100/bytes;
+    LOGPRINT_INFO("%-14s %u.%02u x write amplification", "",
+        (unsigned)(amp/100), (unsigned)(amp % 100));
+}
+
+/******************************************************************************
+    ring_run
+*//**
+    @brief Timed appends to a circular log (sync every sync_bytes, 0: none),
+    then reads back the records kept.
+******************************************************************************/
+static int
+ring_run(uint32_t sync_bytes, const char *name)
+{
+    Lfs_PartRing_Config config = LFS_PARTRING_CONFIG_DEFAULT;
+    Lfs_PartRing *ring = &bench_ring_log;
+    uint8_t rec[BENCH_RING_REC_SIZE];
+    Lfs_PartRing_Stats rs;
+    uint64_t tail, head, off;
+    uint32_t i;
+    BenchMark m;
+    int ret;
+
+    config.seg_size = 4*LFS_PART_BLOCK_SIZE;
+    config.flush_ms = 0;
+    ret = Lfs_PartRing_open(ring, &bench_fs, "ring", &config);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "open failed.");
+
+    mark_start(&m);
+    for (i = 0; i < BENCH_RING_BYTES/sizeof(rec); i++)
+    {
+        memset(rec, (uint8_t)i, sizeof(rec));
+        ret = Lfs_PartRing_append(ring, rec, sizeof(rec));
+        if (ret >= 0 && sync_bytes && (i + 1)*sizeof(rec) % sync_bytes == 0)
+        {
+            ret = Lfs_PartRing_sync(ring);
+        }
+        CHECK_COND_GOTO(ret < 0, done);
+    }
+    ret = Lfs_PartRing_sync(ring);
+    CHECK_COND_GOTO(ret < 0, done);
+    mark_report(&m, name, BENCH_RING_BYTES/sizeof(rec), BENCH_RING_BYTES);
+    report_amp(&m, BENCH_RING_BYTES);
+
+    /* The records kept are the last ones appended. */
+    Lfs_PartRing_bounds(ring, &tail, &head);
+    for (off = tail; off < head; off += sizeof(rec))
+    {
+        ret = Lfs_PartRing_read(ring, off, rec, sizeof(rec));
+        if (ret != sizeof(rec) || rec[0] != (uint8_t)(off/sizeof(rec)) ||
+            rec[sizeof(rec) - 1] != rec[0])
+        {
+            LOGPRINT_ERROR("read failed.");
+            ret = -1;
+            goto done;
+        }
+    }
+    Lfs_PartRing_getStats(ring, &rs, true);
+    LOGPRINT_INFO("%-14s %u writes, %u syncs, %u segments, %u KB kept", "",
+        (unsigned)rs.writes, (unsigned)rs.syncs, (unsigned)rs.segments,
+        (unsigned)((head - tail)/1024));
+
+done:
+    Lfs_PartRing_close(ring);
+    for (i = 0; i < config.num_segs; i++)
+    {
+        char path[16];
+
+        snprintf(path, sizeof(path), "ring/%u", (unsigned)i);
+        lfs_remove(&bench_fs.lfs, path);
+    }
+    lfs_remove(&bench_fs.lfs, "ring/ring");
+    lfs_remove(&bench_fs.lfs, "ring");
+    return (ret < 0) ? ret : 0;
+}
+
+/******************************************************************************
+    bench_ring
+*//**
+    @brief Telemetry appends: one lfs_write_full_append per record (the file
+    opened, appended and closed each time), then through a circular log.
+******************************************************************************/
+static int
+bench_ring(lfs_t *lfs)
+{
+    uint8_t rec[BENCH_RING_REC_SIZE];
+    BenchMark m;
+    uint32_t i;
+    int ret;
+
+    memset(rec, 0x5a, sizeof(rec));
+    mark_start(&m);
+    for (i = 0; i < BENCH_RING_FILE_BYTES/sizeof(rec); i++)
+    {
+        ret = lfs_write_full_append(lfs, "telemetry.log", rec, sizeof(rec));
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "append failed.");
+    }
+    mark_report(&m, "file append", BENCH_RING_FILE_BYTES/sizeof(rec),
+        BENCH_RING_FILE_BYTES);
+    report_amp(&m, BENCH_RING_FILE_BYTES);
+    lfs_remove(lfs, "telemetry.log");
+
+    ret = ring_run(0, "ring");
+    CHECK_COND_RETURN(ret < 0, ret);
+    return ring_run(BENCH_RING_SYNC_BYTES, "ring sync 1K");
+}
+
+/******************************************************************************
+    bench_mount
+*//**
+    @brief Unmount and timed mount (filesystem must be mounted).
+******************************************************************************/
+static int
+bench_mount(lfs_t *lfs, const char *name)
+{
+    BenchMark m;
+    int ret;
+
+    lfs_unmount(lfs);
+
+    mark_start(&m);
+    ret = lfs_mount(lfs, &bench_fs.cfg);
+    mark_report(&m, name, 1, 0);
+
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "mount failed.");
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_bench]
+*//**
+    @brief Runs the benchmark suite. The device is formatted.
+    @param[in] dev  Pointer to initialized Lfs_PartDev (at least 1 MB, not
+    registered/mounted elsewhere).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_Part_bench(Lfs_PartDev *dev)
+{
+    static const uint32_t dir_sizes[] = {10, 100, 1000};
+    Lfs_PartDev_Stats stats;
+    lfs_t *lfs = &bench_fs.lfs;
+    int lfs_result;
+    uint32_t i;
+    int ret;
+
+    CHECK_COND_RETURN_MSG(dev->size < BENCH_MIN_DEV_SIZE, -1,
+        "Device too small for the suite.");
+
+    rand_state = 1;
+
+    ret = Lfs_Part_initDev(&bench_fs, dev, NULL, &lfs_result);
+    CHECK_COND_RETURN_MSG(ret != ESP_OK, -1, "Error mounting device.");
+
+    /* Start from an empty filesystem every run. */
+    lfs_unmount(lfs);
+    ret = lfs_format(lfs, &bench_fs.cfg);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "format failed.");
+    ret = lfs_mount(lfs, &bench_fs.cfg);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "mount failed.");
+
+    LOGPRINT_INFO("Lfs_Part bench on %s: %u KB, block %u",
+        dev->label, (unsigned)(dev->size/1024), (unsigned)dev->block_size);
+
+    Lfs_PartDev_getStats(dev, &stats, true);
+    ret = bench_mount(lfs, "mount empty");
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_seq(lfs);
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_upload(lfs);
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_random(lfs);
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_gc(lfs);
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_small_files(lfs);
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_kv(lfs);
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_ring(lfs);
+    CHECK_COND_GOTO(ret < 0, done);
+
+    for (i = 0; i < sizeof(dir_sizes)/sizeof(dir_sizes[0]); i++)
+    {
+        ret = bench_dirlist(lfs, dir_sizes[i]);
+        CHECK_COND_GOTO(ret < 0, done);
+    }
+
+    ret = bench_list_pages(lfs, dir_sizes[2]);
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_cache(lfs, BENCH_CACHE_BUDGET);
+    CHECK_COND_GOTO(ret < 0, done);
+
+    ret = bench_mount(lfs, "mount full");
+    CHECK_COND_GOTO(ret < 0, done);
+
+    Lfs_PartDev_getStats(dev, &stats, false);
+    LOGPRINT_INFO("Totals: %u reads, %u progs, %u erases, max erase count %u",
+        (unsigned)stats.reads, (unsigned)stats.progs, (unsigned)stats.erases,
+        (unsigned)stats.max_erase_count);
+
+done:
+    Lfs_Part_enableCache(&bench_fs, 0, 0);
+    lfs_unmount(lfs);
+    return ret;
+}
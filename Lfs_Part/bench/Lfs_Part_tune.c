@@ -0,0 +1,193 @@
+/*******************************************************************************
+ *  @file: Lfs_Part_tune.c
+ *
+ *  @brief: Geometry autotuner for Lfs_Part. Replays a recorded operation
+ *  trace (see Lfs_PartTrace.h) on a freshly erased device for every
+ *  Lfs_Part_Config in a grid and reports simulated flash throughput and
+ *  littlefs RAM use of each, then the fastest geometry and the smallest one
+ *  within TUNE_NEAR_PCT of its flash time. Meant for the linux (host) target with a RAM
+ *  device and simulated timings.
+ *
+ *  Usage: record on the device, e.g.
+ *
+ *      Lfs_PartTrace_start(lpfs, 64*1024);
+ *      ... normal operation ...
+ *      trace = Lfs_PartTrace_stop(lpfs, &len);
+ *
+ *  save the trace text, then on the linux target:
+ *
+ *      #include "Lfs_Part_bench.h"
+ *      static Lfs_PartDev dev;
+ *      const Lfs_PartDev_Timing nor = LFS_PARTDEV_TIMING_SPI_NOR;
+ *      Lfs_PartDev_initRam(&dev, "tune", 2*1024*1024, LFS_PART_BLOCK_SIZE);
+ *      Lfs_PartDev_setTiming(&dev, &nor);
+ *      Lfs_Part_tune(&dev, trace, len);
+*******************************************************************************/
+#include <string.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartTrace.h"
+#include "Lfs_Part_bench.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_Part_tune";
+
+/** @brief Candidates are within this much of the best flash time. */
+#define TUNE_NEAR_PCT       5
+
+static const uint32_t io_sizes[] = {16, 64, 128, 256};
+static const uint32_t cache_sizes[] = {256, 512, 1024, 2048, 4096};
+static const uint32_t lookahead_sizes[] = {16, 128};
+
+#define ARRAY_LEN(a)        (sizeof(a)/sizeof((a)[0]))
+
+static Lfs_Part_t tune_fs;
+
+/** @brief Result of one geometry. */
+typedef struct TuneResult
+{
+    Lfs_Part_Config config;
+    uint32_t ram;
+    uint64_t flash_us;
+    uint32_t kbps;
+
+} TuneResult;
+
+/******************************************************************************
+    tune_run
+*//**
+    @brief Replays the trace with one geometry on the erased device.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+static int
+tune_run(
+    Lfs_PartDev *dev,
+    const Lfs_Part_Config *config,
+    const char *trace,
+    uint32_t len,
+    TuneResult *res)
+{
+    Lfs_PartTrace_Result tr;
+    Lfs_PartDev_Stats stats;
+    uint64_t flash_us;
+    uint32_t block;
+    int lfs_result;
+    int ret;
+
+    for (block = 0; block < dev->size/dev->block_size; block++)
+    {
+        Lfs_PartDev_eraseBlock(dev, block);
+    }
+
+    /* Mounting the erased device formats it. */
+    memset(&tune_fs, 0, sizeof(tune_fs));
+    ret = Lfs_Part_initDev(&tune_fs, dev, config, &lfs_result);
+    CHECK_COND_RETURN_MSG(ret != ESP_OK, -1, "Error mounting device.");
+
+    Lfs_PartDev_getStats(dev, &stats, true);
+    ret = Lfs_PartTrace_replay(&tune_fs.lfs, trace, len, &tr);
+    Lfs_PartDev_getStats(dev, &stats, true);
+    Lfs_Part_deinit(&tune_fs);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    flash_us = stats.sim_ns/1000;
+    res->config = *config;
+    res->ram = Lfs_Part_configRam(config, tr.max_open);
+    res->flash_us = flash_us;
+    res->kbps = flash_us ? (uint32_t)((tr.read_bytes + tr.write_bytes)*
+        1000000/1024/flash_us) : 0;
+
+    LOGPRINT_INFO("io %4u cache %4u la %3u: %6u B RAM %8u us flash "
+        "%5u KB/s (%u rd %u pr %u er, %u errors)",
+        (unsigned)config->read_size,
+        (unsigned)config->cache_size,
+        (unsigned)config->lookahead_size,
+        (unsigned)res->ram,
+        (unsigned)flash_us,
+        (unsigned)res->kbps,
+        (unsigned)stats.reads,
+        (unsigned)stats.progs,
+        (unsigned)stats.erases,
+        (unsigned)tr.errors);
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_tune]
+*//**
+    @brief Runs the trace across the geometry grid. The device is erased.
+    @param[in] dev  Pointer to initialized Lfs_PartDev (not registered or
+    mounted elsewhere).
+    @param[in] trace  Recorded trace.
+    @param[in] len  Trace length.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_Part_tune(Lfs_PartDev *dev, const char *trace, uint32_t len)
+{
+    static TuneResult results[ARRAY_LEN(io_sizes)*ARRAY_LEN(cache_sizes)*
+        ARRAY_LEN(lookahead_sizes)];
+    Lfs_Part_Config config = LFS_PART_CONFIG_DEFAULT;
+    TuneResult *best, *small;
+    uint32_t num = 0;
+    uint32_t i, j, k;
+    int ret;
+
+    LOGPRINT_INFO("Lfs_Part tune on %s: %u KB, %u byte trace",
+        dev->label, (unsigned)(dev->size/1024), (unsigned)len);
+
+    for (i = 0; i < ARRAY_LEN(io_sizes); i++)
+    {
+        for (j = 0; j < ARRAY_LEN(cache_sizes); j++)
+        {
+            for (k = 0; k < ARRAY_LEN(lookahead_sizes); k++)
+            {
+                if (cache_sizes[j] < io_sizes[i])
+                {
+                    continue;
+                }
+                config.read_size = io_sizes[i];
+                config.prog_size = io_sizes[i];
+                config.cache_size = cache_sizes[j];
+                config.lookahead_size = lookahead_sizes[k];
+
+                ret = tune_run(dev, &config, trace, len, &results[num]);
+                CHECK_COND_RETURN(ret < 0, ret);
+                num++;
+            }
+        }
+    }
+
+    best = &results[0];
+    for (i = 1; i < num; i++)
+    {
+        if (results[i].flash_us < best->flash_us ||
+            (results[i].flash_us == best->flash_us &&
+             results[i].ram < best->ram))
+        {
+            best = &results[i];
+        }
+    }
+    small = best;
+    for (i = 0; i < num; i++)
+    {
+        if (results[i].flash_us*100 <= best->flash_us*(100 + TUNE_NEAR_PCT) &&
+            results[i].ram < small->ram)
+        {
+            small = &results[i];
+        }
+    }
+
+    LOGPRINT_INFO("Fastest: io %u cache %u la %u, %u KB/s, %u B RAM",
+        (unsigned)best->config.read_size, (unsigned)best->config.cache_size,
+        (unsigned)best->config.lookahead_size, (unsigned)best->kbps,
+        (unsigned)best->ram);
+    LOGPRINT_INFO("Smallest within %u%%: io %u cache %u la %u, %u KB/s, "
+        "%u B RAM",
+        (unsigned)TUNE_NEAR_PCT,
+        (unsigned)small->config.read_size, (unsigned)small->config.cache_size,
+        (unsigned)small->config.lookahead_size, (unsigned)small->kbps,
+        (unsigned)small->ram);
+    return 0;
+}
@@ -8,8 +8,12 @@
 
 #include "lfs.h"
 #include "esp_partition.h"
+#include "Lfs_PartDev.h"
+#include "Lfs_PartCache.h"
+#include "Lfs_PartGc.h"
+#include "Lfs_PartAio.h"
+#include "Lfs_PartTrace.h"
 #include "RtosUtils.h"
-#include "CList.h"
 
 /** @brief Minimum size of a block read.
     All read operations will be a multiple of this value. */
@@ -49,56 +53,350 @@
 #define LFS_PART_BLOCK_CYCLES       512
 #endif
 
+/** @brief Per partition littlefs geometry. The LFS_PART_* macros above are
+    the defaults and document the constraints.
+*/
+typedef struct Lfs_Part_Config
+{
+    uint32_t read_size;
+    uint32_t prog_size;
+    uint32_t cache_size;
+    uint32_t lookahead_size;
+    int32_t block_cycles;
+
+} Lfs_Part_Config;
+
+#define LFS_PART_CONFIG_DEFAULT                 \
+{   .read_size = LFS_PART_READ_SIZE,            \
+    .prog_size = LFS_PART_WRITE_SIZE,           \
+    .cache_size = LFS_PART_CACHE_SIZE,          \
+    .lookahead_size = LFS_PART_LOOKAHEAD_SIZE,  \
+    .block_cycles = LFS_PART_BLOCK_CYCLES       \
+}
+
+/** @brief Default for program coalescing (see Lfs_Part_setCoalesce). */
+#ifndef LFS_PART_COALESCE_PROGS
+#define LFS_PART_COALESCE_PROGS     1
+#endif
+
+/** @brief Max number of registered partitions (handles 1 to
+    LFS_PART_REGISTRY_MAX). */
+#ifndef LFS_PART_REGISTRY_MAX
+#define LFS_PART_REGISTRY_MAX       8
+#endif
+
+/** @brief Tasks mounting the partitions of Lfs_Part_initAll. */
+#define LFS_PART_MOUNT_TASK_STACK   4096
+#define LFS_PART_MOUNT_TASK_PRIO    2
+
 /** @brief Context object for Lfs_Part.
 */
 typedef struct Lfs_Part_t
 {
-    /** @brief Anchor for usage in a list (must be first). */
-    CLIST_ANCHOR();
-
     /** @brief lfs filesystem. */
     lfs_t lfs;
-    /** @brief Partition on which lfs is mounted. */
+    /** @brief Block device on which lfs is mounted. */
+    Lfs_PartDev *dev;
+    /** @brief Partition on which lfs is mounted (NULL for RAM/file devices). */
     const esp_partition_t *partition;
-    /** @brief Rtos Mutex lock. */
+    /** @brief Registry handle (see Lfs_Part_getHandle), 0 if not
+        registered. */
+    uint32_t handle;
+    /** @brief Device storage used by Lfs_Part_init. */
+    Lfs_PartDev part_dev;
+    /** @brief Optional read cache (disabled while num_lines is 0). */
+    Lfs_PartCache bcache;
+    /** @brief Program coalescing: sequential programs within one block are
+        held in prog_buf and issued as one device program. */
+    bool coalesce;
+    uint8_t *prog_buf;
+    uint32_t prog_addr;
+    uint32_t prog_len;
+    /** @brief Incremented by every littlefs program and erase (directory
+        snapshots are valid while it is unchanged). */
+    uint32_t write_gen;
+    /** @brief Background maintenance (see Lfs_PartGc_start). */
+    Lfs_PartGc gc;
+    /** @brief Operation recorder (see Lfs_PartTrace_start). */
+    Lfs_PartTrace trace;
+    /** @brief Asynchronous requests (see Lfs_PartAio_start). */
+    Lfs_PartAio aio;
+    /** @brief Rtos Mutex lock (recursive: a front end may hold it across
+        several littlefs calls, see Lfs_Api pread). */
     RTOS_MUTEX_STATIC_BUF lockbuf;
     RTOS_MUTEX lock;
+    /** @brief lfs is mounted (a lazy partition is mounted by the first
+        Lfs_Part_getPartition), and how long the mount took (format
+        included), us. */
+    bool mounted;
+    uint32_t mount_us;
+    /** @brief Geometry the partition was mounted with. */
+    Lfs_Part_Config config;
     /** @brief lfs configuration object. */
     struct lfs_config cfg;
     /** @brief lfs file object. */
     lfs_file_t file;
+    /** @brief Compressed mode state of file (Lfs_Api, see Lfs_ApiZ.h),
+        NULL for a plain file. */
+    void *file_z;
+    /** @brief Open key/value stores (see Lfs_PartKv_open). */
+    struct Lfs_PartKv *kv;
+    /** @brief Open circular logs (see Lfs_PartRing_open). */
+    struct Lfs_PartRing *ring;
+    /** @brief Open transaction (see Lfs_PartTx_begin). */
+    struct Lfs_PartTx *tx;
     
 } Lfs_Part_t;
 
+/** @brief A partition to initialize with Lfs_Part_initAll.
+*/
+typedef struct Lfs_Part_Mount
+{
+    /** @brief Partition label, or device (RAM, file, see Lfs_PartDev.h)
+        when not NULL. */
+    const char *label;
+    Lfs_PartDev *dev;
+    /** @brief Geometry, NULL for LFS_PART_CONFIG_DEFAULT. */
+    const Lfs_Part_Config *config;
+    /** @brief Defer the mount to the first Lfs_Part_getPartition. */
+    bool lazy;
+    /** @brief Object to initialize (registered on success). */
+    Lfs_Part_t *lpfs;
+
+    /** @brief Result, lfs operation status and mount time, us (0 for a
+        lazy partition). */
+    esp_err_t err;
+    int lfs_result;
+    uint32_t mount_us;
+    /** @brief Task waiting for the mount (internal). */
+    RTOS_TASK waiter;
+
+} Lfs_Part_Mount;
+
 
 /******************************************************************************
     [docexport Lfs_Part_register]
 *//**
-    @brief Registers a littlefs partition.
+    @brief Registers a littlefs partition and gives it a handle.
     Call this after Lfs_Part_init().
     @param[in] lpfs  Pointer to Lfs_Part_t object instance.
 ******************************************************************************/
 void
 Lfs_Part_register(Lfs_Part_t *lpfs);
 
+/******************************************************************************
+    [docexport Lfs_Part_getHandle]
+*//**
+    @brief Gets the handle of a registered partition, for callers that look
+    it up often (see Lfs_Part_getByHandle).
+    @param[in] label  Partition label.
+    @return Returns the handle, 0 if the label is not registered.
+******************************************************************************/
+uint32_t
+Lfs_Part_getHandle(const char *label);
+
+/******************************************************************************
+    [docexport Lfs_Part_getByHandle]
+*//**
+    @brief Gets a partition object by handle (an array index), mounting it
+    if it is lazy and not mounted yet.
+    @param[in] handle  Handle from Lfs_Part_getHandle.
+    @return Returns the Lfs_Part_t object, NULL if the handle is not valid.
+******************************************************************************/
+Lfs_Part_t *
+Lfs_Part_getByHandle(uint32_t handle);
+
 /******************************************************************************
     [docexport Lfs_Part_getPartition]
 *//**
-    @brief Gets a partition object from the registry.
+    @brief Gets a partition object from the registry (hashed by label),
+    mounting it if it is lazy and not mounted yet.
     @param[in] part_label  Label for partition to get.
     @return Returns the matching Lfs_Part_t object, NULL otherwise.
 ******************************************************************************/
 Lfs_Part_t *
 Lfs_Part_getPartition(const char *label);
 
+/******************************************************************************
+    [docexport Lfs_Part_enableCache]
+*//**
+    @brief Enables the block read cache in front of the device, or disables
+    it (budget 0). The cache is write-through and lines of erased blocks are
+    dropped, so it can be toggled while mounted.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[in] budget  RAM budget for cached data, bytes (0 to disable).
+    @param[in] line_size  Cache line size (power of 2, multiple of the
+    read size, at most LFS_PART_BLOCK_SIZE), 0 for
+    LFS_PARTCACHE_LINE_SIZE.
+    @return Returns ESP_OK on success.
+******************************************************************************/
+esp_err_t
+Lfs_Part_enableCache(Lfs_Part_t *lpfs, uint32_t budget, uint32_t line_size);
+
+/******************************************************************************
+    [docexport Lfs_Part_getCacheStats]
+*//**
+    @brief Gets the block read cache counters.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[out] stats  Pointer to stats to fill (zeroed if disabled).
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_Part_getCacheStats(
+    Lfs_Part_t *lpfs,
+    Lfs_PartCache_Stats *stats,
+    bool clear);
+
+/******************************************************************************
+    [docexport Lfs_Part_getDevStats]
+*//**
+    @brief Gets the flash I/O counters of the partition device: operations,
+    bytes, latency histograms and the highest erase count.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared (erase counts are kept).
+******************************************************************************/
+void
+Lfs_Part_getDevStats(
+    Lfs_Part_t *lpfs,
+    Lfs_PartDev_Stats *stats,
+    bool clear);
+
+/******************************************************************************
+    [docexport Lfs_Part_getWear]
+*//**
+    @brief Gets the erase count of the partition blocks (the wear map).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[in] start  First block.
+    @param[out] counts  Erase counts from block start.
+    @param[in] max  Max number of counts.
+    @return Returns the number of counts filled.
+******************************************************************************/
+uint32_t
+Lfs_Part_getWear(
+    Lfs_Part_t *lpfs,
+    uint32_t start,
+    uint32_t *counts,
+    uint32_t max);
+
+/******************************************************************************
+    [docexport Lfs_Part_setCoalesce]
+*//**
+    @brief Enables or disables program coalescing. littlefs programs in
+    cache sized pieces; with coalescing, consecutive programs to one block
+    are combined into a single device program, issued when the block is
+    full, on a non-sequential program, on a read overlapping it that cannot
+    be served from the buffer, or on littlefs sync (which littlefs issues
+    before every metadata commit, so committed data is always on flash).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[in] enable  true to enable.
+    @return Returns ESP_OK on success.
+******************************************************************************/
+esp_err_t
+Lfs_Part_setCoalesce(Lfs_Part_t *lpfs, bool enable);
+
+/******************************************************************************
+    [docexport Lfs_Part_configRam]
+*//**
+    @brief Estimates the littlefs RAM use of a geometry: read and program
+    caches and lookahead buffer, plus one cache per open file.
+    @param[in] config  Geometry.
+    @param[in] open_files  Number of simultaneously open files.
+    @return Returns the number of bytes.
+******************************************************************************/
+uint32_t
+Lfs_Part_configRam(const Lfs_Part_Config *config, uint32_t open_files);
+
+/******************************************************************************
+    [docexport Lfs_Part_deinit]
+*//**
+    @brief Unmounts and releases an Lfs_Part file system that is not
+    registered (e.g. a scratch filesystem on a RAM device).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+******************************************************************************/
+void
+Lfs_Part_deinit(Lfs_Part_t *lpfs);
+
+/******************************************************************************
+    [docexport Lfs_Part_initDev]
+*//**
+    @brief Initializes an Lfs_Part file system on a block device (RAM, file
+    or esp_partition, see Lfs_PartDev.h). The device label is the partition
+    label used by the registry.
+    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
+    @param[in] dev  Pointer to *initialized* block device.
+    @param[in] config  Geometry, NULL for LFS_PART_CONFIG_DEFAULT.
+    @param[out] lfs_result  lfs operation status.
+******************************************************************************/
+esp_err_t
+Lfs_Part_initDev(
+    Lfs_Part_t *lpfs,
+    Lfs_PartDev *dev,
+    const Lfs_Part_Config *config,
+    int *lfs_result);
+
+/******************************************************************************
+    [docexport Lfs_Part_initConfig]
+*//**
+    @brief Initializes an Lfs_Part file system with its own geometry.
+    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
+    @param[in] part_label  Label for partition to use.
+    @param[in] config  Geometry, NULL for LFS_PART_CONFIG_DEFAULT (e.g. large
+    caches for a read mostly asset partition, small program size for a log
+    partition).
+    @param[out] lfs_result  lfs operation status.
+******************************************************************************/
+esp_err_t
+Lfs_Part_initConfig(
+    Lfs_Part_t *lpfs,
+    const char *part_label,
+    const Lfs_Part_Config *config,
+    int *lfs_result);
+
 /******************************************************************************
     [docexport Lfs_Part_init]
 *//**
-    @brief Initializes an Lfs_Part file system.
+    @brief Initializes an Lfs_Part file system with the default geometry
+    (see Lfs_Part_initConfig).
     @param[in] lpfs  Pointer to Lfs_Part_t object instance.
     @param[in] part_label  Label for partition to use.
     @param[out] lfs_result  lfs operation status.
 ******************************************************************************/
 esp_err_t
 Lfs_Part_init(Lfs_Part_t *lpfs, const char *part_label, int *lfs_result);
+
+/******************************************************************************
+    [docexport Lfs_Part_initLazy]
+*//**
+    @brief Initializes an Lfs_Part file system without mounting it. Once
+    registered (Lfs_Part_register), the first Lfs_Part_getPartition mounts
+    it (formatting it if the mount fails), so startup does not wait for
+    partitions used later.
+    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
+    @param[in] part_label  Label for partition to use.
+    @param[in] config  Geometry, NULL for LFS_PART_CONFIG_DEFAULT.
+    @return Returns ESP_OK on success.
+******************************************************************************/
+esp_err_t
+Lfs_Part_initLazy(
+    Lfs_Part_t *lpfs,
+    const char *part_label,
+    const Lfs_Part_Config *config);
+
+/******************************************************************************
+    [docexport Lfs_Part_initAll]
+*//**
+    @brief Initializes and registers several partitions, mounting them in
+    parallel (one task each) instead of one after the other. Lazy entries
+    are not mounted (see Lfs_Part_initLazy). The result and mount time of
+    each partition are filled in mounts. Partitions of one flash chip share
+    its bus: mounts overlap their CPU work (metadata CRCs, on both cores)
+    and the I/O of separate devices.
+    @param[in,out] mounts  Partitions.
+    @param[in] count  Number of partitions.
+    @return Returns ESP_OK if all partitions were initialized, ESP_FAIL
+    otherwise (the others are registered).
+******************************************************************************/
+esp_err_t
+Lfs_Part_initAll(Lfs_Part_Mount *mounts, uint32_t count);
 #endif
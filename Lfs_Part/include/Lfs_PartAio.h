@@ -0,0 +1,172 @@
+/*******************************************************************************
+ *  @file: Lfs_PartAio.h
+ *
+ *  @brief: Header for Lfs_PartAio, asynchronous file requests on an
+ *  Lfs_Part filesystem.
+ *
+ *  Callers submit read, write and stat requests to a per-partition I/O task
+ *  and continue; completion is a callback (run in the I/O task) or a wait on
+ *  the request. The task takes up to LFS_PARTAIO_BATCH queued requests at a
+ *  time and groups them by path (keeping submission order within a path),
+ *  so each group runs under one lock acquisition with the file opened once,
+ *  and requests continuing where the previous one ended need no seek. A
+ *  group is closed (committed) before its requests complete, so a completed
+ *  write is on flash.
+ *
+ *  The request is owned by the caller and must stay valid, with its path
+ *  and buffer, until it completes.
+*******************************************************************************/
+#ifndef LFS_PARTAIO_H
+#define LFS_PARTAIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+#include "RtosUtils.h"
+
+/** @brief Queued requests per partition. */
+#ifndef LFS_PARTAIO_DEPTH
+#define LFS_PARTAIO_DEPTH           16
+#endif
+
+/** @brief Requests reordered and merged together. */
+#ifndef LFS_PARTAIO_BATCH
+#define LFS_PARTAIO_BATCH           8
+#endif
+#define LFS_PARTAIO_TASK_STACK      4096
+#define LFS_PARTAIO_TASK_PRIO       2
+
+/** @brief Write offset appending to the file. */
+#define LFS_PARTAIO_APPEND          0xffffffff
+
+/** @brief Request types. */
+typedef enum
+{
+    /** @brief Read up to size bytes at offset into buf. */
+    LFS_PARTAIO_READ,
+    /** @brief Write size bytes from buf at offset (or LFS_PARTAIO_APPEND),
+        creating the file. */
+    LFS_PARTAIO_WRITE,
+    /** @brief Get the type and size of path. */
+    LFS_PARTAIO_STAT
+
+} Lfs_PartAio_Op;
+
+struct Lfs_PartAio_Req;
+
+/** @brief Completion callback, run in the I/O task (must not wait on other
+    requests of the partition). */
+typedef void (Lfs_PartAio_doneCb)(struct Lfs_PartAio_Req *req);
+
+/** @brief Request. */
+typedef struct Lfs_PartAio_Req
+{
+    Lfs_PartAio_Op op;
+    const char *path;
+    uint32_t offset;
+    void *buf;
+    uint32_t size;
+    /** @brief Completion callback, NULL to use Lfs_PartAio_wait. */
+    Lfs_PartAio_doneCb *cb;
+    void *ctx;
+
+    /** @brief Bytes read or written (0 for stat), negative lfs error code on
+        failure. */
+    int result;
+    /** @brief stat: LFS_TYPE_REG or LFS_TYPE_DIR, and file size. */
+    uint8_t type;
+    uint32_t file_size;
+    volatile bool done;
+
+    /** @brief Task waiting in Lfs_PartAio_wait. */
+    RTOS_TASK waiter;
+
+} Lfs_PartAio_Req;
+
+/** @brief I/O task counters. */
+typedef struct Lfs_PartAio_Stats
+{
+    uint32_t requests;
+    /** @brief Batches taken from the queue. */
+    uint32_t batches;
+    /** @brief Path groups (file opens). */
+    uint32_t groups;
+    /** @brief Reads and writes continuing the previous one (no seek). */
+    uint32_t merged;
+
+} Lfs_PartAio_Stats;
+
+/** @brief I/O task state, embedded in Lfs_Part_t (stopped while queue is
+    NULL).
+*/
+typedef struct Lfs_PartAio
+{
+    RTOS_QUEUE queue;
+    RTOS_TASK task;
+    /** @brief File and its cache buffer (opened with lfs_file_opencfg). */
+    lfs_file_t file;
+    struct lfs_file_config file_cfg;
+    uint8_t *file_buf;
+
+    Lfs_PartAio_Stats stats;
+
+} Lfs_PartAio;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartAio_submit]
+*//**
+    @brief Queues a request (waits while the queue is full).
+    @param[in] lpfs  Pointer to an Lfs_Part_t with the I/O task started.
+    @param[in] req  Request, with op, path, offset, buf, size, cb and ctx
+    set.
+    @return Returns 0 on success, -1 if the I/O task is not running.
+******************************************************************************/
+int
+Lfs_PartAio_submit(struct Lfs_Part_t *lpfs, Lfs_PartAio_Req *req);
+
+/******************************************************************************
+    [docexport Lfs_PartAio_wait]
+*//**
+    @brief Waits for a request submitted without callback (uses the task
+    notification of the calling task, which must be the submitter).
+    @param[in] req  Submitted request.
+    @return Returns req->result.
+******************************************************************************/
+int
+Lfs_PartAio_wait(Lfs_PartAio_Req *req);
+
+/******************************************************************************
+    [docexport Lfs_PartAio_getStats]
+*//**
+    @brief Gets the I/O task counters.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_PartAio_getStats(
+    struct Lfs_Part_t *lpfs,
+    Lfs_PartAio_Stats *stats,
+    bool clear);
+
+/******************************************************************************
+    [docexport Lfs_PartAio_stop]
+*//**
+    @brief Stops the I/O task after the queued requests complete.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartAio_stop(struct Lfs_Part_t *lpfs);
+
+/******************************************************************************
+    [docexport Lfs_PartAio_start]
+*//**
+    @brief Starts the I/O task of a mounted Lfs_Part (no-op if running).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartAio_start(struct Lfs_Part_t *lpfs);
+#endif
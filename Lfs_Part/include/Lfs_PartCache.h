@@ -0,0 +1,138 @@
+/*******************************************************************************
+ *  @file: Lfs_PartCache.h
+ *
+ *  @brief: Header for Lfs_PartCache, a read cache of device lines in front
+ *  of Lfs_PartDev (CLOCK replacement, write-through, invalidated on erase).
+*******************************************************************************/
+#ifndef LFS_PARTCACHE_H
+#define LFS_PARTCACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Lfs_PartDev.h"
+
+/** @brief Default cache line size. Must be a multiple of the littlefs read
+    size and a factor of the block size. */
+#ifndef LFS_PARTCACHE_LINE_SIZE
+#define LFS_PARTCACHE_LINE_SIZE     512
+#endif
+
+/** @brief Cache counters. */
+typedef struct Lfs_PartCache_Stats
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    /** @brief Lines dropped by erases. */
+    uint32_t invalidations;
+
+} Lfs_PartCache_Stats;
+
+/** @brief Cache line tag. */
+typedef struct Lfs_PartCache_Tag
+{
+    /** @brief Device address of the line. */
+    uint32_t addr;
+    bool valid;
+    /** @brief CLOCK reference bit. */
+    bool ref;
+
+} Lfs_PartCache_Tag;
+
+/** @brief Cache object.
+*/
+typedef struct Lfs_PartCache
+{
+    uint32_t line_size;
+    uint32_t num_lines;
+    /** @brief num_lines*line_size bytes. */
+    uint8_t *data;
+    Lfs_PartCache_Tag *tags;
+    /** @brief CLOCK hand. */
+    uint32_t hand;
+
+    Lfs_PartCache_Stats stats;
+
+} Lfs_PartCache;
+
+/******************************************************************************
+    [docexport Lfs_PartCache_read]
+*//**
+    @brief Reads through the cache; missing lines are filled from the device.
+    @param[in] cache  Pointer to initialized cache.
+    @param[in] dev  Pointer to the device.
+    @param[in] addr  Byte offset.
+    @param[out] buf  Destination.
+    @param[in] size  Number of bytes.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartCache_read(
+    Lfs_PartCache *cache,
+    Lfs_PartDev *dev,
+    uint32_t addr,
+    void *buf,
+    uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartCache_update]
+*//**
+    @brief Write-through: applies data just programmed to cached lines.
+    @param[in] cache  Pointer to initialized cache.
+    @param[in] addr  Byte offset.
+    @param[in] buf  Data programmed.
+    @param[in] size  Number of bytes.
+******************************************************************************/
+void
+Lfs_PartCache_update(
+    Lfs_PartCache *cache,
+    uint32_t addr,
+    const void *buf,
+    uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartCache_invalidate]
+*//**
+    @brief Drops cached lines in a range (e.g. an erased block).
+    @param[in] cache  Pointer to initialized cache.
+    @param[in] addr  Byte offset.
+    @param[in] size  Number of bytes.
+******************************************************************************/
+void
+Lfs_PartCache_invalidate(Lfs_PartCache *cache, uint32_t addr, uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartCache_getStats]
+*//**
+    @brief Gets the cache counters.
+    @param[in] cache  Pointer to initialized cache.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_PartCache_getStats(
+    Lfs_PartCache *cache,
+    Lfs_PartCache_Stats *stats,
+    bool clear);
+
+/******************************************************************************
+    [docexport Lfs_PartCache_deinit]
+*//**
+    @brief Frees the cache memory.
+    @param[in] cache  Pointer to initialized cache.
+******************************************************************************/
+void
+Lfs_PartCache_deinit(Lfs_PartCache *cache);
+
+/******************************************************************************
+    [docexport Lfs_PartCache_init]
+*//**
+    @brief Initializes a cache.
+    @param[in] cache  Pointer to uninitialized cache.
+    @param[in] budget  RAM budget for line data, bytes.
+    @param[in] line_size  Line size (power of 2).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartCache_init(Lfs_PartCache *cache, uint32_t budget, uint32_t line_size);
+#endif
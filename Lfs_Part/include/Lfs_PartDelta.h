@@ -0,0 +1,152 @@
+/*******************************************************************************
+ *  @file: Lfs_PartDelta.h
+ *
+ *  @brief: Header for Lfs_PartDelta, rsync-style delta updates of files for
+ *  the Lfs_Part front ends (Lfs_PartRpc FileSig/FilePatch).
+ *
+ *  The host asks for the block signatures of the device copy of a file: a
+ *  rolling checksum (rsync's Adler-32 variant) and a strong hash (MD5,
+ *  truncated) per block_size block. It finds those blocks anywhere in the
+ *  new file with the rolling checksum and sends the new file as a series of
+ *  patch calls, each copying a run of old blocks and then appending
+ *  literal data. The new file is built in a temporary file next to the
+ *  original (path + LFS_PARTDELTA_TMP_SUFFIX), checked against the CRC32 of
+ *  the new file sent with the last call, and renamed over the original
+ *  (atomic in littlefs). On any error the temporary file is removed and the
+ *  original is untouched.
+ *
+ *  One patch runs at a time; starting another abandons it. Patch calls
+ *  from several tasks are serialized (Lfs_PartDelta_init creates the lock).
+*******************************************************************************/
+#ifndef LFS_PARTDELTA_H
+#define LFS_PARTDELTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief Allowed signature block sizes. */
+#define LFS_PARTDELTA_BLOCK_MIN     64
+#define LFS_PARTDELTA_BLOCK_MAX     4096
+
+/** @brief Bytes of the strong hash kept per block. */
+#define LFS_PARTDELTA_STRONG_LEN    8
+
+/** @brief Suffix of the temporary file of a patch. */
+#define LFS_PARTDELTA_TMP_SUFFIX    ".~dt"
+
+/** @brief Longest path of a patch (including the suffix). */
+#define LFS_PARTDELTA_PATH_MAX      64
+
+/** @brief Signature of one block. */
+typedef struct Lfs_PartDelta_Sig
+{
+    uint32_t weak;
+    uint8_t strong[LFS_PARTDELTA_STRONG_LEN];
+
+} Lfs_PartDelta_Sig;
+
+/** @brief Result of a patch call. */
+typedef struct Lfs_PartDelta_Result
+{
+    /** @brief Patch id for the next call, 0 once the patch is over. */
+    uint32_t id;
+    /** @brief Size of the new file so far. */
+    uint32_t size;
+    /** @brief CRC32 of the new file so far. */
+    uint32_t crc;
+
+} Lfs_PartDelta_Result;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartDelta_weak]
+*//**
+    @brief Computes the rolling checksum of a block (rsync: a = sum of the
+    bytes, b = sum of (len - i)*byte i, both mod 2^16; a | b << 16).
+    @param[in] data  Block.
+    @param[in] len  Block length.
+    @return Returns the checksum.
+******************************************************************************/
+uint32_t
+Lfs_PartDelta_weak(const uint8_t *data, uint32_t len);
+
+/******************************************************************************
+    [docexport Lfs_PartDelta_signatures]
+*//**
+    @brief Computes the signatures of the blocks of a file, from block
+    start (the last block may be short).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[in] block_size  Block size (LFS_PARTDELTA_BLOCK_MIN to _MAX).
+    @param[in] start  First block.
+    @param[out] sigs  Signatures.
+    @param[in] max  Max number of signatures.
+    @param[out] file_size  File size.
+    @return Returns the number of signatures, negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartDelta_signatures(
+    struct Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t block_size,
+    uint32_t start,
+    Lfs_PartDelta_Sig *sigs,
+    uint32_t max,
+    uint32_t *file_size);
+
+/******************************************************************************
+    [docexport Lfs_PartDelta_patch]
+*//**
+    @brief Runs one patch call: copies copy_count blocks of the original
+    file from block copy_block (a short last block copies what there is),
+    then appends data.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[in] id  Patch id from the previous result, 0 to start.
+    @param[in] block_size  Block size of the signatures.
+    @param[in] copy_block  First block to copy.
+    @param[in] copy_count  Number of blocks to copy (0 for none).
+    @param[in] data  Literal data.
+    @param[in] len  Literal data length.
+    @param[in] last  The call ends the new file: it is checked against crc
+    and renamed over the original.
+    @param[in] crc  With last, CRC32 of the new file.
+    @param[out] res  Pointer to result to fill.
+    @return Returns 0 on success, LFS_ERR_CORRUPT on a CRC mismatch, other
+    negative lfs error code otherwise (the patch is abandoned).
+******************************************************************************/
+int
+Lfs_PartDelta_patch(
+    struct Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t id,
+    uint32_t block_size,
+    uint32_t copy_block,
+    uint32_t copy_count,
+    const uint8_t *data,
+    uint32_t len,
+    bool last,
+    uint32_t crc,
+    Lfs_PartDelta_Result *res);
+
+/******************************************************************************
+    [docexport Lfs_PartDelta_release]
+*//**
+    @brief Abandons the patch on a partition (before it is unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartDelta_release(struct Lfs_Part_t *lpfs);
+
+/******************************************************************************
+    [docexport Lfs_PartDelta_init]
+*//**
+    @brief Creates the patch lock (call before the first patch).
+    @return Returns 0 on success, -1 on failure.
+******************************************************************************/
+int
+Lfs_PartDelta_init(void);
+#endif
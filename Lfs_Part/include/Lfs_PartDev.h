@@ -0,0 +1,275 @@
+/*******************************************************************************
+ *  @file: Lfs_PartDev.h
+ *
+ *  @brief: Header for Lfs_PartDev, the block device under Lfs_Part.
+ *  Backends: esp_partition (device), RAM and mmap'd file (linux target).
+ *  Every backend counts operations, bytes, latency and erase cycles per
+ *  block, and can simulate flash timings.
+*******************************************************************************/
+#ifndef LFS_PARTDEV_H
+#define LFS_PARTDEV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_partition.h"
+
+/** @brief Max length of a device label (including NUL). */
+#define LFS_PARTDEV_LABEL_MAX       17
+
+/** @brief Simulated flash timings. Operation time is setup + size*per-byte
+    (read, program) or per block (erase).
+*/
+typedef struct Lfs_PartDev_Timing
+{
+    uint32_t read_setup_ns;
+    uint32_t read_byte_ns;
+    uint32_t prog_setup_ns;
+    uint32_t prog_byte_ns;
+    uint32_t erase_block_us;
+    /** @brief If true, operations also take that long in real time
+        (busy wait); otherwise time is only accumulated in the stats. */
+    bool delay;
+
+} Lfs_PartDev_Timing;
+
+/** @brief Typical SPI NOR timings (40 MHz QIO read, 256 B page program
+    ~0.7 ms, 4 KB sector erase ~45 ms). */
+#define LFS_PARTDEV_TIMING_SPI_NOR  \
+{   .read_setup_ns = 1000,          \
+    .read_byte_ns = 50,             \
+    .prog_setup_ns = 20000,         \
+    .prog_byte_ns = 2700,           \
+    .erase_block_us = 45000,        \
+    .delay = false                  \
+}
+
+/** @brief Number of latency histogram buckets. Bucket i counts operations
+    under LFS_PARTDEV_LAT_BASE_US << 2*i us, the last one the rest
+    (16 us .. 64 ms, then slower). */
+#define LFS_PARTDEV_LAT_BUCKETS     8
+#define LFS_PARTDEV_LAT_BASE_US     16
+
+/** @brief Operation types of the latency stats. */
+typedef enum
+{
+    LFS_PARTDEV_OP_READ,
+    LFS_PARTDEV_OP_PROG,
+    LFS_PARTDEV_OP_ERASE,
+    LFS_PARTDEV_OPS
+
+} Lfs_PartDev_Op;
+
+/** @brief Measured latency of one operation type (backend call time, not
+    the simulated time). */
+typedef struct Lfs_PartDev_Latency
+{
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t hist[LFS_PARTDEV_LAT_BUCKETS];
+
+} Lfs_PartDev_Latency;
+
+/** @brief Block device counters. */
+typedef struct Lfs_PartDev_Stats
+{
+    uint32_t reads;
+    uint32_t progs;
+    uint32_t erases;
+    uint64_t read_bytes;
+    uint64_t prog_bytes;
+    /** @brief Simulated flash busy time, ns. */
+    uint64_t sim_ns;
+    /** @brief Highest per block erase count. */
+    uint32_t max_erase_count;
+    /** @brief Latency per Lfs_PartDev_Op. */
+    Lfs_PartDev_Latency lat[LFS_PARTDEV_OPS];
+
+} Lfs_PartDev_Stats;
+
+struct Lfs_PartDev;
+
+/** @brief Backend operations. Addresses are byte offsets into the device. */
+typedef int Lfs_PartDev_read(struct Lfs_PartDev *dev, uint32_t addr,
+    void *buf, uint32_t size);
+typedef int Lfs_PartDev_write(struct Lfs_PartDev *dev, uint32_t addr,
+    const void *buf, uint32_t size);
+typedef int Lfs_PartDev_erase(struct Lfs_PartDev *dev, uint32_t addr,
+    uint32_t size);
+
+/** @brief Block device object.
+*/
+typedef struct Lfs_PartDev
+{
+    char label[LFS_PARTDEV_LABEL_MAX];
+    /** @brief Flash address (esp_partition) or 0. */
+    uint32_t address;
+    /** @brief Device size, bytes. */
+    uint32_t size;
+    /** @brief Erase block size, bytes. */
+    uint32_t block_size;
+
+    Lfs_PartDev_read *read;
+    Lfs_PartDev_write *write;
+    Lfs_PartDev_erase *erase;
+
+    /** @brief Backend state. */
+    const esp_partition_t *partition;
+    uint8_t *mem;
+    int fd;
+    /** @brief Read-only mapping of the whole device (see Lfs_PartDev_map). */
+    const uint8_t *map;
+    esp_partition_mmap_handle_t map_handle;
+
+    Lfs_PartDev_Timing timing;
+    Lfs_PartDev_Stats stats;
+    /** @brief Erase count per block (NULL if not tracked). */
+    uint32_t *erase_counts;
+
+} Lfs_PartDev;
+
+/******************************************************************************
+    [docexport Lfs_PartDev_readBytes]
+*//**
+    @brief Reads from the device, with accounting.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] addr  Byte offset.
+    @param[out] buf  Destination.
+    @param[in] size  Number of bytes.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_readBytes(Lfs_PartDev *dev, uint32_t addr, void *buf, uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartDev_writeBytes]
+*//**
+    @brief Programs the device, with accounting.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] addr  Byte offset.
+    @param[in] buf  Source.
+    @param[in] size  Number of bytes.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_writeBytes(
+    Lfs_PartDev *dev,
+    uint32_t addr,
+    const void *buf,
+    uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartDev_eraseBlock]
+*//**
+    @brief Erases one block, with accounting.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] block  Block number.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_eraseBlock(Lfs_PartDev *dev, uint32_t block);
+
+/******************************************************************************
+    [docexport Lfs_PartDev_map]
+*//**
+    @brief Maps the device read-only into the address space: the flash
+    partition through the MMU (esp_partition_mmap, mapped once and kept),
+    or the RAM/file backing memory. Reads through the mapping are not
+    counted in the stats.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @return Returns a pointer to device offset 0, NULL if it cannot be mapped.
+******************************************************************************/
+const uint8_t *
+Lfs_PartDev_map(Lfs_PartDev *dev);
+
+/******************************************************************************
+    [docexport Lfs_PartDev_setTiming]
+*//**
+    @brief Sets the simulated timings (NULL for none).
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] timing  Pointer to timings.
+******************************************************************************/
+void
+Lfs_PartDev_setTiming(Lfs_PartDev *dev, const Lfs_PartDev_Timing *timing);
+
+/******************************************************************************
+    [docexport Lfs_PartDev_getStats]
+*//**
+    @brief Gets the device counters.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared (erase counts are kept).
+******************************************************************************/
+void
+Lfs_PartDev_getStats(Lfs_PartDev *dev, Lfs_PartDev_Stats *stats, bool clear);
+
+/******************************************************************************
+    [docexport Lfs_PartDev_getWear]
+*//**
+    @brief Gets the erase count of blocks (the wear map).
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] start  First block.
+    @param[out] counts  Erase counts from block start.
+    @param[in] max  Max number of counts.
+    @return Returns the number of counts filled.
+******************************************************************************/
+uint32_t
+Lfs_PartDev_getWear(
+    Lfs_PartDev *dev,
+    uint32_t start,
+    uint32_t *counts,
+    uint32_t max);
+
+/******************************************************************************
+    [docexport Lfs_PartDev_initPartition]
+*//**
+    @brief Initializes a device on an esp_partition.
+    @param[in] dev  Pointer to uninitialized Lfs_PartDev.
+    @param[in] part_label  Label of the data partition.
+    @param[in] block_size  Erase block size.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_initPartition(
+    Lfs_PartDev *dev,
+    const char *part_label,
+    uint32_t block_size);
+
+/******************************************************************************
+    [docexport Lfs_PartDev_initRam]
+*//**
+    @brief Initializes a RAM device (erased, i.e. all 0xff). Programming has
+    NOR semantics: bits can only be cleared.
+    @param[in] dev  Pointer to uninitialized Lfs_PartDev.
+    @param[in] label  Device label.
+    @param[in] size  Device size (multiple of block_size).
+    @param[in] block_size  Erase block size.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_initRam(
+    Lfs_PartDev *dev,
+    const char *label,
+    uint32_t size,
+    uint32_t block_size);
+
+/******************************************************************************
+    [docexport Lfs_PartDev_initFile]
+*//**
+    @brief Initializes a device on an mmap'd file, so an image survives
+    between runs (linux target only). A new or short file is extended and
+    erased.
+    @param[in] dev  Pointer to uninitialized Lfs_PartDev.
+    @param[in] label  Device label.
+    @param[in] path  Image file path.
+    @param[in] size  Device size (multiple of block_size).
+    @param[in] block_size  Erase block size.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_initFile(
+    Lfs_PartDev *dev,
+    const char *label,
+    const char *path,
+    uint32_t size,
+    uint32_t block_size);
+#endif
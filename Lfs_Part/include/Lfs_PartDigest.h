@@ -0,0 +1,119 @@
+/*******************************************************************************
+ *  @file: Lfs_PartDigest.h
+ *
+ *  @brief: Header for Lfs_PartDigest, file digests (SHA-256 and CRC32) for
+ *  the Lfs_Part front ends (Lfs_PartRpc GetDigests), so a host can tell
+ *  which files it needs to send without reading them back.
+ *
+ *  A digest is cached in a littlefs user attribute of the file
+ *  (LFS_PARTDIGEST_ATTR) and only computed again when the file changed.
+ *  The attribute holds the file size and head block at the time the digest
+ *  was computed: littlefs data is copy-on-write, so a write moves the head
+ *  and the cached digest no longer matches, whatever wrote the file.
+ *  Writers in this component also clear the attribute with the file
+ *  (Lfs_PartDigest_invalidate), which costs no extra commit. Inline files
+ *  (no head block, at most inline_max bytes) are hashed on every call.
+*******************************************************************************/
+#ifndef LFS_PARTDIGEST_H
+#define LFS_PARTDIGEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief User attribute type of the cached digest. */
+#define LFS_PARTDIGEST_ATTR         0x64
+
+/** @brief SHA-256 length. */
+#define LFS_PARTDIGEST_SHA256_LEN   32
+
+/** @brief Longest path of a tree walk. */
+#define LFS_PARTDIGEST_PATH_MAX     64
+
+/** @brief Deepest directory of a tree walk. */
+#ifndef LFS_PARTDIGEST_DEPTH
+#define LFS_PARTDIGEST_DEPTH        8
+#endif
+
+/** @brief Digest of a file. */
+typedef struct Lfs_PartDigest
+{
+    uint32_t size;
+    /** @brief CRC32 (zlib/IEEE, as Lfs_PartXfer_crc32). */
+    uint32_t crc;
+    uint8_t sha256[LFS_PARTDIGEST_SHA256_LEN];
+
+} Lfs_PartDigest;
+
+/** @brief Cached digest attribute. */
+typedef struct Lfs_PartDigest_Attr
+{
+    /** @brief Head block of the file the digest was computed from. */
+    uint32_t head;
+    Lfs_PartDigest digest;
+
+} Lfs_PartDigest_Attr;
+
+/** @brief Called with each file of a tree walk.
+    @return Returns 0 to go on, negative lfs error code to stop the walk.
+*/
+typedef int (*Lfs_PartDigest_WalkFn)(void *ctx, const char *path);
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartDigest_get]
+*//**
+    @brief Gets the digest of a file, from its cache attribute when the file
+    has not changed, else computed and cached. The file is hashed without
+    holding the partition lock; the digest is not cached if the file
+    changed meanwhile.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[out] digest  Pointer to digest to fill.
+    @return Returns 1 if the digest was cached, 0 if it was computed,
+    LFS_ERR_ISDIR for a directory, other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartDigest_get(
+    struct Lfs_Part_t *lpfs,
+    const char *path,
+    Lfs_PartDigest *digest);
+
+/******************************************************************************
+    [docexport Lfs_PartDigest_walk]
+*//**
+    @brief Walks the files of a directory tree, depth first in directory
+    order, and calls fn with up to max of them from file index start.
+    Directories deeper than LFS_PARTDIGEST_DEPTH and paths longer than
+    LFS_PARTDIGEST_PATH_MAX are skipped. The paths of the page are copied
+    out under the partition lock and fn is called after it is released, so
+    fn may use the partition (e.g. Lfs_PartDigest_get).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] dir  Directory.
+    @param[in] start  Index of the first file to pass to fn.
+    @param[in] max  Max number of files to pass to fn.
+    @param[in] fn  Called with each file.
+    @param[in] ctx  Passed to fn.
+    @return Returns the index of the next file if the tree has more, 0 once
+    it is done, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartDigest_walk(
+    struct Lfs_Part_t *lpfs,
+    const char *dir,
+    uint32_t start,
+    uint32_t max,
+    Lfs_PartDigest_WalkFn fn,
+    void *ctx);
+
+/******************************************************************************
+    [docexport Lfs_PartDigest_invalidate]
+*//**
+    @brief Makes a file opened for writing with cfg drop its cached digest
+    when it is synced (a zero length attribute written with the file).
+    @param[in] cfg  File configuration (attrs unused).
+******************************************************************************/
+void
+Lfs_PartDigest_invalidate(struct lfs_file_config *cfg);
+#endif
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ *  @file: Lfs_PartDir.h
+ *
+ *  @brief: Header for Lfs_PartDir, paged directory listing for the Lfs_Part
+ *  front ends (Lfs_PartRpc dirlist).
+ *
+ *  Reading page n of a directory from entry 0 makes a full listing O(n^2)
+ *  in flash reads. Lfs_PartDir avoids this two ways:
+ *
+ *  - Cursors: a listing that does not complete in one page keeps its
+ *    lfs_dir_t open in a cursor, and the next page resumes from it. Cursors
+ *    are few (LFS_PARTDIR_CURSORS); an abandoned one is reclaimed when a new
+ *    listing needs its slot (least recently used first).
+ *  - Snapshots: the first page of a listing reads the whole directory into
+ *    a RAM snapshot (up to a byte budget); every page is then served from
+ *    RAM. A snapshot is dropped on any program or erase of the partition
+ *    (Lfs_Part_t write_gen), so it never shows stale entries or sizes.
+ *
+ *  Entry indexes count the "." and ".." entries, as lfs_dir_read does.
+ *  Listings are made from one task (the RPC server).
+*******************************************************************************/
+#ifndef LFS_PARTDIR_H
+#define LFS_PARTDIR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief Number of open listing cursors. */
+#ifndef LFS_PARTDIR_CURSORS
+#define LFS_PARTDIR_CURSORS         2
+#endif
+
+/** @brief Number of directory snapshots kept. */
+#ifndef LFS_PARTDIR_SNAPSHOTS
+#define LFS_PARTDIR_SNAPSHOTS       2
+#endif
+
+/** @brief Default RAM budget of one snapshot, bytes (0 disables snapshots).
+    An entry takes 6 bytes plus its name; a directory that does not fit is
+    listed through a cursor. */
+#ifndef LFS_PARTDIR_SNAPSHOT_SIZE
+#define LFS_PARTDIR_SNAPSHOT_SIZE   (16*1024)
+#endif
+
+/** @brief Longest directory path of a cursor or snapshot. */
+#define LFS_PARTDIR_PATH_MAX        64
+
+/** @brief Called for every listed entry.
+    @param[in] ctx  Caller context.
+    @param[in] idx  Entry index in the directory.
+    @param[in] type  LFS_TYPE_REG or LFS_TYPE_DIR.
+    @param[in] size  File size.
+    @param[in] name  Entry name.
+*/
+typedef void (Lfs_PartDir_entryCb)(
+    void *ctx,
+    uint32_t idx,
+    uint8_t type,
+    uint32_t size,
+    const char *name);
+
+/** @brief One page of a listing. */
+typedef struct Lfs_PartDir_Page
+{
+    /** @brief Entries passed to the callback. */
+    uint32_t count;
+    /** @brief Total entries in the directory when known (snapshot, or last
+        page of a cursor listing), otherwise a lower bound (more than the
+        entries listed so far). */
+    uint32_t num_entries;
+    /** @brief Cursor for the next page, 0 if there is none (listing
+        complete, or served from a snapshot). */
+    uint32_t cursor;
+
+} Lfs_PartDir_Page;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartDir_list]
+*//**
+    @brief Lists up to max entries of a directory, from entry start_idx.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  Directory.
+    @param[in] start_idx  Index of the first entry to list.
+    @param[in] cursor  Cursor from the previous page of this listing, 0 to
+    start one. An unknown or reclaimed cursor starts a new listing at
+    start_idx.
+    @param[in] max  Max entries to list.
+    @param[in] cb  Entry callback.
+    @param[in] ctx  Callback context.
+    @param[out] page  Pointer to page summary to fill.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartDir_list(
+    struct Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t start_idx,
+    uint32_t cursor,
+    uint32_t max,
+    Lfs_PartDir_entryCb *cb,
+    void *ctx,
+    Lfs_PartDir_Page *page);
+
+/******************************************************************************
+    [docexport Lfs_PartDir_setSnapshotSize]
+*//**
+    @brief Sets the RAM budget of one snapshot (0 disables snapshots). Kept
+    snapshots are dropped.
+    @param[in] size  Bytes.
+******************************************************************************/
+void
+Lfs_PartDir_setSnapshotSize(uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartDir_release]
+*//**
+    @brief Closes the cursors and drops the snapshots of a partition (before
+    it is unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartDir_release(struct Lfs_Part_t *lpfs);
+#endif
@@ -0,0 +1,190 @@
+/*******************************************************************************
+ *  @file: Lfs_PartGc.h
+ *
+ *  @brief: Header for Lfs_PartGc, background maintenance of an Lfs_Part
+ *  filesystem: metadata compaction (lfs_fs_gc) and a pool of pre-erased
+ *  free blocks, so littlefs rarely has to wait on an erase when it
+ *  allocates a block.
+ *
+ *  The pool is kept ahead of the littlefs allocator cursor. part_erase skips
+ *  the erase of a pooled block; any program to a block drops it from the
+ *  pool. Free blocks are found with lfs_fs_traverse, and a block is only
+ *  erased if littlefs has not erased anything since the traverse (a block
+ *  can only come into use through an erase), so a live block is never
+ *  touched. The pool is RAM only and starts empty after every mount.
+*******************************************************************************/
+#ifndef LFS_PARTGC_H
+#define LFS_PARTGC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "RtosUtils.h"
+
+/** @brief Defaults, see Lfs_PartGc_Config. */
+#ifndef LFS_PARTGC_PERIOD_MS
+#define LFS_PARTGC_PERIOD_MS        250
+#endif
+#ifndef LFS_PARTGC_IDLE_MS
+#define LFS_PARTGC_IDLE_MS          100
+#endif
+#ifndef LFS_PARTGC_POOL_BLOCKS
+#define LFS_PARTGC_POOL_BLOCKS      8
+#endif
+#ifndef LFS_PARTGC_ERASE_BUDGET
+#define LFS_PARTGC_ERASE_BUDGET     2
+#endif
+#define LFS_PARTGC_TASK_STACK       3072
+#define LFS_PARTGC_TASK_PRIO        1
+
+/** @brief Maintenance configuration.
+*/
+typedef struct Lfs_PartGc_Config
+{
+    /** @brief A pass runs every period_ms (CPU budget). 0: no task, the
+        application calls Lfs_PartGc_step itself. */
+    uint32_t period_ms;
+    /** @brief Passes are skipped, and a running pass stops, until the
+        filesystem has not been used by another task for idle_ms. */
+    uint32_t idle_ms;
+    /** @brief Number of pre-erased free blocks to keep ahead of the
+        allocator. */
+    uint32_t pool_blocks;
+    /** @brief Max erases per pass (flash budget; an erase holds the
+        filesystem lock for one block erase time). */
+    uint32_t erase_budget;
+    /** @brief Run lfs_fs_gc (metadata compaction, lookahead refill) each
+        pass, and compact a due key/value log (see Lfs_PartKv.h). */
+    bool compact;
+
+} Lfs_PartGc_Config;
+
+#define LFS_PARTGC_CONFIG_DEFAULT               \
+{   .period_ms = LFS_PARTGC_PERIOD_MS,          \
+    .idle_ms = LFS_PARTGC_IDLE_MS,              \
+    .pool_blocks = LFS_PARTGC_POOL_BLOCKS,      \
+    .erase_budget = LFS_PARTGC_ERASE_BUDGET,    \
+    .compact = true                             \
+}
+
+/** @brief Maintenance counters. */
+typedef struct Lfs_PartGc_Stats
+{
+    uint32_t passes;
+    /** @brief Passes skipped or cut short by foreground activity. */
+    uint32_t paused;
+    /** @brief Passes cut short because littlefs erased meanwhile. */
+    uint32_t rescans;
+    uint32_t pre_erases;
+    /** @brief littlefs erases served from the pool (skipped). */
+    uint32_t hits;
+    /** @brief littlefs erases done inline. */
+    uint32_t misses;
+    /** @brief Pool size after the last pass. */
+    uint32_t pool;
+
+} Lfs_PartGc_Stats;
+
+/** @brief Maintenance state, embedded in Lfs_Part_t (disabled while
+    erased is NULL).
+*/
+typedef struct Lfs_PartGc
+{
+    Lfs_PartGc_Config config;
+    uint32_t block_count;
+    /** @brief Bitmap of pooled (erased, free) blocks. */
+    uint8_t *erased;
+    /** @brief Scratch bitmap of blocks in use. */
+    uint8_t *used;
+    /** @brief Incremented by every littlefs erase. */
+    uint32_t erase_gen;
+    /** @brief Last filesystem lock by another task than the gc task, us. */
+    uint64_t fg_us;
+    RTOS_TASK task;
+    volatile bool run;
+
+    Lfs_PartGc_Stats stats;
+
+} Lfs_PartGc;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartGc_onErase]
+*//**
+    @brief littlefs erase hook (filesystem locked).
+    @param[in] gc  Pointer to Lfs_PartGc.
+    @param[in] block  Block littlefs erases.
+    @return Returns true if the block is pooled, i.e. already erased.
+******************************************************************************/
+bool
+Lfs_PartGc_onErase(Lfs_PartGc *gc, uint32_t block);
+
+/******************************************************************************
+    [docexport Lfs_PartGc_onProg]
+*//**
+    @brief littlefs program hook (filesystem locked): drops the block from
+    the pool.
+    @param[in] gc  Pointer to Lfs_PartGc.
+    @param[in] block  Block littlefs programs.
+******************************************************************************/
+void
+Lfs_PartGc_onProg(Lfs_PartGc *gc, uint32_t block);
+
+/******************************************************************************
+    [docexport Lfs_PartGc_onLock]
+*//**
+    @brief Filesystem lock hook: records foreground activity.
+    @param[in] gc  Pointer to Lfs_PartGc.
+******************************************************************************/
+void
+Lfs_PartGc_onLock(Lfs_PartGc *gc);
+
+/******************************************************************************
+    [docexport Lfs_PartGc_step]
+*//**
+    @brief Runs one maintenance pass: lfs_fs_gc and key/value log
+    compaction (if configured), circular log flushes (Lfs_PartRing), then
+    tops up the pre-erased pool within the erase budget.
+    @param[in] lpfs  Pointer to an Lfs_Part_t with maintenance started.
+    @return Returns the number of blocks erased, negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartGc_step(struct Lfs_Part_t *lpfs);
+
+/******************************************************************************
+    [docexport Lfs_PartGc_getStats]
+*//**
+    @brief Gets the maintenance counters.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_PartGc_getStats(
+    struct Lfs_Part_t *lpfs,
+    Lfs_PartGc_Stats *stats,
+    bool clear);
+
+/******************************************************************************
+    [docexport Lfs_PartGc_stop]
+*//**
+    @brief Stops maintenance (waits for the task to exit) and drops the
+    pool.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartGc_stop(struct Lfs_Part_t *lpfs);
+
+/******************************************************************************
+    [docexport Lfs_PartGc_start]
+*//**
+    @brief Starts background maintenance on a mounted Lfs_Part (restarts it
+    with the new configuration if running).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] config  Configuration, NULL for LFS_PARTGC_CONFIG_DEFAULT.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartGc_start(struct Lfs_Part_t *lpfs, const Lfs_PartGc_Config *config);
+#endif
@@ -0,0 +1,261 @@
+/*******************************************************************************
+ *  @file: Lfs_PartKv.h
+ *
+ *  @brief: Header for Lfs_PartKv, a log-structured key/value store in a
+ *  littlefs file, for settings and counters.
+ *
+ *  Every set or delete appends a record (CRC32 checked) to the log; a RAM
+ *  hash index maps each key to its latest record and is rebuilt from the
+ *  log on open. Updates collect in a RAM batch and are committed atomically
+ *  by Lfs_PartKv_commit (or when the batch is full) with one write and one
+ *  sync. Uncommitted updates are read back from the batch.
+ *
+ *  littlefs copies the last block of a file on every synced append, so a
+ *  commit goes to a small tail file instead (path with
+ *  LFS_PARTKV_TAIL_SUFFIX) while it stays inline in the directory metadata
+ *  (littlefs inline_max): a commit is then one metadata commit. The tail
+ *  is kept in RAM and appended to the log when it outgrows inline_max. The
+ *  log is the log file followed by the tail file.
+ *
+ *  The log is compacted (live records copied to a new log renamed over the
+ *  old one) once it is LFS_PARTKV_COMPACT_RATIO times the live data: by the
+ *  Lfs_PartGc maintenance task when it runs with compaction, else on commit.
+ *  A temporary log left by an interrupted compaction is removed on open.
+ *
+ *  Calls on a store are serialized by the partition lock.
+*******************************************************************************/
+#ifndef LFS_PARTKV_H
+#define LFS_PARTKV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief Longest key and value. */
+#define LFS_PARTKV_KEY_MAX          32
+#define LFS_PARTKV_VALUE_MAX        256
+
+/** @brief Size of the tail and update batch buffer (a full buffer is
+    appended to the log). */
+#ifndef LFS_PARTKV_BATCH_SIZE
+#define LFS_PARTKV_BATCH_SIZE       1024
+#endif
+
+/** @brief The log is compacted when larger than COMPACT_MIN and
+    COMPACT_RATIO times the live records. */
+#ifndef LFS_PARTKV_COMPACT_MIN
+#define LFS_PARTKV_COMPACT_MIN      (8*1024)
+#endif
+#define LFS_PARTKV_COMPACT_RATIO    2
+
+/** @brief Longest log path, and suffixes (same length) of the tail file and
+    of the log being compacted. */
+#define LFS_PARTKV_PATH_MAX         64
+#define LFS_PARTKV_TAIL_SUFFIX      ".~tl"
+#define LFS_PARTKV_TMP_SUFFIX       ".~kv"
+
+/** @brief Log record header (followed by key and value). */
+typedef struct Lfs_PartKv_RecHdr
+{
+    /** @brief CRC32 of the rest of the header, key and value. */
+    uint32_t crc;
+    uint8_t type;
+    uint8_t key_len;
+    uint16_t val_len;
+
+} Lfs_PartKv_RecHdr;
+
+#define LFS_PARTKV_REC_MAX          (sizeof(Lfs_PartKv_RecHdr) + \
+                                     LFS_PARTKV_KEY_MAX + LFS_PARTKV_VALUE_MAX)
+
+/** @brief Index entry: latest record of a key. */
+typedef struct Lfs_PartKv_Entry
+{
+    uint32_t hash;
+    /** @brief Log offset (at or past the log file size: in the batch). */
+    uint32_t offset;
+    uint16_t rec_len;
+    /** @brief Empty, used or deleted (probe chains continue). */
+    uint8_t state;
+
+} Lfs_PartKv_Entry;
+
+/** @brief Store counters. */
+typedef struct Lfs_PartKv_Stats
+{
+    uint32_t sets;
+    uint32_t dels;
+    uint32_t gets;
+    uint32_t commits;
+    uint32_t compactions;
+    /** @brief Committed log size (log and tail files), live record
+        bytes. */
+    uint32_t log_size;
+    uint32_t live;
+    uint32_t keys;
+
+} Lfs_PartKv_Stats;
+
+/** @brief Store, owned by the caller (open until Lfs_PartKv_close).
+*/
+typedef struct Lfs_PartKv
+{
+    struct Lfs_Part_t *lpfs;
+    /** @brief Next open store of the partition. */
+    struct Lfs_PartKv *next;
+    char path[LFS_PARTKV_PATH_MAX];
+
+    /** @brief Log and tail files, kept open. */
+    lfs_file_t file;
+    struct lfs_file_config file_cfg;
+    uint8_t *file_buf;
+    uint32_t log_size;
+    lfs_file_t tail;
+    struct lfs_file_config tail_cfg;
+    uint8_t *tail_buf;
+    uint32_t tail_max;
+    uint32_t live;
+
+    /** @brief Hash index (power of two size, at most half used). */
+    Lfs_PartKv_Entry *table;
+    uint32_t table_size;
+    uint32_t max_keys;
+    uint32_t num_keys;
+    uint32_t num_deleted;
+
+    /** @brief Records past the log file: the tail (tail_len bytes,
+        committed), then the uncommitted records. */
+    uint8_t batch[LFS_PARTKV_BATCH_SIZE];
+    uint32_t tail_len;
+    uint32_t batch_len;
+    /** @brief One record read back from the log. */
+    uint8_t rec[LFS_PARTKV_REC_MAX];
+
+    Lfs_PartKv_Stats stats;
+
+} Lfs_PartKv;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartKv_open]
+*//**
+    @brief Opens (or creates) a store and rebuilds its index from the log.
+    A damaged end of the log (after the last good record) is cut off.
+    @param[in] kv  Store.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  Log file.
+    @param[in] max_keys  Max number of keys.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_open(
+    Lfs_PartKv *kv,
+    struct Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t max_keys);
+
+/******************************************************************************
+    [docexport Lfs_PartKv_close]
+*//**
+    @brief Commits and closes a store.
+    @param[in] kv  Store.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_close(Lfs_PartKv *kv);
+
+/******************************************************************************
+    [docexport Lfs_PartKv_set]
+*//**
+    @brief Sets a key (durable after the next commit).
+    @param[in] kv  Store.
+    @param[in] key  Key (1 to LFS_PARTKV_KEY_MAX characters).
+    @param[in] value  Value.
+    @param[in] len  Value length (up to LFS_PARTKV_VALUE_MAX).
+    @return Returns 0 on success, LFS_ERR_NOSPC if max_keys are in use,
+    other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_set(Lfs_PartKv *kv, const char *key, const void *value,
+    uint32_t len);
+
+/******************************************************************************
+    [docexport Lfs_PartKv_get]
+*//**
+    @brief Gets a key.
+    @param[in] kv  Store.
+    @param[in] key  Key.
+    @param[out] buf  Value (truncated to size).
+    @param[in] size  Size of buf.
+    @return Returns the value length, LFS_ERR_NOENT if the key is not set,
+    other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_get(Lfs_PartKv *kv, const char *key, void *buf, uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartKv_del]
+*//**
+    @brief Deletes a key (durable after the next commit).
+    @param[in] kv  Store.
+    @param[in] key  Key.
+    @return Returns 0 on success, LFS_ERR_NOENT if the key is not set, other
+    negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_del(Lfs_PartKv *kv, const char *key);
+
+/******************************************************************************
+    [docexport Lfs_PartKv_commit]
+*//**
+    @brief Commits the batch (atomic), then compacts the log if due and
+    no Lfs_PartGc task compacts it (config.compact).
+    @param[in] kv  Store.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_commit(Lfs_PartKv *kv);
+
+/******************************************************************************
+    [docexport Lfs_PartKv_compact]
+*//**
+    @brief Commits, then rewrites the log with the live records only.
+    @param[in] kv  Store.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_compact(Lfs_PartKv *kv);
+
+/******************************************************************************
+    [docexport Lfs_PartKv_compactStep]
+*//**
+    @brief Compacts the first store of a partition whose log is due
+    (Lfs_PartGc maintenance pass).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @return Returns 1 if a log was compacted, 0 if none was due, negative
+    lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_compactStep(struct Lfs_Part_t *lpfs);
+
+/******************************************************************************
+    [docexport Lfs_PartKv_getStats]
+*//**
+    @brief Gets the store counters.
+    @param[in] kv  Store.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, operation counters are cleared.
+******************************************************************************/
+void
+Lfs_PartKv_getStats(Lfs_PartKv *kv, Lfs_PartKv_Stats *stats, bool clear);
+
+/******************************************************************************
+    [docexport Lfs_PartKv_release]
+*//**
+    @brief Closes the open stores of a partition (before it is unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartKv_release(struct Lfs_Part_t *lpfs);
+#endif
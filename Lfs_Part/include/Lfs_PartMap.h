@@ -0,0 +1,93 @@
+/*******************************************************************************
+ *  @file: Lfs_PartMap.h
+ *
+ *  @brief: Header for Lfs_PartMap, zero-copy read-only access to littlefs
+ *  files. The data blocks of a file are returned as extents pointing into
+ *  the mapped device (see Lfs_PartDev_map); files which cannot be mapped
+ *  (inlined in their directory, or on a device without a mapping) are
+ *  copied into RAM instead.
+ *
+ *  A mapping shows the file as it was committed when it was opened. The
+ *  file must not be written, truncated or removed while it is mapped, since
+ *  littlefs may then reuse its blocks.
+*******************************************************************************/
+#ifndef LFS_PARTMAP_H
+#define LFS_PARTMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Lfs_Part.h"
+
+/** @brief Lfs_PartMap_open flags. */
+typedef enum
+{
+    /** @brief Return the data as a single extent, copying if needed. */
+    LFS_PARTMAP_CONTIGUOUS = 0x1 << 0,
+    /** @brief Fail with LFS_ERR_INVAL instead of copying. */
+    LFS_PARTMAP_NO_COPY    = 0x1 << 1,
+
+} Lfs_PartMap_flags;
+
+/** @brief Contiguous piece of file data. */
+typedef struct Lfs_PartMap_Extent
+{
+    const uint8_t *data;
+    uint32_t size;
+
+} Lfs_PartMap_Extent;
+
+/** @brief Mapped file.
+*/
+typedef struct Lfs_PartMap
+{
+    /** @brief File size. */
+    uint32_t size;
+    /** @brief Extents in file order. */
+    Lfs_PartMap_Extent *extents;
+    uint32_t num_extents;
+    /** @brief RAM copy (NULL if the data is mapped). */
+    uint8_t *copy;
+    /** @brief Extent storage for copies. */
+    Lfs_PartMap_Extent copy_extent;
+
+} Lfs_PartMap;
+
+/******************************************************************************
+    [docexport Lfs_PartMap_read]
+*//**
+    @brief Copies mapped data (e.g. a header spanning two extents).
+    @param[in] map  Pointer to open map.
+    @param[in] off  File offset.
+    @param[out] buf  Destination.
+    @param[in] size  Number of bytes.
+    @return Returns the number of bytes copied.
+******************************************************************************/
+uint32_t
+Lfs_PartMap_read(Lfs_PartMap *map, uint32_t off, void *buf, uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartMap_close]
+*//**
+    @brief Releases a map.
+    @param[in] map  Pointer to open map.
+******************************************************************************/
+void
+Lfs_PartMap_close(Lfs_PartMap *map);
+
+/******************************************************************************
+    [docexport Lfs_PartMap_open]
+*//**
+    @brief Maps a file read-only.
+    @param[in] map  Pointer to map object.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[in] path  File path.
+    @param[in] flags  Lfs_PartMap_flags.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartMap_open(
+    Lfs_PartMap *map,
+    Lfs_Part_t *lpfs,
+    const char *path,
+    int flags);
+#endif
@@ -0,0 +1,243 @@
+/*******************************************************************************
+ *  @file: Lfs_PartRing.h
+ *
+ *  @brief: Header for Lfs_PartRing, a fixed-size circular log (telemetry,
+ *  traces) in a littlefs directory, appended at high rate without
+ *  reopening files.
+ *
+ *  The log is a stream of bytes kept in num_segs segment files of seg_size
+ *  bytes (<path>/0 .. <path>/<num_segs - 1>). Appends fill the head segment
+ *  through a RAM staging buffer that is handed to littlefs at block
+ *  boundaries of the segment. When the head segment is full the next one
+ *  is truncated and becomes the head, so the oldest segment is dropped and
+ *  the log keeps between (num_segs - 1) and num_segs segments of data.
+ *  littlefs is copy-on-write, so one preallocated file overwritten in
+ *  place would rewrite its tail on every sync; whole segments are
+ *  recycled instead.
+ *
+ *  The header file (<path>/ring, inline in the directory) holds the
+ *  geometry and the sequence numbers of the oldest (tail) and head
+ *  segments; it is only written when the head moves to a new segment. The
+ *  head position is the head segment file size. Stream offsets are
+ *  seq*seg_size + offset in the segment.
+ *
+ *  Durability: appended bytes are durable once synced: by Lfs_PartRing_sync,
+ *  when a segment is full, or when they are older than flush_ms (checked on
+ *  append and by Lfs_PartRing_flushStep, which the Lfs_PartGc maintenance
+ *  pass calls). A sync inside a block makes littlefs copy that block on the
+ *  next append, so flush_ms trades durability against write amplification.
+ *
+ *  Records are not framed: records cut by a dropped segment must be found
+ *  by the reader (e.g. COBS framing, see Cobs.h).
+ *
+ *  Calls on a ring are serialized by the partition lock.
+*******************************************************************************/
+#ifndef LFS_PARTRING_H
+#define LFS_PARTRING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief Longest ring directory path. */
+#define LFS_PARTRING_PATH_MAX       48
+
+/** @brief Header magic ("RNG1"). */
+#define LFS_PARTRING_MAGIC          0x31474e52
+
+/** @brief Ring geometry and flush interval. */
+typedef struct Lfs_PartRing_Config
+{
+    /** @brief Segment size, a multiple of the block size. */
+    uint32_t seg_size;
+    /** @brief Number of segments (at least 2). */
+    uint32_t num_segs;
+    /** @brief Sync appended bytes older than this, ms (0: only on
+        Lfs_PartRing_sync and full segments). */
+    uint32_t flush_ms;
+
+} Lfs_PartRing_Config;
+
+#define LFS_PARTRING_CONFIG_DEFAULT             \
+{                                               \
+    .seg_size = 16*4096,                        \
+    .num_segs = 4,                              \
+    .flush_ms = 1000                            \
+}
+
+/** @brief Header file contents. */
+typedef struct Lfs_PartRing_Hdr
+{
+    uint32_t magic;
+    uint32_t seg_size;
+    uint32_t num_segs;
+    /** @brief Sequence numbers of the oldest and head segments (file
+        seq % num_segs). */
+    uint32_t first_seq;
+    uint32_t head_seq;
+
+} Lfs_PartRing_Hdr;
+
+/** @brief Ring counters. */
+typedef struct Lfs_PartRing_Stats
+{
+    uint32_t appends;
+    uint64_t bytes;
+    /** @brief Staging buffer writes to littlefs, syncs. */
+    uint32_t writes;
+    uint32_t syncs;
+    /** @brief Segments started, and dropped with their data. */
+    uint32_t segments;
+    uint32_t dropped;
+
+} Lfs_PartRing_Stats;
+
+/** @brief Ring, owned by the caller (open until Lfs_PartRing_close).
+*/
+typedef struct Lfs_PartRing
+{
+    struct Lfs_Part_t *lpfs;
+    /** @brief Next open ring of the partition. */
+    struct Lfs_PartRing *next;
+    char path[LFS_PARTRING_PATH_MAX];
+    Lfs_PartRing_Hdr hdr;
+    uint32_t flush_ms;
+
+    /** @brief Head segment, kept open. */
+    lfs_file_t file;
+    struct lfs_file_config file_cfg;
+    uint8_t *file_buf;
+    /** @brief Head segment size, staged bytes included. */
+    uint32_t seg_pos;
+
+    /** @brief Staging buffer (one block): bytes up to the next block
+        boundary of the segment. */
+    uint8_t *stage;
+    uint32_t stage_len;
+    uint32_t block_size;
+
+    /** @brief Bytes appended since the last sync, and when the first of
+        them was, us. */
+    bool dirty;
+    uint64_t dirty_us;
+
+    Lfs_PartRing_Stats stats;
+
+} Lfs_PartRing;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartRing_open]
+*//**
+    @brief Opens (or creates) a ring. An existing ring keeps its geometry;
+    flush_ms is taken from config.
+    @param[in] ring  Ring.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  Ring directory.
+    @param[in] config  Geometry (for a new ring) and flush interval.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_open(
+    Lfs_PartRing *ring,
+    struct Lfs_Part_t *lpfs,
+    const char *path,
+    const Lfs_PartRing_Config *config);
+
+/******************************************************************************
+    [docexport Lfs_PartRing_close]
+*//**
+    @brief Syncs and closes a ring.
+    @param[in] ring  Ring.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_close(Lfs_PartRing *ring);
+
+/******************************************************************************
+    [docexport Lfs_PartRing_append]
+*//**
+    @brief Appends bytes at the head, dropping the oldest segment when the
+    head moves to a new one.
+    @param[in] ring  Ring.
+    @param[in] data  Data.
+    @param[in] size  Number of bytes.
+    @return Returns size on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_append(Lfs_PartRing *ring, const void *data, uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartRing_sync]
+*//**
+    @brief Makes all appended bytes durable.
+    @param[in] ring  Ring.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_sync(Lfs_PartRing *ring);
+
+/******************************************************************************
+    [docexport Lfs_PartRing_bounds]
+*//**
+    @brief Gets the stream offsets of the oldest byte and of the head.
+    @param[in] ring  Ring.
+    @param[out] tail  Offset of the oldest byte kept.
+    @param[out] head  Offset of the next byte appended.
+******************************************************************************/
+void
+Lfs_PartRing_bounds(Lfs_PartRing *ring, uint64_t *tail, uint64_t *head);
+
+/******************************************************************************
+    [docexport Lfs_PartRing_read]
+*//**
+    @brief Reads the stream at an offset (unsynced bytes in the range are
+    synced first).
+    @param[in] ring  Ring.
+    @param[in] offset  Stream offset.
+    @param[out] buf  Buffer.
+    @param[in] size  Bytes to read.
+    @return Returns the number of bytes read (0 at the head), LFS_ERR_NOENT
+    if offset was dropped, other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_read(
+    Lfs_PartRing *ring,
+    uint64_t offset,
+    void *buf,
+    uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartRing_getStats]
+*//**
+    @brief Gets the ring counters.
+    @param[in] ring  Ring.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_PartRing_getStats(Lfs_PartRing *ring, Lfs_PartRing_Stats *stats,
+    bool clear);
+
+/******************************************************************************
+    [docexport Lfs_PartRing_flushStep]
+*//**
+    @brief Syncs the rings of a partition holding bytes older than their
+    flush_ms (Lfs_PartGc maintenance pass, or an application timer).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @return Returns the number of rings synced, negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_flushStep(struct Lfs_Part_t *lpfs);
+
+/******************************************************************************
+    [docexport Lfs_PartRing_release]
+*//**
+    @brief Closes the open rings of a partition (before it is unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartRing_release(struct Lfs_Part_t *lpfs);
+#endif
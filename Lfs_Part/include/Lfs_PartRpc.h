@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include "Lfs_Part.h"
 #include "ProtoRpc.h"
+#include "RpcLimit.h"
 
 /******************************************************************************
     [docexport Lfs_PartRpc_init]
@@ -19,6 +20,16 @@
 int
 Lfs_PartRpc_init(Lfs_Part_t *lpfs);
 
+/******************************************************************************
+    [docexport Lfs_PartRpc_setLimit]
+*//**
+    @brief Sets the RPC limiter whose counters GetStats reports (the one
+    given to TcpRpcServer_setLimit/UdpRpcServer_setLimit).
+    @param[in] limit  Pointer to initialized RpcLimit, NULL for none.
+******************************************************************************/
+void
+Lfs_PartRpc_setLimit(RpcLimit *limit);
+
 /******************************************************************************
     [docexport Lfs_PartRpc_resolver]
 *//**
@@ -19,6 +19,9 @@ typedef struct _lfspart_FileInfo {
 typedef struct _lfspart_GetFsInfo_call {
     /* Partition label. */
     char part_label[18];
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
 } lfspart_GetFsInfo_call;
 
 typedef struct _lfspart_GetFsInfo_reply {
@@ -30,6 +33,8 @@ typedef struct _lfspart_GetFsInfo_reply {
     uint32_t block_size;
     /* Number of total blocks */
     uint32_t block_count;
+    /* Partition handle, for part_handle in later calls. */
+    uint32_t part_handle;
 } lfspart_GetFsInfo_reply;
 
 typedef struct _lfspart_DirOpen_call {
@@ -37,6 +42,9 @@ typedef struct _lfspart_DirOpen_call {
     char part_label[18];
     /* Path to open */
     char path[64];
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
 } lfspart_DirOpen_call;
 
 typedef struct _lfspart_DirOpen_reply {
@@ -70,6 +78,9 @@ typedef struct _lfspart_FileOpen_call {
     char path[64];
     /* Flags */
     uint32_t flags;
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
 } lfspart_FileOpen_call;
 
 typedef struct _lfspart_FileOpen_reply {
@@ -135,16 +146,24 @@ typedef struct _lfspart_DirList_call {
     char path[64];
     /* Starting index of reply entry. */
     uint32_t start_idx;
+    /* Cursor from the previous reply of this listing, 0 to start one. */
+    uint32_t cursor;
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
 } lfspart_DirList_call;
 
 typedef struct _lfspart_DirList_reply {
     bool valid;
-    /* Total entries in directory */
+    /* Total entries in directory. While cursor is set, a lower bound
+ (more than the entries listed so far). */
     uint32_t num_entries;
     /* Starting index of entry in info_array, */
     uint32_t start_idx;
     pb_size_t info_array_count;
     lfspart_FileInfo info_array[8];
+    /* Cursor to pass with the next page, 0 if none is needed. */
+    uint32_t cursor;
 } lfspart_DirList_reply;
 
 typedef struct _lfspart_Remove_call {
@@ -152,6 +171,12 @@ typedef struct _lfspart_Remove_call {
     char part_label[18];
     /* Path to open */
     char path[64];
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
+    /* Transaction id (TxBegin reply): the file is removed on TxCommit. 0
+ to remove it now. */
+    uint32_t tx_id;
 } lfspart_Remove_call;
 
 typedef struct _lfspart_Remove_reply {
@@ -163,12 +188,296 @@ typedef struct _lfspart_GetFileSize_call {
     char part_label[18];
     /* Path to open */
     char path[64];
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
 } lfspart_GetFileSize_call;
 
 typedef struct _lfspart_GetFileSize_reply {
     int32_t status;
 } lfspart_GetFileSize_reply;
 
+typedef struct _lfspart_FileSync_call {
+    /* Flushes buffered writes and commits the file (durable on success). */
+    uint32_t fd;
+} lfspart_FileSync_call;
+
+typedef struct _lfspart_FileSync_reply {
+    int32_t status;
+} lfspart_FileSync_reply;
+
+typedef struct _lfspart_FileGet_call {
+    /* Partition label. */
+    char part_label[18];
+    /* Path to read */
+    char path[64];
+    /* Transfer id from the previous reply, 0 to start. */
+    uint32_t xfer_id;
+    /* Offset of the chunk. */
+    uint32_t offset;
+    /* CRC32 of the bytes before offset (starting or resuming). */
+    uint32_t crc;
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
+} lfspart_FileGet_call;
+
+typedef PB_BYTES_ARRAY_T(3072) lfspart_FileGet_reply_data_t;
+typedef struct _lfspart_FileGet_reply {
+    /* 0 on success, negative lfs error (the transfer is over). */
+    int32_t status;
+    /* Transfer id for the next call, 0 once the file is read. */
+    uint32_t xfer_id;
+    /* Offset of data in the file. */
+    uint32_t offset;
+    uint32_t file_size;
+    /* data ends the file. */
+    bool eof;
+    /* CRC32 of the file up to the end of data. */
+    uint32_t crc;
+    lfspart_FileGet_reply_data_t data;
+} lfspart_FileGet_reply;
+
+typedef PB_BYTES_ARRAY_T(3072) lfspart_FilePut_call_data_t;
+typedef struct _lfspart_FilePut_call {
+    /* Partition label. */
+    char part_label[18];
+    /* Path to write (created or truncated by a put at offset 0). */
+    char path[64];
+    /* Transfer id from the previous reply, 0 to start. */
+    uint32_t xfer_id;
+    /* Offset of the chunk. */
+    uint32_t offset;
+    /* The chunk ends the file. */
+    bool last;
+    /* With last, CRC32 of the whole file. */
+    uint32_t crc;
+    lfspart_FilePut_call_data_t data;
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
+    /* Transaction id (TxBegin reply): the file is written to a staging
+ file and replaces path on TxCommit. 0 to write path directly. */
+    uint32_t tx_id;
+} lfspart_FilePut_call;
+
+typedef struct _lfspart_FilePut_reply {
+    /* 0 on success, LFS_ERR_CORRUPT on CRC mismatch (file removed), other
+ negative lfs error (the transfer is over, resume at offset). */
+    int32_t status;
+    /* Transfer id for the next call, 0 once the transfer is over. */
+    uint32_t xfer_id;
+    /* Bytes in the file so far. */
+    uint32_t offset;
+    /* CRC32 of the file up to offset. */
+    uint32_t crc;
+} lfspart_FilePut_reply;
+
+typedef struct _lfspart_OpStats {
+    /* Number of operations. */
+    uint32_t count;
+    /* Bytes read or programmed. */
+    uint64_t bytes;
+    /* Cumulative latency, us. */
+    uint64_t total_us;
+    /* Max latency, us. */
+    uint32_t max_us;
+    /* Latency histogram: bucket i counts ops under 16 << 2*i us, the last
+one the rest. */
+    pb_size_t hist_count;
+    uint32_t hist[8];
+} lfspart_OpStats;
+
+typedef struct _lfspart_RpcLimitStats {
+    /* Calls admitted. */
+    uint32_t admitted;
+    /* Calls answered RPC_BUSY by the client, callset and in-flight limits. */
+    uint32_t rejected_client;
+    uint32_t rejected_callset;
+    uint32_t rejected_inflight;
+    /* Calls executing now, and the most at once. */
+    uint32_t in_flight;
+    uint32_t max_in_flight;
+} lfspart_RpcLimitStats;
+
+typedef struct _lfspart_GetStats_call {
+    /* Partition label. */
+    char part_label[18];
+    /* Clear the counters after reading them (erase counts are kept). */
+    bool clear;
+    /* First block of the wear map to return. */
+    uint32_t wear_start;
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
+} lfspart_GetStats_call;
+
+typedef struct _lfspart_GetStats_reply {
+    /* 0 on success, negative on error. */
+    int32_t status;
+    /* Flash operations. */
+    bool has_read;
+    lfspart_OpStats read;
+    bool has_prog;
+    lfspart_OpStats prog;
+    bool has_erase;
+    lfspart_OpStats erase;
+    /* Block read cache. */
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+    /* Highest erase count of a block. */
+    uint32_t max_erase_count;
+    /* Number of blocks of the partition. */
+    uint32_t block_count;
+    /* Erase counts from block wear_start (call again from wear_start +
+number of counts for the rest). */
+    uint32_t wear_start;
+    pb_size_t wear_count;
+    uint32_t wear[512];
+    /* Time the partition took to mount (format included), us. */
+    uint32_t mount_us;
+    /* RPC admission control (see Lfs_PartRpc_setLimit), not set without a
+ limiter. Cleared with the flash counters. */
+    bool has_rpc_limit;
+    lfspart_RpcLimitStats rpc_limit;
+} lfspart_GetStats_reply;
+
+typedef PB_BYTES_ARRAY_T(8) lfspart_BlockSig_strong_t;
+typedef struct _lfspart_BlockSig {
+    /* Rolling checksum (rsync Adler-32 variant). */
+    uint32_t weak;
+    /* First 8 bytes of the block MD5. */
+    lfspart_BlockSig_strong_t strong;
+} lfspart_BlockSig;
+
+typedef struct _lfspart_FileSig_call {
+    /* Partition label. */
+    char part_label[18];
+    /* File path. */
+    char path[64];
+    /* Signature block size, 64 to 4096. */
+    uint32_t block_size;
+    /* First block. */
+    uint32_t start_block;
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
+} lfspart_FileSig_call;
+
+typedef struct _lfspart_FileSig_reply {
+    /* 0 on success, negative lfs error code otherwise. */
+    int32_t status;
+    uint32_t file_size;
+    uint32_t block_size;
+    uint32_t start_block;
+    /* Signatures from start_block (call again from start_block + count for
+the rest). */
+    pb_size_t sigs_count;
+    lfspart_BlockSig sigs[128];
+} lfspart_FileSig_reply;
+
+typedef PB_BYTES_ARRAY_T(3072) lfspart_FilePatch_call_data_t;
+typedef struct _lfspart_FilePatch_call {
+    /* Partition label. */
+    char part_label[18];
+    /* File path. */
+    char path[64];
+    /* Patch id from the previous reply, 0 to start. */
+    uint32_t xfer_id;
+    /* Signature block size. */
+    uint32_t block_size;
+    /* Run of original blocks to copy first (count 0 for none). */
+    uint32_t copy_block;
+    uint32_t copy_count;
+    /* Literal data appended after the copy. */
+    lfspart_FilePatch_call_data_t data;
+    /* Ends the new file, which replaces the original. */
+    bool last;
+    /* With last, CRC32 (zlib) of the new file. */
+    uint32_t crc;
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
+} lfspart_FilePatch_call;
+
+typedef struct _lfspart_FilePatch_reply {
+    /* 0 on success, negative lfs error code otherwise. */
+    int32_t status;
+    /* Patch id for the next call, 0 once over. */
+    uint32_t xfer_id;
+    /* Size and CRC32 of the new file so far. */
+    uint32_t size;
+    uint32_t crc;
+} lfspart_FilePatch_reply;
+
+typedef struct _lfspart_TxBegin_call {
+    /* Partition label. */
+    char part_label[18];
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
+} lfspart_TxBegin_call;
+
+typedef struct _lfspart_TxBegin_reply {
+    /* 0 on success, negative lfs error code otherwise. */
+    int32_t status;
+    /* Transaction id for FilePut, Remove and TxCommit. */
+    uint32_t tx_id;
+} lfspart_TxBegin_reply;
+
+typedef struct _lfspart_TxCommit_call {
+    /* Transaction id (TxBegin reply). */
+    uint32_t tx_id;
+    /* Drop the transaction instead (staging files are removed). */
+    bool abort;
+} lfspart_TxCommit_call;
+
+typedef struct _lfspart_TxCommit_reply {
+    /* 0 on success, negative lfs error code otherwise (LFS_ERR_INVAL: a
+ put of the transaction is not complete, it stays open). */
+    int32_t status;
+    /* Number of files written or removed. */
+    uint32_t files;
+} lfspart_TxCommit_reply;
+
+typedef PB_BYTES_ARRAY_T(32) lfspart_FileDigest_sha256_t;
+typedef struct _lfspart_FileDigest {
+    char path[64];
+    /* 0 on success, negative lfs error code otherwise (LFS_ERR_NOENT: no
+ such file). */
+    int32_t status;
+    uint32_t size;
+    /* CRC32 (zlib) and SHA-256 of the file. */
+    uint32_t crc;
+    lfspart_FileDigest_sha256_t sha256;
+    /* The digest was cached on the device (not computed by this call). */
+    bool cached;
+} lfspart_FileDigest;
+
+typedef struct _lfspart_GetDigests_call {
+    /* Partition label. */
+    char part_label[18];
+    /* Partition handle (GetFsInfo reply) to skip the label lookup, 0 to
+ use part_label. If both are set, part_label is checked. */
+    uint32_t part_handle;
+    /* Files to get the digests of. */
+    pb_size_t paths_count;
+    char paths[16][64];
+    /* Without paths: the files of this directory tree, from file index
+ cursor (0 to start). */
+    char dir[64];
+    uint32_t cursor;
+} lfspart_GetDigests_call;
+
+typedef struct _lfspart_GetDigests_reply {
+    /* 0 on success, negative lfs error code otherwise. */
+    int32_t status;
+    pb_size_t digests_count;
+    lfspart_FileDigest digests[16];
+    /* Cursor of the rest of the tree, 0 once it is done. */
+    uint32_t cursor;
+} lfspart_GetDigests_reply;
+
 typedef struct _lfspart_LfsCallset {
     pb_size_t which_msg;
     union {
@@ -194,6 +503,24 @@ typedef struct _lfspart_LfsCallset {
         lfspart_Remove_reply remove_reply;
         lfspart_GetFileSize_call getfilesize_call;
         lfspart_GetFileSize_reply getfilesize_reply;
+        lfspart_FileSync_call filesync_call;
+        lfspart_FileSync_reply filesync_reply;
+        lfspart_FileGet_call fileget_call;
+        lfspart_FileGet_reply fileget_reply;
+        lfspart_FilePut_call fileput_call;
+        lfspart_FilePut_reply fileput_reply;
+        lfspart_GetStats_call getstats_call;
+        lfspart_GetStats_reply getstats_reply;
+        lfspart_FileSig_call filesig_call;
+        lfspart_FileSig_reply filesig_reply;
+        lfspart_FilePatch_call filepatch_call;
+        lfspart_FilePatch_reply filepatch_reply;
+        lfspart_TxBegin_call txbegin_call;
+        lfspart_TxBegin_reply txbegin_reply;
+        lfspart_TxCommit_call txcommit_call;
+        lfspart_TxCommit_reply txcommit_reply;
+        lfspart_GetDigests_call getdigests_call;
+        lfspart_GetDigests_reply getdigests_reply;
     } msg;
 } lfspart_LfsCallset;
 
@@ -204,15 +531,15 @@ extern "C" {
 
 /* Initializer values for message structs */
 #define lfspart_FileInfo_init_default            {0, 0, ""}
-#define lfspart_GetFsInfo_call_init_default      {""}
-#define lfspart_GetFsInfo_reply_init_default     {0, 0, 0, 0}
-#define lfspart_DirOpen_call_init_default        {"", ""}
+#define lfspart_GetFsInfo_call_init_default      {"", 0}
+#define lfspart_GetFsInfo_reply_init_default     {0, 0, 0, 0, 0}
+#define lfspart_DirOpen_call_init_default        {"", "", 0}
 #define lfspart_DirOpen_reply_init_default       {0}
 #define lfspart_DirClose_call_init_default       {0}
 #define lfspart_DirClose_reply_init_default      {0}
 #define lfspart_DirRead_call_init_default        {0}
 #define lfspart_DirRead_reply_init_default       {0, false, lfspart_FileInfo_init_default}
-#define lfspart_FileOpen_call_init_default       {"", "", 0}
+#define lfspart_FileOpen_call_init_default       {"", "", 0, 0}
 #define lfspart_FileOpen_reply_init_default      {0, 0}
 #define lfspart_FileClose_call_init_default      {0}
 #define lfspart_FileClose_reply_init_default     {0}
@@ -220,23 +547,45 @@ extern "C" {
 #define lfspart_FileRead_reply_init_default      {0, {0, {0}}}
 #define lfspart_FileWrite_call_init_default      {0, 0, 0, 0, {0, {0}}}
 #define lfspart_FileWrite_reply_init_default     {0}
-#define lfspart_DirList_call_init_default        {"", "", 0}
-#define lfspart_DirList_reply_init_default       {0, 0, 0, 0, {lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default}}
-#define lfspart_Remove_call_init_default         {"", ""}
+#define lfspart_DirList_call_init_default        {"", "", 0, 0, 0}
+#define lfspart_DirList_reply_init_default       {0, 0, 0, 0, {lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default, lfspart_FileInfo_init_default}, 0}
+#define lfspart_Remove_call_init_default         {"", "", 0, 0}
 #define lfspart_Remove_reply_init_default        {0}
-#define lfspart_GetFileSize_call_init_default    {"", ""}
+#define lfspart_GetFileSize_call_init_default    {"", "", 0}
 #define lfspart_GetFileSize_reply_init_default   {0}
+#define lfspart_FileSync_call_init_default       {0}
+#define lfspart_FileSync_reply_init_default      {0}
+#define lfspart_FileGet_call_init_default        {"", "", 0, 0, 0, 0}
+#define lfspart_FileGet_reply_init_default       {0, 0, 0, 0, 0, 0, {0, {0}}}
+#define lfspart_FilePut_call_init_default        {"", "", 0, 0, 0, 0, {0, {0}}, 0, 0}
+#define lfspart_FilePut_reply_init_default       {0, 0, 0, 0}
+#define lfspart_OpStats_init_default             {0, 0, 0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0}}
+#define lfspart_RpcLimitStats_init_default       {0, 0, 0, 0, 0, 0}
+#define lfspart_GetStats_call_init_default       {"", 0, 0, 0}
+#define lfspart_GetStats_reply_init_default      {0, false, lfspart_OpStats_init_default, false, lfspart_OpStats_init_default, false, lfspart_OpStats_init_default, 0, 0, 0, 0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, false, lfspart_RpcLimitStats_init_default}
+#define lfspart_BlockSig_init_default            {0, {0, {0}}}
+#define lfspart_FileSig_call_init_default        {"", "", 0, 0, 0}
+#define lfspart_FileSig_reply_init_default       {0, 0, 0, 0, 0, {lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default, lfspart_BlockSig_init_default}}
+#define lfspart_FilePatch_call_init_default      {"", "", 0, 0, 0, 0, {0, {0}}, 0, 0, 0}
+#define lfspart_FilePatch_reply_init_default     {0, 0, 0, 0}
+#define lfspart_TxBegin_call_init_default        {"", 0}
+#define lfspart_TxBegin_reply_init_default       {0, 0}
+#define lfspart_TxCommit_call_init_default       {0, 0}
+#define lfspart_TxCommit_reply_init_default      {0, 0}
+#define lfspart_FileDigest_init_default          {"", 0, 0, 0, {0, {0}}, 0}
+#define lfspart_GetDigests_call_init_default     {"", 0, 0, {"", "", "", "", "", "", "", "", "", "", "", "", "", "", "", ""}, "", 0}
+#define lfspart_GetDigests_reply_init_default    {0, 0, {lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default, lfspart_FileDigest_init_default}, 0}
 #define lfspart_LfsCallset_init_default          {0, {lfspart_GetFsInfo_call_init_default}}
 #define lfspart_FileInfo_init_zero               {0, 0, ""}
-#define lfspart_GetFsInfo_call_init_zero         {""}
-#define lfspart_GetFsInfo_reply_init_zero        {0, 0, 0, 0}
-#define lfspart_DirOpen_call_init_zero           {"", ""}
+#define lfspart_GetFsInfo_call_init_zero         {"", 0}
+#define lfspart_GetFsInfo_reply_init_zero        {0, 0, 0, 0, 0}
+#define lfspart_DirOpen_call_init_zero           {"", "", 0}
 #define lfspart_DirOpen_reply_init_zero          {0}
 #define lfspart_DirClose_call_init_zero          {0}
 #define lfspart_DirClose_reply_init_zero         {0}
 #define lfspart_DirRead_call_init_zero           {0}
 #define lfspart_DirRead_reply_init_zero          {0, false, lfspart_FileInfo_init_zero}
-#define lfspart_FileOpen_call_init_zero          {"", "", 0}
+#define lfspart_FileOpen_call_init_zero          {"", "", 0, 0}
 #define lfspart_FileOpen_reply_init_zero         {0, 0}
 #define lfspart_FileClose_call_init_zero         {0}
 #define lfspart_FileClose_reply_init_zero        {0}
@@ -244,12 +593,34 @@ extern "C" {
 #define lfspart_FileRead_reply_init_zero         {0, {0, {0}}}
 #define lfspart_FileWrite_call_init_zero         {0, 0, 0, 0, {0, {0}}}
 #define lfspart_FileWrite_reply_init_zero        {0}
-#define lfspart_DirList_call_init_zero           {"", "", 0}
-#define lfspart_DirList_reply_init_zero          {0, 0, 0, 0, {lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero}}
-#define lfspart_Remove_call_init_zero            {"", ""}
+#define lfspart_DirList_call_init_zero           {"", "", 0, 0, 0}
+#define lfspart_DirList_reply_init_zero          {0, 0, 0, 0, {lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero, lfspart_FileInfo_init_zero}, 0}
+#define lfspart_Remove_call_init_zero            {"", "", 0, 0}
 #define lfspart_Remove_reply_init_zero           {0}
-#define lfspart_GetFileSize_call_init_zero       {"", ""}
+#define lfspart_GetFileSize_call_init_zero       {"", "", 0}
 #define lfspart_GetFileSize_reply_init_zero      {0}
+#define lfspart_FileSync_call_init_zero          {0}
+#define lfspart_FileSync_reply_init_zero         {0}
+#define lfspart_FileGet_call_init_zero           {"", "", 0, 0, 0, 0}
+#define lfspart_FileGet_reply_init_zero          {0, 0, 0, 0, 0, 0, {0, {0}}}
+#define lfspart_FilePut_call_init_zero           {"", "", 0, 0, 0, 0, {0, {0}}, 0, 0}
+#define lfspart_FilePut_reply_init_zero          {0, 0, 0, 0}
+#define lfspart_OpStats_init_zero                {0, 0, 0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0}}
+#define lfspart_RpcLimitStats_init_zero          {0, 0, 0, 0, 0, 0}
+#define lfspart_GetStats_call_init_zero          {"", 0, 0, 0}
+#define lfspart_GetStats_reply_init_zero         {0, false, lfspart_OpStats_init_zero, false, lfspart_OpStats_init_zero, false, lfspart_OpStats_init_zero, 0, 0, 0, 0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, false, lfspart_RpcLimitStats_init_zero}
+#define lfspart_BlockSig_init_zero               {0, {0, {0}}}
+#define lfspart_FileSig_call_init_zero           {"", "", 0, 0, 0}
+#define lfspart_FileSig_reply_init_zero          {0, 0, 0, 0, 0, {lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero, lfspart_BlockSig_init_zero}}
+#define lfspart_FilePatch_call_init_zero         {"", "", 0, 0, 0, 0, {0, {0}}, 0, 0, 0}
+#define lfspart_FilePatch_reply_init_zero        {0, 0, 0, 0}
+#define lfspart_TxBegin_call_init_zero           {"", 0}
+#define lfspart_TxBegin_reply_init_zero          {0, 0}
+#define lfspart_TxCommit_call_init_zero          {0, 0}
+#define lfspart_TxCommit_reply_init_zero         {0, 0}
+#define lfspart_FileDigest_init_zero             {"", 0, 0, 0, {0, {0}}, 0}
+#define lfspart_GetDigests_call_init_zero        {"", 0, 0, {"", "", "", "", "", "", "", "", "", "", "", "", "", "", "", ""}, "", 0}
+#define lfspart_GetDigests_reply_init_zero       {0, 0, {lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero, lfspart_FileDigest_init_zero}, 0}
 #define lfspart_LfsCallset_init_zero             {0, {lfspart_GetFsInfo_call_init_zero}}
 
 /* Field tags (for use in manual encoding/decoding) */
@@ -257,12 +628,15 @@ extern "C" {
 #define lfspart_FileInfo_size_tag                2
 #define lfspart_FileInfo_name_tag                3
 #define lfspart_GetFsInfo_call_part_label_tag    1
+#define lfspart_GetFsInfo_call_part_handle_tag   2
 #define lfspart_GetFsInfo_reply_address_tag      1
 #define lfspart_GetFsInfo_reply_size_tag         2
 #define lfspart_GetFsInfo_reply_block_size_tag   3
 #define lfspart_GetFsInfo_reply_block_count_tag  4
+#define lfspart_GetFsInfo_reply_part_handle_tag  5
 #define lfspart_DirOpen_call_part_label_tag      1
 #define lfspart_DirOpen_call_path_tag            2
+#define lfspart_DirOpen_call_part_handle_tag     3
 #define lfspart_DirOpen_reply_fd_tag             1
 #define lfspart_DirClose_call_fd_tag             1
 #define lfspart_DirRead_call_fd_tag              1
@@ -271,6 +645,7 @@ extern "C" {
 #define lfspart_FileOpen_call_part_label_tag     1
 #define lfspart_FileOpen_call_path_tag           2
 #define lfspart_FileOpen_call_flags_tag          3
+#define lfspart_FileOpen_call_part_handle_tag    4
 #define lfspart_FileOpen_reply_status_tag        1
 #define lfspart_FileOpen_reply_fd_tag            2
 #define lfspart_FileClose_call_fd_tag            1
@@ -290,16 +665,125 @@ extern "C" {
 #define lfspart_DirList_call_part_label_tag      1
 #define lfspart_DirList_call_path_tag            2
 #define lfspart_DirList_call_start_idx_tag       3
+#define lfspart_DirList_call_cursor_tag          4
+#define lfspart_DirList_call_part_handle_tag     5
 #define lfspart_DirList_reply_valid_tag          1
 #define lfspart_DirList_reply_num_entries_tag    2
 #define lfspart_DirList_reply_start_idx_tag      3
 #define lfspart_DirList_reply_info_array_tag     4
+#define lfspart_DirList_reply_cursor_tag         5
 #define lfspart_Remove_call_part_label_tag       1
 #define lfspart_Remove_call_path_tag             2
+#define lfspart_Remove_call_part_handle_tag      3
+#define lfspart_Remove_call_tx_id_tag            4
 #define lfspart_Remove_reply_status_tag          1
 #define lfspart_GetFileSize_call_part_label_tag  1
 #define lfspart_GetFileSize_call_path_tag        2
+#define lfspart_GetFileSize_call_part_handle_tag 3
 #define lfspart_GetFileSize_reply_status_tag     1
+#define lfspart_FileSync_call_fd_tag             1
+#define lfspart_FileSync_reply_status_tag        1
+#define lfspart_FileGet_call_part_label_tag      1
+#define lfspart_FileGet_call_path_tag            2
+#define lfspart_FileGet_call_xfer_id_tag         3
+#define lfspart_FileGet_call_offset_tag          4
+#define lfspart_FileGet_call_crc_tag             5
+#define lfspart_FileGet_call_part_handle_tag     6
+#define lfspart_FileGet_reply_status_tag         1
+#define lfspart_FileGet_reply_xfer_id_tag        2
+#define lfspart_FileGet_reply_offset_tag         3
+#define lfspart_FileGet_reply_file_size_tag      4
+#define lfspart_FileGet_reply_eof_tag            5
+#define lfspart_FileGet_reply_crc_tag            6
+#define lfspart_FileGet_reply_data_tag           7
+#define lfspart_FilePut_call_part_label_tag      1
+#define lfspart_FilePut_call_path_tag            2
+#define lfspart_FilePut_call_xfer_id_tag         3
+#define lfspart_FilePut_call_offset_tag          4
+#define lfspart_FilePut_call_last_tag            5
+#define lfspart_FilePut_call_crc_tag             6
+#define lfspart_FilePut_call_data_tag            7
+#define lfspart_FilePut_call_part_handle_tag     8
+#define lfspart_FilePut_call_tx_id_tag           9
+#define lfspart_FilePut_reply_status_tag         1
+#define lfspart_FilePut_reply_xfer_id_tag        2
+#define lfspart_FilePut_reply_offset_tag         3
+#define lfspart_FilePut_reply_crc_tag            4
+#define lfspart_OpStats_count_tag                1
+#define lfspart_OpStats_bytes_tag                2
+#define lfspart_OpStats_total_us_tag             3
+#define lfspart_OpStats_max_us_tag               4
+#define lfspart_OpStats_hist_tag                 5
+#define lfspart_RpcLimitStats_admitted_tag       1
+#define lfspart_RpcLimitStats_rejected_client_tag 2
+#define lfspart_RpcLimitStats_rejected_callset_tag 3
+#define lfspart_RpcLimitStats_rejected_inflight_tag 4
+#define lfspart_RpcLimitStats_in_flight_tag      5
+#define lfspart_RpcLimitStats_max_in_flight_tag  6
+#define lfspart_GetStats_call_part_label_tag     1
+#define lfspart_GetStats_call_clear_tag          2
+#define lfspart_GetStats_call_wear_start_tag     3
+#define lfspart_GetStats_call_part_handle_tag    4
+#define lfspart_GetStats_reply_status_tag        1
+#define lfspart_GetStats_reply_read_tag          2
+#define lfspart_GetStats_reply_prog_tag          3
+#define lfspart_GetStats_reply_erase_tag         4
+#define lfspart_GetStats_reply_cache_hits_tag    5
+#define lfspart_GetStats_reply_cache_misses_tag  6
+#define lfspart_GetStats_reply_max_erase_count_tag 7
+#define lfspart_GetStats_reply_block_count_tag   8
+#define lfspart_GetStats_reply_wear_start_tag    9
+#define lfspart_GetStats_reply_wear_tag          10
+#define lfspart_GetStats_reply_mount_us_tag      11
+#define lfspart_GetStats_reply_rpc_limit_tag     12
+#define lfspart_BlockSig_weak_tag                1
+#define lfspart_BlockSig_strong_tag              2
+#define lfspart_FileSig_call_part_label_tag      1
+#define lfspart_FileSig_call_path_tag            2
+#define lfspart_FileSig_call_block_size_tag      3
+#define lfspart_FileSig_call_start_block_tag     4
+#define lfspart_FileSig_call_part_handle_tag     5
+#define lfspart_FileSig_reply_status_tag         1
+#define lfspart_FileSig_reply_file_size_tag      2
+#define lfspart_FileSig_reply_block_size_tag     3
+#define lfspart_FileSig_reply_start_block_tag    4
+#define lfspart_FileSig_reply_sigs_tag           5
+#define lfspart_FilePatch_call_part_label_tag    1
+#define lfspart_FilePatch_call_path_tag          2
+#define lfspart_FilePatch_call_xfer_id_tag       3
+#define lfspart_FilePatch_call_block_size_tag    4
+#define lfspart_FilePatch_call_copy_block_tag    5
+#define lfspart_FilePatch_call_copy_count_tag    6
+#define lfspart_FilePatch_call_data_tag          7
+#define lfspart_FilePatch_call_last_tag          8
+#define lfspart_FilePatch_call_crc_tag           9
+#define lfspart_FilePatch_call_part_handle_tag   10
+#define lfspart_FilePatch_reply_status_tag       1
+#define lfspart_FilePatch_reply_xfer_id_tag      2
+#define lfspart_FilePatch_reply_size_tag         3
+#define lfspart_FilePatch_reply_crc_tag          4
+#define lfspart_TxBegin_call_part_label_tag      1
+#define lfspart_TxBegin_call_part_handle_tag     2
+#define lfspart_TxBegin_reply_status_tag         1
+#define lfspart_TxBegin_reply_tx_id_tag          2
+#define lfspart_TxCommit_call_tx_id_tag          1
+#define lfspart_TxCommit_call_abort_tag          2
+#define lfspart_TxCommit_reply_status_tag        1
+#define lfspart_TxCommit_reply_files_tag         2
+#define lfspart_FileDigest_path_tag              1
+#define lfspart_FileDigest_status_tag            2
+#define lfspart_FileDigest_size_tag              3
+#define lfspart_FileDigest_crc_tag               4
+#define lfspart_FileDigest_sha256_tag            5
+#define lfspart_FileDigest_cached_tag            6
+#define lfspart_GetDigests_call_part_label_tag   1
+#define lfspart_GetDigests_call_part_handle_tag  2
+#define lfspart_GetDigests_call_paths_tag        3
+#define lfspart_GetDigests_call_dir_tag          4
+#define lfspart_GetDigests_call_cursor_tag       5
+#define lfspart_GetDigests_reply_status_tag      1
+#define lfspart_GetDigests_reply_digests_tag     2
+#define lfspart_GetDigests_reply_cursor_tag      3
 #define lfspart_LfsCallset_getfsinfo_call_tag    1
 #define lfspart_LfsCallset_getfsinfo_reply_tag   2
 #define lfspart_LfsCallset_diropen_call_tag      3
@@ -322,6 +806,24 @@ extern "C" {
 #define lfspart_LfsCallset_remove_reply_tag      20
 #define lfspart_LfsCallset_getfilesize_call_tag  21
 #define lfspart_LfsCallset_getfilesize_reply_tag 22
+#define lfspart_LfsCallset_filesync_call_tag     23
+#define lfspart_LfsCallset_filesync_reply_tag    24
+#define lfspart_LfsCallset_fileget_call_tag      25
+#define lfspart_LfsCallset_fileget_reply_tag     26
+#define lfspart_LfsCallset_fileput_call_tag      27
+#define lfspart_LfsCallset_fileput_reply_tag     28
+#define lfspart_LfsCallset_getstats_call_tag     29
+#define lfspart_LfsCallset_getstats_reply_tag    30
+#define lfspart_LfsCallset_filesig_call_tag      31
+#define lfspart_LfsCallset_filesig_reply_tag     32
+#define lfspart_LfsCallset_filepatch_call_tag    33
+#define lfspart_LfsCallset_filepatch_reply_tag   34
+#define lfspart_LfsCallset_txbegin_call_tag      35
+#define lfspart_LfsCallset_txbegin_reply_tag     36
+#define lfspart_LfsCallset_txcommit_call_tag     37
+#define lfspart_LfsCallset_txcommit_reply_tag    38
+#define lfspart_LfsCallset_getdigests_call_tag   39
+#define lfspart_LfsCallset_getdigests_reply_tag  40
 
 /* Struct field encoding specification for nanopb */
 #define lfspart_FileInfo_FIELDLIST(X, a) \
@@ -332,7 +834,8 @@ X(a, STATIC,   SINGULAR, STRING,   name,              3)
 #define lfspart_FileInfo_DEFAULT NULL
 
 #define lfspart_GetFsInfo_call_FIELDLIST(X, a) \
-X(a, STATIC,   SINGULAR, STRING,   part_label,        1)
+X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       2)
 #define lfspart_GetFsInfo_call_CALLBACK NULL
 #define lfspart_GetFsInfo_call_DEFAULT NULL
 
@@ -340,13 +843,15 @@ X(a, STATIC,   SINGULAR, STRING,   part_label,        1)
 X(a, STATIC,   SINGULAR, UINT32,   address,           1) \
 X(a, STATIC,   SINGULAR, UINT32,   size,              2) \
 X(a, STATIC,   SINGULAR, UINT32,   block_size,        3) \
-X(a, STATIC,   SINGULAR, UINT32,   block_count,       4)
+X(a, STATIC,   SINGULAR, UINT32,   block_count,       4) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       5)
 #define lfspart_GetFsInfo_reply_CALLBACK NULL
 #define lfspart_GetFsInfo_reply_DEFAULT NULL
 
 #define lfspart_DirOpen_call_FIELDLIST(X, a) \
 X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
-X(a, STATIC,   SINGULAR, STRING,   path,              2)
+X(a, STATIC,   SINGULAR, STRING,   path,              2) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       3)
 #define lfspart_DirOpen_call_CALLBACK NULL
 #define lfspart_DirOpen_call_DEFAULT NULL
 
@@ -380,7 +885,8 @@ X(a, STATIC,   OPTIONAL, MESSAGE,  info,              2)
 #define lfspart_FileOpen_call_FIELDLIST(X, a) \
 X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
 X(a, STATIC,   SINGULAR, STRING,   path,              2) \
-X(a, STATIC,   SINGULAR, UINT32,   flags,             3)
+X(a, STATIC,   SINGULAR, UINT32,   flags,             3) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       4)
 #define lfspart_FileOpen_call_CALLBACK NULL
 #define lfspart_FileOpen_call_DEFAULT NULL
 
@@ -432,7 +938,9 @@ X(a, STATIC,   SINGULAR, INT32,    status,            1)
 #define lfspart_DirList_call_FIELDLIST(X, a) \
 X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
 X(a, STATIC,   SINGULAR, STRING,   path,              2) \
-X(a, STATIC,   SINGULAR, UINT32,   start_idx,         3)
+X(a, STATIC,   SINGULAR, UINT32,   start_idx,         3) \
+X(a, STATIC,   SINGULAR, UINT32,   cursor,            4) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       5)
 #define lfspart_DirList_call_CALLBACK NULL
 #define lfspart_DirList_call_DEFAULT NULL
 
@@ -440,14 +948,17 @@ X(a, STATIC,   SINGULAR, UINT32,   start_idx,         3)
 X(a, STATIC,   SINGULAR, BOOL,     valid,             1) \
 X(a, STATIC,   SINGULAR, UINT32,   num_entries,       2) \
 X(a, STATIC,   SINGULAR, UINT32,   start_idx,         3) \
-X(a, STATIC,   REPEATED, MESSAGE,  info_array,        4)
+X(a, STATIC,   REPEATED, MESSAGE,  info_array,        4) \
+X(a, STATIC,   SINGULAR, UINT32,   cursor,            5)
 #define lfspart_DirList_reply_CALLBACK NULL
 #define lfspart_DirList_reply_DEFAULT NULL
 #define lfspart_DirList_reply_info_array_MSGTYPE lfspart_FileInfo
 
 #define lfspart_Remove_call_FIELDLIST(X, a) \
 X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
-X(a, STATIC,   SINGULAR, STRING,   path,              2)
+X(a, STATIC,   SINGULAR, STRING,   path,              2) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       3) \
+X(a, STATIC,   SINGULAR, UINT32,   tx_id,             4)
 #define lfspart_Remove_call_CALLBACK NULL
 #define lfspart_Remove_call_DEFAULT NULL
 
@@ -458,7 +969,8 @@ X(a, STATIC,   SINGULAR, INT32,    status,            1)
 
 #define lfspart_GetFileSize_call_FIELDLIST(X, a) \
 X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
-X(a, STATIC,   SINGULAR, STRING,   path,              2)
+X(a, STATIC,   SINGULAR, STRING,   path,              2) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       3)
 #define lfspart_GetFileSize_call_CALLBACK NULL
 #define lfspart_GetFileSize_call_DEFAULT NULL
 
@@ -467,6 +979,203 @@ X(a, STATIC,   SINGULAR, INT32,    status,            1)
 #define lfspart_GetFileSize_reply_CALLBACK NULL
 #define lfspart_GetFileSize_reply_DEFAULT NULL
 
+#define lfspart_FileSync_call_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   fd,                1)
+#define lfspart_FileSync_call_CALLBACK NULL
+#define lfspart_FileSync_call_DEFAULT NULL
+
+#define lfspart_FileSync_reply_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    status,            1)
+#define lfspart_FileSync_reply_CALLBACK NULL
+#define lfspart_FileSync_reply_DEFAULT NULL
+
+#define lfspart_FileGet_call_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
+X(a, STATIC,   SINGULAR, STRING,   path,              2) \
+X(a, STATIC,   SINGULAR, UINT32,   xfer_id,           3) \
+X(a, STATIC,   SINGULAR, UINT32,   offset,            4) \
+X(a, STATIC,   SINGULAR, UINT32,   crc,               5) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       6)
+#define lfspart_FileGet_call_CALLBACK NULL
+#define lfspart_FileGet_call_DEFAULT NULL
+
+#define lfspart_FileGet_reply_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    status,            1) \
+X(a, STATIC,   SINGULAR, UINT32,   xfer_id,           2) \
+X(a, STATIC,   SINGULAR, UINT32,   offset,            3) \
+X(a, STATIC,   SINGULAR, UINT32,   file_size,         4) \
+X(a, STATIC,   SINGULAR, BOOL,     eof,               5) \
+X(a, STATIC,   SINGULAR, UINT32,   crc,               6) \
+X(a, STATIC,   SINGULAR, BYTES,    data,              7)
+#define lfspart_FileGet_reply_CALLBACK NULL
+#define lfspart_FileGet_reply_DEFAULT NULL
+
+#define lfspart_FilePut_call_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
+X(a, STATIC,   SINGULAR, STRING,   path,              2) \
+X(a, STATIC,   SINGULAR, UINT32,   xfer_id,           3) \
+X(a, STATIC,   SINGULAR, UINT32,   offset,            4) \
+X(a, STATIC,   SINGULAR, BOOL,     last,              5) \
+X(a, STATIC,   SINGULAR, UINT32,   crc,               6) \
+X(a, STATIC,   SINGULAR, BYTES,    data,              7) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       8) \
+X(a, STATIC,   SINGULAR, UINT32,   tx_id,             9)
+#define lfspart_FilePut_call_CALLBACK NULL
+#define lfspart_FilePut_call_DEFAULT NULL
+
+#define lfspart_FilePut_reply_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    status,            1) \
+X(a, STATIC,   SINGULAR, UINT32,   xfer_id,           2) \
+X(a, STATIC,   SINGULAR, UINT32,   offset,            3) \
+X(a, STATIC,   SINGULAR, UINT32,   crc,               4)
+#define lfspart_FilePut_reply_CALLBACK NULL
+#define lfspart_FilePut_reply_DEFAULT NULL
+
+#define lfspart_OpStats_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   count,             1) \
+X(a, STATIC,   SINGULAR, UINT64,   bytes,             2) \
+X(a, STATIC,   SINGULAR, UINT64,   total_us,          3) \
+X(a, STATIC,   SINGULAR, UINT32,   max_us,            4) \
+X(a, STATIC,   REPEATED, UINT32,   hist,              5)
+#define lfspart_OpStats_CALLBACK NULL
+#define lfspart_OpStats_DEFAULT NULL
+
+#define lfspart_RpcLimitStats_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   admitted,          1) \
+X(a, STATIC,   SINGULAR, UINT32,   rejected_client,   2) \
+X(a, STATIC,   SINGULAR, UINT32,   rejected_callset,   3) \
+X(a, STATIC,   SINGULAR, UINT32,   rejected_inflight,   4) \
+X(a, STATIC,   SINGULAR, UINT32,   in_flight,         5) \
+X(a, STATIC,   SINGULAR, UINT32,   max_in_flight,     6)
+#define lfspart_RpcLimitStats_CALLBACK NULL
+#define lfspart_RpcLimitStats_DEFAULT NULL
+
+#define lfspart_GetStats_call_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
+X(a, STATIC,   SINGULAR, BOOL,     clear,             2) \
+X(a, STATIC,   SINGULAR, UINT32,   wear_start,        3) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       4)
+#define lfspart_GetStats_call_CALLBACK NULL
+#define lfspart_GetStats_call_DEFAULT NULL
+
+#define lfspart_GetStats_reply_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    status,            1) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  read,              2) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  prog,              3) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  erase,             4) \
+X(a, STATIC,   SINGULAR, UINT32,   cache_hits,        5) \
+X(a, STATIC,   SINGULAR, UINT32,   cache_misses,      6) \
+X(a, STATIC,   SINGULAR, UINT32,   max_erase_count,   7) \
+X(a, STATIC,   SINGULAR, UINT32,   block_count,       8) \
+X(a, STATIC,   SINGULAR, UINT32,   wear_start,        9) \
+X(a, STATIC,   REPEATED, UINT32,   wear,             10) \
+X(a, STATIC,   SINGULAR, UINT32,   mount_us,         11) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  rpc_limit,        12)
+#define lfspart_GetStats_reply_CALLBACK NULL
+#define lfspart_GetStats_reply_DEFAULT NULL
+#define lfspart_GetStats_reply_read_MSGTYPE lfspart_OpStats
+#define lfspart_GetStats_reply_prog_MSGTYPE lfspart_OpStats
+#define lfspart_GetStats_reply_erase_MSGTYPE lfspart_OpStats
+#define lfspart_GetStats_reply_rpc_limit_MSGTYPE lfspart_RpcLimitStats
+
+#define lfspart_BlockSig_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   weak,              1) \
+X(a, STATIC,   SINGULAR, BYTES,    strong,            2)
+#define lfspart_BlockSig_CALLBACK NULL
+#define lfspart_BlockSig_DEFAULT NULL
+
+#define lfspart_FileSig_call_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
+X(a, STATIC,   SINGULAR, STRING,   path,              2) \
+X(a, STATIC,   SINGULAR, UINT32,   block_size,        3) \
+X(a, STATIC,   SINGULAR, UINT32,   start_block,       4) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       5)
+#define lfspart_FileSig_call_CALLBACK NULL
+#define lfspart_FileSig_call_DEFAULT NULL
+
+#define lfspart_FileSig_reply_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    status,            1) \
+X(a, STATIC,   SINGULAR, UINT32,   file_size,         2) \
+X(a, STATIC,   SINGULAR, UINT32,   block_size,        3) \
+X(a, STATIC,   SINGULAR, UINT32,   start_block,       4) \
+X(a, STATIC,   REPEATED, MESSAGE,  sigs,              5)
+#define lfspart_FileSig_reply_CALLBACK NULL
+#define lfspart_FileSig_reply_DEFAULT NULL
+#define lfspart_FileSig_reply_sigs_MSGTYPE lfspart_BlockSig
+
+#define lfspart_FilePatch_call_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
+X(a, STATIC,   SINGULAR, STRING,   path,              2) \
+X(a, STATIC,   SINGULAR, UINT32,   xfer_id,           3) \
+X(a, STATIC,   SINGULAR, UINT32,   block_size,        4) \
+X(a, STATIC,   SINGULAR, UINT32,   copy_block,        5) \
+X(a, STATIC,   SINGULAR, UINT32,   copy_count,        6) \
+X(a, STATIC,   SINGULAR, BYTES,    data,              7) \
+X(a, STATIC,   SINGULAR, BOOL,     last,              8) \
+X(a, STATIC,   SINGULAR, UINT32,   crc,               9) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,      10)
+#define lfspart_FilePatch_call_CALLBACK NULL
+#define lfspart_FilePatch_call_DEFAULT NULL
+
+#define lfspart_FilePatch_reply_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    status,            1) \
+X(a, STATIC,   SINGULAR, UINT32,   xfer_id,           2) \
+X(a, STATIC,   SINGULAR, UINT32,   size,              3) \
+X(a, STATIC,   SINGULAR, UINT32,   crc,               4)
+#define lfspart_FilePatch_reply_CALLBACK NULL
+#define lfspart_FilePatch_reply_DEFAULT NULL
+
+#define lfspart_TxBegin_call_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       2)
+#define lfspart_TxBegin_call_CALLBACK NULL
+#define lfspart_TxBegin_call_DEFAULT NULL
+
+#define lfspart_TxBegin_reply_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    status,            1) \
+X(a, STATIC,   SINGULAR, UINT32,   tx_id,             2)
+#define lfspart_TxBegin_reply_CALLBACK NULL
+#define lfspart_TxBegin_reply_DEFAULT NULL
+
+#define lfspart_TxCommit_call_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   tx_id,             1) \
+X(a, STATIC,   SINGULAR, BOOL,     abort,             2)
+#define lfspart_TxCommit_call_CALLBACK NULL
+#define lfspart_TxCommit_call_DEFAULT NULL
+
+#define lfspart_TxCommit_reply_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    status,            1) \
+X(a, STATIC,   SINGULAR, UINT32,   files,             2)
+#define lfspart_TxCommit_reply_CALLBACK NULL
+#define lfspart_TxCommit_reply_DEFAULT NULL
+
+#define lfspart_FileDigest_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, STRING,   path,              1) \
+X(a, STATIC,   SINGULAR, INT32,    status,            2) \
+X(a, STATIC,   SINGULAR, UINT32,   size,              3) \
+X(a, STATIC,   SINGULAR, UINT32,   crc,               4) \
+X(a, STATIC,   SINGULAR, BYTES,    sha256,            5) \
+X(a, STATIC,   SINGULAR, BOOL,     cached,            6)
+#define lfspart_FileDigest_CALLBACK NULL
+#define lfspart_FileDigest_DEFAULT NULL
+
+#define lfspart_GetDigests_call_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, STRING,   part_label,        1) \
+X(a, STATIC,   SINGULAR, UINT32,   part_handle,       2) \
+X(a, STATIC,   REPEATED, STRING,   paths,             3) \
+X(a, STATIC,   SINGULAR, STRING,   dir,               4) \
+X(a, STATIC,   SINGULAR, UINT32,   cursor,            5)
+#define lfspart_GetDigests_call_CALLBACK NULL
+#define lfspart_GetDigests_call_DEFAULT NULL
+
+#define lfspart_GetDigests_reply_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    status,            1) \
+X(a, STATIC,   REPEATED, MESSAGE,  digests,           2) \
+X(a, STATIC,   SINGULAR, UINT32,   cursor,            3)
+#define lfspart_GetDigests_reply_CALLBACK NULL
+#define lfspart_GetDigests_reply_DEFAULT NULL
+#define lfspart_GetDigests_reply_digests_MSGTYPE lfspart_FileDigest
+
 #define lfspart_LfsCallset_FIELDLIST(X, a) \
 X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getfsinfo_call,msg.getfsinfo_call),   1) \
 X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getfsinfo_reply,msg.getfsinfo_reply),   2) \
@@ -489,7 +1198,25 @@ X(a, STATIC,   ONEOF,    MESSAGE,  (msg,filewrite_reply,msg.filewrite_reply),  1
 X(a, STATIC,   ONEOF,    MESSAGE,  (msg,remove_call,msg.remove_call),  19) \
 X(a, STATIC,   ONEOF,    MESSAGE,  (msg,remove_reply,msg.remove_reply),  20) \
 X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getfilesize_call,msg.getfilesize_call),  21) \
-X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getfilesize_reply,msg.getfilesize_reply),  22)
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getfilesize_reply,msg.getfilesize_reply),  22) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,filesync_call,msg.filesync_call),  23) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,filesync_reply,msg.filesync_reply),  24) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,fileget_call,msg.fileget_call),  25) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,fileget_reply,msg.fileget_reply),  26) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,fileput_call,msg.fileput_call),  27) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,fileput_reply,msg.fileput_reply),  28) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getstats_call,msg.getstats_call),  29) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getstats_reply,msg.getstats_reply),  30) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,filesig_call,msg.filesig_call),  31) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,filesig_reply,msg.filesig_reply),  32) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,filepatch_call,msg.filepatch_call),  33) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,filepatch_reply,msg.filepatch_reply),  34) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,txbegin_call,msg.txbegin_call),  35) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,txbegin_reply,msg.txbegin_reply),  36) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,txcommit_call,msg.txcommit_call),  37) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,txcommit_reply,msg.txcommit_reply),  38) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getdigests_call,msg.getdigests_call),  39) \
+X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getdigests_reply,msg.getdigests_reply),  40)
 #define lfspart_LfsCallset_CALLBACK NULL
 #define lfspart_LfsCallset_DEFAULT NULL
 #define lfspart_LfsCallset_msg_getfsinfo_call_MSGTYPE lfspart_GetFsInfo_call
@@ -514,6 +1241,24 @@ X(a, STATIC,   ONEOF,    MESSAGE,  (msg,getfilesize_reply,msg.getfilesize_reply)
 #define lfspart_LfsCallset_msg_remove_reply_MSGTYPE lfspart_Remove_reply
 #define lfspart_LfsCallset_msg_getfilesize_call_MSGTYPE lfspart_GetFileSize_call
 #define lfspart_LfsCallset_msg_getfilesize_reply_MSGTYPE lfspart_GetFileSize_reply
+#define lfspart_LfsCallset_msg_filesync_call_MSGTYPE lfspart_FileSync_call
+#define lfspart_LfsCallset_msg_filesync_reply_MSGTYPE lfspart_FileSync_reply
+#define lfspart_LfsCallset_msg_fileget_call_MSGTYPE lfspart_FileGet_call
+#define lfspart_LfsCallset_msg_fileget_reply_MSGTYPE lfspart_FileGet_reply
+#define lfspart_LfsCallset_msg_fileput_call_MSGTYPE lfspart_FilePut_call
+#define lfspart_LfsCallset_msg_fileput_reply_MSGTYPE lfspart_FilePut_reply
+#define lfspart_LfsCallset_msg_getstats_call_MSGTYPE lfspart_GetStats_call
+#define lfspart_LfsCallset_msg_getstats_reply_MSGTYPE lfspart_GetStats_reply
+#define lfspart_LfsCallset_msg_filesig_call_MSGTYPE lfspart_FileSig_call
+#define lfspart_LfsCallset_msg_filesig_reply_MSGTYPE lfspart_FileSig_reply
+#define lfspart_LfsCallset_msg_filepatch_call_MSGTYPE lfspart_FilePatch_call
+#define lfspart_LfsCallset_msg_filepatch_reply_MSGTYPE lfspart_FilePatch_reply
+#define lfspart_LfsCallset_msg_txbegin_call_MSGTYPE lfspart_TxBegin_call
+#define lfspart_LfsCallset_msg_txbegin_reply_MSGTYPE lfspart_TxBegin_reply
+#define lfspart_LfsCallset_msg_txcommit_call_MSGTYPE lfspart_TxCommit_call
+#define lfspart_LfsCallset_msg_txcommit_reply_MSGTYPE lfspart_TxCommit_reply
+#define lfspart_LfsCallset_msg_getdigests_call_MSGTYPE lfspart_GetDigests_call
+#define lfspart_LfsCallset_msg_getdigests_reply_MSGTYPE lfspart_GetDigests_reply
 
 extern const pb_msgdesc_t lfspart_FileInfo_msg;
 extern const pb_msgdesc_t lfspart_GetFsInfo_call_msg;
@@ -538,6 +1283,28 @@ extern const pb_msgdesc_t lfspart_Remove_call_msg;
 extern const pb_msgdesc_t lfspart_Remove_reply_msg;
 extern const pb_msgdesc_t lfspart_GetFileSize_call_msg;
 extern const pb_msgdesc_t lfspart_GetFileSize_reply_msg;
+extern const pb_msgdesc_t lfspart_FileSync_call_msg;
+extern const pb_msgdesc_t lfspart_FileSync_reply_msg;
+extern const pb_msgdesc_t lfspart_FileGet_call_msg;
+extern const pb_msgdesc_t lfspart_FileGet_reply_msg;
+extern const pb_msgdesc_t lfspart_FilePut_call_msg;
+extern const pb_msgdesc_t lfspart_FilePut_reply_msg;
+extern const pb_msgdesc_t lfspart_OpStats_msg;
+extern const pb_msgdesc_t lfspart_RpcLimitStats_msg;
+extern const pb_msgdesc_t lfspart_GetStats_call_msg;
+extern const pb_msgdesc_t lfspart_GetStats_reply_msg;
+extern const pb_msgdesc_t lfspart_BlockSig_msg;
+extern const pb_msgdesc_t lfspart_FileSig_call_msg;
+extern const pb_msgdesc_t lfspart_FileSig_reply_msg;
+extern const pb_msgdesc_t lfspart_FilePatch_call_msg;
+extern const pb_msgdesc_t lfspart_FilePatch_reply_msg;
+extern const pb_msgdesc_t lfspart_TxBegin_call_msg;
+extern const pb_msgdesc_t lfspart_TxBegin_reply_msg;
+extern const pb_msgdesc_t lfspart_TxCommit_call_msg;
+extern const pb_msgdesc_t lfspart_TxCommit_reply_msg;
+extern const pb_msgdesc_t lfspart_FileDigest_msg;
+extern const pb_msgdesc_t lfspart_GetDigests_call_msg;
+extern const pb_msgdesc_t lfspart_GetDigests_reply_msg;
 extern const pb_msgdesc_t lfspart_LfsCallset_msg;
 
 /* Defines for backwards compatibility with code written before nanopb-0.4.0 */
@@ -564,33 +1331,77 @@ extern const pb_msgdesc_t lfspart_LfsCallset_msg;
 #define lfspart_Remove_reply_fields &lfspart_Remove_reply_msg
 #define lfspart_GetFileSize_call_fields &lfspart_GetFileSize_call_msg
 #define lfspart_GetFileSize_reply_fields &lfspart_GetFileSize_reply_msg
+#define lfspart_FileSync_call_fields &lfspart_FileSync_call_msg
+#define lfspart_FileSync_reply_fields &lfspart_FileSync_reply_msg
+#define lfspart_FileGet_call_fields &lfspart_FileGet_call_msg
+#define lfspart_FileGet_reply_fields &lfspart_FileGet_reply_msg
+#define lfspart_FilePut_call_fields &lfspart_FilePut_call_msg
+#define lfspart_FilePut_reply_fields &lfspart_FilePut_reply_msg
+#define lfspart_OpStats_fields &lfspart_OpStats_msg
+#define lfspart_RpcLimitStats_fields &lfspart_RpcLimitStats_msg
+#define lfspart_GetStats_call_fields &lfspart_GetStats_call_msg
+#define lfspart_GetStats_reply_fields &lfspart_GetStats_reply_msg
+#define lfspart_BlockSig_fields &lfspart_BlockSig_msg
+#define lfspart_FileSig_call_fields &lfspart_FileSig_call_msg
+#define lfspart_FileSig_reply_fields &lfspart_FileSig_reply_msg
+#define lfspart_FilePatch_call_fields &lfspart_FilePatch_call_msg
+#define lfspart_FilePatch_reply_fields &lfspart_FilePatch_reply_msg
+#define lfspart_TxBegin_call_fields &lfspart_TxBegin_call_msg
+#define lfspart_TxBegin_reply_fields &lfspart_TxBegin_reply_msg
+#define lfspart_TxCommit_call_fields &lfspart_TxCommit_call_msg
+#define lfspart_TxCommit_reply_fields &lfspart_TxCommit_reply_msg
+#define lfspart_FileDigest_fields &lfspart_FileDigest_msg
+#define lfspart_GetDigests_call_fields &lfspart_GetDigests_call_msg
+#define lfspart_GetDigests_reply_fields &lfspart_GetDigests_reply_msg
 #define lfspart_LfsCallset_fields &lfspart_LfsCallset_msg
 
 /* Maximum encoded size of messages (where known) */
+#define lfspart_BlockSig_size                    16
 #define lfspart_DirClose_call_size               6
 #define lfspart_DirClose_reply_size              0
-#define lfspart_DirList_call_size                90
-#define lfspart_DirList_reply_size               646
-#define lfspart_DirOpen_call_size                84
+#define lfspart_DirList_call_size                102
+#define lfspart_DirList_reply_size               652
+#define lfspart_DirOpen_call_size                90
 #define lfspart_DirOpen_reply_size               11
 #define lfspart_DirRead_call_size                6
 #define lfspart_DirRead_reply_size               81
 #define lfspart_FileClose_call_size              6
 #define lfspart_FileClose_reply_size             0
+#define lfspart_FileDigest_size                  124
+#define lfspart_FileGet_call_size                108
+#define lfspart_FileGet_reply_size               3112
 #define lfspart_FileInfo_size                    77
-#define lfspart_FileOpen_call_size               90
+#define lfspart_FileOpen_call_size               96
 #define lfspart_FileOpen_reply_size              22
+#define lfspart_FilePatch_call_size              3197
+#define lfspart_FilePatch_reply_size             29
+#define lfspart_FilePut_call_size                3191
+#define lfspart_FilePut_reply_size               29
 #define lfspart_FileRead_call_size               26
 #define lfspart_FileRead_reply_size              1014
+#define lfspart_FileSig_call_size                102
+#define lfspart_FileSig_reply_size               2333
+#define lfspart_FileSync_call_size               6
+#define lfspart_FileSync_reply_size              11
 #define lfspart_FileWrite_call_size              1023
 #define lfspart_FileWrite_reply_size             11
-#define lfspart_GetFileSize_call_size            84
+#define lfspart_GetDigests_call_size             1136
+#define lfspart_GetDigests_reply_size            2033
+#define lfspart_GetFileSize_call_size            90
 #define lfspart_GetFileSize_reply_size           11
-#define lfspart_GetFsInfo_call_size              19
-#define lfspart_GetFsInfo_reply_size             24
-#define lfspart_LfsCallset_size                  1027
-#define lfspart_Remove_call_size                 84
+#define lfspart_GetFsInfo_call_size              25
+#define lfspart_GetFsInfo_reply_size             30
+#define lfspart_GetStats_call_size               33
+#define lfspart_GetStats_reply_size              3409
+#define lfspart_LfsCallset_size                  3413
+#define lfspart_OpStats_size                     82
+#define lfspart_Remove_call_size                 96
 #define lfspart_Remove_reply_size                11
+#define lfspart_RpcLimitStats_size               36
+#define lfspart_TxBegin_call_size                25
+#define lfspart_TxBegin_reply_size               17
+#define lfspart_TxCommit_call_size               8
+#define lfspart_TxCommit_reply_size              17
 
 #ifdef __cplusplus
 } /* extern "C" */
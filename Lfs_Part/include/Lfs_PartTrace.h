@@ -0,0 +1,111 @@
+/*******************************************************************************
+ *  @file: Lfs_PartTrace.h
+ *
+ *  @brief: Header for Lfs_PartTrace, a recorder of file level operations
+ *  on an Lfs_Part filesystem and a replayer for the recorded trace. Traces
+ *  are geometry independent, so one recording can be replayed against the
+ *  flash simulator with different Lfs_Part_Config (see bench/Lfs_Part_tune.c).
+ *
+ *  Trace format: text, one operation per line. Handles are the lfs_file_t
+ *  address (hex), unique while a file is open.
+ *
+ *      o <handle> <flags hex> <path>   lfs_file_open
+ *      c <handle>                      lfs_file_close
+ *      r <handle> <size>               lfs_file_read
+ *      w <handle> <size>               lfs_file_write (data is not recorded)
+ *      s <handle> <offset> <whence>    lfs_file_seek
+ *      y <handle>                      lfs_file_sync
+ *      d <path>                        lfs_remove
+ *      l <path>                        directory listing
+*******************************************************************************/
+#ifndef LFS_PARTTRACE_H
+#define LFS_PARTTRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief Max simultaneously open files during replay. */
+#define LFS_PARTTRACE_MAX_OPEN      8
+
+/** @brief Recorder state, embedded in Lfs_Part_t (off while buf is NULL).
+*/
+typedef struct Lfs_PartTrace
+{
+    char *buf;
+    uint32_t size;
+    uint32_t len;
+    /** @brief Operations not recorded because the buffer was full. */
+    uint32_t dropped;
+
+} Lfs_PartTrace;
+
+/** @brief Replay summary. */
+typedef struct Lfs_PartTrace_Result
+{
+    uint32_t ops;
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    /** @brief Most files open at once. */
+    uint32_t max_open;
+    /** @brief Operations that failed (or lines that did not parse). */
+    uint32_t errors;
+
+} Lfs_PartTrace_Result;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartTrace_log]
+*//**
+    @brief Records one operation (printf style line without newline), if
+    recording. Called by the Lfs_Part front ends (Lfs_PartRpc, Lfs_Api).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] fmt  Format.
+******************************************************************************/
+void
+Lfs_PartTrace_log(struct Lfs_Part_t *lpfs, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/******************************************************************************
+    [docexport Lfs_PartTrace_replay]
+*//**
+    @brief Replays a trace on a mounted filesystem. Written data is a fixed
+    pattern; missing parent directories of created files are created.
+    @param[in] lfs  Pointer to mounted lfs.
+    @param[in] text  Trace.
+    @param[in] len  Trace length.
+    @param[out] result  Pointer to summary to fill.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartTrace_replay(
+    lfs_t *lfs,
+    const char *text,
+    uint32_t len,
+    Lfs_PartTrace_Result *result);
+
+/******************************************************************************
+    [docexport Lfs_PartTrace_stop]
+*//**
+    @brief Stops recording.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[out] len  Trace length.
+    @return Returns the trace (NUL terminated, the caller frees it), NULL if
+    not recording.
+******************************************************************************/
+char *
+Lfs_PartTrace_stop(struct Lfs_Part_t *lpfs, uint32_t *len);
+
+/******************************************************************************
+    [docexport Lfs_PartTrace_start]
+*//**
+    @brief Starts recording into a RAM buffer (a running recording is
+    discarded).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] size  Buffer size, bytes.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartTrace_start(struct Lfs_Part_t *lpfs, uint32_t size);
+#endif
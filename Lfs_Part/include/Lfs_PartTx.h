@@ -0,0 +1,205 @@
+/*******************************************************************************
+ *  @file: Lfs_PartTx.h
+ *
+ *  @brief: Header for Lfs_PartTx, all-or-nothing updates of several files
+ *  (e.g. an application bundle: Lua scripts and LED configuration).
+ *
+ *  A file written in a transaction goes to a staging file next to it (path
+ *  with LFS_PARTTX_SUFFIX), written like any other file (Lfs_PartXfer_put);
+ *  a removal is only recorded. Commit renames the staging files over their
+ *  targets and removes the removed files, all under the partition lock.
+ *  Staging files share the directory of their target, so each rename is
+ *  one metadata commit of that directory and the file data is not copied.
+ *
+ *  The journal file (LFS_PARTTX_JOURNAL, inline in the root directory for a
+ *  few files) lists the files of the open transaction. It is rewritten when
+ *  a file is added, and with the committed state before the renames start:
+ *  that write is the commit point. Lfs_PartTx_recover, run on mount,
+ *  finishes the renames of a committed journal left by a reset, and removes
+ *  the staging files of a transaction that was not committed. A commit
+ *  whose renames fail runs it too, and a journal still left blocks
+ *  Lfs_PartTx_begin until recovery succeeds.
+ *
+ *  One transaction is open per partition; calls are serialized by the
+ *  partition lock.
+*******************************************************************************/
+#ifndef LFS_PARTTX_H
+#define LFS_PARTTX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief Max number of files in a transaction. */
+#ifndef LFS_PARTTX_FILES
+#define LFS_PARTTX_FILES            16
+#endif
+
+/** @brief Longest staging path (target path and suffix), staging file
+    suffix and journal file. */
+#define LFS_PARTTX_PATH_MAX         64
+#define LFS_PARTTX_SUFFIX           ".~tx"
+#define LFS_PARTTX_JOURNAL          "/.~txj"
+
+/** @brief Journal magic ("TXJ1"). */
+#define LFS_PARTTX_MAGIC            0x314a5854
+
+/** @brief Journal header (followed by one entry per file: op, path length,
+    path). */
+typedef struct Lfs_PartTx_Hdr
+{
+    uint32_t magic;
+    /** @brief Open or committed. */
+    uint32_t state;
+    uint32_t num_files;
+
+} Lfs_PartTx_Hdr;
+
+#define LFS_PARTTX_JOURNAL_MAX      (sizeof(Lfs_PartTx_Hdr) + \
+                                     LFS_PARTTX_FILES*(2 + LFS_PARTTX_PATH_MAX))
+
+/** @brief File of a transaction. */
+typedef struct Lfs_PartTx_File
+{
+    char path[LFS_PARTTX_PATH_MAX];
+    /** @brief Staged write or removal. */
+    uint8_t op;
+    /** @brief Staging file complete (see Lfs_PartTx_staged). */
+    bool ready;
+
+} Lfs_PartTx_File;
+
+/** @brief Transaction, owned by the caller (open from Lfs_PartTx_begin to
+    Lfs_PartTx_commit or Lfs_PartTx_abort).
+*/
+typedef struct Lfs_PartTx
+{
+    struct Lfs_Part_t *lpfs;
+    /** @brief Nonzero while open. */
+    uint32_t id;
+    Lfs_PartTx_File files[LFS_PARTTX_FILES];
+    uint32_t num_files;
+    /** @brief Journal image. */
+    uint8_t journal[LFS_PARTTX_JOURNAL_MAX];
+
+} Lfs_PartTx;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartTx_begin]
+*//**
+    @brief Opens a transaction. An unfinished transaction of the partition
+    (e.g. of a client that went away) is aborted, and a journal left by a
+    failed commit is recovered first (Lfs_PartTx_recover).
+    @param[in] tx  Transaction.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] id  Transaction id (nonzero), passed back by the caller to
+    every other call: a call with an id that is no longer open (the slot
+    reused by a later begin) fails.
+    @return Returns 0 on success, negative lfs error code otherwise (also
+    if the journal cannot be recovered).
+******************************************************************************/
+int
+Lfs_PartTx_begin(Lfs_PartTx *tx, struct Lfs_Part_t *lpfs, uint32_t id);
+
+/******************************************************************************
+    [docexport Lfs_PartTx_stage]
+*//**
+    @brief Adds a file write to a transaction and gets the staging file to
+    write it to. Staging the same file again starts it over.
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @param[in] path  File.
+    @param[out] staged  Staging file path (LFS_PARTTX_PATH_MAX bytes).
+    @return Returns 0 on success, LFS_ERR_BADF if tx is not open with id,
+    LFS_ERR_NOSPC if the transaction is full, other negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartTx_stage(
+    Lfs_PartTx *tx,
+    uint32_t id,
+    const char *path,
+    char *staged);
+
+/******************************************************************************
+    [docexport Lfs_PartTx_staged]
+*//**
+    @brief Marks the staging file of a file complete (it is closed and may
+    be committed).
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @param[in] path  File.
+    @return Returns 0 on success, LFS_ERR_BADF if tx is not open with id,
+    LFS_ERR_NOENT if path is not staged.
+******************************************************************************/
+int
+Lfs_PartTx_staged(Lfs_PartTx *tx, uint32_t id, const char *path);
+
+/******************************************************************************
+    [docexport Lfs_PartTx_remove]
+*//**
+    @brief Adds a file removal to a transaction (a staged write of the file
+    is dropped).
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @param[in] path  File.
+    @return Returns 0 on success, LFS_ERR_BADF if tx is not open with id,
+    LFS_ERR_NOSPC if the transaction is full, other negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartTx_remove(Lfs_PartTx *tx, uint32_t id, const char *path);
+
+/******************************************************************************
+    [docexport Lfs_PartTx_commit]
+*//**
+    @brief Commits a transaction: all its writes and removals take effect,
+    or none do. No other littlefs call of the partition runs in between.
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @return Returns the number of files on success, LFS_ERR_BADF if tx is
+    not open with id, LFS_ERR_INVAL if a staged file is not complete (the
+    transaction stays open), other negative lfs error code otherwise (after
+    the commit point Lfs_PartTx_recover is run to finish the remaining
+    renames).
+******************************************************************************/
+int
+Lfs_PartTx_commit(Lfs_PartTx *tx, uint32_t id);
+
+/******************************************************************************
+    [docexport Lfs_PartTx_abort]
+*//**
+    @brief Aborts a transaction and removes its staging files.
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @return Returns 0 on success, LFS_ERR_BADF if tx is not open with id,
+    other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartTx_abort(Lfs_PartTx *tx, uint32_t id);
+
+/******************************************************************************
+    [docexport Lfs_PartTx_recover]
+*//**
+    @brief Finishes a transaction left by a reset (after mount) or by a
+    failed commit: a committed one is rolled forward, an open one is rolled
+    back. Renames done before are skipped.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @return Returns the number of files rolled forward, negative lfs error
+    code otherwise.
+******************************************************************************/
+int
+Lfs_PartTx_recover(struct Lfs_Part_t *lpfs);
+
+/******************************************************************************
+    [docexport Lfs_PartTx_release]
+*//**
+    @brief Aborts the open transaction of a partition (before it is
+    unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartTx_release(struct Lfs_Part_t *lpfs);
+#endif
@@ -0,0 +1,133 @@
+/*******************************************************************************
+ *  @file: Lfs_PartWb.h
+ *
+ *  @brief: Header for Lfs_PartWb, a write-behind buffer for an open littlefs
+ *  file. Small sequential writes are gathered (up to a block) and handed to
+ *  lfs_file_write in one piece.
+ *
+ *  Durability: bytes accepted by Lfs_PartWb_write are only in RAM until the
+ *  buffer is flushed (full, Lfs_PartWb_flush, or Lfs_PartWb_flushOlder), and
+ *  - as with any littlefs write - only survive power loss once the file is
+ *  synced or closed (Lfs_PartWb_sync). A flush error which cannot be
+ *  reported to a caller is kept and returned by the next call.
+*******************************************************************************/
+#ifndef LFS_PARTWB_H
+#define LFS_PARTWB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief Write-behind buffer object.
+*/
+typedef struct Lfs_PartWb
+{
+    lfs_t *lfs;
+    lfs_file_t *file;
+
+    uint8_t *buf;
+    uint32_t size;
+    /** @brief buf was allocated by Lfs_PartWb_init. */
+    bool own_buf;
+    /** @brief Bytes pending. */
+    uint32_t len;
+    /** @brief Time the oldest pending byte was accepted, us. */
+    uint64_t since_us;
+    /** @brief Deferred flush error. */
+    int error;
+
+    /** @brief Counters. */
+    uint32_t writes;
+    uint32_t flushes;
+
+} Lfs_PartWb;
+
+/******************************************************************************
+    [docexport Lfs_PartWb_write]
+*//**
+    @brief Writes at the current file position through the buffer.
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @param[in] data  Data.
+    @param[in] size  Number of bytes.
+    @return Returns size on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_write(Lfs_PartWb *wb, const void *data, uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartWb_flush]
+*//**
+    @brief Hands pending bytes to littlefs. Call before any other operation
+    on the file (read, seek, truncate, positioned write).
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_flush(Lfs_PartWb *wb);
+
+/******************************************************************************
+    [docexport Lfs_PartWb_flushOlder]
+*//**
+    @brief Flushes if pending bytes are older than age_us (timeout flush).
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @param[in] age_us  Age, us.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_flushOlder(Lfs_PartWb *wb, uint64_t age_us);
+
+/******************************************************************************
+    [docexport Lfs_PartWb_sync]
+*//**
+    @brief Flushes and syncs the file: on success all accepted bytes are
+    durable.
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_sync(Lfs_PartWb *wb);
+
+/******************************************************************************
+    [docexport Lfs_PartWb_deinit]
+*//**
+    @brief Flushes and frees the buffer (unless supplied to
+    Lfs_PartWb_initBuf); call before closing the file.
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @return Returns 0 on success, the flush or deferred error otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_deinit(Lfs_PartWb *wb);
+
+/******************************************************************************
+    [docexport Lfs_PartWb_initBuf]
+*//**
+    @brief Initializes a write-behind buffer for an open file on a caller
+    supplied buffer (e.g. one kept per descriptor slot, so opens do not
+    allocate).
+    @param[in] wb  Pointer to uninitialized Lfs_PartWb.
+    @param[in] lfs  Pointer to mounted lfs.
+    @param[in] file  Pointer to file open for writing.
+    @param[in] buf  Buffer, valid until Lfs_PartWb_deinit.
+    @param[in] size  Buffer size.
+******************************************************************************/
+void
+Lfs_PartWb_initBuf(
+    Lfs_PartWb *wb,
+    lfs_t *lfs,
+    lfs_file_t *file,
+    uint8_t *buf,
+    uint32_t size);
+
+/******************************************************************************
+    [docexport Lfs_PartWb_init]
+*//**
+    @brief Initializes a write-behind buffer for an open file.
+    @param[in] wb  Pointer to uninitialized Lfs_PartWb.
+    @param[in] lfs  Pointer to mounted lfs.
+    @param[in] file  Pointer to file open for writing.
+    @param[in] size  Buffer size (e.g. the block size).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartWb_init(Lfs_PartWb *wb, lfs_t *lfs, lfs_file_t *file, uint32_t size);
+#endif
@@ -0,0 +1,167 @@
+/*******************************************************************************
+ *  @file: Lfs_PartXfer.h
+ *
+ *  @brief: Header for Lfs_PartXfer, whole file transfers for the Lfs_Part
+ *  front ends (Lfs_PartRpc FileGet/FilePut).
+ *
+ *  A transfer is a session: the first call opens the file and returns a
+ *  transfer id, later calls pass it back with the next offset, and the
+ *  session closes itself at the end of the file (get) or on the last chunk
+ *  (put). There is no open/close round trip.
+ *
+ *  Pipelining: the flash I/O of a session runs in the transfer task. A get
+ *  reply is served from the chunk read ahead while the previous reply was
+ *  on the wire, then the next chunk is read ahead; a put chunk is handed to
+ *  the task and the reply goes out while it is written (an error is
+ *  reported by the next call).
+ *
+ *  Integrity: every reply carries the CRC32 (zlib/IEEE) of the file from
+ *  offset 0 to the end of the chunk. The get client compares its own CRC
+ *  at the end; the put client sends its CRC with the last chunk, and a
+ *  mismatch removes the file.
+ *
+ *  Resume: a call with an unknown id starts a session at its offset. For
+ *  get, the call passes the CRC of the bytes it already has; for put, the
+ *  file is truncated to the offset and the CRC of the kept bytes is read
+ *  back. A call repeating the previous offset (reply lost) is answered
+ *  again.
+*******************************************************************************/
+#ifndef LFS_PARTXFER_H
+#define LFS_PARTXFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+/** @brief Number of concurrent transfers. */
+#ifndef LFS_PARTXFER_SESSIONS
+#define LFS_PARTXFER_SESSIONS       2
+#endif
+
+/** @brief Largest chunk of a call (size of the session buffers). */
+#ifndef LFS_PARTXFER_CHUNK_SIZE
+#define LFS_PARTXFER_CHUNK_SIZE     3072
+#endif
+
+/** @brief Run session I/O in the transfer task (0: in the caller). */
+#ifndef LFS_PARTXFER_PIPELINE
+#define LFS_PARTXFER_PIPELINE       1
+#endif
+#define LFS_PARTXFER_TASK_STACK     3072
+#define LFS_PARTXFER_TASK_PRIO      2
+
+/** @brief Longest path of a transfer. */
+#define LFS_PARTXFER_PATH_MAX       64
+
+/** @brief Result of a transfer call. */
+typedef struct Lfs_PartXfer_Result
+{
+    /** @brief Transfer id for the next call, 0 once the transfer is over. */
+    uint32_t id;
+    /** @brief get: file offset of the data; put: bytes in the file so far
+        (the offset of the next chunk). */
+    uint32_t offset;
+    /** @brief get: number of bytes of data. */
+    uint32_t len;
+    /** @brief get: file size. */
+    uint32_t file_size;
+    /** @brief get: the data ends the file. */
+    bool eof;
+    /** @brief CRC32 of the file up to offset + len (get) or offset (put). */
+    uint32_t crc;
+
+} Lfs_PartXfer_Result;
+
+struct Lfs_Part_t;
+
+/******************************************************************************
+    [docexport Lfs_PartXfer_crc32]
+*//**
+    @brief Updates a CRC32 (zlib/IEEE, as Python zlib.crc32).
+    @param[in] crc  CRC of the preceding bytes (0 to start).
+    @param[in] data  Data.
+    @param[in] len  Number of bytes.
+    @return Returns the updated CRC.
+******************************************************************************/
+uint32_t
+Lfs_PartXfer_crc32(uint32_t crc, const void *data, uint32_t len);
+
+/******************************************************************************
+    [docexport Lfs_PartXfer_get]
+*//**
+    @brief Reads the next chunk of a file.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[in] id  Transfer id from the previous result, 0 to start.
+    @param[in] offset  Offset of the chunk.
+    @param[in] crc  CRC32 of the bytes before offset (used when a transfer
+    starts or resumes).
+    @param[out] data  Buffer for the chunk.
+    @param[in] max  Size of data (chunks are at most
+    LFS_PARTXFER_CHUNK_SIZE).
+    @param[out] res  Pointer to result to fill.
+    @return Returns 0 on success, negative lfs error code otherwise (the
+    transfer is over).
+******************************************************************************/
+int
+Lfs_PartXfer_get(
+    struct Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t id,
+    uint32_t offset,
+    uint32_t crc,
+    uint8_t *data,
+    uint32_t max,
+    Lfs_PartXfer_Result *res);
+
+/******************************************************************************
+    [docexport Lfs_PartXfer_put]
+*//**
+    @brief Writes the next chunk of a file. A put starting at offset 0
+    creates or truncates the file.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[in] id  Transfer id from the previous result, 0 to start.
+    @param[in] offset  Offset of the chunk.
+    @param[in] data  Chunk.
+    @param[in] len  Chunk size (at most LFS_PARTXFER_CHUNK_SIZE).
+    @param[in] last  The chunk ends the file: the file is committed and
+    checked against crc.
+    @param[in] crc  With last, CRC32 of the whole file.
+    @param[out] res  Pointer to result to fill.
+    @return Returns 0 on success, LFS_ERR_CORRUPT on a CRC mismatch (the file
+    is removed), other negative lfs error code otherwise (the transfer is
+    over; res->offset tells where to resume).
+******************************************************************************/
+int
+Lfs_PartXfer_put(
+    struct Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t id,
+    uint32_t offset,
+    const uint8_t *data,
+    uint32_t len,
+    bool last,
+    uint32_t crc,
+    Lfs_PartXfer_Result *res);
+
+/******************************************************************************
+    [docexport Lfs_PartXfer_release]
+*//**
+    @brief Ends the transfers of a partition (before it is unmounted). Data
+    of an unfinished put is kept, so it can be resumed.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartXfer_release(struct Lfs_Part_t *lpfs);
+
+/******************************************************************************
+    [docexport Lfs_PartXfer_init]
+*//**
+    @brief Initializes the transfers (call before the first transfer) and
+    starts the transfer task (without it, I/O runs in the caller).
+    @return Returns 0 on success, -1 on failure.
+******************************************************************************/
+int
+Lfs_PartXfer_init(void);
+#endif
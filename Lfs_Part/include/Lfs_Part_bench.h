@@ -0,0 +1,36 @@
+/*******************************************************************************
+ *  @file: Lfs_Part_bench.h
+ *
+ *  @brief: Header for the Lfs_Part benchmark suite and geometry autotuner
+ *  (bench/Lfs_Part_bench.c, bench/Lfs_Part_tune.c). Built with
+ *  CONFIG_LFS_PART_BENCH.
+*******************************************************************************/
+#ifndef LFS_PART_BENCH_H
+#define LFS_PART_BENCH_H
+
+#include "Lfs_PartDev.h"
+
+/******************************************************************************
+    [docexport Lfs_Part_bench]
+*//**
+    @brief Runs the benchmark suite. The device is formatted.
+    @param[in] dev  Pointer to initialized Lfs_PartDev (at least 1 MB, not
+    registered/mounted elsewhere).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_Part_bench(Lfs_PartDev *dev);
+
+/******************************************************************************
+    [docexport Lfs_Part_tune]
+*//**
+    @brief Runs the trace across the geometry grid. The device is erased.
+    @param[in] dev  Pointer to initialized Lfs_PartDev (not registered or
+    mounted elsewhere).
+    @param[in] trace  Recorded trace.
+    @param[in] len  Trace length.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_Part_tune(Lfs_PartDev *dev, const char *trace, uint32_t len);
+#endif
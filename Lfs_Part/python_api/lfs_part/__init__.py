@@ -1,5 +1,7 @@
 import logging
 import itertools
+import zlib
+import hashlib
 from dataclasses import dataclass
 
 from rich import inspect
@@ -7,12 +9,26 @@ from rich.table import Table
 from rich.text import Text
 from rich.pretty import Pretty
 
-from protorpc.util import CallsetBase
+from protorpc.util import CallsetBase, ProtoRpcException
 
 logger = logging.getLogger(__name__)
 logger.addHandler(logging.NullHandler())
 
 DATA_CHUNK_SIZE = 1000
+XFER_CHUNK_SIZE = 3072  # FileGet/FilePut data size (Lfs_PartRpc.proto)
+XFER_RETRIES = 3
+
+# Delta sync (Lfs_PartDelta.h LFS_PARTDELTA_*).
+DELTA_BLOCK_SIZE = 512
+DELTA_STRONG_LEN = 8
+
+# Latency histogram buckets (Lfs_PartDev.h LFS_PARTDEV_LAT_*).
+STATS_LAT_BUCKETS = 8
+STATS_LAT_BASE_US = 16
+STATS_WEAR_ROW = 16
+
+# Digests per GetDigests call (Lfs_PartRpc.proto).
+DIGESTS_MAX = 16
 
 LFS_SEEK_SET = 0
 LFS_SEEK_CUR = 1
@@ -49,6 +65,82 @@ def lfs_error_str(err: int) -> str:
     return lfs_error.get(err, "Unknown")
 
 
+def delta_weak(data) -> int:
+    """rsync rolling checksum of a block (Lfs_PartDelta_weak)."""
+    a = sum(data) & 0xffff
+    b = sum((len(data) - i) * x for i, x in enumerate(data)) & 0xffff
+    return a | (b << 16)
+
+
+def delta_strong(data) -> bytes:
+    return hashlib.md5(data).digest()[:DELTA_STRONG_LEN]
+
+
+def delta_ops(data, sigs, block_size, file_size):
+    """Finds the blocks of the device file in data (rsync scan).
+    Params:
+    data: New file.
+    sigs: (weak, strong) per block of the device file.
+    block_size: Block size of sigs.
+    file_size: Size of the device file (its last block may be short).
+    Returns the list of ('copy', first_block, count) and ('data', bytes),
+    in file order.
+    """
+    n = len(data)
+    full = {}
+    for blk, (weak, strong) in enumerate(sigs):
+        if (blk + 1) * block_size <= file_size:
+            full.setdefault(weak, []).append((blk, strong))
+    ops = []
+
+    def add_copy(blk):
+        if ops and ops[-1][0] == 'copy' and ops[-1][1] + ops[-1][2] == blk:
+            ops[-1] = ('copy', ops[-1][1], ops[-1][2] + 1)
+        else:
+            ops.append(('copy', blk, 1))
+
+    lit = 0
+    pos = 0
+    weak = None
+    while pos + block_size <= n:
+        if weak is None:
+            weak = delta_weak(data[pos:pos + block_size])
+        match = None
+        for blk, strong in full.get(weak, ()):
+            if strong == delta_strong(data[pos:pos + block_size]):
+                match = blk
+                break
+        if match is not None:
+            if lit < pos:
+                ops.append(('data', data[lit:pos]))
+            add_copy(match)
+            pos += block_size
+            lit = pos
+            weak = None
+            continue
+        if pos + block_size == n:
+            break
+        # Roll the window one byte.
+        old, new = data[pos], data[pos + block_size]
+        a = ((weak & 0xffff) - old + new) & 0xffff
+        b = ((weak >> 16) - block_size * old + a) & 0xffff
+        weak = a | (b << 16)
+        pos += 1
+
+    # A short last block of the device file can only end the new file.
+    tail = file_size % block_size
+    if tail and len(sigs) * block_size >= file_size and n - tail >= lit:
+        seg = data[n - tail:]
+        if (delta_weak(seg), delta_strong(seg)) == tuple(sigs[-1]):
+            if lit < n - tail:
+                ops.append(('data', data[lit:n - tail]))
+            add_copy(len(sigs) - 1)
+            lit = n
+    if lit < n:
+        ops.append(('data', data[lit:]))
+    return ops
+
+
 def chunked(iterable, size):
     it = iter(iterable)
     while True:
@@ -80,6 +172,16 @@ class LfsPart(CallsetBase):
 
     def __init__(self, api):
         super().__init__(api)
+        # Partition handles by label (GetFsInfo), sent with the label so the
+        # device skips the label lookup.
+        self.handles = {}
+
+    def part(self, label):
+        """Gets the partition arguments of a call: label and handle.
+        """
+        if label not in self.handles:
+            self.get_fsinfo(label)
+        return dict(part_label=label, part_handle=self.handles[label])
 
     def get_fsinfo_table(self, label='littlefs'):
         """Prints a table for file system information.
@@ -104,16 +206,19 @@ class LfsPart(CallsetBase):
         label : the patition label.
         """
         idx = 0
+        cursor = 0
         entries = []
         while True:
             # Due to limited size of the array of entries in the RPC, it might
-            # take multiple calls to get all the entries.
-            results = self.dirlist(path, start_idx=idx, label=label)
+            # take multiple calls to get all the entries. The cursor lets the
+            # device resume the listing instead of re-reading the directory.
+            results = self.dirlist(path, start_idx=idx, cursor=cursor,
+                                   label=label)
             new = [FileItem(r.type, r.size, r.name) for r in results.info_array]
             entries += new
-            if len(entries) < results.num_entries:
-                # Adjust start_idx to fetch the next group of entries.
-                idx += len(entries)
+            idx += len(new)
+            cursor = results.cursor
+            if new and (cursor or idx < results.num_entries):
                 continue
             # Got them all
             break
@@ -131,6 +236,21 @@ class LfsPart(CallsetBase):
             table.add_row(*row)
         return table
 
+    def digests_table(self, dir='/', label='littlefs'):
+        """Prints a table of the file digests of a directory tree.
+        label : the patition label.
+        """
+        table = Table(title=f"{dir}", box=None)
+        table.add_column('Size')
+        table.add_column('CRC32', style='yellow')
+        table.add_column('SHA-256')
+        table.add_column('Name')
+
+        digests = self.get_digests(dir=dir, label=label)
+        for path, (size, crc, sha256) in digests.items():
+            table.add_row(Pretty(size), f"{crc:08x}", sha256, path)
+        return table
+
     def get_fsinfo(self, label='littlefs'):
         """Gets FS information.
         Params:
@@ -138,14 +258,89 @@ class LfsPart(CallsetBase):
         """
         reply = self.api.getfsinfo(part_label=label)
         self.check_reply(reply)
+        self.handles[label] = reply.result.part_handle
         return reply.result
 
-    def dirlist(self, path, start_idx=0, label='littlefs'):
+    def get_stats(self, clear=False, label='littlefs'):
+        """Gets the flash I/O stats of a partition.
+        Params:
+        clear: Clear the counters after reading them (erase counts are kept).
+        label : Partition label.
+        Returns the reply, with the whole wear map (erase count per block)
+        in wear.
+        """
+        reply = self.api.getstats(**self.part(label), clear=clear,
+                                  wear_start=0)
+        self.check_reply(reply)
+        result = reply.result
+        while result.wear and len(result.wear) < result.block_count:
+            more = self.api.getstats(**self.part(label),
+                                     wear_start=len(result.wear))
+            self.check_reply(more)
+            if not more.result.wear:
+                break
+            result.wear.extend(more.result.wear)
+        return result
+
+    def stats_table(self, clear=False, label='littlefs'):
+        """Prints tables of flash I/O stats and the wear map.
+        clear: Clear the counters after reading them.
+        label : the patition label.
+        """
+        st = self.get_stats(clear, label)
+
+        table = Table(title=f"{label} flash I/O", box=None)
+        table.add_column('Op', style='yellow')
+        table.add_column('Count')
+        table.add_column('Bytes')
+        table.add_column('Avg us')
+        table.add_column('Max us')
+        for i in range(STATS_LAT_BUCKETS):
+            lim = STATS_LAT_BASE_US << 2*i
+            table.add_column(f"<{lim}" if i < STATS_LAT_BUCKETS - 1
+                             else f">={lim >> 2}")
+        for name, op in (('read', st.read), ('prog', st.prog),
+                         ('erase', st.erase)):
+            avg = op.total_us//op.count if op.count else 0
+            row = [name, f"{op.count}", f"{op.bytes}", f"{avg}",
+                   f"{op.max_us}"]
+            row += [f"{h}" for h in op.hist]
+            table.add_row(*row)
+
+        lookups = st.cache_hits + st.cache_misses
+        summary = Table(title='', box=None)
+        summary.add_column('', style='yellow')
+        summary.add_column('')
+        summary.add_row('cache hits', f": {st.cache_hits}/{lookups}")
+        summary.add_row('max erase count', f": {st.max_erase_count}")
+        summary.add_row('mount time', f": {st.mount_us} us")
+        if st.HasField('rpc_limit'):
+            lim = st.rpc_limit
+            summary.add_row('rpc admitted', f": {lim.admitted}")
+            summary.add_row('rpc busy (client/callset/in flight)',
+                            f": {lim.rejected_client}/{lim.rejected_callset}/"
+                            f"{lim.rejected_inflight}")
+            summary.add_row('rpc in flight (max)',
+                            f": {lim.in_flight} ({lim.max_in_flight})")
+
+        wear = Table(title='wear (erase count per block)', box=None)
+        wear.add_column('Block', style='yellow')
+        wear.add_column('Erase counts')
+        for i in range(0, len(st.wear), STATS_WEAR_ROW):
+            wear.add_row(f"{i}", " ".join(f"{c:4}" for c in
+                                          st.wear[i:i + STATS_WEAR_ROW]))
+        return (table, summary, wear)
+
+    def dirlist(self, path, start_idx=0, cursor=0, label='littlefs'):
         """Lists contents of a directory.
+        Params:
+        start_idx: Index of the first entry.
+        cursor: Cursor of the previous reply of this listing, 0 to start one.
         """
-        reply = self.api.dirlist(part_label=label,
+        reply = self.api.dirlist(**self.part(label),
                                  path=path,
-                                 start_idx=start_idx)
+                                 start_idx=start_idx,
+                                 cursor=cursor)
         self.check_reply(reply)
         return reply.result
 
@@ -156,7 +351,7 @@ class LfsPart(CallsetBase):
         label : Partition label.
         Return (fd, file size)
         """
-        reply = self.api.fileopen(path=path, flags=flags, part_label=label)
+        reply = self.api.fileopen(path=path, flags=flags, **self.part(label))
         self.check_reply(reply)
 
         status = reply.result.status
@@ -173,6 +368,21 @@ class LfsPart(CallsetBase):
         reply = self.api.fileclose(fd)
         self.check_reply(reply)
 
+    def file_sync(self, fd) -> int:
+        """File sync.
+        Writes are buffered on the device; once this returns 0 every byte
+        accepted by file_write() on fd is on flash (file_close() implies it).
+        Params:
+        fd: File desciptor returned from file_open().
+        """
+        reply = self.api.filesync(fd=fd)
+        self.check_reply(reply)
+        status = reply.result.status
+        if status < 0:
+            logger.error(f"File sync: {status} ({lfs_error_str(status)})")
+
+        return status
+
     def file_read(
         self,
         fd,
@@ -237,14 +447,15 @@ class LfsPart(CallsetBase):
         logger.debug(f"file write: {status} bytes")
         return status
 
-    def remove(self, path, label='littlefs') -> int:
+    def remove(self, path, label='littlefs', tx_id=0) -> int:
         """Remove dir or file.
         Params:
         path: Path
         label : Partition label.
+        tx_id: Transaction (tx_begin), the file is removed on tx_commit.
         Return (fd, file size)
         """
-        reply = self.api.remove(path=path, part_label=label)
+        reply = self.api.remove(path=path, **self.part(label), tx_id=tx_id)
         self.check_reply(reply)
 
         status = reply.result.status
@@ -255,75 +466,279 @@ class LfsPart(CallsetBase):
 
     def get_file(self, path, label='littlefs'):
         """File read.
+        The device streams the file in XFER_CHUNK_SIZE chunks, reading the
+        next chunk ahead while a reply is in flight. Each reply carries the
+        CRC32 of the file so far, checked against the received data; a lost
+        call is retried and resumes where the data ends.
         Params:
         path: Path to file.
         label : Partition label.
         Returns a bytearray.
         """
-        fd = self.file_open(path, LFS_O_RDONLY, label)
-
-        if fd < 0:
-            logger.error(f"Error opening remote path {path}")
-            return bytearray()
-
-        logger.debug(f"Opened file {path}. fd={fd}")
         filedata = bytearray()
+        xfer_id = 0
+        crc = 0
+        retries = 0
         while True:
-            status, data = self.file_read(fd, DATA_CHUNK_SIZE)
-            if status < 0:
-                self.file_close(fd)
+            try:
+                reply = self.api.fileget(**self.part(label), path=path,
+                                         xfer_id=xfer_id,
+                                         offset=len(filedata), crc=crc)
+                self.check_reply(reply)
+            except ProtoRpcException:
+                retries += 1
+                if retries > XFER_RETRIES:
+                    raise
+                logger.warning(f"get_file: retrying at {len(filedata)}")
+                continue
+
+            result = reply.result
+            if result.status < 0:
+                logger.error(f"get_file: {result.status} "
+                             f"({lfs_error_str(result.status)})")
                 raise LfsPartException("Error during file read")
 
-            if status > 0:
-                logger.debug(f"Read ({status}) data={data}")
-                filedata += data
-            else:
+            retries = 0
+            if result.offset != len(filedata):
+                raise LfsPartException(f"Bad offset {result.offset}")
+
+            crc = zlib.crc32(result.data, crc)
+            if crc != result.crc:
+                raise LfsPartException(f"CRC mismatch at {result.offset}")
+
+            filedata += result.data
+            xfer_id = result.xfer_id
+            logger.debug(f"get_file: {len(filedata)}/{result.file_size}")
+            if result.eof:
                 break
 
-        self.file_close(fd)
         return filedata
 
-    def put_file(self, data, path, label='littlefs'):
+    def put_file(self, data, path, label='littlefs', tx_id=0):
         """File write.
+        The file is sent in XFER_CHUNK_SIZE chunks; the device writes a chunk
+        while the next one is on the wire. The last chunk carries the CRC32
+        of the whole file, which the device checks before the file is kept.
+        A lost call is retried and resumes at the offset the device reports.
         Params:
         data: bytearray to write.
         path: Path to remote file.
         label : Partition label.
+        tx_id: Transaction (tx_begin), the file replaces path on tx_commit.
         """
-        flags = LFS_O_CREAT   # create a new file if it doesn't exist
-        flags |= LFS_O_RDWR    # Open for reading and writing.
-        flags |= LFS_O_TRUNC   # Truncate to 0 bytes to allow overwrite
-        #fd = self.file_open(path, LFS_O_CREAT|LFS_O_RDWR, label)
-        fd = self.file_open(path, flags, label)
-        logger.debug(f"put_file: Opened file {path}. fd={fd} size={len(data)}")
-
-        if fd < 0:
-            raise LfsPartException("Error during file open")
-
-        chunks = len(data)//DATA_CHUNK_SIZE
-        leftover = len(data) % DATA_CHUNK_SIZE
-
-        logger.debug(f"put_file: Writing {chunks} chunks and {leftover} bytes leftover")
-
-        for i, chunk in enumerate(chunked(data, size=DATA_CHUNK_SIZE)):
-            logger.debug(f"put_file: Writing chunk {i} at offset={i*DATA_CHUNK_SIZE}")
-            logger.debug(f"({len(chunk)}) chunk={chunk}")
-            #status = self.file_write(fd, chunk, i*DATA_CHUNK_SIZE)
-            status = self.file_write(fd, chunk)
-            if status is None:
-                logger.error(f"put_file: Error writing file chunk {i}: {path}")
-                self.file_close(fd)
+        xfer_id = 0
+        offset = 0
+        crc = zlib.crc32(data)
+        retries = 0
+        logger.debug(f"put_file: {path} size={len(data)} crc=0x{crc:08x}")
+        while True:
+            chunk = data[offset:offset + XFER_CHUNK_SIZE]
+            last = offset + len(chunk) >= len(data)
+            try:
+                reply = self.api.fileput(**self.part(label), path=path,
+                                         xfer_id=xfer_id, offset=offset,
+                                         last=last, crc=crc if last else 0,
+                                         data=bytes(chunk), tx_id=tx_id)
+                self.check_reply(reply)
+            except ProtoRpcException:
+                retries += 1
+                if retries > XFER_RETRIES:
+                    raise
+                logger.warning(f"put_file: retrying at {offset}")
+                continue
+
+            result = reply.result
+            if result.status < 0:
+                logger.error(f"put_file: {result.status} "
+                             f"({lfs_error_str(result.status)})")
                 raise LfsPartException("Error during file write")
 
-        if leftover > 0:
-            left = data[-leftover:]
-            logger.debug(f"put_file: Writing leftover ({len(left)})")
-            logger.debug(f"leftover={left}")
-            #status = self.file_write(fd, left, chunks*DATA_CHUNK_SIZE)
-            status = self.file_write(fd, left)
-            if status is None:
-                logger.error(f"put_file: Error writing leftover chunk: {path}")
-                self.file_close(fd)
-                raise LfsPartException("Error during file read")
+            retries = 0
+            xfer_id = result.xfer_id
+            offset = result.offset
+            if last and offset == len(data):
+                break
+
+    def tx_begin(self, label='littlefs') -> int:
+        """Opens a transaction: put_file and remove calls with its id take
+        effect together on tx_commit (an unfinished transaction of the
+        partition is aborted).
+        Params:
+        label : Partition label.
+        Returns the transaction id.
+        """
+        reply = self.api.txbegin(**self.part(label))
+        self.check_reply(reply)
+        status = reply.result.status
+        if status < 0:
+            logger.error(f"tx_begin: {status} ({lfs_error_str(status)})")
+            raise LfsPartException("Error opening transaction")
+        return reply.result.tx_id
+
+    def tx_commit(self, tx_id, abort=False) -> int:
+        """Commits (or aborts) a transaction: all its files are written and
+        removed, or none are.
+        Params:
+        tx_id: Transaction id.
+        abort: Drop the transaction instead.
+        Returns the number of files committed.
+        """
+        reply = self.api.txcommit(tx_id=tx_id, abort=abort)
+        self.check_reply(reply)
+        status = reply.result.status
+        if status < 0:
+            logger.error(f"tx_commit: {status} ({lfs_error_str(status)})")
+            raise LfsPartException("Error committing transaction")
+        return reply.result.files
 
-        self.file_close(fd)
+    def put_files(self, files, removes=(), label='littlefs',
+                  changed_only=False) -> int:
+        """Writes and removes several files as one update (all or nothing).
+        Params:
+        files: dict of remote path to bytearray.
+        removes: Remote paths to remove.
+        label : Partition label.
+        changed_only: Skip the files the device already has (same SHA-256).
+        Returns the number of files committed.
+        """
+        if changed_only:
+            digests = self.get_digests(paths=files, label=label)
+            files = {path: data for path, data in files.items()
+                     if path not in digests or
+                     digests[path][2] != hashlib.sha256(data).hexdigest()}
+            if not files and not removes:
+                return 0
+        tx_id = self.tx_begin(label)
+        try:
+            for path, data in files.items():
+                self.put_file(data, path, label=label, tx_id=tx_id)
+            for path in removes:
+                if self.remove(path, label=label, tx_id=tx_id) < 0:
+                    raise LfsPartException(f"Cannot remove {path}")
+        except Exception:
+            self.tx_commit(tx_id, abort=True)
+            raise
+        return self.tx_commit(tx_id)
+
+    def get_digests(self, paths=(), dir='/', label='littlefs'):
+        """File digests, computed on the device and cached there until the
+        file changes.
+        Params:
+        paths: Remote files, else all files of the dir tree.
+        dir: Remote directory.
+        label : Partition label.
+        Returns a dict of path to (size, crc32, sha256 hex); missing files
+        are left out.
+        """
+        digests = {}
+        paths = list(paths)
+        cursor = 0
+        while True:
+            # DIGESTS_MAX paths per call, or a page of the tree.
+            chunk, paths = paths[:DIGESTS_MAX], paths[DIGESTS_MAX:]
+            reply = self.api.getdigests(**self.part(label), paths=chunk,
+                                        dir=dir, cursor=cursor)
+            self.check_reply(reply)
+            result = reply.result
+            if result.status < 0:
+                logger.error(f"get_digests: {result.status} "
+                             f"({lfs_error_str(result.status)})")
+                raise LfsPartException("Error getting digests")
+            for d in result.digests:
+                if d.status < 0:
+                    logger.debug(f"get_digests: {d.path}: {d.status}")
+                    continue
+                digests[d.path] = (d.size, d.crc, bytes(d.sha256).hex())
+            if chunk:
+                if not paths:
+                    break
+            elif result.cursor:
+                cursor = result.cursor
+            else:
+                break
+        return digests
+
+    def get_signatures(self, path, block_size=DELTA_BLOCK_SIZE,
+                       label='littlefs'):
+        """Block signatures of a remote file.
+        Params:
+        path: Path to remote file.
+        block_size: Signature block size.
+        label : Partition label.
+        Returns (status, file_size, [(weak, strong), ...]).
+        """
+        sigs = []
+        while True:
+            reply = self.api.filesig(**self.part(label), path=path,
+                                     block_size=block_size,
+                                     start_block=len(sigs))
+            self.check_reply(reply)
+            result = reply.result
+            if result.status < 0:
+                return result.status, 0, []
+            sigs.extend((s.weak, bytes(s.strong)) for s in result.sigs)
+            if not result.sigs or len(sigs) * block_size >= result.file_size:
+                return 0, result.file_size, sigs
+
+    def sync_file(self, data, path, block_size=DELTA_BLOCK_SIZE,
+                  label='littlefs'):
+        """Delta file write.
+        Only the parts of data not already in the remote file are sent: the
+        remote block signatures are matched in data and the device rebuilds
+        the file from copies of its blocks and the literal data. The last
+        call carries the CRC32 of the whole file, which the device checks
+        before the file replaces the old one. A missing remote file is
+        written with put_file.
+        Params:
+        data: bytearray to write.
+        path: Path to remote file.
+        block_size: Signature block size.
+        label : Partition label.
+        Returns the number of literal bytes sent.
+        """
+        status, file_size, sigs = self.get_signatures(path, block_size,
+                                                      label=label)
+        if status == -2:
+            self.put_file(data, path, label=label)
+            return len(data)
+        if status < 0:
+            logger.error(f"sync_file: {status} ({lfs_error_str(status)})")
+            raise LfsPartException("Error getting file signatures")
+
+        # Each call copies a run of blocks, then appends up to
+        # XFER_CHUNK_SIZE bytes.
+        calls = []
+        for op in delta_ops(data, sigs, block_size, file_size):
+            if op[0] == 'copy':
+                calls.append([op[1], op[2], b''])
+                continue
+            lit = op[1]
+            if calls and not calls[-1][2]:
+                calls[-1][2] = lit[:XFER_CHUNK_SIZE]
+                lit = lit[XFER_CHUNK_SIZE:]
+            calls.extend([0, 0, lit[i:i + XFER_CHUNK_SIZE]]
+                         for i in range(0, len(lit), XFER_CHUNK_SIZE))
+        if not calls:
+            calls.append([0, 0, b''])
+
+        crc = zlib.crc32(data)
+        sent = sum(len(c[2]) for c in calls)
+        logger.debug(f"sync_file: {path} size={len(data)} sent={sent} "
+                     f"calls={len(calls)} crc=0x{crc:08x}")
+        xfer_id = 0
+        for i, (copy_block, copy_count, chunk) in enumerate(calls):
+            last = i == len(calls) - 1
+            reply = self.api.filepatch(**self.part(label), path=path,
+                                       xfer_id=xfer_id, block_size=block_size,
+                                       copy_block=copy_block,
+                                       copy_count=copy_count,
+                                       data=bytes(chunk), last=last,
+                                       crc=crc if last else 0)
+            self.check_reply(reply)
+            result = reply.result
+            if result.status < 0:
+                logger.error(f"sync_file: {result.status} "
+                             f"({lfs_error_str(result.status)})")
+                raise LfsPartException("Error during file sync")
+            xfer_id = result.xfer_id
+        return sent
@@ -76,6 +76,29 @@ def fsinfo(ctx, **kwargs):
         sys.exit()
 
 
+@cli.command
+@click.option("-p", "--part",
+              type=str,
+              default="littlefs",
+              show_default=True,
+              help="Partition label")
+@click.option("--clear", is_flag=True, help="Clear the counters after reading.")
+@click.pass_context
+def stats(ctx, **kwargs):
+    """Prints flash I/O stats (ops, bytes, latency) and the wear map.
+    """
+    params = get_params(**kwargs)
+    cli_params = ctx.obj['cli_params']
+
+    lfs = ctx.obj['lfs']
+    try:
+        con = Console()
+        for tbl in lfs.stats_table(clear=params.clear, label=params.part):
+            con.print(tbl)
+    except ProtoRpcException:
+        sys.exit()
+
+
 @cli.command
 @click.argument('path')
 @click.option("-p", "--part",
@@ -158,6 +181,29 @@ def cat(ctx, **kwargs):
     console.print(f"{data.decode('utf-8')}")
 
 
+@cli.command
+@click.argument('path')
+@click.option("-p", "--part",
+              type=str,
+              default="littlefs",
+              show_default=True,
+              help="Partition label")
+@click.pass_context
+def digests(ctx, **kwargs):
+    """Prints the digests (CRC32, SHA-256) of the files of a directory tree.
+    """
+    params = get_params(**kwargs)
+    cli_params = ctx.obj['cli_params']
+
+    lfs = ctx.obj['lfs']
+    try:
+        tbl = lfs.digests_table(dir=params.path, label=params.part)
+        con = Console()
+        con.print(tbl)
+    except ProtoRpcException:
+        sys.exit()
+
+
 @cli.command
 @click.argument('remotepath')
 @click.option("-p", "--part",
@@ -211,6 +257,75 @@ def put(ctx, **kwargs):
     con.print(f"Wrote: {params.local} --> remote: {params.remote}")
 
 
+@cli.command
+@click.argument('local')
+@click.argument('remote')
+@click.option("-p", "--part",
+              type=str,
+              default="littlefs",
+              show_default=True,
+              help="Partition label")
+@click.option("-a", "--all", is_flag=True,
+              help="Send all files, also those the device already has.")
+@click.pass_context
+def bundle(ctx, **kwargs):
+    """Puts the files of a local directory to a remote directory as one
+    update: the device keeps all of them or none. Files the device already
+    has are not sent.
+    """
+    params = get_params(**kwargs)
+    cli_params = ctx.obj['cli_params']
+
+    lfs = ctx.obj['lfs']
+    local = Path(params.local)
+    files = {f"{params.remote.rstrip('/')}/{f.relative_to(local).as_posix()}":
+             f.read_bytes() for f in sorted(local.rglob('*')) if f.is_file()}
+    try:
+        count = lfs.put_files(files, label=params.part,
+                              changed_only=not params.all)
+    except Exception as e:
+        logger.exception(f"Error: {str(e)}")
+        sys.exit()
+
+    con = Console()
+    con.print(f"Committed {count} files: {params.local} --> remote: "
+              f"{params.remote}")
+
+
+@cli.command
+@click.argument('local')
+@click.argument('remote')
+@click.option("-p", "--part",
+              type=str,
+              default="littlefs",
+              show_default=True,
+              help="Partition label")
+@click.option("-b", "--block-size",
+              type=int,
+              default=512,
+              show_default=True,
+              help="Delta block size (64 to 4096).")
+@click.pass_context
+def sync(ctx, **kwargs):
+    """Updates a remote file, sending only what changed.
+    """
+    params = get_params(**kwargs)
+    cli_params = ctx.obj['cli_params']
+
+    lfs = ctx.obj['lfs']
+    try:
+        data = Path(params.local).read_bytes()
+        sent = lfs.sync_file(data, path=params.remote,
+                             block_size=params.block_size, label=params.part)
+    except Exception as e:
+        logger.exception(f"Error: {str(e)}")
+        sys.exit()
+
+    con = Console()
+    con.print(f"Synced: {params.local} --> remote: {params.remote} "
+              f"({sent} of {len(data)} bytes sent)")
+
+
 @cli.command
 @click.argument('path')
 @click.option("-p", "--part",
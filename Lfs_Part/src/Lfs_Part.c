@@ -4,17 +4,79 @@
  *  @brief: A littlefs wrapper using the esp_parition api.
 *******************************************************************************/
 #include <string.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include "Lfs_Part.h"
+#include "Lfs_PartDir.h"
+#include "Lfs_PartXfer.h"
+#include "Lfs_PartDelta.h"
+#include "Lfs_PartKv.h"
+#include "Lfs_PartRing.h"
+#include "Lfs_PartTx.h"
+#include "SwTimer.h"
 #include "CheckCond.h"
 #include "LogPrint.h"
 #include "LogPrint_local.h"
 
 static const char *TAG = "Lfs_Part";
 
-/** @brief List of registered partitions. */
-static CList registry;
-static bool registry_initialized = false;
+#if LFS_PART_REGISTRY_MAX > 255
+#error "LFS_PART_REGISTRY_MAX must fit the uint8_t handles of the index."
+#endif
+
+/** @brief Registered partitions, by handle (handle - 1). */
+static Lfs_Part_t *registry[LFS_PART_REGISTRY_MAX];
+static uint32_t num_registered = 0;
+
+/** @brief Label index: open addressing hash table (at most half used) of
+    handles (0: empty slot) and label hashes. */
+#define REGISTRY_INDEX_SIZE     (2*LFS_PART_REGISTRY_MAX)
+static uint8_t index_handle[REGISTRY_INDEX_SIZE];
+static uint32_t index_hash[REGISTRY_INDEX_SIZE];
+
+/******************************************************************************
+    dev_prog
+*//**
+    @brief Programs the device and keeps the read cache coherent.
+******************************************************************************/
+static int
+dev_prog(Lfs_Part_t *lpfs, uint32_t addr, const void *buffer, uint32_t size)
+{
+    int err;
+
+    err = Lfs_PartDev_writeBytes(lpfs->dev, addr, buffer, size);
+    if (err)
+    {
+        LOGPRINT_ERROR("Failed to write addr %08x, size %08x, err %d",
+            (unsigned int)addr,
+            (unsigned int)size,
+            err);
+        return LFS_ERR_IO;
+    }
+    if (lpfs->bcache.num_lines)
+    {
+        Lfs_PartCache_update(&lpfs->bcache, addr, buffer, size);
+    }
+    return 0;
+}
+
+/******************************************************************************
+    prog_flush
+*//**
+    @brief Issues the pending coalesced program, if any.
+******************************************************************************/
+static int
+prog_flush(Lfs_Part_t *lpfs)
+{
+    uint32_t len = lpfs->prog_len;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+    lpfs->prog_len = 0;
+    return dev_prog(lpfs, lpfs->prog_addr, lpfs->prog_buf, len);
+}
 
 /******************************************************************************
     part_read
@@ -37,13 +99,41 @@ part_read(
 {
     Lfs_Part_t *lpfs = (Lfs_Part_t *)c->context;
     size_t part_off = (block * c->block_size) + off;
-    esp_err_t err;
+    uint32_t prog_end = lpfs->prog_addr + lpfs->prog_len;
+    int err;
 
     LOGPRINT_VERBOSE("read block %u, 0x%08x %u bytes",
         (unsigned int)block,
         (unsigned int)part_off,
         (unsigned int)size);
-    err = esp_partition_read(lpfs->partition, part_off, buffer, size);
+
+    /* Reads of pending programs (e.g. littlefs validating what it just
+        programmed) are served from the buffer; partial overlaps flush. */
+    if (lpfs->prog_len && part_off < prog_end &&
+        part_off + size > lpfs->prog_addr)
+    {
+        if (part_off >= lpfs->prog_addr && part_off + size <= prog_end)
+        {
+            memcpy(buffer, lpfs->prog_buf + (part_off - lpfs->prog_addr),
+                size);
+            return 0;
+        }
+        err = prog_flush(lpfs);
+        if (err)
+        {
+            return err;
+        }
+    }
+
+    if (lpfs->bcache.num_lines)
+    {
+        err = Lfs_PartCache_read(&lpfs->bcache, lpfs->dev, part_off, buffer,
+            size);
+    }
+    else
+    {
+        err = Lfs_PartDev_readBytes(lpfs->dev, part_off, buffer, size);
+    }
     if (err)
     {
         LOGPRINT_ERROR("Failed to read addr %08x, size %08x, err %d",
@@ -76,20 +166,46 @@ part_write(
 {
     Lfs_Part_t *lpfs = c->context;
     size_t part_off = (block * c->block_size) + off;
-    esp_err_t err;
+    int err;
 
     LOGPRINT_VERBOSE("write block %u, 0x%08x %u bytes",
         (unsigned int)block,
         (unsigned int)part_off,
         (unsigned int)size);
-    err = esp_partition_write(lpfs->partition, part_off, buffer, size);
-    if (err)
+
+    lpfs->write_gen++;
+    Lfs_PartGc_onProg(&lpfs->gc, block);
+    if (lpfs->coalesce && !lpfs->prog_buf)
     {
-        LOGPRINT_ERROR("Failed to write addr %08x, size %08x, err %d",
-            (unsigned int) part_off,
-            (unsigned int) size,
-            err);
-        return LFS_ERR_IO;
+        lpfs->prog_buf = (uint8_t *)malloc(c->block_size);
+    }
+    if (!lpfs->coalesce || !lpfs->prog_buf)
+    {
+        return dev_prog(lpfs, part_off, buffer, size);
+    }
+
+    /* Only a program continuing the pending one in the same block joins it. */
+    if (lpfs->prog_len &&
+        ((part_off != lpfs->prog_addr + lpfs->prog_len) ||
+         (part_off/c->block_size != lpfs->prog_addr/c->block_size)))
+    {
+        err = prog_flush(lpfs);
+        if (err)
+        {
+            return err;
+        }
+    }
+
+    if (lpfs->prog_len == 0)
+    {
+        lpfs->prog_addr = part_off;
+    }
+    memcpy(lpfs->prog_buf + lpfs->prog_len, buffer, size);
+    lpfs->prog_len += size;
+
+    if ((lpfs->prog_addr + lpfs->prog_len) % c->block_size == 0)
+    {
+        return prog_flush(lpfs);
     }
     return 0;
 }
@@ -107,12 +223,29 @@ part_erase(const struct lfs_config *c, lfs_block_t block)
 {
     Lfs_Part_t *lpfs = c->context;
     size_t part_off = block * c->block_size;
-    esp_err_t err;
+    int err;
 
     LOGPRINT_VERBOSE("erase block %u, 0x%08x",
         (unsigned int)block,
         (unsigned int)part_off);
-    err = esp_partition_erase_range(lpfs->partition, part_off, c->block_size);
+
+    lpfs->write_gen++;
+
+    /* Programs pending on this block would be erased anyway. */
+    if (lpfs->prog_len && lpfs->prog_addr/c->block_size == block)
+    {
+        lpfs->prog_len = 0;
+    }
+    /* Blocks pre-erased by the maintenance task are still erased. */
+    if (Lfs_PartGc_onErase(&lpfs->gc, block))
+    {
+        return 0;
+    }
+    if (lpfs->bcache.num_lines)
+    {
+        Lfs_PartCache_invalidate(&lpfs->bcache, part_off, c->block_size);
+    }
+    err = Lfs_PartDev_eraseBlock(lpfs->dev, block);
     if (err)
     {
         LOGPRINT_ERROR("Failed to erase addr %08x, size %08x, err %d",
@@ -134,8 +267,8 @@ part_erase(const struct lfs_config *c, lfs_block_t block)
 static int
 part_sync(const struct lfs_config *c)
 {
-    /* Unnecessary for esp-idf */
-    return 0;
+    /* Only coalesced programs are held back; esp-idf itself needs no sync. */
+    return prog_flush((Lfs_Part_t *)c->context);
 }
 
 static int
@@ -143,7 +276,8 @@ lock(const struct lfs_config *c)
 {
     Lfs_Part_t *lpfs = c->context;
     LOGPRINT_VERBOSE("getting lock.");
-    RTOS_MUTEX_GET(lpfs->lock);
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    Lfs_PartGc_onLock(&lpfs->gc);
     return 0;
 }
 
@@ -152,80 +286,64 @@ unlock(const struct lfs_config *c)
 {
     Lfs_Part_t *lpfs = c->context;
     LOGPRINT_VERBOSE("releasing lock");
-    RTOS_MUTEX_PUT(lpfs->lock);
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
     return 0;
 }
 
 /******************************************************************************
-    [docimport Lfs_Part_register]
+    config_valid
 *//**
-    @brief Registers a littlefs partition.
-    Call this after Lfs_Part_init().
-    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
+    @brief Checks a geometry against the littlefs constraints.
 ******************************************************************************/
-void
-Lfs_Part_register(Lfs_Part_t *lpfs)
+static bool
+config_valid(const Lfs_Part_Config *config)
 {
-    if (!registry_initialized) {
-        CList_init(&registry);
-        registry_initialized = true;
+    if (!config->read_size || !config->prog_size || !config->cache_size ||
+        !config->lookahead_size || !config->block_cycles)
+    {
+        return false;
     }
-
-    CList_append(&registry, lpfs);
-    LOGPRINT_INFO("Registered littlefs partition: %s", lpfs->partition->label);
+    return (config->cache_size % config->read_size == 0) &&
+        (config->cache_size % config->prog_size == 0) &&
+        (LFS_PART_BLOCK_SIZE % config->cache_size == 0) &&
+        (config->lookahead_size % 8 == 0);
 }
 
 /******************************************************************************
-    [docimport Lfs_Part_getPartition]
+    part_setup
 *//**
-    @brief Gets a partition object from the registry.
-    @param[in] part_label  Label for partition to get.
-    @return Returns the matching Lfs_Part_t object, NULL otherwise.
+    @brief Checks the geometry, creates the lock and fills the lfs
+    configuration of a partition (not mounted yet).
 ******************************************************************************/
-Lfs_Part_t *
-Lfs_Part_getPartition(const char *label)
+static esp_err_t
+part_setup(Lfs_Part_t *lpfs, Lfs_PartDev *dev, const Lfs_Part_Config *config)
 {
-    Lfs_Part_t *entry;
+    static const Lfs_Part_Config defaults = LFS_PART_CONFIG_DEFAULT;
 
-    CLIST_ITER_ENTRY(entry, &registry)
+    if (!config)
     {
-        if (strcmp(entry->partition->label, label) == 0)
-        {
-            LOGPRINT_DEBUG("Found registry with label: %s", label);
-            return entry;
-        }
+        config = &defaults;
     }
-    LOGPRINT_ERROR("Failed to find matching partition: %s", label);
-    return NULL;
-}
 
-/******************************************************************************
-    [docimport Lfs_Part_init]
-*//**
-    @brief Initializes an Lfs_Part file system.
-    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
-    @param[in] part_label  Label for partition to use.
-    @param[out] lfs_result  lfs operation status.
-******************************************************************************/
-esp_err_t
-Lfs_Part_init(Lfs_Part_t *lpfs, const char *part_label, int *lfs_result)
-{
-    int res;
-    const esp_partition_t *part;
+    CHECK_COND_RETURN_MSG(dev->block_size != LFS_PART_BLOCK_SIZE,
+        ESP_ERR_INVALID_ARG, "Unsupported block size.");
+    CHECK_COND_RETURN_MSG(!config_valid(config),
+        ESP_ERR_INVALID_ARG, "Invalid geometry.");
 
-    *lfs_result = LFS_ERR_OK;
-
-    /** @brief Get flash partition. */
-    part = esp_partition_find_first(
-        ESP_PARTITION_TYPE_DATA,
-        ESP_PARTITION_SUBTYPE_ANY,
-        part_label);
-    CHECK_COND_RETURN_MSG(!part, ESP_ERR_NOT_FOUND, "Could not find partition.");
-
-    lpfs->lock = RTOS_MUTEX_CREATE_STATIC(&lpfs->lockbuf);
+    lpfs->lock = RTOS_MUTEX_CREATE_RECURSIVE_STATIC(&lpfs->lockbuf);
     CHECK_COND_RETURN_MSG(!lpfs->lock, ESP_FAIL, "Failed creating mutex.");
 
-    lpfs->partition   = part;
+    lpfs->dev         = dev;
+    lpfs->partition   = dev->partition;
+    lpfs->handle      = 0;
+    lpfs->config      = *config;
+    lpfs->coalesce    = LFS_PART_COALESCE_PROGS;
+    lpfs->mounted     = false;
+    lpfs->mount_us    = 0;
+    lpfs->file_z      = NULL;
+    lpfs->kv          = NULL;
+    lpfs->ring        = NULL;
+    lpfs->tx          = NULL;
     lpfs->cfg.context = lpfs;
     lpfs->cfg.lock    = lock;
     lpfs->cfg.unlock  = unlock;
@@ -236,13 +354,30 @@ Lfs_Part_init(Lfs_Part_t *lpfs, const char *part_label, int *lfs_result)
     lpfs->cfg.erase = part_erase;
     lpfs->cfg.sync  = part_sync;
     
-    lpfs->cfg.read_size      = LFS_PART_READ_SIZE;
-    lpfs->cfg.prog_size      = LFS_PART_WRITE_SIZE;
-    lpfs->cfg.cache_size     = LFS_PART_CACHE_SIZE;
+    lpfs->cfg.read_size      = config->read_size;
+    lpfs->cfg.prog_size      = config->prog_size;
+    lpfs->cfg.cache_size     = config->cache_size;
     lpfs->cfg.block_size     = LFS_PART_BLOCK_SIZE;
-    lpfs->cfg.block_cycles   = LFS_PART_BLOCK_CYCLES;
-    lpfs->cfg.lookahead_size = LFS_PART_LOOKAHEAD_SIZE;
-    lpfs->cfg.block_count    = part->size / LFS_PART_BLOCK_SIZE;
+    lpfs->cfg.block_cycles   = config->block_cycles;
+    lpfs->cfg.lookahead_size = config->lookahead_size;
+    lpfs->cfg.block_count    = dev->size / LFS_PART_BLOCK_SIZE;
+
+    return ESP_OK;
+}
+
+/******************************************************************************
+    part_mount
+*//**
+    @brief Mounts the filesystem of a partition set up by part_setup and
+    records how long it took.
+******************************************************************************/
+static esp_err_t
+part_mount(Lfs_Part_t *lpfs, int *lfs_result)
+{
+    SwTimer swt;
+    int res;
+
+    SwTimer_tic(&swt);
 
     /** @brief Attempt to mount filesystem. Format the partition on fail. */
     res = lfs_mount(&lpfs->lfs, &lpfs->cfg);
@@ -250,7 +385,7 @@ Lfs_Part_init(Lfs_Part_t *lpfs, const char *part_label, int *lfs_result)
     {
         LOGPRINT_INFO("Mount failed (err=%d)", res);
         LOGPRINT_INFO("Formatting partition at 0x%08x",
-            (unsigned int)part->address);
+            (unsigned int)lpfs->dev->address);
 
         res = lfs_format(&lpfs->lfs, &lpfs->cfg);
         if (res != LFS_ERR_OK)
@@ -271,7 +406,586 @@ Lfs_Part_init(Lfs_Part_t *lpfs, const char *part_label, int *lfs_result)
         }
     }
 
-    LOGPRINT_INFO("Mount successful.");
+    /* Finish a transaction cut by a reset before anything reads. */
+    Lfs_PartTx_recover(lpfs);
+
+    lpfs->mount_us = (uint32_t)SwTimer_toc(&swt);
+    lpfs->mounted = true;
+    LOGPRINT_INFO("Mount successful (%s, %u us).", lpfs->dev->label,
+        (unsigned int)lpfs->mount_us);
 
     return ESP_OK;
 }
+
+/******************************************************************************
+    lazy_mount
+*//**
+    @brief Mounts a lazy partition on its first use.
+******************************************************************************/
+static esp_err_t
+lazy_mount(Lfs_Part_t *lpfs)
+{
+    esp_err_t err = ESP_OK;
+    int res;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    if (!lpfs->mounted)
+    {
+        err = part_mount(lpfs, &res);
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return err;
+}
+
+/******************************************************************************
+    label_hash
+*//**
+    @brief FNV-1a hash of a partition label.
+******************************************************************************/
+static uint32_t
+label_hash(const char *label)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*label)
+    {
+        hash = (hash ^ (uint8_t)*label++)*16777619u;
+    }
+    return hash;
+}
+
+/******************************************************************************
+    index_find
+*//**
+    @brief Finds the index slot of a label: its entry, or the empty slot
+    ending its probe sequence.
+******************************************************************************/
+static uint32_t
+index_find(const char *label, uint32_t hash)
+{
+    uint32_t slot = hash % REGISTRY_INDEX_SIZE;
+    uint8_t handle;
+
+    while ((handle = index_handle[slot]) != 0)
+    {
+        if (index_hash[slot] == hash &&
+            strcmp(registry[handle - 1]->dev->label, label) == 0)
+        {
+            break;
+        }
+        slot = (slot + 1) % REGISTRY_INDEX_SIZE;
+    }
+    return slot;
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_register]
+*//**
+    @brief Registers a littlefs partition and gives it a handle.
+    Call this after Lfs_Part_init().
+    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
+******************************************************************************/
+void
+Lfs_Part_register(Lfs_Part_t *lpfs)
+{
+    const char *label = lpfs->dev->label;
+    uint32_t hash = label_hash(label);
+    uint32_t slot = index_find(label, hash);
+
+    CHECK_COND_VOID_RETURN_MSG(index_handle[slot] != 0,
+        "Partition label already registered.");
+    CHECK_COND_VOID_RETURN_MSG(num_registered == LFS_PART_REGISTRY_MAX,
+        "Partition registry full.");
+
+    registry[num_registered++] = lpfs;
+    lpfs->handle = num_registered;
+    index_hash[slot] = hash;
+    index_handle[slot] = (uint8_t)lpfs->handle;
+    LOGPRINT_INFO("Registered littlefs partition: %s (handle %u)", label,
+        (unsigned int)lpfs->handle);
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_getHandle]
+*//**
+    @brief Gets the handle of a registered partition, for callers that look
+    it up often (see Lfs_Part_getByHandle).
+    @param[in] label  Partition label.
+    @return Returns the handle, 0 if the label is not registered.
+******************************************************************************/
+uint32_t
+Lfs_Part_getHandle(const char *label)
+{
+    return index_handle[index_find(label, label_hash(label))];
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_getByHandle]
+*//**
+    @brief Gets a partition object by handle (an array index), mounting it
+    if it is lazy and not mounted yet.
+    @param[in] handle  Handle from Lfs_Part_getHandle.
+    @return Returns the Lfs_Part_t object, NULL if the handle is not valid.
+******************************************************************************/
+Lfs_Part_t *
+Lfs_Part_getByHandle(uint32_t handle)
+{
+    Lfs_Part_t *lpfs;
+
+    if (handle == 0 || handle > num_registered)
+    {
+        return NULL;
+    }
+    lpfs = registry[handle - 1];
+    if (!lpfs->mounted && lazy_mount(lpfs) != ESP_OK)
+    {
+        return NULL;
+    }
+    return lpfs;
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_getPartition]
+*//**
+    @brief Gets a partition object from the registry (hashed by label),
+    mounting it if it is lazy and not mounted yet.
+    @param[in] part_label  Label for partition to get.
+    @return Returns the matching Lfs_Part_t object, NULL otherwise.
+******************************************************************************/
+Lfs_Part_t *
+Lfs_Part_getPartition(const char *label)
+{
+    uint32_t handle = Lfs_Part_getHandle(label);
+
+    if (!handle)
+    {
+        LOGPRINT_ERROR("Failed to find matching partition: %s", label);
+        return NULL;
+    }
+    LOGPRINT_DEBUG("Found registry with label: %s", label);
+    return Lfs_Part_getByHandle(handle);
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_enableCache]
+*//**
+    @brief Enables the block read cache in front of the device, or disables
+    it (budget 0). The cache is write-through and lines of erased blocks are
+    dropped, so it can be toggled while mounted.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[in] budget  RAM budget for cached data, bytes (0 to disable).
+    @param[in] line_size  Cache line size (power of 2, multiple of the
+    read size, at most LFS_PART_BLOCK_SIZE), 0 for
+    LFS_PARTCACHE_LINE_SIZE.
+    @return Returns ESP_OK on success.
+******************************************************************************/
+esp_err_t
+Lfs_Part_enableCache(Lfs_Part_t *lpfs, uint32_t budget, uint32_t line_size)
+{
+    int ret = 0;
+
+    if (line_size == 0)
+    {
+        line_size = LFS_PARTCACHE_LINE_SIZE;
+    }
+    CHECK_COND_RETURN_MSG(
+        (line_size < lpfs->cfg.read_size) || (line_size > LFS_PART_BLOCK_SIZE),
+        ESP_ERR_INVALID_ARG, "Unsupported cache line size.");
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    if (lpfs->bcache.num_lines)
+    {
+        Lfs_PartCache_deinit(&lpfs->bcache);
+    }
+    if (budget)
+    {
+        ret = Lfs_PartCache_init(&lpfs->bcache, budget, line_size);
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    CHECK_COND_RETURN_MSG(ret < 0, ESP_ERR_NO_MEM, "Error enabling cache.");
+    LOGPRINT_DEBUG("Block cache on %s: %u bytes.", lpfs->dev->label,
+        (unsigned int)(lpfs->bcache.num_lines*lpfs->bcache.line_size));
+    return ESP_OK;
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_getCacheStats]
+*//**
+    @brief Gets the block read cache counters.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[out] stats  Pointer to stats to fill (zeroed if disabled).
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_Part_getCacheStats(
+    Lfs_Part_t *lpfs,
+    Lfs_PartCache_Stats *stats,
+    bool clear)
+{
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    Lfs_PartCache_getStats(&lpfs->bcache, stats, clear);
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_getDevStats]
+*//**
+    @brief Gets the flash I/O counters of the partition device: operations,
+    bytes, latency histograms and the highest erase count.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared (erase counts are kept).
+******************************************************************************/
+void
+Lfs_Part_getDevStats(
+    Lfs_Part_t *lpfs,
+    Lfs_PartDev_Stats *stats,
+    bool clear)
+{
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    Lfs_PartDev_getStats(lpfs->dev, stats, clear);
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_getWear]
+*//**
+    @brief Gets the erase count of the partition blocks (the wear map).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[in] start  First block.
+    @param[out] counts  Erase counts from block start.
+    @param[in] max  Max number of counts.
+    @return Returns the number of counts filled.
+******************************************************************************/
+uint32_t
+Lfs_Part_getWear(
+    Lfs_Part_t *lpfs,
+    uint32_t start,
+    uint32_t *counts,
+    uint32_t max)
+{
+    uint32_t n;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    n = Lfs_PartDev_getWear(lpfs->dev, start, counts, max);
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+    return n;
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_setCoalesce]
+*//**
+    @brief Enables or disables program coalescing. littlefs programs in
+    cache sized pieces; with coalescing, consecutive programs to one block
+    are combined into a single device program, issued when the block is
+    full, on a non-sequential program, on a read overlapping it that cannot
+    be served from the buffer, or on littlefs sync (which littlefs issues
+    before every metadata commit, so committed data is always on flash).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[in] enable  true to enable.
+    @return Returns ESP_OK on success.
+******************************************************************************/
+esp_err_t
+Lfs_Part_setCoalesce(Lfs_Part_t *lpfs, bool enable)
+{
+    int err;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    err = prog_flush(lpfs);
+    lpfs->coalesce = enable;
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return err ? ESP_FAIL : ESP_OK;
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_configRam]
+*//**
+    @brief Estimates the littlefs RAM use of a geometry: read and program
+    caches and lookahead buffer, plus one cache per open file.
+    @param[in] config  Geometry.
+    @param[in] open_files  Number of simultaneously open files.
+    @return Returns the number of bytes.
+******************************************************************************/
+uint32_t
+Lfs_Part_configRam(const Lfs_Part_Config *config, uint32_t open_files)
+{
+    return (2 + open_files)*config->cache_size + config->lookahead_size;
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_deinit]
+*//**
+    @brief Unmounts and releases an Lfs_Part file system that is not
+    registered (e.g. a scratch filesystem on a RAM device).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+******************************************************************************/
+void
+Lfs_Part_deinit(Lfs_Part_t *lpfs)
+{
+    Lfs_PartAio_stop(lpfs);
+    Lfs_PartGc_stop(lpfs);
+    Lfs_PartDir_release(lpfs);
+    Lfs_PartXfer_release(lpfs);
+    Lfs_PartDelta_release(lpfs);
+    Lfs_PartKv_release(lpfs);
+    Lfs_PartRing_release(lpfs);
+    Lfs_PartTx_release(lpfs);
+    if (lpfs->mounted)
+    {
+        lfs_unmount(&lpfs->lfs);
+        lpfs->mounted = false;
+    }
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    prog_flush(lpfs);
+    free(lpfs->prog_buf);
+    lpfs->prog_buf = NULL;
+    if (lpfs->bcache.num_lines)
+    {
+        Lfs_PartCache_deinit(&lpfs->bcache);
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    RTOS_MUTEX_DELETE(lpfs->lock);
+    lpfs->lock = NULL;
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_initDev]
+*//**
+    @brief Initializes an Lfs_Part file system on a block device (RAM, file
+    or esp_partition, see Lfs_PartDev.h). The device label is the partition
+    label used by the registry.
+    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
+    @param[in] dev  Pointer to *initialized* block device.
+    @param[in] config  Geometry, NULL for LFS_PART_CONFIG_DEFAULT.
+    @param[out] lfs_result  lfs operation status.
+******************************************************************************/
+esp_err_t
+Lfs_Part_initDev(
+    Lfs_Part_t *lpfs,
+    Lfs_PartDev *dev,
+    const Lfs_Part_Config *config,
+    int *lfs_result)
+{
+    esp_err_t err;
+
+    *lfs_result = LFS_ERR_OK;
+
+    err = part_setup(lpfs, dev, config);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return part_mount(lpfs, lfs_result);
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_initConfig]
+*//**
+    @brief Initializes an Lfs_Part file system with its own geometry.
+    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
+    @param[in] part_label  Label for partition to use.
+    @param[in] config  Geometry, NULL for LFS_PART_CONFIG_DEFAULT (e.g. large
+    caches for a read mostly asset partition, small program size for a log
+    partition).
+    @param[out] lfs_result  lfs operation status.
+******************************************************************************/
+esp_err_t
+Lfs_Part_initConfig(
+    Lfs_Part_t *lpfs,
+    const char *part_label,
+    const Lfs_Part_Config *config,
+    int *lfs_result)
+{
+    int ret;
+
+    *lfs_result = LFS_ERR_OK;
+
+    /** @brief Get flash partition. */
+    ret = Lfs_PartDev_initPartition(&lpfs->part_dev, part_label,
+        LFS_PART_BLOCK_SIZE);
+    CHECK_COND_RETURN_MSG(ret < 0, ESP_ERR_NOT_FOUND, "Could not find partition.");
+
+    return Lfs_Part_initDev(lpfs, &lpfs->part_dev, config, lfs_result);
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_init]
+*//**
+    @brief Initializes an Lfs_Part file system with the default geometry
+    (see Lfs_Part_initConfig).
+    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
+    @param[in] part_label  Label for partition to use.
+    @param[out] lfs_result  lfs operation status.
+******************************************************************************/
+esp_err_t
+Lfs_Part_init(Lfs_Part_t *lpfs, const char *part_label, int *lfs_result)
+{
+    return Lfs_Part_initConfig(lpfs, part_label, NULL, lfs_result);
+}
+
+/******************************************************************************
+    init_mount
+*//**
+    @brief Initializes one partition of Lfs_Part_initAll (mounted unless
+    lazy).
+******************************************************************************/
+static esp_err_t
+init_mount(Lfs_Part_Mount *mount)
+{
+    Lfs_Part_t *lpfs = mount->lpfs;
+    Lfs_PartDev *dev = mount->dev;
+    esp_err_t err;
+    int ret;
+
+    mount->lfs_result = LFS_ERR_OK;
+
+    if (!dev)
+    {
+        ret = Lfs_PartDev_initPartition(&lpfs->part_dev, mount->label,
+            LFS_PART_BLOCK_SIZE);
+        CHECK_COND_RETURN_MSG(ret < 0, ESP_ERR_NOT_FOUND,
+            "Could not find partition.");
+        dev = &lpfs->part_dev;
+    }
+
+    err = part_setup(lpfs, dev, mount->config);
+    if (err != ESP_OK || mount->lazy)
+    {
+        return err;
+    }
+    return part_mount(lpfs, &mount->lfs_result);
+}
+
+/******************************************************************************
+    mount_task
+*//**
+    @brief Mounts one partition of Lfs_Part_initAll and notifies the caller.
+******************************************************************************/
+static void
+mount_task(void *p)
+{
+    Lfs_Part_Mount *mount = (Lfs_Part_Mount *)p;
+    RTOS_TASK waiter = mount->waiter;
+
+    mount->err = init_mount(mount);
+    RTOS_TASK_NOTIFY_GIVE(waiter);
+    RTOS_TASK_DELETE(NULL);
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_initLazy]
+*//**
+    @brief Initializes an Lfs_Part file system without mounting it. Once
+    registered (Lfs_Part_register), the first Lfs_Part_getPartition mounts
+    it (formatting it if the mount fails), so startup does not wait for
+    partitions used later.
+    @param[in] lpfs  Pointer to Lfs_Part_t object instance.
+    @param[in] part_label  Label for partition to use.
+    @param[in] config  Geometry, NULL for LFS_PART_CONFIG_DEFAULT.
+    @return Returns ESP_OK on success.
+******************************************************************************/
+esp_err_t
+Lfs_Part_initLazy(
+    Lfs_Part_t *lpfs,
+    const char *part_label,
+    const Lfs_Part_Config *config)
+{
+    Lfs_Part_Mount mount = {
+        .label = part_label,
+        .config = config,
+        .lazy = true,
+        .lpfs = lpfs
+    };
+
+    return init_mount(&mount);
+}
+
+/******************************************************************************
+    [docimport Lfs_Part_initAll]
+*//**
+    @brief Initializes and registers several partitions, mounting them in
+    parallel (one task each) instead of one after the other. Lazy entries
+    are not mounted (see Lfs_Part_initLazy). The result and mount time of
+    each partition are filled in mounts. Partitions of one flash chip share
+    its bus: mounts overlap their CPU work (metadata CRCs, on both cores)
+    and the I/O of separate devices.
+    @param[in,out] mounts  Partitions.
+    @param[in] count  Number of partitions.
+    @return Returns ESP_OK if all partitions were initialized, ESP_FAIL
+    otherwise (the others are registered).
+******************************************************************************/
+esp_err_t
+Lfs_Part_initAll(Lfs_Part_Mount *mounts, uint32_t count)
+{
+    esp_err_t err = ESP_OK;
+    Lfs_Part_Mount *mount;
+    uint32_t pending = 0;
+    uint32_t done, i;
+    SwTimer swt;
+    int ret;
+
+    SwTimer_tic(&swt);
+
+    for (i = 0; i < count; i++)
+    {
+        mount = &mounts[i];
+        mount->waiter = RTOS_TASK_SELF();
+        ret = -1;
+        if (!mount->lazy)
+        {
+            ret = RTOS_TASK_CREATE(
+                mount_task,
+                "Lfs_PartMount",
+                LFS_PART_MOUNT_TASK_STACK,
+                mount,
+                LFS_PART_MOUNT_TASK_PRIO,
+                NULL);
+        }
+        if (ret < 0)
+        {
+            /* Lazy (no flash access), or no task: initialized here. */
+            mount->err = init_mount(mount);
+            continue;
+        }
+        pending++;
+    }
+
+    while (pending)
+    {
+        done = RTOS_TASK_NOTIFY_TAKE();
+        pending -= (done < pending) ? done : pending;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        mount = &mounts[i];
+        mount->mount_us = 0;
+        if (mount->err != ESP_OK)
+        {
+            LOGPRINT_ERROR("Error %d initializing partition %s.",
+                (int)mount->err, mount->dev ? mount->dev->label : mount->label);
+            err = ESP_FAIL;
+            continue;
+        }
+        mount->mount_us = mount->lpfs->mount_us;
+        Lfs_Part_register(mount->lpfs);
+        if (mount->lazy)
+        {
+            LOGPRINT_INFO("%s: mounted on first use.", mount->lpfs->dev->label);
+        }
+        else
+        {
+            LOGPRINT_INFO("%s: mounted in %u us.", mount->lpfs->dev->label,
+                (unsigned int)mount->mount_us);
+        }
+    }
+
+    LOGPRINT_INFO("Initialized %u partitions in %u us.", (unsigned int)count,
+        (unsigned int)SwTimer_toc(&swt));
+    return err;
+}
@@ -0,0 +1,385 @@
+/*******************************************************************************
+ *  @file: Lfs_PartAio.c
+ *
+ *  @brief: Asynchronous file requests on an Lfs_Part filesystem, served by a
+ *  per-partition I/O task.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartAio.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartAio";
+
+/******************************************************************************
+    complete
+*//**
+    @brief Completes a request. The request may be reused as soon as done is
+    set, so it is not touched after that (except by its callback).
+******************************************************************************/
+static void
+complete(Lfs_PartAio_Req *req)
+{
+    Lfs_PartAio_doneCb *cb = req->cb;
+    RTOS_TASK waiter = req->waiter;
+
+    req->done = true;
+    if (cb)
+    {
+        cb(req);
+    }
+    else
+    {
+        RTOS_TASK_NOTIFY_GIVE(waiter);
+    }
+}
+
+/******************************************************************************
+    run_group
+*//**
+    @brief Runs the requests of one path, in order, under one lock
+    acquisition and one file open, then completes them.
+******************************************************************************/
+static void
+run_group(Lfs_Part_t *lpfs, Lfs_PartAio_Req **reqs, uint32_t num)
+{
+    Lfs_PartAio *aio = &lpfs->aio;
+    lfs_t *lfs = &lpfs->lfs;
+    lfs_file_t *file = &aio->file;
+    struct lfs_info info;
+    Lfs_PartAio_Req *req;
+    bool io = false, wr = false, open = false;
+    lfs_soff_t pos = -1;
+    uint32_t off;
+    uint32_t i;
+    int ret = 0;
+
+    for (i = 0; i < num; i++)
+    {
+        io |= (reqs[i]->op != LFS_PARTAIO_STAT);
+        wr |= (reqs[i]->op == LFS_PARTAIO_WRITE);
+    }
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    aio->stats.groups++;
+    if (io)
+    {
+        ret = lfs_file_opencfg(lfs, file, reqs[0]->path,
+            wr ? LFS_O_RDWR | LFS_O_CREAT : LFS_O_RDONLY, &aio->file_cfg);
+        open = (ret >= 0);
+        pos = 0;
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        req = reqs[i];
+        if (req->op == LFS_PARTAIO_STAT)
+        {
+            if (open)
+            {
+                req->type = LFS_TYPE_REG;
+                req->file_size = lfs_file_size(lfs, file);
+                req->result = 0;
+                continue;
+            }
+            req->result = lfs_stat(lfs, req->path, &info);
+            if (req->result >= 0)
+            {
+                req->type = info.type;
+                req->file_size = info.size;
+            }
+            continue;
+        }
+        if (!open)
+        {
+            req->result = ret;
+            continue;
+        }
+
+        off = req->offset;
+        if (off == LFS_PARTAIO_APPEND)
+        {
+            off = lfs_file_size(lfs, file);
+        }
+        if (pos == (lfs_soff_t)off)
+        {
+            aio->stats.merged++;
+        }
+        else
+        {
+            pos = lfs_file_seek(lfs, file, off, LFS_SEEK_SET);
+            if (pos < 0)
+            {
+                req->result = pos;
+                continue;
+            }
+        }
+
+        if (req->op == LFS_PARTAIO_READ)
+        {
+            req->result = lfs_file_read(lfs, file, req->buf, req->size);
+        }
+        else
+        {
+            req->result = lfs_file_write(lfs, file, req->buf, req->size);
+        }
+        pos = (req->result >= 0) ? (lfs_soff_t)(off + req->result) : -1;
+    }
+
+    if (open)
+    {
+        /* Writes complete once committed. */
+        ret = lfs_file_close(lfs, file);
+        for (i = 0; ret < 0 && i < num; i++)
+        {
+            if (reqs[i]->op == LFS_PARTAIO_WRITE && reqs[i]->result >= 0)
+            {
+                reqs[i]->result = ret;
+            }
+        }
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    for (i = 0; i < num; i++)
+    {
+        if (reqs[i]->result < 0)
+        {
+            LOGPRINT_DEBUG("Request %d on %s failed: %d", reqs[i]->op,
+                reqs[i]->path, reqs[i]->result);
+        }
+        complete(reqs[i]);
+    }
+}
+
+/******************************************************************************
+    run_batch
+*//**
+    @brief Groups a batch by path, keeping submission order within a path,
+    and runs the groups.
+******************************************************************************/
+static void
+run_batch(Lfs_Part_t *lpfs, Lfs_PartAio_Req **reqs, uint32_t num)
+{
+    Lfs_PartAio_Req *req;
+    uint32_t i, j;
+
+    /* Stable insertion sort by path. */
+    for (i = 1; i < num; i++)
+    {
+        req = reqs[i];
+        for (j = i; j > 0 && strcmp(reqs[j - 1]->path, req->path) > 0; j--)
+        {
+            reqs[j] = reqs[j - 1];
+        }
+        reqs[j] = req;
+    }
+
+    for (i = 0; i < num; i = j)
+    {
+        for (j = i + 1; j < num && !strcmp(reqs[j]->path, reqs[i]->path); j++)
+        {
+        }
+        run_group(lpfs, &reqs[i], j - i);
+    }
+}
+
+/******************************************************************************
+    aio_task
+*//**
+    @brief I/O task: takes up to LFS_PARTAIO_BATCH queued requests and runs
+    them, until a NULL request (stop).
+******************************************************************************/
+static void
+aio_task(void *p)
+{
+    Lfs_Part_t *lpfs = (Lfs_Part_t *)p;
+    Lfs_PartAio *aio = &lpfs->aio;
+    Lfs_PartAio_Req *reqs[LFS_PARTAIO_BATCH];
+    Lfs_PartAio_Req *req;
+    bool run = true;
+    uint32_t num;
+
+    while (run)
+    {
+        if (RTOS_QUEUE_RECV(aio->queue, &req) != pdTRUE)
+        {
+            continue;
+        }
+
+        num = 0;
+        while (req)
+        {
+            reqs[num++] = req;
+            if (num == LFS_PARTAIO_BATCH ||
+                RTOS_QUEUE_RECV_WAIT(aio->queue, &req, 0) != pdTRUE)
+            {
+                break;
+            }
+        }
+        run = (req != NULL);
+
+        if (num)
+        {
+            RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+            aio->stats.requests += num;
+            aio->stats.batches++;
+            RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+            run_batch(lpfs, reqs, num);
+        }
+    }
+
+    aio->task = NULL;
+    RTOS_TASK_DELETE(NULL);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartAio_submit]
+*//**
+    @brief Queues a request (waits while the queue is full).
+    @param[in] lpfs  Pointer to an Lfs_Part_t with the I/O task started.
+    @param[in] req  Request, with op, path, offset, buf, size, cb and ctx
+    set.
+    @return Returns 0 on success, -1 if the I/O task is not running.
+******************************************************************************/
+int
+Lfs_PartAio_submit(Lfs_Part_t *lpfs, Lfs_PartAio_Req *req)
+{
+    Lfs_PartAio *aio = &lpfs->aio;
+
+    CHECK_COND_RETURN_MSG(!aio->queue || !aio->task, -1,
+        "I/O task not running.");
+
+    req->result = 0;
+    req->done = false;
+    req->waiter = RTOS_TASK_SELF();
+    if (RTOS_QUEUE_SEND(aio->queue, &req) != pdTRUE)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartAio_wait]
+*//**
+    @brief Waits for a request submitted without callback (uses the task
+    notification of the calling task, which must be the submitter).
+    @param[in] req  Submitted request.
+    @return Returns req->result.
+******************************************************************************/
+int
+Lfs_PartAio_wait(Lfs_PartAio_Req *req)
+{
+    /* A notification left by an earlier request only causes a recheck. */
+    while (!req->done)
+    {
+        RTOS_TASK_NOTIFY_TAKE();
+    }
+    return req->result;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartAio_getStats]
+*//**
+    @brief Gets the I/O task counters.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_PartAio_getStats(Lfs_Part_t *lpfs, Lfs_PartAio_Stats *stats, bool clear)
+{
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    *stats = lpfs->aio.stats;
+    if (clear)
+    {
+        memset(&lpfs->aio.stats, 0, sizeof(lpfs->aio.stats));
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartAio_stop]
+*//**
+    @brief Stops the I/O task after the queued requests complete.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartAio_stop(Lfs_Part_t *lpfs)
+{
+    Lfs_PartAio *aio = &lpfs->aio;
+    Lfs_PartAio_Req *stop = NULL;
+
+    if (!aio->queue)
+    {
+        return;
+    }
+
+    if (aio->task)
+    {
+        RTOS_QUEUE_SEND(aio->queue, &stop);
+    }
+    while (aio->task)
+    {
+        RTOS_TASK_SLEEP_ms(10);
+    }
+
+    RTOS_QUEUE_DELETE(aio->queue);
+    aio->queue = NULL;
+    free(aio->file_buf);
+    aio->file_buf = NULL;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartAio_start]
+*//**
+    @brief Starts the I/O task of a mounted Lfs_Part (no-op if running).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartAio_start(Lfs_Part_t *lpfs)
+{
+    Lfs_PartAio *aio = &lpfs->aio;
+    int ret;
+
+    if (aio->queue)
+    {
+        return 0;
+    }
+
+    memset(aio, 0, sizeof(*aio));
+    aio->file_buf = (uint8_t *)malloc(lpfs->cfg.cache_size);
+    CHECK_COND_RETURN_MSG(!aio->file_buf, -1, "Error allocating file buffer.");
+    aio->file_cfg.buffer = aio->file_buf;
+
+    aio->queue = RTOS_QUEUE_CREATE(LFS_PARTAIO_DEPTH,
+        sizeof(Lfs_PartAio_Req *));
+    if (!aio->queue)
+    {
+        LOGPRINT_ERROR("Error creating I/O queue.");
+        free(aio->file_buf);
+        aio->file_buf = NULL;
+        return -1;
+    }
+
+    ret = RTOS_TASK_CREATE(
+        aio_task,
+        "Lfs_PartAio",
+        LFS_PARTAIO_TASK_STACK,
+        lpfs,
+        LFS_PARTAIO_TASK_PRIO,
+        &aio->task);
+    if (ret < 0)
+    {
+        Lfs_PartAio_stop(lpfs);
+        return -1;
+    }
+
+    LOGPRINT_INFO("I/O task on %s: queue %u, batch %u.", lpfs->dev->label,
+        (unsigned int)LFS_PARTAIO_DEPTH, (unsigned int)LFS_PARTAIO_BATCH);
+    return 0;
+}
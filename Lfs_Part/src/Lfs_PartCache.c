@@ -0,0 +1,263 @@
+/*******************************************************************************
+ *  @file: Lfs_PartCache.c
+ *
+ *  @brief: Read cache of device lines for Lfs_Part. Lines are found by a
+ *  linear tag scan (budgets are a few tens of lines) and replaced with CLOCK.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_PartCache.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartCache";
+
+/******************************************************************************
+    lookup
+*//**
+    @brief Finds the line holding line_addr.
+    @return Returns the line index, -1 if not cached.
+******************************************************************************/
+static int
+lookup(Lfs_PartCache *cache, uint32_t line_addr)
+{
+    uint32_t i;
+
+    for (i = 0; i < cache->num_lines; i++)
+    {
+        Lfs_PartCache_Tag *tag = &cache->tags[i];
+        if (tag->valid && tag->addr == line_addr)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/******************************************************************************
+    victim
+*//**
+    @brief CLOCK: picks a line to replace (invalid lines first).
+******************************************************************************/
+static uint32_t
+victim(Lfs_PartCache *cache)
+{
+    while (1)
+    {
+        Lfs_PartCache_Tag *tag = &cache->tags[cache->hand];
+        uint32_t idx = cache->hand;
+
+        cache->hand = (cache->hand + 1) % cache->num_lines;
+
+        if (!tag->valid)
+        {
+            return idx;
+        }
+        if (!tag->ref)
+        {
+            cache->stats.evictions++;
+            return idx;
+        }
+        tag->ref = false;
+    }
+}
+
+/******************************************************************************
+    [docimport Lfs_PartCache_read]
+*//**
+    @brief Reads through the cache; missing lines are filled from the device.
+    @param[in] cache  Pointer to initialized cache.
+    @param[in] dev  Pointer to the device.
+    @param[in] addr  Byte offset.
+    @param[out] buf  Destination.
+    @param[in] size  Number of bytes.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartCache_read(
+    Lfs_PartCache *cache,
+    Lfs_PartDev *dev,
+    uint32_t addr,
+    void *buf,
+    uint32_t size)
+{
+    uint8_t *out = (uint8_t *)buf;
+    uint32_t mask = cache->line_size - 1;
+
+    while (size > 0)
+    {
+        uint32_t line_addr = addr & ~mask;
+        uint32_t off = addr - line_addr;
+        uint32_t n = cache->line_size - off;
+        int idx;
+
+        n = (n > size) ? size : n;
+
+        idx = lookup(cache, line_addr);
+        if (idx >= 0)
+        {
+            cache->stats.hits++;
+        }
+        else
+        {
+            int ret;
+
+            cache->stats.misses++;
+            idx = victim(cache);
+            cache->tags[idx].valid = false;
+
+            ret = Lfs_PartDev_readBytes(dev, line_addr,
+                cache->data + idx*cache->line_size, cache->line_size);
+            CHECK_COND_RETURN(ret < 0, ret);
+
+            cache->tags[idx].addr = line_addr;
+            cache->tags[idx].valid = true;
+        }
+
+        cache->tags[idx].ref = true;
+        memcpy(out, cache->data + idx*cache->line_size + off, n);
+
+        out += n;
+        addr += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartCache_update]
+*//**
+    @brief Write-through: applies data just programmed to cached lines.
+    @param[in] cache  Pointer to initialized cache.
+    @param[in] addr  Byte offset.
+    @param[in] buf  Data programmed.
+    @param[in] size  Number of bytes.
+******************************************************************************/
+void
+Lfs_PartCache_update(
+    Lfs_PartCache *cache,
+    uint32_t addr,
+    const void *buf,
+    uint32_t size)
+{
+    const uint8_t *in = (const uint8_t *)buf;
+    uint32_t mask = cache->line_size - 1;
+
+    while (size > 0)
+    {
+        uint32_t line_addr = addr & ~mask;
+        uint32_t off = addr - line_addr;
+        uint32_t n = cache->line_size - off;
+        int idx;
+
+        n = (n > size) ? size : n;
+
+        /* Only lines already cached are touched (no allocate on write). */
+        idx = lookup(cache, line_addr);
+        if (idx >= 0)
+        {
+            memcpy(cache->data + idx*cache->line_size + off, in, n);
+        }
+
+        in += n;
+        addr += n;
+        size -= n;
+    }
+}
+
+/******************************************************************************
+    [docimport Lfs_PartCache_invalidate]
+*//**
+    @brief Drops cached lines in a range (e.g. an erased block).
+    @param[in] cache  Pointer to initialized cache.
+    @param[in] addr  Byte offset.
+    @param[in] size  Number of bytes.
+******************************************************************************/
+void
+Lfs_PartCache_invalidate(Lfs_PartCache *cache, uint32_t addr, uint32_t size)
+{
+    uint32_t i;
+
+    for (i = 0; i < cache->num_lines; i++)
+    {
+        Lfs_PartCache_Tag *tag = &cache->tags[i];
+        if (tag->valid && tag->addr >= addr && tag->addr < addr + size)
+        {
+            tag->valid = false;
+            cache->stats.invalidations++;
+        }
+    }
+}
+
+/******************************************************************************
+    [docimport Lfs_PartCache_getStats]
+*//**
+    @brief Gets the cache counters.
+    @param[in] cache  Pointer to initialized cache.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_PartCache_getStats(
+    Lfs_PartCache *cache,
+    Lfs_PartCache_Stats *stats,
+    bool clear)
+{
+    *stats = cache->stats;
+    if (clear)
+    {
+        memset(&cache->stats, 0, sizeof(Lfs_PartCache_Stats));
+    }
+}
+
+/******************************************************************************
+    [docimport Lfs_PartCache_deinit]
+*//**
+    @brief Frees the cache memory.
+    @param[in] cache  Pointer to initialized cache.
+******************************************************************************/
+void
+Lfs_PartCache_deinit(Lfs_PartCache *cache)
+{
+    free(cache->data);
+    free(cache->tags);
+    memset(cache, 0, sizeof(Lfs_PartCache));
+}
+
+/******************************************************************************
+    [docimport Lfs_PartCache_init]
+*//**
+    @brief Initializes a cache.
+    @param[in] cache  Pointer to uninitialized cache.
+    @param[in] budget  RAM budget for line data, bytes.
+    @param[in] line_size  Line size (power of 2).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartCache_init(Lfs_PartCache *cache, uint32_t budget, uint32_t line_size)
+{
+    memset(cache, 0, sizeof(Lfs_PartCache));
+
+    CHECK_COND_RETURN_MSG(line_size == 0 || (line_size & (line_size - 1)), -1,
+        "Line size must be a power of 2.");
+    CHECK_COND_RETURN_MSG(budget < line_size, -1, "Budget below one line.");
+
+    cache->line_size = line_size;
+    cache->num_lines = budget/line_size;
+
+    cache->data = (uint8_t *)malloc(cache->num_lines*line_size);
+    cache->tags = (Lfs_PartCache_Tag *)calloc(cache->num_lines,
+        sizeof(Lfs_PartCache_Tag));
+    if (!cache->data || !cache->tags)
+    {
+        LOGPRINT_ERROR("Error allocating memory.");
+        Lfs_PartCache_deinit(cache);
+        return -1;
+    }
+
+    LOGPRINT_DEBUG("Cache: %u lines of %u bytes.",
+        (unsigned int)cache->num_lines, (unsigned int)line_size);
+    return 0;
+}
@@ -0,0 +1,489 @@
+/*******************************************************************************
+ *  @file: Lfs_PartDelta.c
+ *
+ *  @brief: rsync-style delta updates of files: block signatures and patch
+ *  application into a temporary file renamed over the original.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "esp_rom_md5.h"
+#include "Lfs_Part.h"
+#include "Lfs_PartDelta.h"
+#include "Lfs_PartDigest.h"
+#include "Lfs_PartXfer.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartDelta";
+
+/** @brief Copy chunk of a patch. */
+#define DELTA_COPY_CHUNK        512
+
+#define MIN(x,y)  (((x) < (y)) ? (x) : (y))
+
+/** @brief Patch in progress. */
+typedef struct DeltaPatch
+{
+    bool used;
+    uint32_t id;
+    Lfs_Part_t *lpfs;
+    char path[LFS_PARTDELTA_PATH_MAX];
+    char tmp[LFS_PARTDELTA_PATH_MAX];
+    uint32_t block_size;
+
+    /** @brief Original file (if it exists) and the new file. */
+    lfs_file_t old;
+    bool has_old;
+    lfs_file_t out;
+    struct lfs_file_config old_cfg;
+    struct lfs_file_config out_cfg;
+    uint8_t *old_buf;
+    uint8_t *out_buf;
+    uint32_t buf_size;
+
+    /** @brief Size and CRC32 of the new file so far. */
+    uint32_t size;
+    uint32_t crc;
+
+} DeltaPatch;
+
+static DeltaPatch patch;
+static uint32_t patch_gen;
+static uint8_t copy_buf[DELTA_COPY_CHUNK];
+
+/** @brief Protects the patch, shared by the TCP and UDP RPC servers. */
+static RTOS_MUTEX_STATIC_BUF delta_lockbuf;
+static RTOS_MUTEX delta_lock;
+
+/******************************************************************************
+    [docimport Lfs_PartDelta_weak]
+*//**
+    @brief Computes the rolling checksum of a block (rsync: a = sum of the
+    bytes, b = sum of (len - i)*byte i, both mod 2^16; a | b << 16).
+    @param[in] data  Block.
+    @param[in] len  Block length.
+    @return Returns the checksum.
+******************************************************************************/
+uint32_t
+Lfs_PartDelta_weak(const uint8_t *data, uint32_t len)
+{
+    uint32_t a = 0, b = 0;
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        a += data[i];
+        b += (len - i)*data[i];
+    }
+    return (a & 0xffff) | ((b & 0xffff) << 16);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDelta_signatures]
+*//**
+    @brief Computes the signatures of the blocks of a file, from block
+    start (the last block may be short).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[in] block_size  Block size (LFS_PARTDELTA_BLOCK_MIN to _MAX).
+    @param[in] start  First block.
+    @param[out] sigs  Signatures.
+    @param[in] max  Max number of signatures.
+    @param[out] file_size  File size.
+    @return Returns the number of signatures, negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartDelta_signatures(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t block_size,
+    uint32_t start,
+    Lfs_PartDelta_Sig *sigs,
+    uint32_t max,
+    uint32_t *file_size)
+{
+    uint8_t digest[ESP_ROM_MD5_DIGEST_LEN];
+    md5_context_t md5;
+    lfs_t *lfs = &lpfs->lfs;
+    lfs_file_t file;
+    uint8_t *block;
+    uint32_t num = 0;
+    int ret;
+
+    *file_size = 0;
+    CHECK_COND_RETURN(block_size < LFS_PARTDELTA_BLOCK_MIN ||
+        block_size > LFS_PARTDELTA_BLOCK_MAX, LFS_ERR_INVAL);
+
+    block = (uint8_t *)malloc(block_size);
+    CHECK_COND_RETURN_MSG(!block, LFS_ERR_NOMEM, "No block buffer.");
+
+    ret = lfs_file_open(lfs, &file, path, LFS_O_RDONLY);
+    if (ret < 0)
+    {
+        free(block);
+        return ret;
+    }
+    *file_size = lfs_file_size(lfs, &file);
+
+    if ((uint64_t)start*block_size < *file_size)
+    {
+        ret = lfs_file_seek(lfs, &file, start*block_size, LFS_SEEK_SET);
+    }
+    while (ret >= 0 && num < max &&
+        (uint64_t)(start + num)*block_size < *file_size)
+    {
+        ret = lfs_file_read(lfs, &file, block, block_size);
+        if (ret <= 0)
+        {
+            break;
+        }
+        sigs[num].weak = Lfs_PartDelta_weak(block, ret);
+        esp_rom_md5_init(&md5);
+        esp_rom_md5_update(&md5, block, ret);
+        esp_rom_md5_final(digest, &md5);
+        memcpy(sigs[num].strong, digest, LFS_PARTDELTA_STRONG_LEN);
+        num++;
+    }
+
+    lfs_file_close(lfs, &file);
+    free(block);
+    return (ret < 0) ? ret : (int)num;
+}
+
+/******************************************************************************
+    patch_end
+*//**
+    @brief Ends the patch, removing the temporary file unless it was
+    committed.
+******************************************************************************/
+static void
+patch_end(bool committed)
+{
+    lfs_t *lfs;
+
+    if (!patch.used)
+    {
+        return;
+    }
+    lfs = &patch.lpfs->lfs;
+    if (patch.has_old)
+    {
+        lfs_file_close(lfs, &patch.old);
+        patch.has_old = false;
+    }
+    if (!committed)
+    {
+        lfs_file_close(lfs, &patch.out);
+        lfs_remove(lfs, patch.tmp);
+    }
+    patch.used = false;
+}
+
+/******************************************************************************
+    patch_start
+*//**
+    @brief Starts a patch of path: opens the original (if any) and creates
+    the temporary file.
+******************************************************************************/
+static int
+patch_start(Lfs_Part_t *lpfs, const char *path, uint32_t block_size)
+{
+    uint32_t cache_size = lpfs->lfs.cfg->cache_size;
+    lfs_t *lfs = &lpfs->lfs;
+    uint8_t *old_buf, *out_buf;
+    int ret;
+
+    CHECK_COND_RETURN(block_size < LFS_PARTDELTA_BLOCK_MIN ||
+        block_size > LFS_PARTDELTA_BLOCK_MAX, LFS_ERR_INVAL);
+    CHECK_COND_RETURN_MSG(strlen(path) + sizeof(LFS_PARTDELTA_TMP_SUFFIX) >
+        LFS_PARTDELTA_PATH_MAX, LFS_ERR_NAMETOOLONG, "Patch path too long.");
+
+    if (patch.used)
+    {
+        LOGPRINT_WARN("Abandoning patch of %s for %s.", patch.path, path);
+        patch_end(false);
+    }
+
+    /* Buffers are kept for the next patch. */
+    if (patch.buf_size < cache_size)
+    {
+        old_buf = (uint8_t *)realloc(patch.old_buf, cache_size);
+        if (old_buf)
+        {
+            patch.old_buf = old_buf;
+        }
+        out_buf = (uint8_t *)realloc(patch.out_buf, cache_size);
+        if (out_buf)
+        {
+            patch.out_buf = out_buf;
+        }
+        CHECK_COND_RETURN_MSG(!old_buf || !out_buf, LFS_ERR_NOMEM,
+            "No patch buffers.");
+        patch.buf_size = cache_size;
+    }
+
+    strcpy(patch.path, path);
+    strcpy(patch.tmp, path);
+    strcat(patch.tmp, LFS_PARTDELTA_TMP_SUFFIX);
+
+    memset(&patch.old_cfg, 0, sizeof(patch.old_cfg));
+    patch.old_cfg.buffer = patch.old_buf;
+    ret = lfs_file_opencfg(lfs, &patch.old, path, LFS_O_RDONLY,
+        &patch.old_cfg);
+    CHECK_COND_RETURN(ret < 0 && ret != LFS_ERR_NOENT, ret);
+    patch.has_old = (ret >= 0);
+
+    memset(&patch.out_cfg, 0, sizeof(patch.out_cfg));
+    patch.out_cfg.buffer = patch.out_buf;
+    Lfs_PartDigest_invalidate(&patch.out_cfg);
+    ret = lfs_file_opencfg(lfs, &patch.out, patch.tmp,
+        LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC, &patch.out_cfg);
+    if (ret < 0)
+    {
+        if (patch.has_old)
+        {
+            lfs_file_close(lfs, &patch.old);
+            patch.has_old = false;
+        }
+        return ret;
+    }
+
+    patch_gen = (patch_gen + 1) ? patch_gen + 1 : 1;
+    patch.id = patch_gen;
+    patch.used = true;
+    patch.lpfs = lpfs;
+    patch.block_size = block_size;
+    patch.size = 0;
+    patch.crc = 0;
+    return 0;
+}
+
+/******************************************************************************
+    patch_write
+*//**
+    @brief Appends to the new file.
+******************************************************************************/
+static int
+patch_write(const uint8_t *data, uint32_t len)
+{
+    int ret;
+
+    ret = lfs_file_write(&patch.lpfs->lfs, &patch.out, data, len);
+    if (ret >= 0 && (uint32_t)ret != len)
+    {
+        ret = LFS_ERR_NOSPC;
+    }
+    CHECK_COND_RETURN(ret < 0, ret);
+    patch.crc = Lfs_PartXfer_crc32(patch.crc, data, len);
+    patch.size += len;
+    return 0;
+}
+
+/******************************************************************************
+    patch_copy
+*//**
+    @brief Appends blocks of the original file to the new file.
+******************************************************************************/
+static int
+patch_copy(uint32_t block, uint32_t count)
+{
+    lfs_t *lfs = &patch.lpfs->lfs;
+    uint64_t left = (uint64_t)count*patch.block_size;
+    uint32_t copied = 0;
+    int ret, n;
+
+    CHECK_COND_RETURN(!patch.has_old, LFS_ERR_NOENT);
+    ret = lfs_file_seek(lfs, &patch.old, block*patch.block_size,
+        LFS_SEEK_SET);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    while (left)
+    {
+        n = lfs_file_read(lfs, &patch.old, copy_buf,
+            (lfs_size_t)MIN(left, DELTA_COPY_CHUNK));
+        CHECK_COND_RETURN(n < 0, n);
+        if (n == 0)
+        {
+            break;
+        }
+        ret = patch_write(copy_buf, n);
+        CHECK_COND_RETURN(ret < 0, ret);
+        copied += n;
+        left -= n;
+    }
+
+    /* Only the last block of the original can be short. */
+    return (count && !copied) ? LFS_ERR_INVAL : 0;
+}
+
+/******************************************************************************
+    delta_patch
+*//**
+    @brief Lfs_PartDelta_patch with the patch locked.
+******************************************************************************/
+static int
+delta_patch(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t id,
+    uint32_t block_size,
+    uint32_t copy_block,
+    uint32_t copy_count,
+    const uint8_t *data,
+    uint32_t len,
+    bool last,
+    uint32_t crc,
+    Lfs_PartDelta_Result *res)
+{
+    lfs_t *lfs = &lpfs->lfs;
+    int ret = 0;
+
+    if (!patch.used || patch.id != id || patch.lpfs != lpfs ||
+        strcmp(patch.path, path) != 0)
+    {
+        /* Only a first call starts a patch; a stale id means it was lost. */
+        CHECK_COND_RETURN_MSG(id != 0, LFS_ERR_BADF, "Unknown patch.");
+        ret = patch_start(lpfs, path, block_size);
+        CHECK_COND_RETURN(ret < 0, ret);
+    }
+
+    if (copy_count)
+    {
+        ret = patch_copy(copy_block, copy_count);
+    }
+    if (ret >= 0 && len)
+    {
+        ret = patch_write(data, len);
+    }
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Patch of %s failed at %u: %d", path,
+            (unsigned int)patch.size, ret);
+        patch_end(false);
+        return ret;
+    }
+
+    res->size = patch.size;
+    res->crc = patch.crc;
+    if (!last)
+    {
+        res->id = patch.id;
+        return 0;
+    }
+
+    ret = lfs_file_close(lfs, &patch.out);
+    if (ret >= 0 && patch.crc != crc)
+    {
+        LOGPRINT_ERROR("Patch of %s: CRC %08x, expected %08x.", path,
+            (unsigned int)patch.crc, (unsigned int)crc);
+        ret = LFS_ERR_CORRUPT;
+    }
+    if (ret < 0)
+    {
+        if (patch.has_old)
+        {
+            lfs_file_close(lfs, &patch.old);
+            patch.has_old = false;
+        }
+        lfs_remove(lfs, patch.tmp);
+        patch.used = false;
+        return ret;
+    }
+
+    patch_end(true);
+    ret = lfs_rename(lfs, patch.tmp, path);
+    if (ret < 0)
+    {
+        lfs_remove(lfs, patch.tmp);
+    }
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDelta_patch]
+*//**
+    @brief Runs one patch call: copies copy_count blocks of the original
+    file from block copy_block (a short last block copies what there is),
+    then appends data.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[in] id  Patch id from the previous result, 0 to start.
+    @param[in] block_size  Block size of the signatures.
+    @param[in] copy_block  First block to copy.
+    @param[in] copy_count  Number of blocks to copy (0 for none).
+    @param[in] data  Literal data.
+    @param[in] len  Literal data length.
+    @param[in] last  The call ends the new file: it is checked against crc
+    and renamed over the original.
+    @param[in] crc  With last, CRC32 of the new file.
+    @param[out] res  Pointer to result to fill.
+    @return Returns 0 on success, LFS_ERR_CORRUPT on a CRC mismatch, other
+    negative lfs error code otherwise (the patch is abandoned).
+******************************************************************************/
+int
+Lfs_PartDelta_patch(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t id,
+    uint32_t block_size,
+    uint32_t copy_block,
+    uint32_t copy_count,
+    const uint8_t *data,
+    uint32_t len,
+    bool last,
+    uint32_t crc,
+    Lfs_PartDelta_Result *res)
+{
+    int ret;
+
+    memset(res, 0, sizeof(*res));
+    CHECK_COND_RETURN_MSG(!delta_lock, LFS_ERR_INVAL,
+        "Delta updates are not initialized.");
+    RTOS_MUTEX_GET(delta_lock);
+    ret = delta_patch(lpfs, path, id, block_size, copy_block, copy_count,
+        data, len, last, crc, res);
+    RTOS_MUTEX_PUT(delta_lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDelta_release]
+*//**
+    @brief Abandons the patch on a partition (before it is unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartDelta_release(Lfs_Part_t *lpfs)
+{
+    /* Without Lfs_PartDelta_init no patch was started. */
+    if (!delta_lock)
+    {
+        return;
+    }
+
+    RTOS_MUTEX_GET(delta_lock);
+    if (patch.used && patch.lpfs == lpfs)
+    {
+        patch_end(false);
+    }
+    RTOS_MUTEX_PUT(delta_lock);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDelta_init]
+*//**
+    @brief Creates the patch lock (call before the first patch).
+    @return Returns 0 on success, -1 on failure.
+******************************************************************************/
+int
+Lfs_PartDelta_init(void)
+{
+    if (!delta_lock)
+    {
+        delta_lock = RTOS_MUTEX_CREATE_STATIC(&delta_lockbuf);
+        CHECK_COND_RETURN_MSG(!delta_lock, -1, "Error creating delta lock.");
+    }
+    return 0;
+}
@@ -0,0 +1,506 @@
+/*******************************************************************************
+ *  @file: Lfs_PartDev.c
+ *
+ *  @brief: Block devices for Lfs_Part: esp_partition, RAM and mmap'd file.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_PartDev.h"
+#include "SwTimer.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char *TAG = "Lfs_PartDev";
+
+#define ERASED_BYTE     0xff
+
+/******************************************************************************
+    account
+*//**
+    @brief Adds simulated busy time, waiting it out if requested.
+******************************************************************************/
+static void
+account(Lfs_PartDev *dev, uint64_t ns)
+{
+    dev->stats.sim_ns += ns;
+    if (dev->timing.delay && ns >= 1000)
+    {
+        SwTimer_sleepUs(ns/1000);
+    }
+}
+
+/******************************************************************************
+    latency
+*//**
+    @brief Adds a measured operation time to the latency stats.
+******************************************************************************/
+static void
+latency(Lfs_PartDev *dev, Lfs_PartDev_Op op, uint64_t start)
+{
+    Lfs_PartDev_Latency *lat = &dev->stats.lat[op];
+    uint32_t us = (uint32_t)(SwTimer_getCount() - start);
+    uint32_t b = 0;
+
+    lat->total_us += us;
+    if (us > lat->max_us)
+    {
+        lat->max_us = us;
+    }
+    while (b < LFS_PARTDEV_LAT_BUCKETS - 1 &&
+        us >= ((uint32_t)LFS_PARTDEV_LAT_BASE_US << 2*b))
+    {
+        b++;
+    }
+    lat->hist[b]++;
+}
+
+/******************************************************************************
+    part_read
+*//**
+    @brief esp_partition backend read.
+******************************************************************************/
+static int
+part_read(Lfs_PartDev *dev, uint32_t addr, void *buf, uint32_t size)
+{
+    esp_err_t err = esp_partition_read(dev->partition, addr, buf, size);
+    return err ? -1 : 0;
+}
+
+/******************************************************************************
+    part_write
+*//**
+    @brief esp_partition backend program.
+******************************************************************************/
+static int
+part_write(Lfs_PartDev *dev, uint32_t addr, const void *buf, uint32_t size)
+{
+    esp_err_t err = esp_partition_write(dev->partition, addr, buf, size);
+    return err ? -1 : 0;
+}
+
+/******************************************************************************
+    part_erase
+*//**
+    @brief esp_partition backend erase.
+******************************************************************************/
+static int
+part_erase(Lfs_PartDev *dev, uint32_t addr, uint32_t size)
+{
+    esp_err_t err = esp_partition_erase_range(dev->partition, addr, size);
+    return err ? -1 : 0;
+}
+
+/******************************************************************************
+    mem_read
+*//**
+    @brief RAM/file backend read.
+******************************************************************************/
+static int
+mem_read(Lfs_PartDev *dev, uint32_t addr, void *buf, uint32_t size)
+{
+    memcpy(buf, dev->mem + addr, size);
+    return 0;
+}
+
+/******************************************************************************
+    mem_write
+*//**
+    @brief RAM/file backend program: NOR semantics, bits can only be cleared.
+******************************************************************************/
+static int
+mem_write(Lfs_PartDev *dev, uint32_t addr, const void *buf, uint32_t size)
+{
+    const uint8_t *src = (const uint8_t *)buf;
+    uint8_t *dst = dev->mem + addr;
+    uint32_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        dst[i] &= src[i];
+    }
+    return 0;
+}
+
+/******************************************************************************
+    mem_erase
+*//**
+    @brief RAM/file backend erase.
+******************************************************************************/
+static int
+mem_erase(Lfs_PartDev *dev, uint32_t addr, uint32_t size)
+{
+    memset(dev->mem + addr, ERASED_BYTE, size);
+    return 0;
+}
+
+/******************************************************************************
+    dev_setup
+*//**
+    @brief Common part of the init functions.
+******************************************************************************/
+static int
+dev_setup(
+    Lfs_PartDev *dev,
+    const char *label,
+    uint32_t size,
+    uint32_t block_size)
+{
+    CHECK_COND_RETURN_MSG(block_size == 0, -1, "Invalid block size.");
+    CHECK_COND_RETURN_MSG(size/block_size*block_size != size, -1,
+        "Size must be a multiple of the block size.");
+
+    memset(dev, 0, sizeof(Lfs_PartDev));
+    strncpy(dev->label, label, sizeof(dev->label) - 1);
+    dev->size = size;
+    dev->block_size = block_size;
+    dev->fd = -1;
+
+    dev->erase_counts = (uint32_t *)calloc(size/block_size, sizeof(uint32_t));
+    CHECK_COND_RETURN_MSG(!dev->erase_counts, -1, "Error allocating memory.");
+
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_readBytes]
+*//**
+    @brief Reads from the device, with accounting.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] addr  Byte offset.
+    @param[out] buf  Destination.
+    @param[in] size  Number of bytes.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_readBytes(Lfs_PartDev *dev, uint32_t addr, void *buf, uint32_t size)
+{
+    uint64_t start;
+    int ret;
+
+    CHECK_COND_RETURN_MSG(addr + size > dev->size, -1, "Read out of range.");
+
+    dev->stats.reads++;
+    dev->stats.read_bytes += size;
+    account(dev, dev->timing.read_setup_ns +
+        (uint64_t)size*dev->timing.read_byte_ns);
+
+    start = SwTimer_getCount();
+    ret = dev->read(dev, addr, buf, size);
+    latency(dev, LFS_PARTDEV_OP_READ, start);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_writeBytes]
+*//**
+    @brief Programs the device, with accounting.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] addr  Byte offset.
+    @param[in] buf  Source.
+    @param[in] size  Number of bytes.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_writeBytes(
+    Lfs_PartDev *dev,
+    uint32_t addr,
+    const void *buf,
+    uint32_t size)
+{
+    uint64_t start;
+    int ret;
+
+    CHECK_COND_RETURN_MSG(addr + size > dev->size, -1, "Write out of range.");
+
+    dev->stats.progs++;
+    dev->stats.prog_bytes += size;
+    account(dev, dev->timing.prog_setup_ns +
+        (uint64_t)size*dev->timing.prog_byte_ns);
+
+    start = SwTimer_getCount();
+    ret = dev->write(dev, addr, buf, size);
+    latency(dev, LFS_PARTDEV_OP_PROG, start);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_eraseBlock]
+*//**
+    @brief Erases one block, with accounting.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] block  Block number.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_eraseBlock(Lfs_PartDev *dev, uint32_t block)
+{
+    uint64_t start;
+    uint32_t count;
+    int ret;
+
+    CHECK_COND_RETURN_MSG(block >= dev->size/dev->block_size, -1,
+        "Erase out of range.");
+
+    dev->stats.erases++;
+    count = ++dev->erase_counts[block];
+    if (count > dev->stats.max_erase_count)
+    {
+        dev->stats.max_erase_count = count;
+    }
+    account(dev, (uint64_t)dev->timing.erase_block_us*1000);
+
+    start = SwTimer_getCount();
+    ret = dev->erase(dev, block*dev->block_size, dev->block_size);
+    latency(dev, LFS_PARTDEV_OP_ERASE, start);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_map]
+*//**
+    @brief Maps the device read-only into the address space: the flash
+    partition through the MMU (esp_partition_mmap, mapped once and kept),
+    or the RAM/file backing memory. Reads through the mapping are not
+    counted in the stats.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @return Returns a pointer to device offset 0, NULL if it cannot be mapped.
+******************************************************************************/
+const uint8_t *
+Lfs_PartDev_map(Lfs_PartDev *dev)
+{
+    if (dev->map)
+    {
+        return dev->map;
+    }
+
+    if (dev->mem)
+    {
+        dev->map = dev->mem;
+    }
+    else if (dev->partition)
+    {
+        const void *ptr;
+        esp_err_t err;
+
+        err = esp_partition_mmap(dev->partition, 0, dev->size,
+            ESP_PARTITION_MMAP_DATA, &ptr, &dev->map_handle);
+        if (err != ESP_OK)
+        {
+            LOGPRINT_ERROR("Error mapping %s (%d).", dev->label, err);
+            return NULL;
+        }
+        dev->map = (const uint8_t *)ptr;
+    }
+
+    return dev->map;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_setTiming]
+*//**
+    @brief Sets the simulated timings (NULL for none).
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] timing  Pointer to timings.
+******************************************************************************/
+void
+Lfs_PartDev_setTiming(Lfs_PartDev *dev, const Lfs_PartDev_Timing *timing)
+{
+    if (timing)
+    {
+        dev->timing = *timing;
+    }
+    else
+    {
+        memset(&dev->timing, 0, sizeof(Lfs_PartDev_Timing));
+    }
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_getStats]
+*//**
+    @brief Gets the device counters.
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared (erase counts are kept).
+******************************************************************************/
+void
+Lfs_PartDev_getStats(Lfs_PartDev *dev, Lfs_PartDev_Stats *stats, bool clear)
+{
+    *stats = dev->stats;
+    if (clear)
+    {
+        uint32_t max_erase_count = dev->stats.max_erase_count;
+        memset(&dev->stats, 0, sizeof(Lfs_PartDev_Stats));
+        dev->stats.max_erase_count = max_erase_count;
+    }
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_getWear]
+*//**
+    @brief Gets the erase count of blocks (the wear map).
+    @param[in] dev  Pointer to initialized Lfs_PartDev.
+    @param[in] start  First block.
+    @param[out] counts  Erase counts from block start.
+    @param[in] max  Max number of counts.
+    @return Returns the number of counts filled.
+******************************************************************************/
+uint32_t
+Lfs_PartDev_getWear(
+    Lfs_PartDev *dev,
+    uint32_t start,
+    uint32_t *counts,
+    uint32_t max)
+{
+    uint32_t num_blocks = dev->size/dev->block_size;
+    uint32_t n;
+
+    if (start >= num_blocks)
+    {
+        return 0;
+    }
+    n = num_blocks - start < max ? num_blocks - start : max;
+    memcpy(counts, &dev->erase_counts[start], n*sizeof(uint32_t));
+    return n;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_initPartition]
+*//**
+    @brief Initializes a device on an esp_partition.
+    @param[in] dev  Pointer to uninitialized Lfs_PartDev.
+    @param[in] part_label  Label of the data partition.
+    @param[in] block_size  Erase block size.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_initPartition(
+    Lfs_PartDev *dev,
+    const char *part_label,
+    uint32_t block_size)
+{
+    const esp_partition_t *part;
+    int ret;
+
+    part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA,
+        ESP_PARTITION_SUBTYPE_ANY,
+        part_label);
+    CHECK_COND_RETURN_MSG(!part, -1, "Could not find partition.");
+
+    ret = dev_setup(dev, part->label, part->size, block_size);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    dev->partition = part;
+    dev->address = part->address;
+    dev->read = part_read;
+    dev->write = part_write;
+    dev->erase = part_erase;
+
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_initRam]
+*//**
+    @brief Initializes a RAM device (erased, i.e. all 0xff). Programming has
+    NOR semantics: bits can only be cleared.
+    @param[in] dev  Pointer to uninitialized Lfs_PartDev.
+    @param[in] label  Device label.
+    @param[in] size  Device size (multiple of block_size).
+    @param[in] block_size  Erase block size.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_initRam(
+    Lfs_PartDev *dev,
+    const char *label,
+    uint32_t size,
+    uint32_t block_size)
+{
+    int ret;
+
+    ret = dev_setup(dev, label, size, block_size);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    dev->mem = (uint8_t *)malloc(size);
+    CHECK_COND_RETURN_MSG(!dev->mem, -1, "Error allocating memory.");
+    memset(dev->mem, ERASED_BYTE, size);
+
+    dev->read = mem_read;
+    dev->write = mem_write;
+    dev->erase = mem_erase;
+
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDev_initFile]
+*//**
+    @brief Initializes a device on an mmap'd file, so an image survives
+    between runs (linux target only). A new or short file is extended and
+    erased.
+    @param[in] dev  Pointer to uninitialized Lfs_PartDev.
+    @param[in] label  Device label.
+    @param[in] path  Image file path.
+    @param[in] size  Device size (multiple of block_size).
+    @param[in] block_size  Erase block size.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartDev_initFile(
+    Lfs_PartDev *dev,
+    const char *label,
+    const char *path,
+    uint32_t size,
+    uint32_t block_size)
+{
+#if defined(__linux__)
+    struct stat st;
+    off_t old_size;
+    void *mem;
+    int ret;
+
+    ret = dev_setup(dev, label, size, block_size);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    dev->fd = open(path, O_RDWR | O_CREAT, 0644);
+    CHECK_COND_RETURN_MSG(dev->fd < 0, -1, "Error opening image file.");
+
+    ret = fstat(dev->fd, &st);
+    CHECK_COND_RETURN_MSG(ret < 0, -1, "Error reading image file size.");
+    old_size = (st.st_size < size) ? st.st_size : size;
+
+    if (st.st_size < size)
+    {
+        ret = ftruncate(dev->fd, size);
+        CHECK_COND_RETURN_MSG(ret < 0, -1, "Error sizing image file.");
+    }
+
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dev->fd, 0);
+    CHECK_COND_RETURN_MSG(mem == MAP_FAILED, -1, "Error mapping image file.");
+    dev->mem = (uint8_t *)mem;
+
+    /* Anything the file did not hold yet reads as erased flash. */
+    memset(dev->mem + old_size, ERASED_BYTE, size - old_size);
+
+    dev->read = mem_read;
+    dev->write = mem_write;
+    dev->erase = mem_erase;
+
+    LOGPRINT_INFO("Mapped %s (%u bytes) as %s.", path, (unsigned int)size,
+        dev->label);
+    return 0;
+#else
+    LOGPRINT_ERROR("File backed devices need the linux target.");
+    return -1;
+#endif
+}
@@ -0,0 +1,292 @@
+/*******************************************************************************
+ *  @file: Lfs_PartDigest.c
+ *
+ *  @brief: Cached file digests on an Lfs_Part filesystem.
+*******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mbedtls/sha256.h"
+#include "Lfs_Part.h"
+#include "Lfs_PartDigest.h"
+#include "Lfs_PartXfer.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartDigest";
+
+/** @brief Zero length digest attribute (see Lfs_PartDigest_invalidate). */
+static uint8_t clear_buf;
+static struct lfs_attr clear_attr = {
+    .type = LFS_PARTDIGEST_ATTR,
+    .buffer = &clear_buf,
+    .size = 0
+};
+
+/** @brief State of a tree walk: one open directory per level. */
+typedef struct DigestWalk
+{
+    lfs_dir_t dirs[LFS_PARTDIGEST_DEPTH];
+    /** @brief Length of the path of each level. */
+    uint32_t lens[LFS_PARTDIGEST_DEPTH];
+    char path[LFS_PARTDIGEST_PATH_MAX];
+    struct lfs_info info;
+    /** @brief Files of the page, for fn once the lock is released. */
+    char (*page)[LFS_PARTDIGEST_PATH_MAX];
+
+} DigestWalk;
+
+/******************************************************************************
+    compute
+*//**
+    @brief Reads an open file through and computes its digest.
+******************************************************************************/
+static int
+compute(lfs_t *lfs, lfs_file_t *file, Lfs_PartDigest *digest)
+{
+    mbedtls_sha256_context sha;
+    uint32_t buf_size = lfs->cfg->block_size;
+    uint8_t *buf;
+    int ret;
+
+    buf = (uint8_t *)malloc(buf_size);
+    CHECK_COND_RETURN_MSG(!buf, LFS_ERR_NOMEM, "No memory for hashing.");
+
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    digest->size = 0;
+    digest->crc = 0;
+    while ((ret = lfs_file_read(lfs, file, buf, buf_size)) > 0)
+    {
+        mbedtls_sha256_update(&sha, buf, ret);
+        digest->crc = Lfs_PartXfer_crc32(digest->crc, buf, ret);
+        digest->size += ret;
+    }
+    mbedtls_sha256_finish(&sha, digest->sha256);
+    mbedtls_sha256_free(&sha);
+
+    free(buf);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDigest_get]
+*//**
+    @brief Gets the digest of a file, from its cache attribute when the file
+    has not changed, else computed and cached. The file is hashed without
+    holding the partition lock; the digest is not cached if the file
+    changed meanwhile.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[out] digest  Pointer to digest to fill.
+    @return Returns 1 if the digest was cached, 0 if it was computed,
+    LFS_ERR_ISDIR for a directory, other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartDigest_get(Lfs_Part_t *lpfs, const char *path, Lfs_PartDigest *digest)
+{
+    lfs_t *lfs = &lpfs->lfs;
+    Lfs_PartDigest_Attr attr;
+    lfs_file_t file;
+    bool inline_file;
+    uint32_t size;
+    int ret;
+
+    memset(digest, 0, sizeof(*digest));
+
+    /* The head, size and attribute are read together. */
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    ret = lfs_file_open(lfs, &file, path, LFS_O_RDONLY);
+    if (ret < 0)
+    {
+        RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+        return ret;
+    }
+
+    /* A file is inline or has a head block; the data is copy-on-write, so
+       a write moves the head. */
+    inline_file = (file.flags & LFS_F_INLINE) != 0;
+    size = (uint32_t)lfs_file_size(lfs, &file);
+    if (!inline_file &&
+        lfs_getattr(lfs, path, LFS_PARTDIGEST_ATTR, &attr, sizeof(attr)) ==
+        sizeof(attr) && attr.head == file.ctz.head && attr.digest.size == size)
+    {
+        lfs_file_close(lfs, &file);
+        RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+        *digest = attr.digest;
+        return 1;
+    }
+    attr.head = file.ctz.head;
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    /* The open file keeps reading the version it opened (its blocks are
+       not reused while it is open). */
+    ret = compute(lfs, &file, digest);
+    lfs_file_close(lfs, &file);
+    if (ret < 0 || inline_file || digest->size != size)
+    {
+        return ret;
+    }
+
+    /* Cached only if the file is still the version hashed. */
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    ret = lfs_file_open(lfs, &file, path, LFS_O_RDONLY);
+    if (ret >= 0)
+    {
+        if (!(file.flags & LFS_F_INLINE) && file.ctz.head == attr.head &&
+            (uint32_t)lfs_file_size(lfs, &file) == size)
+        {
+            attr.digest = *digest;
+            if (lfs_setattr(lfs, path, LFS_PARTDIGEST_ATTR, &attr,
+                sizeof(attr)) < 0)
+            {
+                LOGPRINT_WARN("Cannot cache the digest of %s.", path);
+            }
+        }
+        lfs_file_close(lfs, &file);
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDigest_walk]
+*//**
+    @brief Walks the files of a directory tree, depth first in directory
+    order, and calls fn with up to max of them from file index start.
+    Directories deeper than LFS_PARTDIGEST_DEPTH and paths longer than
+    LFS_PARTDIGEST_PATH_MAX are skipped. The paths of the page are copied
+    out under the partition lock and fn is called after it is released, so
+    fn may use the partition (e.g. Lfs_PartDigest_get).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] dir  Directory.
+    @param[in] start  Index of the first file to pass to fn.
+    @param[in] max  Max number of files to pass to fn.
+    @param[in] fn  Called with each file.
+    @param[in] ctx  Passed to fn.
+    @return Returns the index of the next file if the tree has more, 0 once
+    it is done, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartDigest_walk(
+    Lfs_Part_t *lpfs,
+    const char *dir,
+    uint32_t start,
+    uint32_t max,
+    Lfs_PartDigest_WalkFn fn,
+    void *ctx)
+{
+    lfs_t *lfs = &lpfs->lfs;
+    uint32_t index = 0, count = 0, len, name_len, i;
+    int depth = 0, ret, err;
+    DigestWalk *w;
+
+    len = strlen(dir);
+    while (len && dir[len - 1] == '/')
+    {
+        len--;
+    }
+    CHECK_COND_RETURN_MSG(len >= LFS_PARTDIGEST_PATH_MAX,
+        LFS_ERR_NAMETOOLONG, "Walk path too long.");
+
+    w = (DigestWalk *)malloc(sizeof(DigestWalk) +
+        max * LFS_PARTDIGEST_PATH_MAX);
+    CHECK_COND_RETURN_MSG(!w, LFS_ERR_NOMEM, "No memory for the walk.");
+    w->page = (char (*)[LFS_PARTDIGEST_PATH_MAX])(w + 1);
+    memcpy(w->path, dir, len);
+    w->path[len] = '\0';
+    w->lens[0] = len;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    ret = lfs_dir_open(lfs, &w->dirs[0], len ? w->path : "/");
+    if (ret < 0)
+    {
+        RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+        free(w);
+        return ret;
+    }
+
+    while (depth >= 0)
+    {
+        ret = lfs_dir_read(lfs, &w->dirs[depth], &w->info);
+        if (ret < 0)
+        {
+            break;
+        }
+        if (ret == 0)
+        {
+            /* End of this directory: back to its parent. */
+            lfs_dir_close(lfs, &w->dirs[depth--]);
+            continue;
+        }
+        if (strcmp(w->info.name, ".") == 0 || strcmp(w->info.name, "..") == 0)
+        {
+            continue;
+        }
+
+        len = w->lens[depth];
+        name_len = strlen(w->info.name);
+        if (len + 1 + name_len >= LFS_PARTDIGEST_PATH_MAX)
+        {
+            LOGPRINT_WARN("Skipping %s: path too long.", w->info.name);
+            continue;
+        }
+        w->path[len] = '/';
+        memcpy(&w->path[len + 1], w->info.name, name_len + 1);
+
+        if (w->info.type == LFS_TYPE_DIR)
+        {
+            if (depth + 1 >= LFS_PARTDIGEST_DEPTH ||
+                lfs_dir_open(lfs, &w->dirs[depth + 1], w->path) < 0)
+            {
+                LOGPRINT_WARN("Skipping directory %s.", w->path);
+                continue;
+            }
+            depth++;
+            w->lens[depth] = len + 1 + name_len;
+            continue;
+        }
+
+        if (index >= start + max)
+        {
+            /* One more file: the walk is not done. */
+            ret = (int)index;
+            break;
+        }
+        if (index++ >= start)
+        {
+            strcpy(w->page[count++], w->path);
+        }
+    }
+
+    /* Directories left open by a stop. */
+    while (depth >= 0)
+    {
+        lfs_dir_close(lfs, &w->dirs[depth--]);
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    for (i = 0; ret >= 0 && i < count; i++)
+    {
+        err = fn(ctx, w->page[i]);
+        ret = (err < 0) ? err : ret;
+    }
+    free(w);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDigest_invalidate]
+*//**
+    @brief Makes a file opened for writing with cfg drop its cached digest
+    when it is synced (a zero length attribute written with the file).
+    @param[in] cfg  File configuration (attrs unused).
+******************************************************************************/
+void
+Lfs_PartDigest_invalidate(struct lfs_file_config *cfg)
+{
+    cfg->attrs = &clear_attr;
+    cfg->attr_count = 1;
+}
@@ -0,0 +1,509 @@
+/*******************************************************************************
+ *  @file: Lfs_PartDir.c
+ *
+ *  @brief: Paged directory listing with cursors and snapshots.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartDir.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartDir";
+
+/** @brief A cursor id is the slot index in the low CURSOR_INDEX_BITS and
+    the slot generation above (never 0). */
+#define CURSOR_INDEX_BITS       4
+#define CURSOR_INDEX_MASK       ((1u << CURSOR_INDEX_BITS) - 1)
+#define CURSOR_GEN_MASK         0x7fff
+
+_Static_assert(LFS_PARTDIR_CURSORS <= (1u << CURSOR_INDEX_BITS),
+    "LFS_PARTDIR_CURSORS exceeds the cursor index bits.");
+
+/** @brief Snapshot record: type (1), size (4), NUL terminated name. */
+#define SNAP_REC_HDR            5
+/** @brief First allocation of a snapshot being built. */
+#define SNAP_MIN_ALLOC          256
+
+/** @brief Listing in progress, with its directory open. */
+typedef struct DirCursor
+{
+    uint32_t id;
+    uint16_t gen;
+    bool used;
+    Lfs_Part_t *lpfs;
+    char path[LFS_PARTDIR_PATH_MAX];
+    lfs_dir_t dir;
+    /** @brief Index of the entry lfs_dir_read returns next. */
+    uint32_t pos;
+    /** @brief Last use (LRU reclaim). */
+    uint32_t stamp;
+
+} DirCursor;
+
+/** @brief Copy of a whole directory listing. */
+typedef struct DirSnapshot
+{
+    Lfs_Part_t *lpfs;
+    char path[LFS_PARTDIR_PATH_MAX];
+    /** @brief Partition write_gen the listing was read at. */
+    uint32_t write_gen;
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t size;
+    uint32_t num;
+    /** @brief Entry index and offset after the last page served, so
+        sequential pages do not walk the records from the start. */
+    uint32_t next_idx;
+    uint32_t next_off;
+    uint32_t stamp;
+
+} DirSnapshot;
+
+static DirCursor cursors[LFS_PARTDIR_CURSORS];
+static DirSnapshot snapshots[LFS_PARTDIR_SNAPSHOTS];
+static uint32_t snapshot_size = LFS_PARTDIR_SNAPSHOT_SIZE;
+static uint32_t use_stamp;
+
+/******************************************************************************
+    cursor_close
+*//**
+    @brief Closes a cursor; its id becomes stale.
+******************************************************************************/
+static void
+cursor_close(DirCursor *c)
+{
+    if (!c->used)
+    {
+        return;
+    }
+    lfs_dir_close(&c->lpfs->lfs, &c->dir);
+    c->used = false;
+    c->gen = (c->gen + 1) & CURSOR_GEN_MASK;
+}
+
+/******************************************************************************
+    cursor_find
+*//**
+    @brief Finds the open cursor of a listing.
+    Returns the cursor, NULL if id is not open for lpfs and path.
+******************************************************************************/
+static DirCursor *
+cursor_find(uint32_t id, Lfs_Part_t *lpfs, const char *path)
+{
+    uint32_t idx = id & CURSOR_INDEX_MASK;
+    DirCursor *c;
+
+    if (idx >= LFS_PARTDIR_CURSORS)
+    {
+        return NULL;
+    }
+    c = &cursors[idx];
+    if (!c->used || c->id != id || c->lpfs != lpfs ||
+        strcmp(c->path, path) != 0)
+    {
+        LOGPRINT_DEBUG("Cursor %u is gone, restarting %s.", (unsigned int)id,
+            path);
+        return NULL;
+    }
+    return c;
+}
+
+/******************************************************************************
+    cursor_open
+*//**
+    @brief Opens a directory in a free cursor, reclaiming the least recently
+    used one if all are open.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+static int
+cursor_open(Lfs_Part_t *lpfs, const char *path, DirCursor **out)
+{
+    DirCursor *c = NULL;
+    uint32_t i;
+    int ret;
+
+    for (i = 0; i < LFS_PARTDIR_CURSORS; i++)
+    {
+        if (!cursors[i].used)
+        {
+            c = &cursors[i];
+            break;
+        }
+        if (!c || (int32_t)(cursors[i].stamp - c->stamp) < 0)
+        {
+            c = &cursors[i];
+        }
+    }
+    cursor_close(c);
+
+    ret = lfs_dir_open(&lpfs->lfs, &c->dir, path);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    if (c->gen == 0)
+    {
+        c->gen = 1;
+    }
+    c->id = ((uint32_t)c->gen << CURSOR_INDEX_BITS) | (uint32_t)(c - cursors);
+    c->used = true;
+    c->lpfs = lpfs;
+    strcpy(c->path, path);
+    c->pos = 0;
+    c->stamp = use_stamp;
+
+    *out = c;
+    return 0;
+}
+
+/******************************************************************************
+    snapshot_drop
+*//**
+    @brief Frees a snapshot.
+******************************************************************************/
+static void
+snapshot_drop(DirSnapshot *s)
+{
+    free(s->buf);
+    memset(s, 0, sizeof(*s));
+}
+
+/******************************************************************************
+    snapshot_find
+*//**
+    @brief Finds the current snapshot of a directory (a stale one is
+    dropped).
+    Returns the snapshot, NULL if there is none.
+******************************************************************************/
+static DirSnapshot *
+snapshot_find(Lfs_Part_t *lpfs, const char *path)
+{
+    DirSnapshot *s;
+
+    for (s = snapshots; s < snapshots + LFS_PARTDIR_SNAPSHOTS; s++)
+    {
+        if (s->buf && s->lpfs == lpfs && strcmp(s->path, path) == 0)
+        {
+            if (s->write_gen != lpfs->write_gen)
+            {
+                snapshot_drop(s);
+                return NULL;
+            }
+            return s;
+        }
+    }
+    return NULL;
+}
+
+/******************************************************************************
+    snapshot_append
+*//**
+    @brief Appends an entry to a snapshot being built.
+    @return Returns false if it does not fit the budget (the snapshot is
+    dropped).
+******************************************************************************/
+static bool
+snapshot_append(DirSnapshot *s, const struct lfs_info *info)
+{
+    uint32_t name_len = strlen(info->name) + 1;
+    uint32_t need = s->len + SNAP_REC_HDR + name_len;
+    uint32_t size = s->size;
+    uint32_t file_size = info->size;
+    uint8_t *buf;
+
+    if (need > size)
+    {
+        while (size < need)
+        {
+            size = size ? 2*size : SNAP_MIN_ALLOC;
+        }
+        if (size > snapshot_size)
+        {
+            size = snapshot_size;
+        }
+        buf = (need <= size) ? (uint8_t *)realloc(s->buf, size) : NULL;
+        if (!buf)
+        {
+            snapshot_drop(s);
+            return false;
+        }
+        s->buf = buf;
+        s->size = size;
+    }
+
+    s->buf[s->len] = info->type;
+    memcpy(&s->buf[s->len + 1], &file_size, sizeof(file_size));
+    memcpy(&s->buf[s->len + SNAP_REC_HDR], info->name, name_len);
+    s->len = need;
+    s->num++;
+    return true;
+}
+
+/******************************************************************************
+    snapshot_store
+*//**
+    @brief Keeps a complete snapshot, replacing the one of the same
+    directory or the least recently used.
+******************************************************************************/
+static void
+snapshot_store(DirSnapshot *build)
+{
+    DirSnapshot *s = NULL;
+    DirSnapshot *it;
+    uint8_t *buf;
+
+    for (it = snapshots; it < snapshots + LFS_PARTDIR_SNAPSHOTS; it++)
+    {
+        if (it->buf && it->lpfs == build->lpfs &&
+            strcmp(it->path, build->path) == 0)
+        {
+            s = it;
+            break;
+        }
+        if (!s || (s->buf && (!it->buf ||
+            (int32_t)(it->stamp - s->stamp) < 0)))
+        {
+            s = it;
+        }
+    }
+    snapshot_drop(s);
+
+    /* Give back the unused part of the last doubling. */
+    buf = (uint8_t *)realloc(build->buf, build->len);
+    if (buf)
+    {
+        build->buf = buf;
+        build->size = build->len;
+    }
+    *s = *build;
+    LOGPRINT_DEBUG("Snapshot of %s: %u entries, %u bytes.", s->path,
+        (unsigned int)s->num, (unsigned int)s->len);
+}
+
+/******************************************************************************
+    snapshot_serve
+*//**
+    @brief Lists a page from a snapshot.
+******************************************************************************/
+static void
+snapshot_serve(
+    DirSnapshot *s,
+    uint32_t start_idx,
+    uint32_t max,
+    Lfs_PartDir_entryCb *cb,
+    void *ctx,
+    Lfs_PartDir_Page *page)
+{
+    uint32_t idx = 0;
+    uint32_t off = 0;
+    uint32_t file_size;
+
+    if (start_idx >= s->next_idx)
+    {
+        idx = s->next_idx;
+        off = s->next_off;
+    }
+
+    while (idx < s->num && page->count < max)
+    {
+        if (idx >= start_idx)
+        {
+            memcpy(&file_size, &s->buf[off + 1], sizeof(file_size));
+            cb(ctx, idx, s->buf[off], file_size,
+                (const char *)&s->buf[off + SNAP_REC_HDR]);
+            page->count++;
+        }
+        off += SNAP_REC_HDR + strlen((const char *)&s->buf[off + SNAP_REC_HDR])
+            + 1;
+        idx++;
+    }
+
+    s->next_idx = idx;
+    s->next_off = off;
+    s->stamp = use_stamp;
+    page->num_entries = s->num;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDir_list]
+*//**
+    @brief Lists up to max entries of a directory, from entry start_idx.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  Directory.
+    @param[in] start_idx  Index of the first entry to list.
+    @param[in] cursor  Cursor from the previous page of this listing, 0 to
+    start one. An unknown or reclaimed cursor starts a new listing at
+    start_idx.
+    @param[in] max  Max entries to list.
+    @param[in] cb  Entry callback.
+    @param[in] ctx  Callback context.
+    @param[out] page  Pointer to page summary to fill.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartDir_list(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t start_idx,
+    uint32_t cursor,
+    uint32_t max,
+    Lfs_PartDir_entryCb *cb,
+    void *ctx,
+    Lfs_PartDir_Page *page)
+{
+    lfs_t *lfs = &lpfs->lfs;
+    DirSnapshot build;
+    DirSnapshot *snap;
+    DirCursor *c = NULL;
+    struct lfs_info info;
+    bool building = false;
+    uint32_t idx;
+    int ret;
+
+    memset(page, 0, sizeof(*page));
+    CHECK_COND_RETURN_MSG(strlen(path) >= LFS_PARTDIR_PATH_MAX,
+        LFS_ERR_NAMETOOLONG, "Listing path too long.");
+
+    use_stamp++;
+    if (cursor)
+    {
+        c = cursor_find(cursor, lpfs, path);
+    }
+
+    if (!c)
+    {
+        snap = snapshot_find(lpfs, path);
+        if (snap)
+        {
+            snapshot_serve(snap, start_idx, max, cb, ctx, page);
+            return 0;
+        }
+
+        ret = cursor_open(lpfs, path, &c);
+        if (ret < 0)
+        {
+            return ret;
+        }
+
+        /* A new listing reads the whole directory into a snapshot. The
+            generation is taken first, so a write meanwhile makes it stale. */
+        if (snapshot_size)
+        {
+            memset(&build, 0, sizeof(build));
+            build.lpfs = lpfs;
+            strcpy(build.path, path);
+            build.write_gen = lpfs->write_gen;
+            build.stamp = use_stamp;
+            building = true;
+        }
+    }
+    c->stamp = use_stamp;
+
+    if (!building && c->pos != start_idx)
+    {
+        ret = lfs_dir_seek(lfs, &c->dir, start_idx);
+        if (ret < 0)
+        {
+            cursor_close(c);
+            return ret;
+        }
+        c->pos = start_idx;
+    }
+
+    idx = c->pos;
+    while (building || page->count < max)
+    {
+        ret = lfs_dir_read(lfs, &c->dir, &info);
+        if (ret <= 0)
+        {
+            break;
+        }
+        if (building && !snapshot_append(&build, &info))
+        {
+            LOGPRINT_DEBUG("%s does not fit a snapshot.", path);
+            building = false;
+        }
+        if (idx >= start_idx && page->count < max)
+        {
+            cb(ctx, idx, info.type, info.size, info.name);
+            page->count++;
+        }
+        c->pos = ++idx;
+    }
+
+    if (ret < 0)
+    {
+        if (building)
+        {
+            snapshot_drop(&build);
+        }
+        cursor_close(c);
+        return ret;
+    }
+
+    if (ret == 0)
+    {
+        /* End of directory. */
+        page->num_entries = idx;
+        cursor_close(c);
+        if (building)
+        {
+            snapshot_store(&build);
+        }
+        return 0;
+    }
+
+    page->num_entries = idx + 1;
+    page->cursor = c->id;
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDir_setSnapshotSize]
+*//**
+    @brief Sets the RAM budget of one snapshot (0 disables snapshots). Kept
+    snapshots are dropped.
+    @param[in] size  Bytes.
+******************************************************************************/
+void
+Lfs_PartDir_setSnapshotSize(uint32_t size)
+{
+    uint32_t i;
+
+    for (i = 0; i < LFS_PARTDIR_SNAPSHOTS; i++)
+    {
+        snapshot_drop(&snapshots[i]);
+    }
+    snapshot_size = size;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartDir_release]
+*//**
+    @brief Closes the cursors and drops the snapshots of a partition (before
+    it is unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartDir_release(Lfs_Part_t *lpfs)
+{
+    uint32_t i;
+
+    for (i = 0; i < LFS_PARTDIR_CURSORS; i++)
+    {
+        if (cursors[i].used && cursors[i].lpfs == lpfs)
+        {
+            cursor_close(&cursors[i]);
+        }
+    }
+    for (i = 0; i < LFS_PARTDIR_SNAPSHOTS; i++)
+    {
+        if (snapshots[i].lpfs == lpfs)
+        {
+            snapshot_drop(&snapshots[i]);
+        }
+    }
+}
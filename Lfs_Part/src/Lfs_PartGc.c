@@ -0,0 +1,406 @@
+/*******************************************************************************
+ *  @file: Lfs_PartGc.c
+ *
+ *  @brief: Background maintenance of an Lfs_Part filesystem (metadata
+ *  and key/value log compaction, and a pool of pre-erased blocks).
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartGc.h"
+#include "Lfs_PartKv.h"
+#include "Lfs_PartRing.h"
+#include "SwTimer.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartGc";
+
+#define BIT_GET(map, n)     ((map)[(n)/8] & (1u << ((n)%8)))
+#define BIT_SET(map, n)     ((map)[(n)/8] |= (1u << ((n)%8)))
+#define BIT_CLR(map, n)     ((map)[(n)/8] &= ~(1u << ((n)%8)))
+
+/******************************************************************************
+    [docimport Lfs_PartGc_onErase]
+*//**
+    @brief littlefs erase hook (filesystem locked).
+    @param[in] gc  Pointer to Lfs_PartGc.
+    @param[in] block  Block littlefs erases.
+    @return Returns true if the block is pooled, i.e. already erased.
+******************************************************************************/
+bool
+Lfs_PartGc_onErase(Lfs_PartGc *gc, uint32_t block)
+{
+    if (!gc->erased || block >= gc->block_count)
+    {
+        return false;
+    }
+
+    gc->erase_gen++;
+    if (BIT_GET(gc->erased, block))
+    {
+        BIT_CLR(gc->erased, block);
+        gc->stats.hits++;
+        return true;
+    }
+    gc->stats.misses++;
+    return false;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartGc_onProg]
+*//**
+    @brief littlefs program hook (filesystem locked): drops the block from
+    the pool.
+    @param[in] gc  Pointer to Lfs_PartGc.
+    @param[in] block  Block littlefs programs.
+******************************************************************************/
+void
+Lfs_PartGc_onProg(Lfs_PartGc *gc, uint32_t block)
+{
+    if (gc->erased && block < gc->block_count)
+    {
+        BIT_CLR(gc->erased, block);
+    }
+}
+
+/******************************************************************************
+    [docimport Lfs_PartGc_onLock]
+*//**
+    @brief Filesystem lock hook: records foreground activity.
+    @param[in] gc  Pointer to Lfs_PartGc.
+******************************************************************************/
+void
+Lfs_PartGc_onLock(Lfs_PartGc *gc)
+{
+    if (gc->erased && (!gc->task || RTOS_TASK_SELF() != gc->task))
+    {
+        gc->fg_us = SwTimer_getCount();
+    }
+}
+
+/******************************************************************************
+    fg_active
+*//**
+    @brief Returns true if another task used the filesystem within idle_ms.
+    Without a task (Lfs_PartGc_step called by the application) the caller
+    is the foreground, so this is always false.
+******************************************************************************/
+static bool
+fg_active(Lfs_PartGc *gc)
+{
+    return gc->task &&
+        (SwTimer_getCount() - gc->fg_us < (uint64_t)gc->config.idle_ms*1000);
+}
+
+/******************************************************************************
+    mark_used
+*//**
+    @brief lfs_fs_traverse callback.
+******************************************************************************/
+static int
+mark_used(void *p, lfs_block_t block)
+{
+    Lfs_PartGc *gc = (Lfs_PartGc *)p;
+
+    if (block < gc->block_count)
+    {
+        BIT_SET(gc->used, block);
+    }
+    return 0;
+}
+
+/******************************************************************************
+    pre_erase
+*//**
+    @brief Erases a free block into the pool (filesystem locked).
+******************************************************************************/
+static int
+pre_erase(Lfs_Part_t *lpfs, uint32_t block)
+{
+    uint32_t block_size = lpfs->cfg.block_size;
+    int err;
+
+    if (lpfs->prog_len && lpfs->prog_addr/block_size == block)
+    {
+        lpfs->prog_len = 0;
+    }
+    if (lpfs->bcache.num_lines)
+    {
+        Lfs_PartCache_invalidate(&lpfs->bcache, block*block_size, block_size);
+    }
+    err = Lfs_PartDev_eraseBlock(lpfs->dev, block);
+    if (err)
+    {
+        LOGPRINT_ERROR("Failed to pre-erase block %u, err %d",
+            (unsigned int)block, err);
+        return LFS_ERR_IO;
+    }
+    BIT_SET(lpfs->gc.erased, block);
+    lpfs->gc.stats.pre_erases++;
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartGc_step]
+*//**
+    @brief Runs one maintenance pass: lfs_fs_gc and key/value log
+    compaction (if configured), circular log flushes (Lfs_PartRing), then
+    tops up the pre-erased pool within the erase budget.
+    @param[in] lpfs  Pointer to an Lfs_Part_t with maintenance started.
+    @return Returns the number of blocks erased, negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartGc_step(Lfs_Part_t *lpfs)
+{
+    Lfs_PartGc *gc = &lpfs->gc;
+    uint32_t gen, cursor, block, have = 0, erases = 0;
+    uint32_t i;
+    int err;
+
+    if (!gc->erased)
+    {
+        return 0;
+    }
+    gc->stats.passes++;
+
+    if (gc->config.compact)
+    {
+        err = lfs_fs_gc(&lpfs->lfs);
+        if (err < 0)
+        {
+            return err;
+        }
+        /* One key/value log per pass, when the foreground is idle. */
+        if (lpfs->kv && !fg_active(gc))
+        {
+            err = Lfs_PartKv_compactStep(lpfs);
+            if (err < 0)
+            {
+                return err;
+            }
+        }
+    }
+    if (lpfs->ring)
+    {
+        err = Lfs_PartRing_flushStep(lpfs);
+        if (err < 0)
+        {
+            return err;
+        }
+    }
+
+    /* The allocator hands out free blocks from its lookahead cursor on, so
+        the pool is the next pool_blocks free blocks after it. */
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    gen = gc->erase_gen;
+    cursor = (lpfs->lfs.lookahead.start + lpfs->lfs.lookahead.next) %
+        gc->block_count;
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    memset(gc->used, 0, (gc->block_count + 7)/8);
+    err = lfs_fs_traverse(&lpfs->lfs, mark_used, gc);
+    if (err < 0)
+    {
+        return err;
+    }
+
+    for (i = 0; i < gc->block_count && have < gc->config.pool_blocks; i++)
+    {
+        block = (cursor + i) % gc->block_count;
+        if (BIT_GET(gc->used, block))
+        {
+            continue;
+        }
+        if (BIT_GET(gc->erased, block))
+        {
+            have++;
+            continue;
+        }
+        if (erases >= gc->config.erase_budget)
+        {
+            break;
+        }
+        if (fg_active(gc))
+        {
+            gc->stats.paused++;
+            break;
+        }
+
+        /* Any erase since the traverse may have put a free block in use. */
+        RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+        if (gc->erase_gen != gen)
+        {
+            RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+            gc->stats.rescans++;
+            break;
+        }
+        err = pre_erase(lpfs, block);
+        RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+        if (err)
+        {
+            return err;
+        }
+        erases++;
+        have++;
+    }
+
+    gc->stats.pool = have;
+    return erases;
+}
+
+/******************************************************************************
+    gc_task
+*//**
+    @brief Maintenance task: one pass per period while the filesystem is
+    idle.
+******************************************************************************/
+static void
+gc_task(void *p)
+{
+    Lfs_Part_t *lpfs = (Lfs_Part_t *)p;
+    Lfs_PartGc *gc = &lpfs->gc;
+    int ret;
+
+    while (gc->run)
+    {
+        RTOS_TASK_SLEEP_ms(gc->config.period_ms);
+        if (!gc->run)
+        {
+            break;
+        }
+        if (fg_active(gc))
+        {
+            gc->stats.paused++;
+            continue;
+        }
+
+        ret = Lfs_PartGc_step(lpfs);
+        if (ret < 0)
+        {
+            LOGPRINT_ERROR("Maintenance pass on %s failed (%d).",
+                lpfs->dev->label, ret);
+        }
+    }
+
+    gc->task = NULL;
+    RTOS_TASK_DELETE(NULL);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartGc_getStats]
+*//**
+    @brief Gets the maintenance counters.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_PartGc_getStats(Lfs_Part_t *lpfs, Lfs_PartGc_Stats *stats, bool clear)
+{
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    *stats = lpfs->gc.stats;
+    if (clear)
+    {
+        memset(&lpfs->gc.stats, 0, sizeof(lpfs->gc.stats));
+        lpfs->gc.stats.pool = stats->pool;
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartGc_stop]
+*//**
+    @brief Stops maintenance (waits for the task to exit) and drops the
+    pool.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartGc_stop(Lfs_Part_t *lpfs)
+{
+    Lfs_PartGc *gc = &lpfs->gc;
+    uint8_t *erased, *used;
+
+    gc->run = false;
+    while (gc->task)
+    {
+        RTOS_TASK_SLEEP_ms(10);
+    }
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    erased = gc->erased;
+    used = gc->used;
+    gc->erased = NULL;
+    gc->used = NULL;
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    free(erased);
+    free(used);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartGc_start]
+*//**
+    @brief Starts background maintenance on a mounted Lfs_Part (restarts it
+    with the new configuration if running).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] config  Configuration, NULL for LFS_PARTGC_CONFIG_DEFAULT.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartGc_start(Lfs_Part_t *lpfs, const Lfs_PartGc_Config *config)
+{
+    static const Lfs_PartGc_Config defaults = LFS_PARTGC_CONFIG_DEFAULT;
+    Lfs_PartGc *gc = &lpfs->gc;
+    uint32_t block_count = lpfs->cfg.block_count;
+    uint8_t *erased, *used;
+    int ret;
+
+    Lfs_PartGc_stop(lpfs);
+
+    erased = (uint8_t *)calloc((block_count + 7)/8, 1);
+    used = (uint8_t *)calloc((block_count + 7)/8, 1);
+    if (!erased || !used)
+    {
+        free(erased);
+        free(used);
+        LOGPRINT_ERROR("Error allocating maintenance bitmaps.");
+        return -1;
+    }
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    gc->config = config ? *config : defaults;
+    gc->block_count = block_count;
+    gc->used = used;
+    gc->fg_us = SwTimer_getCount();
+    memset(&gc->stats, 0, sizeof(gc->stats));
+    gc->erased = erased;
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    if (gc->config.period_ms)
+    {
+        gc->run = true;
+        ret = RTOS_TASK_CREATE(
+            gc_task,
+            "Lfs_PartGc",
+            LFS_PARTGC_TASK_STACK,
+            lpfs,
+            LFS_PARTGC_TASK_PRIO,
+            &gc->task);
+        if (ret < 0)
+        {
+            gc->run = false;
+            Lfs_PartGc_stop(lpfs);
+            return -1;
+        }
+    }
+
+    LOGPRINT_INFO("Maintenance on %s: pool %u blocks, %u erases per %u ms.",
+        lpfs->dev->label,
+        (unsigned int)gc->config.pool_blocks,
+        (unsigned int)gc->config.erase_budget,
+        (unsigned int)gc->config.period_ms);
+    return 0;
+}
@@ -0,0 +1,1018 @@
+/*******************************************************************************
+ *  @file: Lfs_PartKv.c
+ *
+ *  @brief: Log-structured key/value store on an Lfs_Part filesystem.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartKv.h"
+#include "Lfs_PartXfer.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartKv";
+
+/** @brief Log file header ("KVL1"). */
+#define KV_MAGIC                0x314c564b
+#define KV_HDR_SIZE             sizeof(uint32_t)
+
+/** @brief Record types. */
+#define KV_REC_SET              1
+#define KV_REC_DEL              2
+
+/** @brief Index entry states. */
+#define KV_EMPTY                0
+#define KV_USED                 1
+#define KV_DELETED              2
+
+/******************************************************************************
+    key_hash
+*//**
+    @brief FNV-1a hash of a key.
+******************************************************************************/
+static uint32_t
+key_hash(const char *key, uint32_t len)
+{
+    uint32_t h = 2166136261u;
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        h = (h ^ (uint8_t)key[i])*16777619u;
+    }
+    return h;
+}
+
+/******************************************************************************
+    rec_crc
+*//**
+    @brief CRC32 of a record (after the crc field).
+******************************************************************************/
+static uint32_t
+rec_crc(const uint8_t *rec, uint32_t len)
+{
+    return Lfs_PartXfer_crc32(0, rec + sizeof(uint32_t),
+        len - sizeof(uint32_t));
+}
+
+/******************************************************************************
+    read_rec
+*//**
+    @brief Reads the record of an index entry into kv->rec (from the batch
+    if it is past the log file).
+******************************************************************************/
+static int
+read_rec(Lfs_PartKv *kv, const Lfs_PartKv_Entry *e)
+{
+    lfs_t *lfs = &kv->lpfs->lfs;
+    int ret;
+
+    if (e->offset >= kv->log_size)
+    {
+        memcpy(kv->rec, &kv->batch[e->offset - kv->log_size], e->rec_len);
+        return 0;
+    }
+    ret = lfs_file_seek(lfs, &kv->file, e->offset, LFS_SEEK_SET);
+    CHECK_COND_RETURN(ret < 0, ret);
+    ret = lfs_file_read(lfs, &kv->file, kv->rec, e->rec_len);
+    CHECK_COND_RETURN(ret < 0, ret);
+    CHECK_COND_RETURN_MSG(ret != e->rec_len, LFS_ERR_CORRUPT,
+        "Short record.");
+    return 0;
+}
+
+/******************************************************************************
+    lookup
+*//**
+    @brief Finds the index entry of a key.
+    @param[out] slot  Entry of the key, else the first free entry of its
+    probe chain.
+    @return Returns 1 if found, 0 if not, negative lfs error code otherwise.
+******************************************************************************/
+static int
+lookup(Lfs_PartKv *kv, const char *key, uint32_t key_len, uint32_t hash,
+    Lfs_PartKv_Entry **slot)
+{
+    const Lfs_PartKv_RecHdr *hdr = (const Lfs_PartKv_RecHdr *)kv->rec;
+    uint32_t mask = kv->table_size - 1;
+    Lfs_PartKv_Entry *e, *free_e = NULL;
+    uint32_t i;
+    int ret;
+
+    for (i = 0; i < kv->table_size; i++)
+    {
+        e = &kv->table[(hash + i) & mask];
+        if (e->state == KV_EMPTY)
+        {
+            break;
+        }
+        if (e->state == KV_DELETED)
+        {
+            free_e = free_e ? free_e : e;
+            continue;
+        }
+        if (e->hash != hash)
+        {
+            continue;
+        }
+        /* Same hash: the key is in the record. */
+        ret = read_rec(kv, e);
+        CHECK_COND_RETURN(ret < 0, ret);
+        if (hdr->key_len == key_len &&
+            !memcmp(&kv->rec[sizeof(*hdr)], key, key_len))
+        {
+            *slot = e;
+            return 1;
+        }
+    }
+    *slot = free_e ? free_e : (i < kv->table_size ? e : NULL);
+    return 0;
+}
+
+/******************************************************************************
+    rehash
+*//**
+    @brief Rebuilds the index without deleted entries.
+******************************************************************************/
+static int
+rehash(Lfs_PartKv *kv)
+{
+    Lfs_PartKv_Entry *old = kv->table;
+    uint32_t mask = kv->table_size - 1;
+    uint32_t i, j;
+
+    kv->table = (Lfs_PartKv_Entry *)calloc(kv->table_size,
+        sizeof(Lfs_PartKv_Entry));
+    if (!kv->table)
+    {
+        kv->table = old;
+        return LFS_ERR_NOMEM;
+    }
+    for (i = 0; i < kv->table_size; i++)
+    {
+        if (old[i].state != KV_USED)
+        {
+            continue;
+        }
+        for (j = old[i].hash & mask; kv->table[j].state != KV_EMPTY;
+            j = (j + 1) & mask)
+        {
+        }
+        kv->table[j] = old[i];
+    }
+    kv->num_deleted = 0;
+    free(old);
+    return 0;
+}
+
+/******************************************************************************
+    index_rec
+*//**
+    @brief Applies a record at offset to the index.
+    @param[in] rec  Record (header and key at least).
+******************************************************************************/
+static int
+index_rec(Lfs_PartKv *kv, const uint8_t *rec, uint32_t offset)
+{
+    Lfs_PartKv_RecHdr hdr;
+    char key[LFS_PARTKV_KEY_MAX];
+    Lfs_PartKv_Entry *e;
+    uint32_t rec_len, hash;
+    int found;
+
+    /* lookup reads records into kv->rec, which may hold this one. */
+    memcpy(&hdr, rec, sizeof(hdr));
+    memcpy(key, &rec[sizeof(hdr)], hdr.key_len);
+    rec_len = sizeof(hdr) + hdr.key_len + hdr.val_len;
+    hash = key_hash(key, hdr.key_len);
+    found = lookup(kv, key, hdr.key_len, hash, &e);
+    CHECK_COND_RETURN(found < 0, found);
+
+    if (found)
+    {
+        kv->live -= e->rec_len;
+        if (hdr.type == KV_REC_DEL)
+        {
+            e->state = KV_DELETED;
+            kv->num_keys--;
+            kv->num_deleted++;
+            return 0;
+        }
+    }
+    else
+    {
+        if (hdr.type == KV_REC_DEL)
+        {
+            return 0;
+        }
+        CHECK_COND_RETURN_MSG(!e || kv->num_keys >= kv->max_keys,
+            LFS_ERR_NOSPC, "Too many keys.");
+        if (e->state == KV_DELETED)
+        {
+            kv->num_deleted--;
+        }
+        kv->num_keys++;
+    }
+
+    e->hash = hash;
+    e->offset = offset;
+    e->rec_len = (uint16_t)rec_len;
+    e->state = KV_USED;
+    kv->live += rec_len;
+    return 0;
+}
+
+/******************************************************************************
+    log_open
+*//**
+    @brief Opens the log file (created with its header if missing).
+******************************************************************************/
+static int
+log_open(Lfs_PartKv *kv)
+{
+    lfs_t *lfs = &kv->lpfs->lfs;
+    uint32_t magic = KV_MAGIC;
+    lfs_soff_t size;
+    int ret;
+
+    memset(&kv->file_cfg, 0, sizeof(kv->file_cfg));
+    kv->file_cfg.buffer = kv->file_buf;
+    ret = lfs_file_opencfg(lfs, &kv->file, kv->path,
+        LFS_O_RDWR | LFS_O_CREAT, &kv->file_cfg);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    size = lfs_file_size(lfs, &kv->file);
+    if (size == 0)
+    {
+        ret = lfs_file_write(lfs, &kv->file, &magic, sizeof(magic));
+        if (ret >= 0)
+        {
+            ret = lfs_file_sync(lfs, &kv->file);
+        }
+        size = KV_HDR_SIZE;
+    }
+    else
+    {
+        ret = lfs_file_read(lfs, &kv->file, &magic, sizeof(magic));
+        if (ret >= 0 && (ret != sizeof(magic) || magic != KV_MAGIC))
+        {
+            LOGPRINT_ERROR("%s is not a key/value log.", kv->path);
+            ret = LFS_ERR_CORRUPT;
+        }
+    }
+    if (ret < 0)
+    {
+        lfs_file_close(lfs, &kv->file);
+        return ret;
+    }
+    kv->log_size = (uint32_t)size;
+    return 0;
+}
+
+/******************************************************************************
+    rec_len_valid
+*//**
+    @brief Checks a record header.
+    @return Returns the record length, 0 if the header is invalid.
+******************************************************************************/
+static uint32_t
+rec_len_valid(const Lfs_PartKv_RecHdr *hdr)
+{
+    if ((hdr->type != KV_REC_SET && hdr->type != KV_REC_DEL) ||
+        !hdr->key_len || hdr->key_len > LFS_PARTKV_KEY_MAX ||
+        hdr->val_len > LFS_PARTKV_VALUE_MAX)
+    {
+        return 0;
+    }
+    return sizeof(*hdr) + hdr->key_len + hdr->val_len;
+}
+
+/******************************************************************************
+    cut
+*//**
+    @brief Truncates a damaged file at off.
+******************************************************************************/
+static int
+cut(Lfs_PartKv *kv, lfs_file_t *file, uint32_t off, uint32_t size)
+{
+    lfs_t *lfs = &kv->lpfs->lfs;
+    int ret;
+
+    LOGPRINT_WARN("%s: damaged log at %u, %u bytes cut off.", kv->path,
+        (unsigned int)off, (unsigned int)(size - off));
+    ret = lfs_file_truncate(lfs, file, off);
+    if (ret >= 0)
+    {
+        ret = lfs_file_sync(lfs, file);
+    }
+    return ret;
+}
+
+/******************************************************************************
+    load_log
+*//**
+    @brief Rebuilds the index from the log file, cutting off a damaged end.
+******************************************************************************/
+static int
+load_log(Lfs_PartKv *kv)
+{
+    lfs_t *lfs = &kv->lpfs->lfs;
+    const Lfs_PartKv_RecHdr *hdr = (const Lfs_PartKv_RecHdr *)kv->rec;
+    uint32_t off = KV_HDR_SIZE;
+    uint32_t len;
+    int ret;
+
+    ret = lfs_file_seek(lfs, &kv->file, off, LFS_SEEK_SET);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    while (off < kv->log_size)
+    {
+        ret = lfs_file_read(lfs, &kv->file, kv->rec, sizeof(*hdr));
+        CHECK_COND_RETURN(ret < 0, ret);
+        len = (ret == sizeof(*hdr)) ? rec_len_valid(hdr) : 0;
+        if (!len)
+        {
+            break;
+        }
+        ret = lfs_file_read(lfs, &kv->file, &kv->rec[sizeof(*hdr)],
+            len - sizeof(*hdr));
+        CHECK_COND_RETURN(ret < 0, ret);
+        if ((uint32_t)ret != len - sizeof(*hdr) ||
+            rec_crc(kv->rec, len) != hdr->crc)
+        {
+            break;
+        }
+
+        ret = index_rec(kv, kv->rec, off);
+        CHECK_COND_RETURN(ret < 0, ret);
+        off += len;
+        /* index_rec may have read another record. */
+        ret = lfs_file_seek(lfs, &kv->file, off, LFS_SEEK_SET);
+        CHECK_COND_RETURN(ret < 0, ret);
+    }
+
+    if (off < kv->log_size)
+    {
+        ret = cut(kv, &kv->file, off, kv->log_size);
+        CHECK_COND_RETURN(ret < 0, ret);
+        kv->log_size = off;
+    }
+    return 0;
+}
+
+/******************************************************************************
+    load_tail
+*//**
+    @brief Opens the tail file and replays it into the batch. The tail file
+    starts with the log file size it follows: a tail already appended to
+    the log file (flush cut short) is dropped.
+******************************************************************************/
+static int
+load_tail(Lfs_PartKv *kv)
+{
+    lfs_t *lfs = &kv->lpfs->lfs;
+    char path[LFS_PARTKV_PATH_MAX];
+    Lfs_PartKv_RecHdr hdr;
+    uint32_t base = 0;
+    uint32_t off = 0, len;
+    lfs_soff_t size;
+    int n, ret;
+
+    strcpy(path, kv->path);
+    strcat(path, LFS_PARTKV_TAIL_SUFFIX);
+    memset(&kv->tail_cfg, 0, sizeof(kv->tail_cfg));
+    kv->tail_cfg.buffer = kv->tail_buf;
+    ret = lfs_file_opencfg(lfs, &kv->tail, path, LFS_O_RDWR | LFS_O_CREAT,
+        &kv->tail_cfg);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    size = lfs_file_size(lfs, &kv->tail);
+    n = lfs_file_read(lfs, &kv->tail, &base, sizeof(base));
+    if (n == sizeof(base) && base == kv->log_size)
+    {
+        n = lfs_file_read(lfs, &kv->tail, kv->batch, sizeof(kv->batch));
+        while (n > 0 && off + sizeof(hdr) <= (uint32_t)n)
+        {
+            memcpy(&hdr, &kv->batch[off], sizeof(hdr));
+            len = rec_len_valid(&hdr);
+            if (!len || off + len > (uint32_t)n ||
+                rec_crc(&kv->batch[off], len) != hdr.crc)
+            {
+                break;
+            }
+            ret = index_rec(kv, &kv->batch[off], kv->log_size + off);
+            CHECK_COND_GOTO(ret < 0, done);
+            off += len;
+        }
+        if (n >= 0 && size > (lfs_soff_t)(KV_HDR_SIZE + off))
+        {
+            n = cut(kv, &kv->tail, KV_HDR_SIZE + off, size);
+        }
+    }
+    else if (n >= 0 && size)
+    {
+        LOGPRINT_DEBUG("%s: tail already in the log file.", kv->path);
+        n = lfs_file_truncate(lfs, &kv->tail, 0);
+        if (n >= 0)
+        {
+            n = lfs_file_sync(lfs, &kv->tail);
+        }
+    }
+    ret = (n < 0) ? n : 0;
+    kv->tail_len = off;
+    kv->batch_len = off;
+
+done:
+    if (ret < 0)
+    {
+        lfs_file_close(lfs, &kv->tail);
+    }
+    return ret;
+}
+
+/******************************************************************************
+    commit
+*//**
+    @brief Commits the batch (store locked): to the tail file while the tail
+    fits there, else the tail and batch are appended to the log file.
+    @param[in] flush  Append to the log file whatever the size.
+******************************************************************************/
+static int
+commit(Lfs_PartKv *kv, bool flush)
+{
+    lfs_t *lfs = &kv->lpfs->lfs;
+    bool updates = (kv->batch_len != kv->tail_len);
+    int ret;
+
+    if (!updates && (!flush || !kv->tail_len))
+    {
+        return 0;
+    }
+
+    if (!flush && kv->batch_len <= kv->tail_max)
+    {
+        /* Rewritten whole: an inline file is anyway. */
+        ret = lfs_file_seek(lfs, &kv->tail, 0, LFS_SEEK_SET);
+        if (ret >= 0)
+        {
+            ret = lfs_file_write(lfs, &kv->tail, &kv->log_size,
+                sizeof(kv->log_size));
+        }
+        if (ret >= 0)
+        {
+            ret = lfs_file_write(lfs, &kv->tail, kv->batch, kv->batch_len);
+        }
+        if (ret >= 0 && lfs_file_size(lfs, &kv->tail) >
+            (lfs_soff_t)(KV_HDR_SIZE + kv->batch_len))
+        {
+            ret = lfs_file_truncate(lfs, &kv->tail,
+                KV_HDR_SIZE + kv->batch_len);
+        }
+        if (ret >= 0)
+        {
+            ret = lfs_file_sync(lfs, &kv->tail);
+        }
+        if (ret < 0)
+        {
+            LOGPRINT_ERROR("Error %d committing %s.", ret, kv->path);
+            return ret;
+        }
+        kv->tail_len = kv->batch_len;
+        kv->stats.commits++;
+        return 0;
+    }
+
+    ret = lfs_file_seek(lfs, &kv->file, kv->log_size, LFS_SEEK_SET);
+    if (ret >= 0)
+    {
+        ret = lfs_file_write(lfs, &kv->file, kv->batch, kv->batch_len);
+    }
+    if (ret >= 0)
+    {
+        ret = lfs_file_sync(lfs, &kv->file);
+    }
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Error %d committing %s.", ret, kv->path);
+        return ret;
+    }
+    kv->log_size += kv->batch_len;
+    kv->batch_len = 0;
+    kv->tail_len = 0;
+    if (updates)
+    {
+        kv->stats.commits++;
+    }
+
+    /* If this is cut short, the tail file no longer follows the log file
+       size and is dropped on open. */
+    ret = lfs_file_truncate(lfs, &kv->tail, 0);
+    if (ret >= 0)
+    {
+        ret = lfs_file_sync(lfs, &kv->tail);
+    }
+    return ret;
+}
+
+/******************************************************************************
+    compact_due
+*//**
+    @brief Checks the log size against the live records.
+******************************************************************************/
+static bool
+compact_due(const Lfs_PartKv *kv)
+{
+    uint32_t size = kv->log_size + kv->tail_len;
+
+    return size > LFS_PARTKV_COMPACT_MIN &&
+        size > LFS_PARTKV_COMPACT_RATIO*(kv->live + KV_HDR_SIZE);
+}
+
+/******************************************************************************
+    compact
+*//**
+    @brief Appends the batch to the log file, then copies the live records
+    to a new log file and renames it over the log file (store locked).
+******************************************************************************/
+static int
+compact(Lfs_PartKv *kv)
+{
+    lfs_t *lfs = &kv->lpfs->lfs;
+    char tmp[LFS_PARTKV_PATH_MAX];
+    uint32_t magic = KV_MAGIC;
+    uint32_t off = KV_HDR_SIZE;
+    lfs_file_t out;
+    uint32_t i;
+    int ret, err;
+
+    ret = commit(kv, true);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    strcpy(tmp, kv->path);
+    strcat(tmp, LFS_PARTKV_TMP_SUFFIX);
+    ret = lfs_file_open(lfs, &out, tmp,
+        LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    ret = lfs_file_write(lfs, &out, &magic, sizeof(magic));
+    for (i = 0; ret >= 0 && i < kv->table_size; i++)
+    {
+        if (kv->table[i].state != KV_USED)
+        {
+            continue;
+        }
+        ret = read_rec(kv, &kv->table[i]);
+        if (ret >= 0)
+        {
+            ret = lfs_file_write(lfs, &out, kv->rec, kv->table[i].rec_len);
+        }
+    }
+    if (ret < 0)
+    {
+        lfs_file_close(lfs, &out);
+        lfs_remove(lfs, tmp);
+        return ret;
+    }
+    ret = lfs_file_close(lfs, &out);
+    if (ret >= 0)
+    {
+        lfs_file_close(lfs, &kv->file);
+        ret = lfs_rename(lfs, tmp, kv->path);
+        if (ret < 0)
+        {
+            lfs_remove(lfs, tmp);
+        }
+    }
+    else
+    {
+        lfs_remove(lfs, tmp);
+        return ret;
+    }
+
+    /* The index follows the new log file (records in table order), or the
+       old one if the rename failed. */
+    if (ret >= 0)
+    {
+        for (i = 0; i < kv->table_size; i++)
+        {
+            if (kv->table[i].state == KV_USED)
+            {
+                kv->table[i].offset = off;
+                off += kv->table[i].rec_len;
+            }
+        }
+        rehash(kv);
+        kv->stats.compactions++;
+        LOGPRINT_DEBUG("Compacted %s to %u bytes.", kv->path,
+            (unsigned int)off);
+    }
+    err = log_open(kv);
+    CHECK_COND_RETURN_MSG(err < 0, err, "Error reopening the log.");
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_open]
+*//**
+    @brief Opens (or creates) a store and rebuilds its index from the log.
+    A damaged end of the log (after the last good record) is cut off.
+    @param[in] kv  Store.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  Log file.
+    @param[in] max_keys  Max number of keys.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_open(
+    Lfs_PartKv *kv,
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t max_keys)
+{
+    uint32_t cache_size = lpfs->lfs.cfg->cache_size;
+    char tmp[LFS_PARTKV_PATH_MAX];
+    int ret;
+
+    CHECK_COND_RETURN(!max_keys, LFS_ERR_INVAL);
+    CHECK_COND_RETURN_MSG(strlen(path) + sizeof(LFS_PARTKV_TMP_SUFFIX) >
+        LFS_PARTKV_PATH_MAX, LFS_ERR_NAMETOOLONG, "Store path too long.");
+
+    memset(kv, 0, sizeof(*kv));
+    kv->lpfs = lpfs;
+    strcpy(kv->path, path);
+    kv->max_keys = max_keys;
+    for (kv->table_size = 8; kv->table_size < 2*max_keys;
+        kv->table_size *= 2)
+    {
+    }
+    kv->table = (Lfs_PartKv_Entry *)calloc(kv->table_size,
+        sizeof(Lfs_PartKv_Entry));
+    kv->file_buf = (uint8_t *)malloc(cache_size);
+    kv->tail_buf = (uint8_t *)malloc(cache_size);
+    if (!kv->table || !kv->file_buf || !kv->tail_buf)
+    {
+        ret = LFS_ERR_NOMEM;
+        goto fail;
+    }
+
+    /* The tail file (size word and tail) must stay inline, and leave
+       room in the batch for updates. */
+    kv->tail_max = lpfs->lfs.inline_max;
+    kv->tail_max = (kv->tail_max > KV_HDR_SIZE) ?
+        kv->tail_max - KV_HDR_SIZE : 0;
+    if (kv->tail_max > sizeof(kv->batch)/2)
+    {
+        kv->tail_max = sizeof(kv->batch)/2;
+    }
+
+    /* A compaction cut short before its rename left the old log intact. */
+    strcpy(tmp, path);
+    strcat(tmp, LFS_PARTKV_TMP_SUFFIX);
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    ret = lfs_remove(&lpfs->lfs, tmp);
+    ret = (ret == LFS_ERR_NOENT) ? 0 : ret;
+    if (ret >= 0)
+    {
+        ret = log_open(kv);
+    }
+    if (ret >= 0)
+    {
+        ret = load_log(kv);
+        if (ret >= 0)
+        {
+            ret = load_tail(kv);
+        }
+
+        if (ret < 0)
+        {
+            lfs_file_close(&lpfs->lfs, &kv->file);
+        }
+    }
+    if (ret >= 0)
+    {
+        kv->next = lpfs->kv;
+        lpfs->kv = kv;
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+    CHECK_COND_GOTO(ret < 0, fail);
+
+    LOGPRINT_DEBUG("Store %s: %u keys, log %u bytes (%u live).", path,
+        (unsigned int)kv->num_keys,
+        (unsigned int)(kv->log_size + kv->tail_len),
+        (unsigned int)kv->live);
+    return 0;
+
+fail:
+    LOGPRINT_ERROR("Error %d opening store %s.", ret, path);
+    free(kv->table);
+    free(kv->file_buf);
+    free(kv->tail_buf);
+    kv->table = NULL;
+    kv->file_buf = NULL;
+    kv->tail_buf = NULL;
+    return ret;
+}
+
+/******************************************************************************
+    append
+*//**
+    @brief Adds a record to the batch and indexes it.
+******************************************************************************/
+static int
+append(Lfs_PartKv *kv, uint8_t type, const char *key, const void *value,
+    uint32_t len)
+{
+    Lfs_PartKv_RecHdr hdr;
+    uint32_t key_len = strlen(key);
+    uint32_t rec_len = sizeof(hdr) + key_len + len;
+    uint8_t *rec;
+    int ret;
+
+    CHECK_COND_RETURN(!key_len || key_len > LFS_PARTKV_KEY_MAX ||
+        len > LFS_PARTKV_VALUE_MAX, LFS_ERR_INVAL);
+
+    if (kv->batch_len + rec_len > sizeof(kv->batch))
+    {
+        ret = commit(kv, true);
+        CHECK_COND_RETURN(ret < 0, ret);
+    }
+
+    rec = &kv->batch[kv->batch_len];
+    hdr.type = type;
+    hdr.key_len = (uint8_t)key_len;
+    hdr.val_len = (uint16_t)len;
+    memcpy(rec, &hdr, sizeof(hdr));
+    memcpy(&rec[sizeof(hdr)], key, key_len);
+    if (len)
+    {
+        memcpy(&rec[sizeof(hdr) + key_len], value, len);
+    }
+    hdr.crc = rec_crc(rec, rec_len);
+    memcpy(rec, &hdr, sizeof(hdr.crc));
+
+    ret = index_rec(kv, rec, kv->log_size + kv->batch_len);
+    CHECK_COND_RETURN(ret < 0, ret);
+    kv->batch_len += rec_len;
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_set]
+*//**
+    @brief Sets a key (durable after the next commit).
+    @param[in] kv  Store.
+    @param[in] key  Key (1 to LFS_PARTKV_KEY_MAX characters).
+    @param[in] value  Value.
+    @param[in] len  Value length (up to LFS_PARTKV_VALUE_MAX).
+    @return Returns 0 on success, LFS_ERR_NOSPC if max_keys are in use,
+    other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_set(Lfs_PartKv *kv, const char *key, const void *value,
+    uint32_t len)
+{
+    int ret;
+
+    RTOS_MUTEX_GET_RECURSIVE(kv->lpfs->lock);
+    ret = append(kv, KV_REC_SET, key, value, len);
+    if (ret >= 0)
+    {
+        kv->stats.sets++;
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(kv->lpfs->lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_get]
+*//**
+    @brief Gets a key.
+    @param[in] kv  Store.
+    @param[in] key  Key.
+    @param[out] buf  Value (truncated to size).
+    @param[in] size  Size of buf.
+    @return Returns the value length, LFS_ERR_NOENT if the key is not set,
+    other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_get(Lfs_PartKv *kv, const char *key, void *buf, uint32_t size)
+{
+    const Lfs_PartKv_RecHdr *hdr = (const Lfs_PartKv_RecHdr *)kv->rec;
+    uint32_t key_len = strlen(key);
+    Lfs_PartKv_Entry *e;
+    int ret;
+
+    CHECK_COND_RETURN(!key_len || key_len > LFS_PARTKV_KEY_MAX,
+        LFS_ERR_INVAL);
+
+    RTOS_MUTEX_GET_RECURSIVE(kv->lpfs->lock);
+    kv->stats.gets++;
+    ret = lookup(kv, key, key_len, key_hash(key, key_len), &e);
+    if (ret == 0)
+    {
+        ret = LFS_ERR_NOENT;
+    }
+    else if (ret > 0)
+    {
+        /* lookup left the record in kv->rec. */
+        memcpy(buf, &kv->rec[sizeof(*hdr) + key_len],
+            hdr->val_len < size ? hdr->val_len : size);
+        ret = hdr->val_len;
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(kv->lpfs->lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_del]
+*//**
+    @brief Deletes a key (durable after the next commit).
+    @param[in] kv  Store.
+    @param[in] key  Key.
+    @return Returns 0 on success, LFS_ERR_NOENT if the key is not set, other
+    negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_del(Lfs_PartKv *kv, const char *key)
+{
+    uint32_t key_len = strlen(key);
+    Lfs_PartKv_Entry *e;
+    int ret;
+
+    CHECK_COND_RETURN(!key_len || key_len > LFS_PARTKV_KEY_MAX,
+        LFS_ERR_INVAL);
+
+    RTOS_MUTEX_GET_RECURSIVE(kv->lpfs->lock);
+    ret = lookup(kv, key, key_len, key_hash(key, key_len), &e);
+    if (ret == 0)
+    {
+        ret = LFS_ERR_NOENT;
+    }
+    else if (ret > 0)
+    {
+        ret = append(kv, KV_REC_DEL, key, NULL, 0);
+        if (ret >= 0)
+        {
+            kv->stats.dels++;
+        }
+        /* Keep probe chains short. */
+        if (ret >= 0 && (kv->num_keys + kv->num_deleted)*4 >
+            kv->table_size*3)
+        {
+            ret = rehash(kv);
+        }
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(kv->lpfs->lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_commit]
+*//**
+    @brief Commits the batch (atomic), then compacts the log if due and
+    no Lfs_PartGc task compacts it (config.compact).
+    @param[in] kv  Store.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_commit(Lfs_PartKv *kv)
+{
+    int ret;
+
+    RTOS_MUTEX_GET_RECURSIVE(kv->lpfs->lock);
+    ret = commit(kv, false);
+    if (ret >= 0 &&
+        !(kv->lpfs->gc.task && kv->lpfs->gc.config.compact) &&
+        compact_due(kv))
+    {
+        ret = compact(kv);
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(kv->lpfs->lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_compact]
+*//**
+    @brief Commits, then rewrites the log with the live records only.
+    @param[in] kv  Store.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_compact(Lfs_PartKv *kv)
+{
+    int ret;
+
+    RTOS_MUTEX_GET_RECURSIVE(kv->lpfs->lock);
+    ret = compact(kv);
+    RTOS_MUTEX_PUT_RECURSIVE(kv->lpfs->lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_compactStep]
+*//**
+    @brief Compacts the first store of a partition whose log is due
+    (Lfs_PartGc maintenance pass).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @return Returns 1 if a log was compacted, 0 if none was due, negative
+    lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_compactStep(Lfs_Part_t *lpfs)
+{
+    Lfs_PartKv *kv;
+    int ret = 0;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    for (kv = lpfs->kv; kv; kv = kv->next)
+    {
+        /* Uncommitted updates are left to their owner. */
+        if (kv->batch_len == kv->tail_len && compact_due(kv))
+        {
+            ret = compact(kv);
+            ret = (ret < 0) ? ret : 1;
+            break;
+        }
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_getStats]
+*//**
+    @brief Gets the store counters.
+    @param[in] kv  Store.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, operation counters are cleared.
+******************************************************************************/
+void
+Lfs_PartKv_getStats(Lfs_PartKv *kv, Lfs_PartKv_Stats *stats, bool clear)
+{
+    RTOS_MUTEX_GET_RECURSIVE(kv->lpfs->lock);
+    kv->stats.log_size = kv->log_size + kv->tail_len;
+    kv->stats.live = kv->live;
+    kv->stats.keys = kv->num_keys;
+    *stats = kv->stats;
+    if (clear)
+    {
+        memset(&kv->stats, 0, sizeof(kv->stats));
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(kv->lpfs->lock);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_close]
+*//**
+    @brief Commits and closes a store.
+    @param[in] kv  Store.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartKv_close(Lfs_PartKv *kv)
+{
+    Lfs_Part_t *lpfs = kv->lpfs;
+    Lfs_PartKv **p;
+    int ret, err;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    ret = commit(kv, false);
+    err = lfs_file_close(&lpfs->lfs, &kv->file);
+    lfs_file_close(&lpfs->lfs, &kv->tail);
+    for (p = &lpfs->kv; *p; p = &(*p)->next)
+    {
+        if (*p == kv)
+        {
+            *p = kv->next;
+            break;
+        }
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    free(kv->table);
+    free(kv->file_buf);
+    free(kv->tail_buf);
+    kv->table = NULL;
+    kv->file_buf = NULL;
+    kv->tail_buf = NULL;
+    return (ret < 0) ? ret : err;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartKv_release]
+*//**
+    @brief Closes the open stores of a partition (before it is unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartKv_release(Lfs_Part_t *lpfs)
+{
+    while (lpfs->kv)
+    {
+        Lfs_PartKv_close(lpfs->kv);
+    }
+}
@@ -0,0 +1,243 @@
+/*******************************************************************************
+ *  @file: Lfs_PartMap.c
+ *
+ *  @brief: Zero-copy read-only access to littlefs files.
+ *
+ *  Non-inlined files are stored as a CTZ skip-list: block n of a file
+ *  starts with ctz(n)+1 little-endian pointers (none for block 0), the
+ *  first of which points to block n-1, followed by file data. The list is
+ *  walked back from the head block through the mapped device.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_PartMap.h"
+#include "lfs_util.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartMap";
+
+/******************************************************************************
+    ctz_header
+*//**
+    @brief Size of the pointer header of file block n.
+******************************************************************************/
+static uint32_t
+ctz_header(uint32_t n)
+{
+    return n ? 4*(lfs_ctz(n) + 1) : 0;
+}
+
+/******************************************************************************
+    ctz_index
+*//**
+    @brief Index of the file block holding byte pos (as lfs_ctz_index).
+******************************************************************************/
+static uint32_t
+ctz_index(uint32_t block_size, uint32_t pos)
+{
+    uint32_t b = block_size - 2*4;
+    uint32_t i = pos/b;
+
+    if (i == 0)
+    {
+        return 0;
+    }
+    return (pos - 4*(lfs_popc(i - 1) + 2))/b;
+}
+
+/******************************************************************************
+    map_ctz
+*//**
+    @brief Builds the extents of a CTZ file from the mapped device.
+******************************************************************************/
+static int
+map_ctz(
+    Lfs_PartMap *map,
+    Lfs_Part_t *lpfs,
+    const uint8_t *base,
+    lfs_block_t head)
+{
+    uint32_t block_size = lpfs->cfg.block_size;
+    uint32_t last = ctz_index(block_size, map->size - 1);
+    uint32_t remain = map->size;
+    lfs_block_t block = head;
+    uint32_t n;
+
+    map->extents = (Lfs_PartMap_Extent *)malloc(
+        (last + 1)*sizeof(Lfs_PartMap_Extent));
+    CHECK_COND_RETURN_MSG(!map->extents, LFS_ERR_NOMEM,
+        "Error allocating memory.");
+    map->num_extents = last + 1;
+
+    /* Data held by all blocks but the head. */
+    for (n = 0; n < last; n++)
+    {
+        remain -= block_size - ctz_header(n);
+    }
+
+    for (n = last; ; n--)
+    {
+        const uint8_t *data;
+        uint32_t prev;
+
+        CHECK_COND_RETURN_MSG(block >= lpfs->cfg.block_count, LFS_ERR_CORRUPT,
+            "Corrupt file block list.");
+        data = base + block*block_size;
+
+        map->extents[n].data = data + ctz_header(n);
+        map->extents[n].size = (n == last) ? remain :
+            block_size - ctz_header(n);
+
+        if (n == 0)
+        {
+            break;
+        }
+
+        memcpy(&prev, data, sizeof(prev));
+        block = lfs_fromle32(prev);
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+    map_copy
+*//**
+    @brief Fallback: reads the whole file into RAM.
+******************************************************************************/
+static int
+map_copy(Lfs_PartMap *map, Lfs_Part_t *lpfs, lfs_file_t *file)
+{
+    int ret;
+
+    map->copy = (uint8_t *)malloc(map->size ? map->size : 1);
+    CHECK_COND_RETURN_MSG(!map->copy, LFS_ERR_NOMEM, "Error allocating memory.");
+
+    ret = lfs_file_read(&lpfs->lfs, file, map->copy, map->size);
+    CHECK_COND_RETURN_MSG(ret != (int)map->size, (ret < 0) ? ret : LFS_ERR_IO,
+        "Error reading file.");
+
+    map->copy_extent.data = map->copy;
+    map->copy_extent.size = map->size;
+    map->extents = &map->copy_extent;
+    map->num_extents = 1;
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartMap_read]
+*//**
+    @brief Copies mapped data (e.g. a header spanning two extents).
+    @param[in] map  Pointer to open map.
+    @param[in] off  File offset.
+    @param[out] buf  Destination.
+    @param[in] size  Number of bytes.
+    @return Returns the number of bytes copied.
+******************************************************************************/
+uint32_t
+Lfs_PartMap_read(Lfs_PartMap *map, uint32_t off, void *buf, uint32_t size)
+{
+    uint8_t *out = (uint8_t *)buf;
+    uint32_t done = 0;
+    uint32_t i;
+
+    for (i = 0; i < map->num_extents && done < size; i++)
+    {
+        Lfs_PartMap_Extent *ext = &map->extents[i];
+        uint32_t n;
+
+        if (off >= ext->size)
+        {
+            off -= ext->size;
+            continue;
+        }
+
+        n = ext->size - off;
+        n = (n > size - done) ? size - done : n;
+        memcpy(out + done, ext->data + off, n);
+        done += n;
+        off = 0;
+    }
+
+    return done;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartMap_close]
+*//**
+    @brief Releases a map.
+    @param[in] map  Pointer to open map.
+******************************************************************************/
+void
+Lfs_PartMap_close(Lfs_PartMap *map)
+{
+    if (map->extents != &map->copy_extent)
+    {
+        free(map->extents);
+    }
+    free(map->copy);
+    memset(map, 0, sizeof(Lfs_PartMap));
+}
+
+/******************************************************************************
+    [docimport Lfs_PartMap_open]
+*//**
+    @brief Maps a file read-only.
+    @param[in] map  Pointer to map object.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t object instance.
+    @param[in] path  File path.
+    @param[in] flags  Lfs_PartMap_flags.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartMap_open(
+    Lfs_PartMap *map,
+    Lfs_Part_t *lpfs,
+    const char *path,
+    int flags)
+{
+    const uint8_t *base = Lfs_PartDev_map(lpfs->dev);
+    lfs_file_t file;
+    bool mappable;
+    int ret;
+
+    memset(map, 0, sizeof(Lfs_PartMap));
+
+    ret = lfs_file_open(&lpfs->lfs, &file, path, LFS_O_RDONLY);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    map->size = file.ctz.size;
+    mappable = base && !(file.flags & LFS_F_INLINE);
+
+    if (map->size == 0)
+    {
+        ret = 0;
+    }
+    else if (mappable && !((flags & LFS_PARTMAP_CONTIGUOUS) &&
+        ctz_index(lpfs->cfg.block_size, map->size - 1) > 0))
+    {
+        /* Block pointers must not change under the walk. */
+        RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+        ret = map_ctz(map, lpfs, base, file.ctz.head);
+        RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+    }
+    else if (flags & LFS_PARTMAP_NO_COPY)
+    {
+        ret = LFS_ERR_INVAL;
+    }
+    else
+    {
+        LOGPRINT_DEBUG("Copying %s (%u bytes).", path,
+            (unsigned int)map->size);
+        ret = map_copy(map, lpfs, &file);
+    }
+
+    lfs_file_close(&lpfs->lfs, &file);
+    if (ret < 0)
+    {
+        Lfs_PartMap_close(map);
+    }
+    return ret;
+}
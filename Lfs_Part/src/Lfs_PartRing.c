@@ -0,0 +1,606 @@
+/*******************************************************************************
+ *  @file: Lfs_PartRing.c
+ *
+ *  @brief: Fixed-size circular log in segment files on an Lfs_Part
+ *  filesystem.
+*******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartRing.h"
+#include "SwTimer.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartRing";
+
+/** @brief Longest file name in the ring directory. */
+#define RING_NAME_MAX           12
+
+/******************************************************************************
+    seg_path
+*//**
+    @brief Builds the path of the segment of seq.
+******************************************************************************/
+static void
+seg_path(const Lfs_PartRing *ring, uint32_t seq, char *path)
+{
+    sprintf(path, "%s/%u", ring->path,
+        (unsigned int)(seq % ring->hdr.num_segs));
+}
+
+/******************************************************************************
+    hdr_write
+*//**
+    @brief Writes the header file (inline: one metadata commit).
+******************************************************************************/
+static int
+hdr_write(Lfs_PartRing *ring)
+{
+    lfs_t *lfs = &ring->lpfs->lfs;
+    char path[LFS_PARTRING_PATH_MAX + RING_NAME_MAX];
+    lfs_file_t file;
+    int ret, err;
+
+    sprintf(path, "%s/ring", ring->path);
+    ret = lfs_file_open(lfs, &file, path,
+        LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    CHECK_COND_RETURN(ret < 0, ret);
+    ret = lfs_file_write(lfs, &file, &ring->hdr, sizeof(ring->hdr));
+    err = lfs_file_close(lfs, &file);
+    return (ret < 0) ? ret : err;
+}
+
+/******************************************************************************
+    hdr_read
+*//**
+    @brief Reads the header file.
+    @return Returns 0 on success, LFS_ERR_NOENT for a new ring, other
+    negative lfs error code otherwise.
+******************************************************************************/
+static int
+hdr_read(Lfs_PartRing *ring)
+{
+    lfs_t *lfs = &ring->lpfs->lfs;
+    char path[LFS_PARTRING_PATH_MAX + RING_NAME_MAX];
+    Lfs_PartRing_Hdr hdr;
+    lfs_file_t file;
+    int ret;
+
+    sprintf(path, "%s/ring", ring->path);
+    ret = lfs_file_open(lfs, &file, path, LFS_O_RDONLY);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    ret = lfs_file_read(lfs, &file, &hdr, sizeof(hdr));
+    lfs_file_close(lfs, &file);
+    CHECK_COND_RETURN(ret < 0, ret);
+    CHECK_COND_RETURN_MSG(ret != sizeof(hdr) ||
+        hdr.magic != LFS_PARTRING_MAGIC || hdr.num_segs < 2 ||
+        !hdr.seg_size || hdr.seg_size/ring->block_size*ring->block_size !=
+        hdr.seg_size || hdr.head_seq - hdr.first_seq >= hdr.num_segs,
+        LFS_ERR_CORRUPT, "Bad ring header.");
+    ring->hdr = hdr;
+    return 0;
+}
+
+/******************************************************************************
+    head_open
+*//**
+    @brief Opens the head segment for appending.
+    @param[in] trunc  Start the segment empty.
+******************************************************************************/
+static int
+head_open(Lfs_PartRing *ring, bool trunc)
+{
+    lfs_t *lfs = &ring->lpfs->lfs;
+    char path[LFS_PARTRING_PATH_MAX + RING_NAME_MAX];
+    lfs_soff_t size;
+    int ret;
+
+    seg_path(ring, ring->hdr.head_seq, path);
+    memset(&ring->file_cfg, 0, sizeof(ring->file_cfg));
+    ring->file_cfg.buffer = ring->file_buf;
+    ret = lfs_file_opencfg(lfs, &ring->file, path,
+        LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND |
+        (trunc ? LFS_O_TRUNC : 0), &ring->file_cfg);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    size = lfs_file_size(lfs, &ring->file);
+    if (size < 0)
+    {
+        lfs_file_close(lfs, &ring->file);
+        return size;
+    }
+    ring->seg_pos = ((uint32_t)size > ring->hdr.seg_size) ?
+        ring->hdr.seg_size : (uint32_t)size;
+    return 0;
+}
+
+/******************************************************************************
+    stage_write
+*//**
+    @brief Hands the staged bytes to littlefs.
+******************************************************************************/
+static int
+stage_write(Lfs_PartRing *ring)
+{
+    int ret;
+
+    if (!ring->stage_len)
+    {
+        return 0;
+    }
+    ret = lfs_file_write(&ring->lpfs->lfs, &ring->file, ring->stage,
+        ring->stage_len);
+    CHECK_COND_RETURN(ret < 0, ret);
+    ring->stage_len = 0;
+    ring->stats.writes++;
+    return 0;
+}
+
+/******************************************************************************
+    ring_sync
+*//**
+    @brief Makes the appended bytes durable (ring locked).
+******************************************************************************/
+static int
+ring_sync(Lfs_PartRing *ring)
+{
+    int ret;
+
+    if (!ring->dirty)
+    {
+        return 0;
+    }
+    ret = stage_write(ring);
+    if (ret >= 0)
+    {
+        ret = lfs_file_sync(&ring->lpfs->lfs, &ring->file);
+    }
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Error %d syncing %s.", ret, ring->path);
+        return ret;
+    }
+    ring->dirty = false;
+    ring->stats.syncs++;
+    return 0;
+}
+
+/******************************************************************************
+    next_segment
+*//**
+    @brief Moves the head to a new segment, dropping the oldest one if the
+    ring is full (ring locked, head segment full and synced).
+******************************************************************************/
+static int
+next_segment(Lfs_PartRing *ring)
+{
+    Lfs_PartRing_Hdr prev = ring->hdr;
+    bool drop = false;
+    int ret;
+
+    ret = lfs_file_close(&ring->lpfs->lfs, &ring->file);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    ring->hdr.head_seq++;
+    if (ring->hdr.head_seq - ring->hdr.first_seq >= ring->hdr.num_segs)
+    {
+        ring->hdr.first_seq++;
+        drop = true;
+    }
+
+    /* Truncated before the header moves: a crash in between leaves the
+       header on the full segment, and the next append moves again. */
+    ret = head_open(ring, true);
+    if (ret >= 0)
+    {
+        ret = lfs_file_sync(&ring->lpfs->lfs, &ring->file);
+        if (ret >= 0)
+        {
+            ret = hdr_write(ring);
+        }
+        if (ret < 0)
+        {
+            lfs_file_close(&ring->lpfs->lfs, &ring->file);
+        }
+    }
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Error %d starting a segment of %s.", ret,
+            ring->path);
+        ring->hdr = prev;
+        head_open(ring, false);
+        return ret;
+    }
+    ring->stats.segments++;
+    ring->stats.dropped += drop;
+    return 0;
+}
+
+/******************************************************************************
+    flush_due
+*//**
+    @brief Checks the age of the unsynced bytes against flush_ms.
+******************************************************************************/
+static bool
+flush_due(const Lfs_PartRing *ring)
+{
+    return ring->dirty && ring->flush_ms &&
+        SwTimer_getCount() - ring->dirty_us >=
+        (uint64_t)ring->flush_ms*1000;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartRing_open]
+*//**
+    @brief Opens (or creates) a ring. An existing ring keeps its geometry;
+    flush_ms is taken from config.
+    @param[in] ring  Ring.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  Ring directory.
+    @param[in] config  Geometry (for a new ring) and flush interval.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_open(
+    Lfs_PartRing *ring,
+    Lfs_Part_t *lpfs,
+    const char *path,
+    const Lfs_PartRing_Config *config)
+{
+    lfs_t *lfs = &lpfs->lfs;
+    char seg[LFS_PARTRING_PATH_MAX + RING_NAME_MAX];
+    struct lfs_info info;
+    int ret;
+
+    CHECK_COND_RETURN_MSG(strlen(path) >= LFS_PARTRING_PATH_MAX,
+        LFS_ERR_NAMETOOLONG, "Ring path too long.");
+    CHECK_COND_RETURN_MSG(config->num_segs < 2 || !config->seg_size ||
+        config->seg_size/lpfs->cfg.block_size*lpfs->cfg.block_size !=
+        config->seg_size, LFS_ERR_INVAL, "Invalid ring geometry.");
+
+    memset(ring, 0, sizeof(*ring));
+    ring->lpfs = lpfs;
+    strcpy(ring->path, path);
+    ring->flush_ms = config->flush_ms;
+    ring->block_size = lpfs->cfg.block_size;
+    ring->stage = (uint8_t *)malloc(ring->block_size);
+    ring->file_buf = (uint8_t *)malloc(lpfs->cfg.cache_size);
+    if (!ring->stage || !ring->file_buf)
+    {
+        ret = LFS_ERR_NOMEM;
+        goto fail;
+    }
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    ret = hdr_read(ring);
+    if (ret == LFS_ERR_NOENT)
+    {
+        ring->hdr.magic = LFS_PARTRING_MAGIC;
+        ring->hdr.seg_size = config->seg_size;
+        ring->hdr.num_segs = config->num_segs;
+        ret = lfs_mkdir(lfs, path);
+        ret = (ret == LFS_ERR_EXIST) ? 0 : ret;
+        if (ret >= 0)
+        {
+            ret = hdr_write(ring);
+        }
+    }
+    else if (ret >= 0 && (ring->hdr.seg_size != config->seg_size ||
+        ring->hdr.num_segs != config->num_segs))
+    {
+        LOGPRINT_WARN("%s keeps its geometry: %u x %u bytes.", path,
+            (unsigned int)ring->hdr.num_segs,
+            (unsigned int)ring->hdr.seg_size);
+    }
+
+    /* A crash while the head moved may have emptied the oldest segment. */
+    if (ret >= 0 && ring->hdr.first_seq != ring->hdr.head_seq)
+    {
+        seg_path(ring, ring->hdr.first_seq, seg);
+        if (lfs_stat(lfs, seg, &info) < 0 || info.size < ring->hdr.seg_size)
+        {
+            ring->hdr.first_seq++;
+        }
+    }
+    if (ret >= 0)
+    {
+        ret = head_open(ring, false);
+    }
+    if (ret >= 0)
+    {
+        ring->next = lpfs->ring;
+        lpfs->ring = ring;
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+    CHECK_COND_GOTO(ret < 0, fail);
+
+    LOGPRINT_DEBUG("Ring %s: %u x %u bytes, segments %u..%u.", path,
+        (unsigned int)ring->hdr.num_segs, (unsigned int)ring->hdr.seg_size,
+        (unsigned int)ring->hdr.first_seq, (unsigned int)ring->hdr.head_seq);
+    return 0;
+
+fail:
+    LOGPRINT_ERROR("Error %d opening ring %s.", ret, path);
+    free(ring->stage);
+    free(ring->file_buf);
+    ring->stage = NULL;
+    ring->file_buf = NULL;
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartRing_append]
+*//**
+    @brief Appends bytes at the head, dropping the oldest segment when the
+    head moves to a new one.
+    @param[in] ring  Ring.
+    @param[in] data  Data.
+    @param[in] size  Number of bytes.
+    @return Returns size on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_append(Lfs_PartRing *ring, const void *data, uint32_t size)
+{
+    const uint8_t *in = (const uint8_t *)data;
+    uint32_t done = 0, n;
+    int ret = 0;
+
+    RTOS_MUTEX_GET_RECURSIVE(ring->lpfs->lock);
+    while (done < size)
+    {
+        if (ring->seg_pos == ring->hdr.seg_size)
+        {
+            ret = next_segment(ring);
+            CHECK_COND_GOTO(ret < 0, done);
+        }
+
+        /* Up to the next block boundary of the segment. */
+        n = ring->block_size - ring->seg_pos % ring->block_size;
+        n = (n > size - done) ? size - done : n;
+        memcpy(&ring->stage[ring->stage_len], &in[done], n);
+        ring->stage_len += n;
+        ring->seg_pos += n;
+        done += n;
+        if (!ring->dirty)
+        {
+            ring->dirty = true;
+            ring->dirty_us = SwTimer_getCount();
+        }
+
+        if (ring->seg_pos % ring->block_size == 0)
+        {
+            ret = stage_write(ring);
+            CHECK_COND_GOTO(ret < 0, done);
+        }
+        if (ring->seg_pos == ring->hdr.seg_size)
+        {
+            ret = ring_sync(ring);
+            CHECK_COND_GOTO(ret < 0, done);
+        }
+    }
+    ring->stats.appends++;
+    ring->stats.bytes += size;
+
+    if (flush_due(ring))
+    {
+        ret = ring_sync(ring);
+    }
+
+done:
+    RTOS_MUTEX_PUT_RECURSIVE(ring->lpfs->lock);
+    return (ret < 0) ? ret : (int)size;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartRing_sync]
+*//**
+    @brief Makes all appended bytes durable.
+    @param[in] ring  Ring.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_sync(Lfs_PartRing *ring)
+{
+    int ret;
+
+    RTOS_MUTEX_GET_RECURSIVE(ring->lpfs->lock);
+    ret = ring_sync(ring);
+    RTOS_MUTEX_PUT_RECURSIVE(ring->lpfs->lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartRing_bounds]
+*//**
+    @brief Gets the stream offsets of the oldest byte and of the head.
+    @param[in] ring  Ring.
+    @param[out] tail  Offset of the oldest byte kept.
+    @param[out] head  Offset of the next byte appended.
+******************************************************************************/
+void
+Lfs_PartRing_bounds(Lfs_PartRing *ring, uint64_t *tail, uint64_t *head)
+{
+    RTOS_MUTEX_GET_RECURSIVE(ring->lpfs->lock);
+    *tail = (uint64_t)ring->hdr.first_seq*ring->hdr.seg_size;
+    *head = (uint64_t)ring->hdr.head_seq*ring->hdr.seg_size + ring->seg_pos;
+    RTOS_MUTEX_PUT_RECURSIVE(ring->lpfs->lock);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartRing_read]
+*//**
+    @brief Reads the stream at an offset (unsynced bytes in the range are
+    synced first).
+    @param[in] ring  Ring.
+    @param[in] offset  Stream offset.
+    @param[out] buf  Buffer.
+    @param[in] size  Bytes to read.
+    @return Returns the number of bytes read (0 at the head), LFS_ERR_NOENT
+    if offset was dropped, other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_read(
+    Lfs_PartRing *ring,
+    uint64_t offset,
+    void *buf,
+    uint32_t size)
+{
+    lfs_t *lfs = &ring->lpfs->lfs;
+    char path[LFS_PARTRING_PATH_MAX + RING_NAME_MAX];
+    uint32_t seg_size = ring->hdr.seg_size;
+    uint64_t tail, head;
+    uint32_t done = 0, seq, off, n;
+    lfs_file_t file;
+    int ret = 0;
+
+    RTOS_MUTEX_GET_RECURSIVE(ring->lpfs->lock);
+    Lfs_PartRing_bounds(ring, &tail, &head);
+    if (offset < tail)
+    {
+        ret = LFS_ERR_NOENT;
+        goto done;
+    }
+    if (offset + size > head)
+    {
+        size = (offset < head) ? (uint32_t)(head - offset) : 0;
+    }
+    /* Only the head segment has unsynced bytes. */
+    if (size && ring->dirty &&
+        offset + size > (uint64_t)ring->hdr.head_seq*seg_size)
+    {
+        ret = ring_sync(ring);
+        CHECK_COND_GOTO(ret < 0, done);
+    }
+
+    while (done < size)
+    {
+        seq = (uint32_t)((offset + done)/seg_size);
+        off = (uint32_t)((offset + done) % seg_size);
+        n = seg_size - off;
+        n = (n > size - done) ? size - done : n;
+
+        seg_path(ring, seq, path);
+        ret = lfs_file_open(lfs, &file, path, LFS_O_RDONLY);
+        CHECK_COND_GOTO(ret < 0, done);
+        ret = lfs_file_seek(lfs, &file, off, LFS_SEEK_SET);
+        if (ret >= 0)
+        {
+            ret = lfs_file_read(lfs, &file, (uint8_t *)buf + done, n);
+        }
+        lfs_file_close(lfs, &file);
+        CHECK_COND_GOTO(ret < 0, done);
+        done += ret;
+        if ((uint32_t)ret < n)
+        {
+            break;
+        }
+    }
+
+done:
+    RTOS_MUTEX_PUT_RECURSIVE(ring->lpfs->lock);
+    return (ret < 0) ? ret : (int)done;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartRing_getStats]
+*//**
+    @brief Gets the ring counters.
+    @param[in] ring  Ring.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared.
+******************************************************************************/
+void
+Lfs_PartRing_getStats(Lfs_PartRing *ring, Lfs_PartRing_Stats *stats,
+    bool clear)
+{
+    RTOS_MUTEX_GET_RECURSIVE(ring->lpfs->lock);
+    *stats = ring->stats;
+    if (clear)
+    {
+        memset(&ring->stats, 0, sizeof(ring->stats));
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(ring->lpfs->lock);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartRing_flushStep]
+*//**
+    @brief Syncs the rings of a partition holding bytes older than their
+    flush_ms (Lfs_PartGc maintenance pass, or an application timer).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @return Returns the number of rings synced, negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_flushStep(Lfs_Part_t *lpfs)
+{
+    Lfs_PartRing *ring;
+    int ret = 0, n = 0;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    for (ring = lpfs->ring; ring && ret >= 0; ring = ring->next)
+    {
+        if (flush_due(ring))
+        {
+            ret = ring_sync(ring);
+            n++;
+        }
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+    return (ret < 0) ? ret : n;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartRing_close]
+*//**
+    @brief Syncs and closes a ring.
+    @param[in] ring  Ring.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartRing_close(Lfs_PartRing *ring)
+{
+    Lfs_Part_t *lpfs = ring->lpfs;
+    Lfs_PartRing **p;
+    int ret, err;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    ret = ring_sync(ring);
+    err = lfs_file_close(&lpfs->lfs, &ring->file);
+    for (p = &lpfs->ring; *p; p = &(*p)->next)
+    {
+        if (*p == ring)
+        {
+            *p = ring->next;
+            break;
+        }
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    free(ring->stage);
+    free(ring->file_buf);
+    ring->stage = NULL;
+    ring->file_buf = NULL;
+    return (ret < 0) ? ret : err;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartRing_release]
+*//**
+    @brief Closes the open rings of a partition (before it is unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartRing_release(Lfs_Part_t *lpfs)
+{
+    while (lpfs->ring)
+    {
+        Lfs_PartRing_close(lpfs->ring);
+    }
+}
@@ -4,9 +4,15 @@
  *  @brief: Handlers for lfspart_rpc.
 *******************************************************************************/
 #include "Lfs_PartRpc.h"
-#include "CList.h"
+#include "Lfs_PartWb.h"
+#include "Lfs_PartDir.h"
+#include "Lfs_PartXfer.h"
+#include "Lfs_PartDelta.h"
+#include "Lfs_PartDigest.h"
+#include "Lfs_PartTx.h"
 #include "Lfs_PartRpc.pb.h"
 #include "ProtoRpc.pb.h"
+#include "RpcLimit.h"
 #include "lfs_helpers.h"
 #include "LogPrint.h"
 #include "LogPrint_local.h"
@@ -16,151 +22,279 @@ static const char *TAG = "Lfs_PartRpc";
 /** @brief MAX number of simultaneously open file descriptors. */
 #define MAX_OPEN_DESCRIPTORS    4
 
-/** @brief Pool of descriptors. */
-static lfs_pool_t *pool = NULL;
+/** @brief Write-behind buffer per file open for writing (0 disables).
+    filewrite chunks are gathered up to this size before lfs_file_write. */
+#ifndef LFS_PARTRPC_WB_SIZE
+#define LFS_PARTRPC_WB_SIZE     LFS_PART_BLOCK_SIZE
+#endif
+
+/** @brief Buffered bytes older than this are flushed by the write-behind
+    task. */
+#define LFS_PARTRPC_WB_TIMEOUT_MS   500
+#define LFS_PARTRPC_WB_TASK_STACK   3072
+#define LFS_PARTRPC_WB_TASK_PRIO    2
+
+/** @brief An fd is the slot index in the low FD_INDEX_BITS and the slot
+    generation above, so a stale fd (closed, slot reused) is rejected. */
+#define FD_INDEX_BITS           4
+#define FD_INDEX_MASK           ((1u << FD_INDEX_BITS) - 1)
+#define FD_GEN_MASK             0x7fff
+
+_Static_assert(MAX_OPEN_DESCRIPTORS <= (1u << FD_INDEX_BITS),
+    "MAX_OPEN_DESCRIPTORS exceeds the fd index bits.");
 
 /** @brief Local copy of the LFS partition FS. */
 static Lfs_Part_t *_lpfs = NULL;
 
-typedef struct CacheItem
+/** @brief Descriptor table slot. The littlefs file cache and write-behind
+    buffer are allocated on first use and kept with the slot, so opening a
+    descriptor does not touch the heap.
+*/
+typedef struct FdSlot
 {
-    /** @brief List anchor so that this object can be added to a list.
-        MUST BE THE FIRST MEMBER */
-    CLIST_ANCHOR();
-
-    /** @brief The fd. */
-    uint8_t fd;
-    /** @brief lfs fs reference. */
+    /** @brief The fd while in use. */
+    uint32_t fd;
+    uint16_t gen;
+    bool used;
+    /** @brief Next free slot (-1 for none) while free. */
+    int8_t next_free;
+
+    /** @brief Partition and lfs fs reference. */
+    Lfs_Part_t *lpfs;
     lfs_t *lfs;
-    /** @brief The lfs descriptor. */
-    lfs_descriptor_t *descr;
+    /** @brief The lfs objects. */
+    lfs_file_t file;
+    lfs_dir_t dir;
     /** @brief item info */
     struct lfs_info info;
-} CacheItem;
 
-/** @brief The cache holding open fd's. */
-static CList cache;
+    /** @brief littlefs file cache (lfs_file_opencfg). */
+    struct lfs_file_config file_cfg;
+    uint8_t *file_buf;
+    uint32_t file_buf_size;
+
+    /** @brief Write-behind buffer (files open for writing only). */
+    Lfs_PartWb wb;
+    uint8_t *wb_buf;
+} FdSlot;
+
+/** @brief The descriptor table, indexed by fd. */
+static FdSlot fd_table[MAX_OPEN_DESCRIPTORS];
+static int8_t fd_free_head;
+
+/** @brief Protects descriptor allocation and write-behind buffers against
+    the write-behind task. */
+static RTOS_MUTEX_STATIC_BUF wb_lockbuf;
+static RTOS_MUTEX wb_lock;
+static RTOS_TASK wb_task_handle;
+
+/** @brief Number of open transactions (at most one per partition). A
+    transaction id is the slot index in the low TX_INDEX_BITS and a
+    sequence number above. */
+#ifndef LFS_PARTRPC_TX_MAX
+#define LFS_PARTRPC_TX_MAX      2
+#endif
+#define TX_INDEX_BITS           4
+#define TX_INDEX_MASK           ((1u << TX_INDEX_BITS) - 1)
+
+_Static_assert(LFS_PARTRPC_TX_MAX <= (1u << TX_INDEX_BITS),
+    "LFS_PARTRPC_TX_MAX exceeds the transaction index bits.");
+
+/** @brief Transactions (TxBegin/TxCommit). tx_lock covers the slot ids
+    and tx_seq between calls from the TCP and UDP servers. */
+static Lfs_PartTx tx_table[LFS_PARTRPC_TX_MAX];
+static uint32_t tx_seq;
+static RTOS_MUTEX_STATIC_BUF tx_lockbuf;
+static RTOS_MUTEX tx_lock;
+
+/** @brief Limiter reported by GetStats (see Lfs_PartRpc_setLimit). */
+static RpcLimit *rpc_limit;
 
 #define MIN(x,y)  (((x) < (y)) ? (x) : (y))
 
+/** @brief Trace handle of an open file (see Lfs_PartTrace.h). */
+#define TRACE_HANDLE(item)  ((unsigned int)(uintptr_t)&(item)->file)
+
 /******************************************************************************
-    cache_print
+    fd_table_init
 *//**
-    @brief Prints all items in cache.
+    @brief Puts every slot on the free list.
 ******************************************************************************/
 static void
-cache_print(void)
+fd_table_init(void)
 {
-    CacheItem *item;
-    LOGPRINT_DEBUG("Cache contents:");
-    CLIST_ITER_ENTRY(item, &cache)
+    int i;
+
+    for (i = 0; i < MAX_OPEN_DESCRIPTORS; i++)
     {
-        LOGPRINT_DEBUG("  %u: %s", (unsigned int)item->fd, item->info.name);
+        fd_table[i].used = false;
+        fd_table[i].gen = 1;
+        fd_table[i].next_free = (i + 1 < MAX_OPEN_DESCRIPTORS) ? i + 1 : -1;
     }
+    fd_free_head = 0;
 }
 
 /******************************************************************************
-    cache_find_fd
+    tx_find
 *//**
-    @brief Retrieves entry from cache matching fd.
-    @param[in] fd  File descriptor to match.
-    Returns the CacheItem matching fd, NULL if not found.
+    @brief Finds an open transaction of a partition. The Lfs_PartTx calls
+    check the id again, as the slot may be reused once tx_lock is released.
+    @return Returns the transaction, NULL if id is not open on lpfs.
 ******************************************************************************/
-static CacheItem *
-cache_find_fd(uint8_t fd)
+static Lfs_PartTx *
+tx_find(uint32_t id, Lfs_Part_t *lpfs)
 {
-    CacheItem *item;
-    CLIST_ITER_ENTRY(item, &cache)
+    uint32_t idx = id & TX_INDEX_MASK;
+    bool found;
+
+    RTOS_MUTEX_GET(tx_lock);
+    found = id && idx < LFS_PARTRPC_TX_MAX && tx_table[idx].id == id &&
+        (!lpfs || tx_table[idx].lpfs == lpfs);
+    RTOS_MUTEX_PUT(tx_lock);
+    if (!found)
     {
-        if (item->fd == fd)
-        {
-            LOGPRINT_DEBUG("Found fd=%u in cache.", (unsigned int)fd);
-            return item;
-        }
+        LOGPRINT_ERROR("Transaction %u is not open.", (unsigned int)id);
+        return NULL;
     }
-    LOGPRINT_ERROR("Did not find fd=%u in cache.", (unsigned int)fd);
-    return NULL;
+    return &tx_table[idx];
 }
 
 /******************************************************************************
-    cache_rm_fd
+    fd_lookup
 *//**
-    @brief Removed entry from cache matching fd. Releases back to the pool.
-    @param[in] fd  File descriptor to match.
-    Returns 0 on success, -1 on failure.
+    @brief Retrieves the slot of an open fd.
+    @param[in] fd  File descriptor.
+    Returns the FdSlot of fd, NULL if fd is not open (or stale).
 ******************************************************************************/
-static int
-cache_rm_fd(uint8_t fd)
+static FdSlot *
+fd_lookup(uint32_t fd)
 {
-    CacheItem *item;
-    bool found = false;
+    uint32_t idx = fd & FD_INDEX_MASK;
+    FdSlot *item;
 
-    CLIST_ITER_ENTRY(item, &cache)
+    if (idx < MAX_OPEN_DESCRIPTORS)
     {
-        if (item->fd == fd)
+        item = &fd_table[idx];
+        if (item->used && item->fd == fd)
         {
-            found = true;
-            break;
+            return item;
         }
     }
+    LOGPRINT_ERROR("fd=%u is not open.", (unsigned int)fd);
+    return NULL;
+}
 
-    if (found)
+/******************************************************************************
+    fd_release
+*//**
+    @brief Returns a slot to the free list; its fd becomes stale.
+    @param[in] item  Slot from fd_alloc.
+******************************************************************************/
+static void
+fd_release(FdSlot *item)
+{
+    RTOS_MUTEX_GET(wb_lock);
+    LOGPRINT_DEBUG("Released fd=%u.", (unsigned int)item->fd);
+    item->used = false;
+    item->gen = (item->gen + 1) & FD_GEN_MASK;
+    if (item->gen == 0)
     {
-#ifdef LOCAL_DEBUG
-        cache_print();
-#endif
-        /* Release descriptor back to the pool */
-        lfs_pool_put_descriptor(pool, fd);
-        /* Remove from the cache of open fd's. */
-        CList_remove((CList *)item);
-        /* Finally, free the item */
-        free(item);
-        LOGPRINT_DEBUG("Removed fd=%u from cache.", (unsigned int)fd);
-#ifdef LOCAL_DEBUG
-        cache_print();
-#endif
-        return 0;
+        item->gen = 1;
     }
-
-    LOGPRINT_ERROR("Did not find fd=%u in cache.", (unsigned int)fd);
-    return -1;
+    item->next_free = fd_free_head;
+    fd_free_head = (int8_t)(item - fd_table);
+    RTOS_MUTEX_PUT(wb_lock);
 }
 
 /******************************************************************************
-    cache_add_fd
+    fd_alloc
 *//**
-    @brief Gets a new file descriptor and adds to cache.
-    @param[in] lfs  Pointer to the lfs filesystem.
-    Returns the created CacheItem or NULL on failure.
+    @brief Takes a free slot and assigns it an fd.
+    @param[in] lpfs  Pointer to the partition.
+    Returns the slot or NULL if all descriptors are open.
 ******************************************************************************/
-static CacheItem *
-cache_add_fd(lfs_t *lfs)
+static FdSlot *
+fd_alloc(Lfs_Part_t *lpfs)
 {
-    int fd;
-    CacheItem *item;
-    lfs_descriptor_t *descr = NULL;
+    FdSlot *item;
+    uint32_t idx;
 
-    fd = lfs_pool_get_descriptor(pool, &descr);
-    if (fd < 0)
+    RTOS_MUTEX_GET(wb_lock);
+    if (fd_free_head < 0)
     {
+        RTOS_MUTEX_PUT(wb_lock);
         return NULL;
     }
+    idx = fd_free_head;
+    item = &fd_table[idx];
+    fd_free_head = item->next_free;
+
+    item->fd = ((uint32_t)item->gen << FD_INDEX_BITS) | idx;
+    item->lpfs = lpfs;
+    item->lfs = &lpfs->lfs;
+    memset(&item->info, 0, sizeof(item->info));
+    memset(&item->wb, 0, sizeof(item->wb));
+    item->used = true;
+    RTOS_MUTEX_PUT(wb_lock);
+
+    LOGPRINT_DEBUG("Allocated fd=%u.", (unsigned int)item->fd);
+    return item;
+}
 
-    /* Got a descriptor, now add to cache. */
-    item = (CacheItem *)malloc(sizeof(CacheItem));
-    if (!item)
+/******************************************************************************
+    fd_file_cfg
+*//**
+    @brief Gets the file config for opening a file on the slot, with the
+    slot's cache buffer (grown to the partition's cache size if needed).
+    Returns the config, NULL if there is no memory for the buffer.
+******************************************************************************/
+static const struct lfs_file_config *
+fd_file_cfg(FdSlot *item)
+{
+    uint32_t size = item->lfs->cfg->cache_size;
+    uint8_t *buf;
+
+    if (item->file_buf_size < size)
     {
-        LOGPRINT_ERROR("Error allocating memory.");
-        lfs_pool_put_descriptor(pool, (uint8_t)fd);
-        return NULL;
+        buf = (uint8_t *)realloc(item->file_buf, size);
+        if (!buf)
+        {
+            return NULL;
+        }
+        item->file_buf = buf;
+        item->file_buf_size = size;
     }
+    memset(&item->file_cfg, 0, sizeof(item->file_cfg));
+    item->file_cfg.buffer = item->file_buf;
+    return &item->file_cfg;
+}
 
-    item->fd = fd;
-    item->descr = descr;
-    item->lfs = lfs;
-    CList_append(&cache, item);
-    LOGPRINT_DEBUG("Added fd=%u to cache.", (unsigned int)fd);
-    return item;
+/******************************************************************************
+    wb_task
+*//**
+    @brief Flushes write-behind buffers which have been idle too long, so a
+    stalled upload does not leave data only in RAM.
+******************************************************************************/
+static void
+wb_task(void *p)
+{
+    while (1)
+    {
+        FdSlot *item;
+
+        RTOS_TASK_SLEEP_ms(LFS_PARTRPC_WB_TIMEOUT_MS/2);
+
+        RTOS_MUTEX_GET(wb_lock);
+        for (item = fd_table; item < fd_table + MAX_OPEN_DESCRIPTORS; item++)
+        {
+            if (item->used && item->wb.buf)
+            {
+                Lfs_PartWb_flushOlder(&item->wb,
+                    (uint64_t)LFS_PARTRPC_WB_TIMEOUT_MS*1000);
+            }
+        }
+        RTOS_MUTEX_PUT(wb_lock);
+    }
 }
 
 /******************************************************************************
@@ -168,15 +302,29 @@ cache_add_fd(lfs_t *lfs)
 *//**
     @brief Gets filesystem objects from partition.
     @param[in] label  Parition label.
+    @param[in] handle  Partition handle, 0 to look the label up. A handle
+    of another partition (e.g. from before a restart) falls back to label.
     @param[in] lpfs  Returned Lfs_Part_t object.
     @param[out] lfs  Returned lfs filesystem.
     @return Returns 0 on success, -1 on error.
 ******************************************************************************/
 static int
-get_lfs(const char *label, Lfs_Part_t **lpfs, lfs_t **lfs)
+get_lfs(const char *label, uint32_t handle, Lfs_Part_t **lpfs, lfs_t **lfs)
 {
-    Lfs_Part_t *lp;
-    lp = Lfs_Part_getPartition(label);
+    Lfs_Part_t *lp = NULL;
+
+    if (handle)
+    {
+        lp = Lfs_Part_getByHandle(handle);
+        if (lp && label[0] && strcmp(lp->dev->label, label) != 0)
+        {
+            lp = NULL;
+        }
+    }
+    if (!lp)
+    {
+        lp = Lfs_Part_getPartition(label);
+    }
     if (!lp)
     {
         LOGPRINT_ERROR("Cound not get partition with label: %s", label);
@@ -193,11 +341,13 @@ get_lfs(const char *label, Lfs_Part_t **lpfs, lfs_t **lfs)
 
     Call params:
         call->part_label: string 
+        call->part_handle: uint32 
     Reply params:
         reply->address: uint32 
         reply->size: uint32 
         reply->block_size: uint32 
         reply->block_count: uint32 
+        reply->part_handle: uint32 
 *//**
     @brief Implements the RPC getfsinfo handler.
 ******************************************************************************/
@@ -220,7 +370,7 @@ getfsinfo(void *call_frame, void *reply_frame, StatusEnum *status)
 
     memset(reply, 0, sizeof(lfspart_GetFsInfo_reply));
 
-    ret = get_lfs(call->part_label, &lpfs, &lfs);
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
     if (ret < 0)
     {
         LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
@@ -236,11 +386,11 @@ getfsinfo(void *call_frame, void *reply_frame, StatusEnum *status)
         return;
     }
 
-    reply->address = lpfs->partition->address;
-    reply->size = lpfs->partition->size;
+    reply->address = lpfs->dev->address;
+    reply->size = lpfs->dev->size;
     reply->block_size = fsinfo.block_size;
     reply->block_count = fsinfo.block_count;
-    reply->block_count = fsinfo.block_count;
+    reply->part_handle = lpfs->handle;
 }
 
 /******************************************************************************
@@ -249,6 +399,7 @@ getfsinfo(void *call_frame, void *reply_frame, StatusEnum *status)
     Call params:
         call->part_label: string 
         call->path: string 
+        call->part_handle: uint32 
     Reply params:
         reply->fd: int32 
 *//**
@@ -264,7 +415,7 @@ diropen(void *call_frame, void *reply_frame, StatusEnum *status)
     Lfs_Part_t *lpfs;
     lfs_t *lfs;
     struct lfs_info info;
-    CacheItem *item;
+    FdSlot *item;
     int ret;
 
     (void)call;
@@ -275,7 +426,7 @@ diropen(void *call_frame, void *reply_frame, StatusEnum *status)
     reply_msg->which_msg = lfspart_LfsCallset_diropen_reply_tag;
     *status = StatusEnum_RPC_SUCCESS;
 
-    ret = get_lfs(call->part_label, &lpfs, &lfs);
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
     if (ret < 0)
     {
         LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
@@ -290,7 +441,7 @@ diropen(void *call_frame, void *reply_frame, StatusEnum *status)
         return;
     }
 
-    item = cache_add_fd(lfs);
+    item = fd_alloc(lpfs);
     if (!item)
     {
         reply->fd = -1;
@@ -302,10 +453,10 @@ diropen(void *call_frame, void *reply_frame, StatusEnum *status)
 
     reply->fd = item->fd;
 
-    ret = lfs_dir_open(lfs, &item->descr->dir, call->path);
+    ret = lfs_dir_open(lfs, &item->dir, call->path);
     if (ret < 0)
     {
-        cache_rm_fd(item->fd);
+        fd_release(item);
         reply->fd = -1;
         LOGPRINT_ERROR("Failed open dir %s", call->path);
         return;
@@ -331,7 +482,7 @@ dirclose(void *call_frame, void *reply_frame, StatusEnum *status)
     lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
     lfspart_DirClose_call *call = &call_msg->msg.dirclose_call;
     lfspart_DirClose_reply *reply = &reply_msg->msg.dirclose_reply;
-    CacheItem *item;
+    FdSlot *item;
     int ret;
 
     (void)call;
@@ -342,14 +493,14 @@ dirclose(void *call_frame, void *reply_frame, StatusEnum *status)
     reply_msg->which_msg = lfspart_LfsCallset_dirclose_reply_tag;
     *status = StatusEnum_RPC_SUCCESS;
 
-    item = cache_find_fd(call->fd);
+    item = fd_lookup(call->fd);
     if (!item)
     {
         *status = StatusEnum_RPC_HANDLER_ERROR;
         return;
     }
 
-    ret = lfs_dir_close(item->lfs, &item->descr->dir);
+    ret = lfs_dir_close(item->lfs, &item->dir);
     if (ret < 0)
     {
         *status = StatusEnum_RPC_HANDLER_ERROR;
@@ -357,12 +508,7 @@ dirclose(void *call_frame, void *reply_frame, StatusEnum *status)
     }
 
     LOGPRINT_DEBUG("Directory %s is now closed.", item->info.name);
-    ret = cache_rm_fd(item->fd);
-    if (ret < 0)
-    {
-        *status = StatusEnum_RPC_HANDLER_ERROR;
-        return;
-    }
+    fd_release(item);
 }
 
 /******************************************************************************
@@ -384,7 +530,7 @@ dirread(void *call_frame, void *reply_frame, StatusEnum *status)
     lfspart_DirRead_call *call = &call_msg->msg.dirread_call;
     lfspart_DirRead_reply *reply = &reply_msg->msg.dirread_reply;
     uint32_t name_max = PROTORPC_ARRAY_LENGTH(reply->info.name);
-    CacheItem *item;
+    FdSlot *item;
     struct lfs_info info;
     int ret;
 
@@ -397,14 +543,14 @@ dirread(void *call_frame, void *reply_frame, StatusEnum *status)
     *status = StatusEnum_RPC_SUCCESS;
 
     /* Lookup item in cache by provided fd. */
-    item = cache_find_fd(call->fd);
+    item = fd_lookup(call->fd);
     if (!item)
     {
         *status = StatusEnum_RPC_HANDLER_ERROR;
         return;
     }
 
-    ret = lfs_dir_read(item->lfs, &item->descr->dir, &info);
+    ret = lfs_dir_read(item->lfs, &item->dir, &info);
     if (ret < 0)
     {
         *status = StatusEnum_RPC_HANDLER_ERROR;
@@ -418,6 +564,33 @@ dirread(void *call_frame, void *reply_frame, StatusEnum *status)
     strncpy(reply->info.name, info.name, name_max); 
 }
 
+/******************************************************************************
+    dirlist_entry
+*//**
+    @brief Lfs_PartDir_list callback: adds an entry to the dirlist reply.
+******************************************************************************/
+static void
+dirlist_entry(
+    void *ctx,
+    uint32_t idx,
+    uint8_t type,
+    uint32_t size,
+    const char *name)
+{
+    lfspart_DirList_reply *reply = (lfspart_DirList_reply *)ctx;
+    lfspart_FileInfo *fi = &reply->info_array[reply->info_array_count++];
+
+    fi->type = type;
+    fi->size = size;
+    strncpy(fi->name, name, PROTORPC_ARRAY_LENGTH(fi->name) - 1);
+    fi->name[PROTORPC_ARRAY_LENGTH(fi->name) - 1] = '\0';
+    LOGPRINT_DEBUG("[%u]: %c %u: %s",
+        (unsigned int)idx,
+        (type == LFS_TYPE_REG) ? 'f' : 'd',
+        (unsigned int)size,
+        name);
+}
+
 /******************************************************************************
     dirlist
 
@@ -425,13 +598,18 @@ dirread(void *call_frame, void *reply_frame, StatusEnum *status)
         call->part_label: string 
         call->path: string 
         call->start_idx: uint32 
+        call->cursor: uint32 
+        call->part_handle: uint32 
     Reply params:
         reply->valid: bool 
         reply->num_entries: uint32 
         reply->start_idx: uint32 
         reply->info_array: message [repeated]
+        reply->cursor: uint32 
 *//**
-    @brief Implements the RPC dirlist handler.
+    @brief Implements the RPC dirlist handler. Pages are served from a
+    directory snapshot or resume the listing's cursor (see Lfs_PartDir.h),
+    so a directory is read from flash once per listing, not once per page.
 ******************************************************************************/
 static void
 dirlist(void *call_frame, void *reply_frame, StatusEnum *status)
@@ -440,90 +618,50 @@ dirlist(void *call_frame, void *reply_frame, StatusEnum *status)
     lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
     lfspart_DirList_call *call = &call_msg->msg.dirlist_call;
     lfspart_DirList_reply *reply = &reply_msg->msg.dirlist_reply;
-    uint32_t name_max = PROTORPC_ARRAY_LENGTH(reply->info_array[0].name);
     uint32_t entries_max = PROTORPC_ARRAY_LENGTH(reply->info_array);
+    Lfs_PartDir_Page page;
     Lfs_Part_t *lpfs;
     lfs_t *lfs;
-    lfs_dir_t dir;
-    struct lfs_info info;
     int ret;
 
     (void)call;
     (void)reply;
 
-    LOGPRINT_DEBUG("In dirlist handler (%u, %u)",
-        (unsigned int)name_max, (unsigned int)entries_max);
+    LOGPRINT_DEBUG("In dirlist handler (%u, cursor %u)",
+        (unsigned int)call->start_idx, (unsigned int)call->cursor);
 
     reply_msg->which_msg = lfspart_LfsCallset_dirlist_reply_tag;
     *status = StatusEnum_RPC_SUCCESS;
 
-    if ((ret = get_lfs(call->part_label, &lpfs, &lfs)) < 0)
+    if ((ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs)) < 0)
     {
         LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
         *status = StatusEnum_RPC_HANDLER_ERROR;
         return;
     }
 
-    if (lfs_exists(lfs, call->path, NULL) < 0)
+    if (!call->cursor)
     {
-        reply->valid = false;
-        reply->num_entries = 0;
-        reply->info_array_count = 0; 
-        LOGPRINT_ERROR("Dir does not exist: %s", call->path);
-        return;
+        Lfs_PartTrace_log(lpfs, "l %s", call->path);
     }
 
-    if ((ret = lfs_dir_open(lfs, &dir, call->path)) < 0)
+    reply->info_array_count = 0;
+    ret = Lfs_PartDir_list(lpfs, call->path, call->start_idx, call->cursor,
+        entries_max, dirlist_entry, reply, &page);
+    if (ret < 0)
     {
         reply->valid = false;
         reply->num_entries = 0;
         reply->info_array_count = 0; 
-        LOGPRINT_ERROR("Failed open dir %s: %d", call->path, ret);
+        reply->cursor = 0;
+        LOGPRINT_ERROR("Failed listing dir %s: %d", call->path, ret);
         return;
     }
 
-    uint32_t entry_idx = 0;
-    uint32_t num_returned = 0;
-    while (1)
-    {
-        /* lfs_dir_read returns 0 at end of directory. */
-        ret = lfs_dir_read(lfs, &dir, &info);
-        if (ret > 0)
-        {
-            if ((call->start_idx <= entry_idx) && (num_returned < entries_max))
-            {
-                reply->info_array[num_returned].type = info.type;
-                reply->info_array[num_returned].size = info.size;
-                strncpy(reply->info_array[num_returned++].name,
-                        info.name,
-                        name_max); 
-                LOGPRINT_DEBUG("[%u]: %c %u: %s",
-                    (unsigned int)entry_idx,
-                    (info.type == LFS_TYPE_REG) ? 'f' : 'd',
-                    (unsigned int)info.size,
-                    info.name);
-            }
-            entry_idx++;
-        }
-        else 
-        {
-            if (ret < 0)
-            {
-                LOGPRINT_ERROR("Got error on dir read, closing dir: %d", ret);
-            }
-            else
-            {
-                LOGPRINT_DEBUG("Finished reading dir, closing.");
-            }
-            lfs_dir_close(lfs, &dir);
-            break;
-        }
-    }
-
     reply->valid = true;
-    reply->num_entries = entry_idx;
+    reply->num_entries = page.num_entries;
     reply->start_idx = call->start_idx;
-    reply->info_array_count = num_returned; 
+    reply->cursor = page.cursor;
 }
 
 /******************************************************************************
@@ -533,6 +671,7 @@ dirlist(void *call_frame, void *reply_frame, StatusEnum *status)
         call->part_label: string 
         call->path: string 
         call->flags: uint32 
+        call->part_handle: uint32 
     Reply params:
         reply->status: int32 
         reply->fd: int32 
@@ -549,7 +688,8 @@ fileopen(void *call_frame, void *reply_frame, StatusEnum *status)
     lfspart_FileOpen_reply *reply = &reply_msg->msg.fileopen_reply;
     Lfs_Part_t *lpfs;
     lfs_t *lfs;
-    CacheItem *item;
+    const struct lfs_file_config *file_cfg;
+    FdSlot *item;
     int ret;
 
     (void)call;
@@ -560,7 +700,7 @@ fileopen(void *call_frame, void *reply_frame, StatusEnum *status)
     reply_msg->which_msg = lfspart_LfsCallset_fileopen_reply_tag;
     *status = StatusEnum_RPC_SUCCESS;
 
-    ret = get_lfs(call->part_label, &lpfs, &lfs);
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
     if (ret < 0)
     {
         LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
@@ -575,7 +715,7 @@ fileopen(void *call_frame, void *reply_frame, StatusEnum *status)
         return;
     }
 
-    item = cache_add_fd(lfs);
+    item = fd_alloc(lpfs);
     if (!item)
     {
         LOGPRINT_ERROR("Could not get file descriptor");
@@ -587,16 +727,43 @@ fileopen(void *call_frame, void *reply_frame, StatusEnum *status)
     LOGPRINT_DEBUG("Opening %s with flags 0x%08x",
         call->path, (unsigned int)call->flags);
 
-    ret = lfs_file_open(lfs, &item->descr->file, call->path, call->flags);
+    file_cfg = fd_file_cfg(item);
+    if (file_cfg && (call->flags & LFS_O_WRONLY))
+    {
+        Lfs_PartDigest_invalidate(&item->file_cfg);
+    }
+    ret = file_cfg ? lfs_file_opencfg(lfs, &item->file, call->path,
+        call->flags, file_cfg) : LFS_ERR_NOMEM;
     if (ret < 0)
     {
-        cache_rm_fd(item->fd);
+        fd_release(item);
         reply->status = ret;
         reply->fd = -1;
         LOGPRINT_ERROR("Failed file open (flags=0x%08x): %s (ret=%d)",
             (unsigned int)call->flags, call->path, ret);
         return;
     }
+    Lfs_PartTrace_log(lpfs, "o %x %x %s", TRACE_HANDLE(item),
+        (unsigned int)call->flags, call->path);
+
+    /* Files open for writing get the slot's write-behind buffer
+        (unbuffered if there is no memory for it). */
+    if (LFS_PARTRPC_WB_SIZE && (call->flags & LFS_O_WRONLY))
+    {
+        if (!item->wb_buf)
+        {
+            item->wb_buf = (uint8_t *)malloc(LFS_PARTRPC_WB_SIZE);
+        }
+        if (item->wb_buf)
+        {
+            Lfs_PartWb_initBuf(&item->wb, lfs, &item->file, item->wb_buf,
+                LFS_PARTRPC_WB_SIZE);
+        }
+        else
+        {
+            LOGPRINT_WARN("No write-behind buffer for %s.", call->path);
+        }
+    }
 
     /* Add info to the item. */
     ret = lfs_stat(lfs, call->path, &item->info);
@@ -628,7 +795,8 @@ fileclose(void *call_frame, void *reply_frame, StatusEnum *status)
     lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
     lfspart_FileClose_call *call = &call_msg->msg.fileclose_call;
     lfspart_FileClose_reply *reply = &reply_msg->msg.fileclose_reply;
-    CacheItem *item;
+    FdSlot *item;
+    int wb_ret;
     int ret;
 
     (void)call;
@@ -639,29 +807,33 @@ fileclose(void *call_frame, void *reply_frame, StatusEnum *status)
     reply_msg->which_msg = lfspart_LfsCallset_fileclose_reply_tag;
     *status = StatusEnum_RPC_SUCCESS;
 
-    item = cache_find_fd(call->fd);
+    item = fd_lookup(call->fd);
     if (!item)
     {
         *status = StatusEnum_RPC_HANDLER_ERROR;
         return;
     }
 
-    ret = lfs_file_close(item->lfs, &item->descr->file);
-    if (ret < 0)
+    /* Buffered bytes go out first; a (deferred) write error fails the
+        close, but the file is closed regardless. */
+    RTOS_MUTEX_GET(wb_lock);
+    wb_ret = item->wb.buf ? Lfs_PartWb_deinit(&item->wb) : 0;
+    RTOS_MUTEX_PUT(wb_lock);
+
+    /* littlefs drops the file from its open list even when the close
+        fails, so the slot is released either way. */
+    ret = lfs_file_close(item->lfs, &item->file);
+    Lfs_PartTrace_log(item->lpfs, "c %x", TRACE_HANDLE(item));
+    fd_release(item);
+    if (ret < 0 || wb_ret < 0)
     {
-        LOGPRINT_ERROR("Error closing fd=%u: %d", (unsigned int)call->fd, ret);
+        LOGPRINT_ERROR("Error closing fd=%u: %d (%d)", (unsigned int)call->fd,
+            ret, wb_ret);
         *status = StatusEnum_RPC_HANDLER_ERROR;
         return;
     }
 
     LOGPRINT_DEBUG("File %s is now closed.", item->info.name);
-
-    ret = cache_rm_fd(item->fd);
-    if (ret < 0)
-    {
-        *status = StatusEnum_RPC_HANDLER_ERROR;
-        return;
-    }
 }
 
 /******************************************************************************
@@ -689,7 +861,7 @@ fileread(void *call_frame, void *reply_frame, StatusEnum *status)
     lfspart_FileRead_reply *reply = &reply_msg->msg.fileread_reply;
     uint32_t size_max = PROTORPC_ARRAY_LENGTH(reply->data.bytes);
     uint32_t read_size;
-    CacheItem *item;
+    FdSlot *item;
     int ret;
 
     (void)call;
@@ -700,7 +872,7 @@ fileread(void *call_frame, void *reply_frame, StatusEnum *status)
     reply_msg->which_msg = lfspart_LfsCallset_fileread_reply_tag;
     *status = StatusEnum_RPC_SUCCESS;
 
-    item = cache_find_fd(call->fd);
+    item = fd_lookup(call->fd);
     if (!item)
     {
         LOGPRINT_ERROR("Could not retrieve file descriptor: %u",
@@ -711,6 +883,19 @@ fileread(void *call_frame, void *reply_frame, StatusEnum *status)
 
     read_size = MIN(call->read_size, size_max);
 
+    if (item->wb.buf)
+    {
+        RTOS_MUTEX_GET(wb_lock);
+        ret = Lfs_PartWb_flush(&item->wb);
+        RTOS_MUTEX_PUT(wb_lock);
+        if (ret < 0)
+        {
+            reply->status = ret;
+            reply->data.size = 0;
+            return;
+        }
+    }
+
     if (call->use_offset)
     {
         if ((call->seek_flag != LFS_SEEK_SET) &&
@@ -731,8 +916,10 @@ fileread(void *call_frame, void *reply_frame, StatusEnum *status)
         }
 
 
+        Lfs_PartTrace_log(item->lpfs, "s %x %d %d", TRACE_HANDLE(item),
+            (int)call->offset, (int)call->seek_flag);
         ret = lfs_read_from_offset(item->lfs,
-                                   &item->descr->file,
+                                   &item->file,
                                    call->offset,
                                    call->seek_flag,
                                    reply->data.bytes,
@@ -741,11 +928,14 @@ fileread(void *call_frame, void *reply_frame, StatusEnum *status)
     else
     {
         ret = lfs_file_read(item->lfs,
-                            &item->descr->file,
+                            &item->file,
                             reply->data.bytes,
                             read_size);
     }
 
+    Lfs_PartTrace_log(item->lpfs, "r %x %u", TRACE_HANDLE(item),
+        (unsigned int)read_size);
+
     /* Returns the number of bytes read or error code. */
     reply->status = ret;
 
@@ -787,7 +977,7 @@ filewrite(void *call_frame, void *reply_frame, StatusEnum *status)
     lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
     lfspart_FileWrite_call *call = &call_msg->msg.filewrite_call;
     lfspart_FileWrite_reply *reply = &reply_msg->msg.filewrite_reply;
-    CacheItem *item;
+    FdSlot *item;
     int ret;
 
     (void)call;
@@ -798,7 +988,7 @@ filewrite(void *call_frame, void *reply_frame, StatusEnum *status)
     reply_msg->which_msg = lfspart_LfsCallset_filewrite_reply_tag;
     *status = StatusEnum_RPC_SUCCESS;
 
-    item = cache_find_fd(call->fd);
+    item = fd_lookup(call->fd);
     if (!item)
     {
         LOGPRINT_ERROR("Could not retrieve file descriptor: %u",
@@ -818,21 +1008,39 @@ filewrite(void *call_frame, void *reply_frame, StatusEnum *status)
             return;
         }
 
-        ret = lfs_write_to_offset(item->lfs,
-                                  &item->descr->file,
-                                  call->offset,
-                                  call->seek_flag,
-                                  call->data.bytes,
-                                  call->data.size);
+        RTOS_MUTEX_GET(wb_lock);
+        ret = item->wb.buf ? Lfs_PartWb_flush(&item->wb) : 0;
+        RTOS_MUTEX_PUT(wb_lock);
+        if (ret >= 0)
+        {
+            Lfs_PartTrace_log(item->lpfs, "s %x %d %d", TRACE_HANDLE(item),
+                (int)call->offset, (int)call->seek_flag);
+            ret = lfs_write_to_offset(item->lfs,
+                                      &item->file,
+                                      call->offset,
+                                      call->seek_flag,
+                                      call->data.bytes,
+                                      call->data.size);
+        }
+    }
+    else if (item->wb.buf)
+    {
+        /* Accepted into RAM; see Lfs_PartWb.h for durability. */
+        RTOS_MUTEX_GET(wb_lock);
+        ret = Lfs_PartWb_write(&item->wb, call->data.bytes, call->data.size);
+        RTOS_MUTEX_PUT(wb_lock);
     }
     else
     {
         ret = lfs_file_write(item->lfs,
-                             &item->descr->file,
+                             &item->file,
                              call->data.bytes,
                              call->data.size);
     }
 
+    Lfs_PartTrace_log(item->lpfs, "w %x %u", TRACE_HANDLE(item),
+        (unsigned int)call->data.size);
+
     /* Returns the number of bytes written or negative error. */
     reply->status = ret;
 
@@ -848,16 +1056,71 @@ filewrite(void *call_frame, void *reply_frame, StatusEnum *status)
         (unsigned int)call->offset);
 }
 
+/******************************************************************************
+    filesync
+
+    Call params:
+        call->fd: uint32 
+    Reply params:
+        reply->status: int32 
+*//**
+    @brief Implements the RPC filesync handler. On success every byte
+    accepted by filewrite on fd is durable.
+******************************************************************************/
+static void
+filesync(void *call_frame, void *reply_frame, StatusEnum *status)
+{
+    lfspart_LfsCallset *call_msg = (lfspart_LfsCallset *)call_frame;
+    lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
+    lfspart_FileSync_call *call = &call_msg->msg.filesync_call;
+    lfspart_FileSync_reply *reply = &reply_msg->msg.filesync_reply;
+    FdSlot *item;
+    int ret;
+
+    LOGPRINT_DEBUG("==> In filesync handler");
+
+    reply_msg->which_msg = lfspart_LfsCallset_filesync_reply_tag;
+    *status = StatusEnum_RPC_SUCCESS;
+
+    item = fd_lookup(call->fd);
+    if (!item)
+    {
+        *status = StatusEnum_RPC_HANDLER_ERROR;
+        return;
+    }
+
+    RTOS_MUTEX_GET(wb_lock);
+    if (item->wb.buf)
+    {
+        ret = Lfs_PartWb_sync(&item->wb);
+    }
+    else
+    {
+        ret = lfs_file_sync(item->lfs, &item->file);
+    }
+    RTOS_MUTEX_PUT(wb_lock);
+    Lfs_PartTrace_log(item->lpfs, "y %x", TRACE_HANDLE(item));
+
+    reply->status = ret;
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Error syncing fd=%u: %d", (unsigned int)call->fd, ret);
+    }
+}
+
 /******************************************************************************
     remove
 
     Call params:
         call->part_label: string 
         call->path: string 
+        call->part_handle: uint32 
+        call->tx_id: uint32 
     Reply params:
         reply->status: int32 
 *//**
-    @brief Implements the RPC remove handler.
+    @brief Implements the RPC remove handler (with a transaction, the
+    removal is recorded for TxCommit).
 ******************************************************************************/
 static void
 remove_path(void *call_frame, void *reply_frame, StatusEnum *status)
@@ -866,6 +1129,7 @@ remove_path(void *call_frame, void *reply_frame, StatusEnum *status)
     lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
     lfspart_Remove_call *call = &call_msg->msg.remove_call;
     lfspart_Remove_reply *reply = &reply_msg->msg.remove_reply;
+    Lfs_PartTx *tx;
     Lfs_Part_t *lpfs;
     lfs_t *lfs;
     int ret;
@@ -878,7 +1142,7 @@ remove_path(void *call_frame, void *reply_frame, StatusEnum *status)
     reply_msg->which_msg = lfspart_LfsCallset_remove_reply_tag;
     *status = StatusEnum_RPC_SUCCESS;
 
-    ret = get_lfs(call->part_label, &lpfs, &lfs);
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
     if (ret < 0)
     {
         LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
@@ -886,8 +1150,17 @@ remove_path(void *call_frame, void *reply_frame, StatusEnum *status)
         return;
     }
 
+    if (call->tx_id)
+    {
+        tx = tx_find(call->tx_id, lpfs);
+        reply->status = tx ? Lfs_PartTx_remove(tx, call->tx_id, call->path) :
+            LFS_ERR_BADF;
+        return;
+    }
+
     LOGPRINT_DEBUG("Removing file %s.", call->path);
     ret = lfs_remove(lfs, call->path);
+    Lfs_PartTrace_log(lpfs, "d %s", call->path);
     if (ret < 0)
     {
         LOGPRINT_ERROR("Error removing path: %s", call->path);
@@ -901,6 +1174,7 @@ remove_path(void *call_frame, void *reply_frame, StatusEnum *status)
     Call params:
         call->part_label: string 
         call->path: string 
+        call->part_handle: uint32 
     Reply params:
         reply->status: int32 
 *//**
@@ -925,13 +1199,616 @@ getfilesize(void *call_frame, void *reply_frame, StatusEnum *status)
     reply_msg->which_msg = lfspart_LfsCallset_getfilesize_reply_tag;
     *status = StatusEnum_RPC_SUCCESS;
 
-    ret = get_lfs(call->part_label, &lpfs, &lfs);
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
+        *status = StatusEnum_RPC_HANDLER_ERROR;
+        return;
+    }
+}
+
+/******************************************************************************
+    fileget
+
+    Call params:
+        call->part_label: string 
+        call->path: string 
+        call->xfer_id: uint32 
+        call->offset: uint32 
+        call->crc: uint32 
+        call->part_handle: uint32 
+    Reply params:
+        reply->status: int32 
+        reply->xfer_id: uint32 
+        reply->offset: uint32 
+        reply->file_size: uint32 
+        reply->eof: bool 
+        reply->crc: uint32 
+        reply->data: bytes 
+*//**
+    @brief Implements the RPC fileget handler: the next chunk of a whole
+    file transfer (see Lfs_PartXfer.h).
+******************************************************************************/
+static void
+fileget(void *call_frame, void *reply_frame, StatusEnum *status)
+{
+    lfspart_LfsCallset *call_msg = (lfspart_LfsCallset *)call_frame;
+    lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
+    lfspart_FileGet_call *call = &call_msg->msg.fileget_call;
+    lfspart_FileGet_reply *reply = &reply_msg->msg.fileget_reply;
+    Lfs_PartXfer_Result res;
+    Lfs_Part_t *lpfs;
+    lfs_t *lfs;
+    int ret;
+
+    LOGPRINT_DEBUG("==> In fileget handler");
+
+    reply_msg->which_msg = lfspart_LfsCallset_fileget_reply_tag;
+    *status = StatusEnum_RPC_SUCCESS;
+
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
+        *status = StatusEnum_RPC_HANDLER_ERROR;
+        return;
+    }
+
+    ret = Lfs_PartXfer_get(lpfs, call->path, call->xfer_id, call->offset,
+        call->crc, reply->data.bytes, PROTORPC_ARRAY_LENGTH(reply->data.bytes),
+        &res);
+
+    reply->status = ret;
+    reply->xfer_id = res.id;
+    reply->offset = res.offset;
+    reply->file_size = res.file_size;
+    reply->eof = res.eof;
+    reply->crc = res.crc;
+    reply->data.size = res.len;
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Get of %s at %u failed: %d", call->path,
+            (unsigned int)call->offset, ret);
+    }
+}
+
+/******************************************************************************
+    fileput
+
+    Call params:
+        call->part_label: string 
+        call->path: string 
+        call->xfer_id: uint32 
+        call->offset: uint32 
+        call->last: bool 
+        call->crc: uint32 
+        call->data: bytes 
+        call->part_handle: uint32 
+        call->tx_id: uint32 
+    Reply params:
+        reply->status: int32 
+        reply->xfer_id: uint32 
+        reply->offset: uint32 
+        reply->crc: uint32 
+*//**
+    @brief Implements the RPC fileput handler: the next chunk of a whole
+    file transfer (see Lfs_PartXfer.h). With a transaction, the file goes
+    to its staging file (see Lfs_PartTx.h).
+******************************************************************************/
+static void
+fileput(void *call_frame, void *reply_frame, StatusEnum *status)
+{
+    lfspart_LfsCallset *call_msg = (lfspart_LfsCallset *)call_frame;
+    lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
+    lfspart_FilePut_call *call = &call_msg->msg.fileput_call;
+    lfspart_FilePut_reply *reply = &reply_msg->msg.fileput_reply;
+    char staged[LFS_PARTTX_PATH_MAX];
+    const char *path = call->path;
+    Lfs_PartXfer_Result res;
+    Lfs_PartTx *tx = NULL;
+    Lfs_Part_t *lpfs;
+    lfs_t *lfs;
+    int ret;
+
+    LOGPRINT_DEBUG("==> In fileput handler");
+
+    reply_msg->which_msg = lfspart_LfsCallset_fileput_reply_tag;
+    *status = StatusEnum_RPC_SUCCESS;
+
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
+        *status = StatusEnum_RPC_HANDLER_ERROR;
+        return;
+    }
+
+    if (call->tx_id)
+    {
+        tx = tx_find(call->tx_id, lpfs);
+        ret = tx ? Lfs_PartTx_stage(tx, call->tx_id, call->path, staged) :
+            LFS_ERR_BADF;
+        if (ret < 0)
+        {
+            reply->status = ret;
+            return;
+        }
+        path = staged;
+    }
+
+    ret = Lfs_PartXfer_put(lpfs, path, call->xfer_id, call->offset,
+        call->data.bytes, call->data.size, call->last, call->crc, &res);
+    if (tx && ret == 0 && call->last)
+    {
+        Lfs_PartTx_staged(tx, call->tx_id, call->path);
+    }
+
+    reply->status = ret;
+    reply->xfer_id = res.id;
+    reply->offset = res.offset;
+    reply->crc = res.crc;
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Put of %s at %u failed: %d", call->path,
+            (unsigned int)call->offset, ret);
+    }
+}
+
+/******************************************************************************
+    op_stats
+*//**
+    @brief Fills the reply stats of one operation type.
+******************************************************************************/
+static void
+op_stats(
+    lfspart_OpStats *op,
+    uint32_t count,
+    uint64_t bytes,
+    const Lfs_PartDev_Latency *lat)
+{
+    uint32_t i;
+
+    op->count = count;
+    op->bytes = bytes;
+    op->total_us = lat->total_us;
+    op->max_us = lat->max_us;
+    for (i = 0; i < LFS_PARTDEV_LAT_BUCKETS; i++)
+    {
+        op->hist[i] = lat->hist[i];
+    }
+    op->hist_count = LFS_PARTDEV_LAT_BUCKETS;
+}
+
+/******************************************************************************
+    getstats
+
+    Call params:
+        call->part_label: string 
+        call->clear: bool 
+        call->wear_start: uint32 
+        call->part_handle: uint32 
+    Reply params:
+        reply->status: int32 
+        reply->read: OpStats 
+        reply->prog: OpStats 
+        reply->erase: OpStats 
+        reply->cache_hits: uint32 
+        reply->cache_misses: uint32 
+        reply->max_erase_count: uint32 
+        reply->block_count: uint32 
+        reply->wear_start: uint32 
+        reply->wear: uint32[] 
+        reply->mount_us: uint32 
+        reply->rpc_limit: RpcLimitStats 
+*//**
+    @brief Implements the RPC getstats handler: flash I/O counters, latency
+    histograms, the wear map and the mount time of a partition.
+******************************************************************************/
+static void
+getstats(void *call_frame, void *reply_frame, StatusEnum *status)
+{
+    lfspart_LfsCallset *call_msg = (lfspart_LfsCallset *)call_frame;
+    lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
+    lfspart_GetStats_call *call = &call_msg->msg.getstats_call;
+    lfspart_GetStats_reply *reply = &reply_msg->msg.getstats_reply;
+    Lfs_PartDev_Stats stats;
+    Lfs_PartCache_Stats cstats;
+    Lfs_Part_t *lpfs;
+    lfs_t *lfs;
+    int ret;
+
+    LOGPRINT_DEBUG("==> In getstats handler");
+
+    reply_msg->which_msg = lfspart_LfsCallset_getstats_reply_tag;
+    *status = StatusEnum_RPC_SUCCESS;
+
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
+        *status = StatusEnum_RPC_HANDLER_ERROR;
+        return;
+    }
+
+    Lfs_Part_getDevStats(lpfs, &stats, call->clear);
+    Lfs_Part_getCacheStats(lpfs, &cstats, call->clear);
+
+    reply->status = 0;
+    reply->has_read = true;
+    op_stats(&reply->read, stats.reads, stats.read_bytes,
+        &stats.lat[LFS_PARTDEV_OP_READ]);
+    reply->has_prog = true;
+    op_stats(&reply->prog, stats.progs, stats.prog_bytes,
+        &stats.lat[LFS_PARTDEV_OP_PROG]);
+    reply->has_erase = true;
+    op_stats(&reply->erase, stats.erases,
+        (uint64_t)stats.erases*lpfs->dev->block_size,
+        &stats.lat[LFS_PARTDEV_OP_ERASE]);
+    reply->cache_hits = cstats.hits;
+    reply->cache_misses = cstats.misses;
+    reply->max_erase_count = stats.max_erase_count;
+    reply->block_count = lpfs->dev->size/lpfs->dev->block_size;
+    reply->wear_start = call->wear_start;
+    reply->wear_count = Lfs_Part_getWear(lpfs, call->wear_start, reply->wear,
+        PROTORPC_ARRAY_LENGTH(reply->wear));
+    reply->mount_us = lpfs->mount_us;
+
+    if (rpc_limit)
+    {
+        RpcLimit_Stats lstats;
+
+        RpcLimit_getStats(rpc_limit, &lstats, call->clear);
+        reply->has_rpc_limit = true;
+        reply->rpc_limit.admitted = lstats.admitted;
+        reply->rpc_limit.rejected_client = lstats.rejected_client;
+        reply->rpc_limit.rejected_callset = lstats.rejected_callset;
+        reply->rpc_limit.rejected_inflight = lstats.rejected_inflight;
+        reply->rpc_limit.in_flight = lstats.in_flight;
+        reply->rpc_limit.max_in_flight = lstats.max_in_flight;
+    }
+}
+
+/******************************************************************************
+    filesig
+
+    Call params:
+        call->part_label: string 
+        call->path: string 
+        call->block_size: uint32 
+        call->start_block: uint32 
+        call->part_handle: uint32 
+    Reply params:
+        reply->status: int32 
+        reply->file_size: uint32 
+        reply->block_size: uint32 
+        reply->start_block: uint32 
+        reply->sigs: BlockSig[] 
+*//**
+    @brief Implements the RPC filesig handler: block signatures of a file
+    for a delta update (see Lfs_PartDelta.h).
+******************************************************************************/
+static void
+filesig(void *call_frame, void *reply_frame, StatusEnum *status)
+{
+    lfspart_LfsCallset *call_msg = (lfspart_LfsCallset *)call_frame;
+    lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
+    lfspart_FileSig_call *call = &call_msg->msg.filesig_call;
+    lfspart_FileSig_reply *reply = &reply_msg->msg.filesig_reply;
+    Lfs_PartDelta_Sig *sigs;
+    Lfs_Part_t *lpfs;
+    lfs_t *lfs;
+    int ret;
+    int i;
+
+    LOGPRINT_DEBUG("==> In filesig handler");
+
+    reply_msg->which_msg = lfspart_LfsCallset_filesig_reply_tag;
+    *status = StatusEnum_RPC_SUCCESS;
+
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
+        *status = StatusEnum_RPC_HANDLER_ERROR;
+        return;
+    }
+
+    /* Per call: the TCP and UDP servers may run filesig at once. */
+    sigs = (Lfs_PartDelta_Sig *)malloc(PROTORPC_ARRAY_LENGTH(reply->sigs)*
+        sizeof(Lfs_PartDelta_Sig));
+    if (!sigs)
+    {
+        reply->status = LFS_ERR_NOMEM;
+        return;
+    }
+    ret = Lfs_PartDelta_signatures(lpfs, call->path, call->block_size,
+        call->start_block, sigs, PROTORPC_ARRAY_LENGTH(reply->sigs),
+        &reply->file_size);
+
+    reply->status = (ret < 0) ? ret : 0;
+    reply->block_size = call->block_size;
+    reply->start_block = call->start_block;
+    for (i = 0; i < ret; i++)
+    {
+        reply->sigs[i].weak = sigs[i].weak;
+        memcpy(reply->sigs[i].strong.bytes, sigs[i].strong,
+            LFS_PARTDELTA_STRONG_LEN);
+        reply->sigs[i].strong.size = LFS_PARTDELTA_STRONG_LEN;
+    }
+    reply->sigs_count = (ret < 0) ? 0 : ret;
+    free(sigs);
+}
+
+/******************************************************************************
+    filepatch
+
+    Call params:
+        call->part_label: string 
+        call->path: string 
+        call->xfer_id: uint32 
+        call->block_size: uint32 
+        call->copy_block: uint32 
+        call->copy_count: uint32 
+        call->data: bytes 
+        call->last: bool 
+        call->crc: uint32 
+        call->part_handle: uint32 
+    Reply params:
+        reply->status: int32 
+        reply->xfer_id: uint32 
+        reply->size: uint32 
+        reply->crc: uint32 
+*//**
+    @brief Implements the RPC filepatch handler: the next step of a delta
+    update (see Lfs_PartDelta.h).
+******************************************************************************/
+static void
+filepatch(void *call_frame, void *reply_frame, StatusEnum *status)
+{
+    lfspart_LfsCallset *call_msg = (lfspart_LfsCallset *)call_frame;
+    lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
+    lfspart_FilePatch_call *call = &call_msg->msg.filepatch_call;
+    lfspart_FilePatch_reply *reply = &reply_msg->msg.filepatch_reply;
+    Lfs_PartDelta_Result res;
+    Lfs_Part_t *lpfs;
+    lfs_t *lfs;
+    int ret;
+
+    LOGPRINT_DEBUG("==> In filepatch handler");
+
+    reply_msg->which_msg = lfspart_LfsCallset_filepatch_reply_tag;
+    *status = StatusEnum_RPC_SUCCESS;
+
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
     if (ret < 0)
     {
         LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
         *status = StatusEnum_RPC_HANDLER_ERROR;
         return;
     }
+
+    ret = Lfs_PartDelta_patch(lpfs, call->path, call->xfer_id,
+        call->block_size, call->copy_block, call->copy_count,
+        call->data.bytes, call->data.size, call->last, call->crc, &res);
+
+    reply->status = ret;
+    reply->xfer_id = res.id;
+    reply->size = res.size;
+    reply->crc = res.crc;
+}
+
+/******************************************************************************
+    txbegin
+
+    Call params:
+        call->part_label: string 
+        call->part_handle: uint32 
+    Reply params:
+        reply->status: int32 
+        reply->tx_id: uint32 
+*//**
+    @brief Implements the RPC txbegin handler: opens a transaction (see
+    Lfs_PartTx.h); an unfinished one of the partition is aborted.
+******************************************************************************/
+static void
+txbegin(void *call_frame, void *reply_frame, StatusEnum *status)
+{
+    lfspart_LfsCallset *call_msg = (lfspart_LfsCallset *)call_frame;
+    lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
+    lfspart_TxBegin_call *call = &call_msg->msg.txbegin_call;
+    lfspart_TxBegin_reply *reply = &reply_msg->msg.txbegin_reply;
+    Lfs_PartTx *tx = NULL;
+    Lfs_Part_t *lpfs;
+    lfs_t *lfs;
+    uint32_t i;
+    int ret;
+
+    LOGPRINT_DEBUG("==> In txbegin handler");
+
+    reply_msg->which_msg = lfspart_LfsCallset_txbegin_reply_tag;
+    *status = StatusEnum_RPC_SUCCESS;
+
+    ret = get_lfs(call->part_label, call->part_handle, &lpfs, &lfs);
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
+        *status = StatusEnum_RPC_HANDLER_ERROR;
+        return;
+    }
+
+    /* The slot of the transaction being replaced, else a free one. The
+       lock is held until the slot is taken (its id set). */
+    RTOS_MUTEX_GET(tx_lock);
+    for (i = 0; i < LFS_PARTRPC_TX_MAX; i++)
+    {
+        if (lpfs->tx == &tx_table[i] || (!tx && !tx_table[i].id))
+        {
+            tx = &tx_table[i];
+        }
+    }
+    if (!tx)
+    {
+        RTOS_MUTEX_PUT(tx_lock);
+        LOGPRINT_ERROR("No free transaction.");
+        reply->status = LFS_ERR_NOMEM;
+        return;
+    }
+
+    tx_seq++;
+    reply->status = Lfs_PartTx_begin(tx, lpfs,
+        (tx_seq << TX_INDEX_BITS) | (uint32_t)(tx - tx_table));
+    reply->tx_id = (reply->status < 0) ? 0 : tx->id;
+    RTOS_MUTEX_PUT(tx_lock);
+}
+
+/******************************************************************************
+    txcommit
+
+    Call params:
+        call->tx_id: uint32 
+        call->abort: bool 
+    Reply params:
+        reply->status: int32 
+        reply->files: uint32 
+*//**
+    @brief Implements the RPC txcommit handler: commits or aborts a
+    transaction.
+******************************************************************************/
+static void
+txcommit(void *call_frame, void *reply_frame, StatusEnum *status)
+{
+    lfspart_LfsCallset *call_msg = (lfspart_LfsCallset *)call_frame;
+    lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
+    lfspart_TxCommit_call *call = &call_msg->msg.txcommit_call;
+    lfspart_TxCommit_reply *reply = &reply_msg->msg.txcommit_reply;
+    Lfs_PartTx *tx;
+    int ret;
+
+    LOGPRINT_DEBUG("==> In txcommit handler");
+
+    reply_msg->which_msg = lfspart_LfsCallset_txcommit_reply_tag;
+    *status = StatusEnum_RPC_SUCCESS;
+
+    tx = tx_find(call->tx_id, NULL);
+    if (!tx)
+    {
+        reply->status = LFS_ERR_BADF;
+        return;
+    }
+
+    ret = call->abort ? Lfs_PartTx_abort(tx, call->tx_id) :
+        Lfs_PartTx_commit(tx, call->tx_id);
+    reply->status = (ret < 0) ? ret : 0;
+    reply->files = (ret < 0) ? 0 : ret;
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Transaction %u failed: %d", (unsigned int)call->tx_id,
+            ret);
+    }
+}
+
+/** @brief Context of getdigests_entry. */
+typedef struct DigestsCtx
+{
+    Lfs_Part_t *lpfs;
+    lfspart_GetDigests_reply *reply;
+
+} DigestsCtx;
+
+/******************************************************************************
+    getdigests_entry
+*//**
+    @brief Adds the digest of a file to the getdigests reply (also the
+    Lfs_PartDigest_walk callback).
+******************************************************************************/
+static int
+getdigests_entry(void *ctx, const char *path)
+{
+    DigestsCtx *dc = (DigestsCtx *)ctx;
+    lfspart_GetDigests_reply *reply = dc->reply;
+    lfspart_FileDigest *fd = &reply->digests[reply->digests_count++];
+    Lfs_PartDigest digest;
+    int ret;
+
+    ret = Lfs_PartDigest_get(dc->lpfs, path, &digest);
+    strncpy(fd->path, path, PROTORPC_ARRAY_LENGTH(fd->path) - 1);
+    fd->path[PROTORPC_ARRAY_LENGTH(fd->path) - 1] = '\0';
+    fd->status = (ret < 0) ? ret : 0;
+    fd->cached = (ret == 1);
+    fd->size = digest.size;
+    fd->crc = digest.crc;
+    memcpy(fd->sha256.bytes, digest.sha256, LFS_PARTDIGEST_SHA256_LEN);
+    fd->sha256.size = (ret < 0) ? 0 : LFS_PARTDIGEST_SHA256_LEN;
+
+    return 0;
+}
+
+/******************************************************************************
+    getdigests
+
+    Call params:
+        call->part_label: string 
+        call->part_handle: uint32 
+        call->paths: string [repeated]
+        call->dir: string 
+        call->cursor: uint32 
+    Reply params:
+        reply->status: int32 
+        reply->digests: message [repeated]
+        reply->cursor: uint32 
+*//**
+    @brief Implements the RPC getdigests handler: digests of the given
+    files, else of a page of the files of a directory tree (see
+    Lfs_PartDigest.h).
+******************************************************************************/
+static void
+getdigests(void *call_frame, void *reply_frame, StatusEnum *status)
+{
+    lfspart_LfsCallset *call_msg = (lfspart_LfsCallset *)call_frame;
+    lfspart_LfsCallset *reply_msg = (lfspart_LfsCallset *)reply_frame;
+    lfspart_GetDigests_call *call = &call_msg->msg.getdigests_call;
+    lfspart_GetDigests_reply *reply = &reply_msg->msg.getdigests_reply;
+    DigestsCtx dc;
+    lfs_t *lfs;
+    pb_size_t i;
+    int ret;
+
+    LOGPRINT_DEBUG("==> In getdigests handler");
+
+    reply_msg->which_msg = lfspart_LfsCallset_getdigests_reply_tag;
+    *status = StatusEnum_RPC_SUCCESS;
+
+    ret = get_lfs(call->part_label, call->part_handle, &dc.lpfs, &lfs);
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Cound not get partition with label: %s", call->part_label);
+        *status = StatusEnum_RPC_HANDLER_ERROR;
+        return;
+    }
+
+    dc.reply = reply;
+    reply->digests_count = 0;
+    reply->status = 0;
+    reply->cursor = 0;
+    if (call->paths_count)
+    {
+        for (i = 0; i < call->paths_count; i++)
+        {
+            getdigests_entry(&dc, call->paths[i]);
+        }
+        return;
+    }
+
+    ret = Lfs_PartDigest_walk(dc.lpfs, call->dir, call->cursor,
+        PROTORPC_ARRAY_LENGTH(reply->digests), getdigests_entry, &dc);
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Failed walking dir %s: %d", call->dir, ret);
+        reply->status = ret;
+        return;
+    }
+    reply->cursor = ret;
 }
 
 static ProtoRpc_Handler_Entry handlers[] = {
@@ -946,6 +1823,15 @@ static ProtoRpc_Handler_Entry handlers[] = {
     PROTORPC_ADD_HANDLER(lfspart_LfsCallset_filewrite_call_tag   , filewrite)   , 
     PROTORPC_ADD_HANDLER(lfspart_LfsCallset_remove_call_tag      , remove_path) , 
     PROTORPC_ADD_HANDLER(lfspart_LfsCallset_getfilesize_call_tag , getfilesize) , 
+    PROTORPC_ADD_HANDLER(lfspart_LfsCallset_filesync_call_tag    , filesync)    , 
+    PROTORPC_ADD_HANDLER(lfspart_LfsCallset_fileget_call_tag     , fileget)     , 
+    PROTORPC_ADD_HANDLER(lfspart_LfsCallset_fileput_call_tag     , fileput)     , 
+    PROTORPC_ADD_HANDLER(lfspart_LfsCallset_getstats_call_tag    , getstats)    , 
+    PROTORPC_ADD_HANDLER(lfspart_LfsCallset_filesig_call_tag     , filesig)     , 
+    PROTORPC_ADD_HANDLER(lfspart_LfsCallset_filepatch_call_tag   , filepatch)   , 
+    PROTORPC_ADD_HANDLER(lfspart_LfsCallset_txbegin_call_tag     , txbegin)     , 
+    PROTORPC_ADD_HANDLER(lfspart_LfsCallset_txcommit_call_tag    , txcommit)    , 
+    PROTORPC_ADD_HANDLER(lfspart_LfsCallset_getdigests_call_tag  , getdigests)  , 
 };
 
 #define NUM_HANDLERS    PROTORPC_ARRAY_LENGTH(handlers)
@@ -959,18 +1845,53 @@ static ProtoRpc_Handler_Entry handlers[] = {
 int
 Lfs_PartRpc_init(Lfs_Part_t *lpfs)
 {
-    CList_init(&cache);
+    fd_table_init();
+
+    wb_lock = RTOS_MUTEX_CREATE_STATIC(&wb_lockbuf);
+    tx_lock = RTOS_MUTEX_CREATE_STATIC(&tx_lockbuf);
+    if (!wb_lock || !tx_lock)
+    {
+        return -1;
+    }
 
     _lpfs = lpfs;
-    pool = lfs_pool_init(MAX_OPEN_DESCRIPTORS);
-    if (!pool)
+
+    if (Lfs_PartXfer_init() < 0)
+    {
+        LOGPRINT_WARN("File transfers run without read ahead.");
+    }
+    if (Lfs_PartDelta_init() < 0)
     {
-        _lpfs = NULL;
+        return -1;
+    }
+
+    if (LFS_PARTRPC_WB_SIZE && RTOS_TASK_CREATE(
+        wb_task,
+        "LfsRpcWb",
+        LFS_PARTRPC_WB_TASK_STACK,
+        NULL,
+        LFS_PARTRPC_WB_TASK_PRIO,
+        &wb_task_handle) < 0)
+    {
+        LOGPRINT_ERROR("Error starting write-behind task.");
         return -1;
     }
     return 0;
 }
 
+/******************************************************************************
+    [docimport Lfs_PartRpc_setLimit]
+*//**
+    @brief Sets the RPC limiter whose counters GetStats reports (the one
+    given to TcpRpcServer_setLimit/UdpRpcServer_setLimit).
+    @param[in] limit  Pointer to initialized RpcLimit, NULL for none.
+******************************************************************************/
+void
+Lfs_PartRpc_setLimit(RpcLimit *limit)
+{
+    rpc_limit = limit;
+}
+
 /******************************************************************************
     [docimport Lfs_PartRpc_resolver]
 *//**
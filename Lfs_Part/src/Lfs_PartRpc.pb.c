@@ -75,6 +75,72 @@ PB_BIND(lfspart_GetFileSize_call, lfspart_GetFileSize_call, AUTO)
 PB_BIND(lfspart_GetFileSize_reply, lfspart_GetFileSize_reply, AUTO)
 
 
+PB_BIND(lfspart_FileSync_call, lfspart_FileSync_call, AUTO)
+
+
+PB_BIND(lfspart_FileSync_reply, lfspart_FileSync_reply, AUTO)
+
+
+PB_BIND(lfspart_FileGet_call, lfspart_FileGet_call, AUTO)
+
+
+PB_BIND(lfspart_FileGet_reply, lfspart_FileGet_reply, 2)
+
+
+PB_BIND(lfspart_FilePut_call, lfspart_FilePut_call, 2)
+
+
+PB_BIND(lfspart_FilePut_reply, lfspart_FilePut_reply, AUTO)
+
+
+PB_BIND(lfspart_OpStats, lfspart_OpStats, AUTO)
+
+
+PB_BIND(lfspart_RpcLimitStats, lfspart_RpcLimitStats, AUTO)
+
+
+PB_BIND(lfspart_GetStats_call, lfspart_GetStats_call, AUTO)
+
+
+PB_BIND(lfspart_GetStats_reply, lfspart_GetStats_reply, 2)
+
+
+PB_BIND(lfspart_BlockSig, lfspart_BlockSig, AUTO)
+
+
+PB_BIND(lfspart_FileSig_call, lfspart_FileSig_call, AUTO)
+
+
+PB_BIND(lfspart_FileSig_reply, lfspart_FileSig_reply, 2)
+
+
+PB_BIND(lfspart_FilePatch_call, lfspart_FilePatch_call, 2)
+
+
+PB_BIND(lfspart_FilePatch_reply, lfspart_FilePatch_reply, AUTO)
+
+
+PB_BIND(lfspart_TxBegin_call, lfspart_TxBegin_call, AUTO)
+
+
+PB_BIND(lfspart_TxBegin_reply, lfspart_TxBegin_reply, AUTO)
+
+
+PB_BIND(lfspart_TxCommit_call, lfspart_TxCommit_call, AUTO)
+
+
+PB_BIND(lfspart_TxCommit_reply, lfspart_TxCommit_reply, AUTO)
+
+
+PB_BIND(lfspart_FileDigest, lfspart_FileDigest, AUTO)
+
+
+PB_BIND(lfspart_GetDigests_call, lfspart_GetDigests_call, 2)
+
+
+PB_BIND(lfspart_GetDigests_reply, lfspart_GetDigests_reply, 2)
+
+
 PB_BIND(lfspart_LfsCallset, lfspart_LfsCallset, 2)
 
 
@@ -0,0 +1,375 @@
+/*******************************************************************************
+ *  @file: Lfs_PartTrace.c
+ *
+ *  @brief: Recorder and replayer of file level operation traces.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartTrace.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartTrace";
+
+/** @brief Replay I/O chunk size. */
+#define REPLAY_IO_SIZE      512
+/** @brief Longest path in a trace line (the scanf widths below). */
+#define REPLAY_PATH_MAX     256
+
+/** @brief Open file during replay. */
+typedef struct ReplayFile
+{
+    uint32_t handle;
+    bool used;
+    lfs_file_t file;
+
+} ReplayFile;
+
+/******************************************************************************
+    [docimport Lfs_PartTrace_log]
+*//**
+    @brief Records one operation (printf style line without newline), if
+    recording. Called by the Lfs_Part front ends (Lfs_PartRpc, Lfs_Api).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] fmt  Format.
+******************************************************************************/
+void
+Lfs_PartTrace_log(Lfs_Part_t *lpfs, const char *fmt, ...)
+{
+    Lfs_PartTrace *trace = &lpfs->trace;
+    va_list args;
+    uint32_t room;
+    int n;
+
+    if (!trace->buf)
+    {
+        return;
+    }
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    if (trace->buf)
+    {
+        /* Room for the line, its newline and the terminating NUL. */
+        room = trace->size - trace->len;
+        va_start(args, fmt);
+        n = vsnprintf(trace->buf + trace->len, room, fmt, args);
+        va_end(args);
+        if (n < 0 || (uint32_t)n + 2 > room)
+        {
+            trace->buf[trace->len] = '\0';
+            trace->dropped++;
+        }
+        else
+        {
+            trace->len += n;
+            trace->buf[trace->len++] = '\n';
+            trace->buf[trace->len] = '\0';
+        }
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+}
+
+/******************************************************************************
+    find_file
+*//**
+    @brief Finds the replay file of a handle (or a free slot for NULL).
+******************************************************************************/
+static ReplayFile *
+find_file(ReplayFile *files, uint32_t handle, bool free_slot)
+{
+    uint32_t i;
+
+    for (i = 0; i < LFS_PARTTRACE_MAX_OPEN; i++)
+    {
+        if (free_slot ? !files[i].used :
+            (files[i].used && files[i].handle == handle))
+        {
+            return &files[i];
+        }
+    }
+    return NULL;
+}
+
+/******************************************************************************
+    make_parents
+*//**
+    @brief Creates the parent directories of path.
+******************************************************************************/
+static void
+make_parents(lfs_t *lfs, const char *path)
+{
+    char dir[REPLAY_PATH_MAX];
+    const char *p = path;
+
+    while ((p = strchr(p + 1, '/')) != NULL)
+    {
+        if ((size_t)(p - path) >= sizeof(dir))
+        {
+            return;
+        }
+        memcpy(dir, path, p - path);
+        dir[p - path] = '\0';
+        lfs_mkdir(lfs, dir);
+    }
+}
+
+/******************************************************************************
+    replay_op
+*//**
+    @brief Replays one trace line.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+static int
+replay_op(
+    lfs_t *lfs,
+    ReplayFile *files,
+    uint8_t *io,
+    const char *line,
+    Lfs_PartTrace_Result *result)
+{
+    struct lfs_info info;
+    ReplayFile *rf = NULL;
+    uint32_t handle = 0, size = 0, flags, chunk;
+    int32_t off, whence;
+    char path[REPLAY_PATH_MAX];
+    char op = line[0];
+    lfs_dir_t dir;
+    int ret = 0;
+    int n = 0;
+
+    if (op == 'd' || op == 'l')
+    {
+        CHECK_COND_RETURN(sscanf(line + 1, " %255[^\n]", path) != 1, -1);
+    }
+    else
+    {
+        CHECK_COND_RETURN(sscanf(line + 1, " %x%n", (unsigned *)&handle, &n) != 1,
+            -1);
+        rf = find_file(files, handle, op == 'o');
+        CHECK_COND_RETURN(!rf, -1);
+        line += n + 1;
+    }
+
+    switch (op)
+    {
+    case 'o':
+        CHECK_COND_RETURN(sscanf(line, " %x %255[^\n]", (unsigned *)&flags,
+            path) != 2, -1);
+        ret = lfs_file_open(lfs, &rf->file, path, flags);
+        if (ret == LFS_ERR_NOENT && (flags & LFS_O_CREAT))
+        {
+            make_parents(lfs, path);
+            ret = lfs_file_open(lfs, &rf->file, path, flags);
+        }
+        if (ret >= 0)
+        {
+            rf->used = true;
+            rf->handle = handle;
+        }
+        break;
+    case 'c':
+        ret = lfs_file_close(lfs, &rf->file);
+        rf->used = false;
+        break;
+    case 'r':
+    case 'w':
+        CHECK_COND_RETURN(sscanf(line, " %u", (unsigned *)&size) != 1, -1);
+        while (size && ret >= 0)
+        {
+            chunk = (size < REPLAY_IO_SIZE) ? size : REPLAY_IO_SIZE;
+            if (op == 'r')
+            {
+                ret = lfs_file_read(lfs, &rf->file, io, chunk);
+                if (ret > 0)
+                {
+                    result->read_bytes += ret;
+                }
+                if (ret < (int)chunk)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                ret = lfs_file_write(lfs, &rf->file, io, chunk);
+                if (ret > 0)
+                {
+                    result->write_bytes += ret;
+                }
+            }
+            size -= chunk;
+        }
+        break;
+    case 's':
+        CHECK_COND_RETURN(sscanf(line, " %d %d", (int *)&off,
+            (int *)&whence) != 2, -1);
+        ret = lfs_file_seek(lfs, &rf->file, off, whence);
+        break;
+    case 'y':
+        ret = lfs_file_sync(lfs, &rf->file);
+        break;
+    case 'd':
+        ret = lfs_remove(lfs, path);
+        break;
+    case 'l':
+        ret = lfs_dir_open(lfs, &dir, path);
+        if (ret >= 0)
+        {
+            while ((ret = lfs_dir_read(lfs, &dir, &info)) > 0)
+            {
+            }
+            lfs_dir_close(lfs, &dir);
+        }
+        break;
+    default:
+        return -1;
+    }
+    return (ret < 0) ? ret : 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTrace_replay]
+*//**
+    @brief Replays a trace on a mounted filesystem. Written data is a fixed
+    pattern; missing parent directories of created files are created.
+    @param[in] lfs  Pointer to mounted lfs.
+    @param[in] text  Trace.
+    @param[in] len  Trace length.
+    @param[out] result  Pointer to summary to fill.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartTrace_replay(
+    lfs_t *lfs,
+    const char *text,
+    uint32_t len,
+    Lfs_PartTrace_Result *result)
+{
+    const char *end = text + len;
+    const char *eol;
+    char line[REPLAY_PATH_MAX + 32];
+    ReplayFile *files;
+    uint8_t *io;
+    uint32_t open = 0;
+    uint32_t i;
+
+    memset(result, 0, sizeof(*result));
+
+    files = (ReplayFile *)calloc(LFS_PARTTRACE_MAX_OPEN, sizeof(ReplayFile));
+    io = (uint8_t *)malloc(REPLAY_IO_SIZE);
+    if (!files || !io)
+    {
+        free(files);
+        free(io);
+        LOGPRINT_ERROR("Error allocating replay state.");
+        return -1;
+    }
+    memset(io, 0x5a, REPLAY_IO_SIZE);
+
+    while (text < end)
+    {
+        eol = memchr(text, '\n', end - text);
+        if (!eol)
+        {
+            eol = end;
+        }
+        if (eol > text && (size_t)(eol - text) < sizeof(line))
+        {
+            memcpy(line, text, eol - text);
+            line[eol - text] = '\0';
+
+            result->ops++;
+            if (replay_op(lfs, files, io, line, result) < 0)
+            {
+                result->errors++;
+            }
+
+            for (open = 0, i = 0; i < LFS_PARTTRACE_MAX_OPEN; i++)
+            {
+                open += files[i].used;
+            }
+            if (open > result->max_open)
+            {
+                result->max_open = open;
+            }
+        }
+        text = eol + 1;
+    }
+
+    /* Close what the trace left open. */
+    for (i = 0; i < LFS_PARTTRACE_MAX_OPEN; i++)
+    {
+        if (files[i].used)
+        {
+            lfs_file_close(lfs, &files[i].file);
+        }
+    }
+
+    free(files);
+    free(io);
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTrace_stop]
+*//**
+    @brief Stops recording.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[out] len  Trace length.
+    @return Returns the trace (NUL terminated, the caller frees it), NULL if
+    not recording.
+******************************************************************************/
+char *
+Lfs_PartTrace_stop(Lfs_Part_t *lpfs, uint32_t *len)
+{
+    char *buf;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    buf = lpfs->trace.buf;
+    *len = lpfs->trace.len;
+    if (lpfs->trace.dropped)
+    {
+        LOGPRINT_WARN("Trace buffer full, %u operations dropped.",
+            (unsigned int)lpfs->trace.dropped);
+    }
+    memset(&lpfs->trace, 0, sizeof(lpfs->trace));
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return buf;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTrace_start]
+*//**
+    @brief Starts recording into a RAM buffer (a running recording is
+    discarded).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] size  Buffer size, bytes.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartTrace_start(Lfs_Part_t *lpfs, uint32_t size)
+{
+    uint32_t len;
+    char *buf;
+
+    CHECK_COND_RETURN_MSG(size < 2, -1, "Trace buffer too small.");
+
+    free(Lfs_PartTrace_stop(lpfs, &len));
+
+    buf = (char *)malloc(size);
+    CHECK_COND_RETURN_MSG(!buf, -1, "Error allocating trace buffer.");
+    buf[0] = '\0';
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    lpfs->trace.size = size;
+    lpfs->trace.len = 0;
+    lpfs->trace.dropped = 0;
+    lpfs->trace.buf = buf;
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+    return 0;
+}
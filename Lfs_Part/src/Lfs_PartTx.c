@@ -0,0 +1,582 @@
+/*******************************************************************************
+ *  @file: Lfs_PartTx.c
+ *
+ *  @brief: Multi-file transactions on an Lfs_Part filesystem.
+*******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartTx.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartTx";
+
+/** @brief Journal states. */
+#define TX_OPEN                 1
+#define TX_COMMITTED            2
+
+/** @brief File operations. */
+#define TX_PUT                  1
+#define TX_DEL                  2
+
+/******************************************************************************
+    staged_path
+*//**
+    @brief Makes the staging file path of a file.
+******************************************************************************/
+static void
+staged_path(const char *path, char *staged)
+{
+    snprintf(staged, LFS_PARTTX_PATH_MAX, "%s%s", path, LFS_PARTTX_SUFFIX);
+}
+
+/******************************************************************************
+    journal_write
+*//**
+    @brief Writes the journal of a transaction (replaced atomically on
+    close).
+******************************************************************************/
+static int
+journal_write(Lfs_PartTx *tx, uint32_t state)
+{
+    lfs_t *lfs = &tx->lpfs->lfs;
+    Lfs_PartTx_Hdr hdr;
+    lfs_file_t file;
+    uint32_t i, len, pos = sizeof(hdr);
+    int ret, err;
+
+    hdr.magic = LFS_PARTTX_MAGIC;
+    hdr.state = state;
+    hdr.num_files = tx->num_files;
+    memcpy(tx->journal, &hdr, sizeof(hdr));
+    for (i = 0; i < tx->num_files; i++)
+    {
+        len = strlen(tx->files[i].path);
+        tx->journal[pos++] = tx->files[i].op;
+        tx->journal[pos++] = (uint8_t)len;
+        memcpy(&tx->journal[pos], tx->files[i].path, len);
+        pos += len;
+    }
+
+    ret = lfs_file_open(lfs, &file, LFS_PARTTX_JOURNAL,
+        LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Cannot open the journal.");
+    ret = lfs_file_write(lfs, &file, tx->journal, pos);
+    err = lfs_file_close(lfs, &file);
+    if (ret >= 0)
+    {
+        ret = err;
+    }
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Cannot write the journal.");
+    return 0;
+}
+
+/******************************************************************************
+    journal_read
+*//**
+    @brief Reads and checks the journal into tx (files and lpfs).
+    @return Returns the journal state, 0 if there is no journal, negative
+    lfs error code otherwise.
+******************************************************************************/
+static int
+journal_read(Lfs_PartTx *tx)
+{
+    lfs_t *lfs = &tx->lpfs->lfs;
+    Lfs_PartTx_Hdr hdr;
+    lfs_file_t file;
+    uint32_t i, len, pos = sizeof(hdr);
+    int ret;
+
+    ret = lfs_file_open(lfs, &file, LFS_PARTTX_JOURNAL, LFS_O_RDONLY);
+    if (ret == LFS_ERR_NOENT)
+    {
+        return 0;
+    }
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Cannot open the journal.");
+    ret = lfs_file_read(lfs, &file, tx->journal, sizeof(tx->journal));
+    lfs_file_close(lfs, &file);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    len = (uint32_t)ret;
+    CHECK_COND_RETURN_MSG(len < sizeof(hdr), LFS_ERR_CORRUPT,
+        "Short journal.");
+    memcpy(&hdr, tx->journal, sizeof(hdr));
+    CHECK_COND_RETURN_MSG(hdr.magic != LFS_PARTTX_MAGIC ||
+        hdr.num_files > LFS_PARTTX_FILES ||
+        (hdr.state != TX_OPEN && hdr.state != TX_COMMITTED),
+        LFS_ERR_CORRUPT, "Bad journal header.");
+    for (i = 0; i < hdr.num_files; i++)
+    {
+        CHECK_COND_RETURN_MSG(pos + 2 > len ||
+            tx->journal[pos + 1] >= LFS_PARTTX_PATH_MAX ||
+            pos + 2 + tx->journal[pos + 1] > len,
+            LFS_ERR_CORRUPT, "Bad journal entry.");
+        tx->files[i].op = tx->journal[pos];
+        memcpy(tx->files[i].path, &tx->journal[pos + 2], tx->journal[pos + 1]);
+        tx->files[i].path[tx->journal[pos + 1]] = '\0';
+        tx->files[i].ready = true;
+        pos += 2 + tx->journal[pos + 1];
+    }
+    tx->num_files = hdr.num_files;
+    return (int)hdr.state;
+}
+
+/******************************************************************************
+    finish
+*//**
+    @brief Rolls the files of a transaction forward (renames, removals) or
+    back (staging files removed), then removes the journal. On a rerun
+    (recovery), a missing staging file is a rename already done.
+    @return Returns 0 on success, negative lfs error code otherwise (the
+    journal is kept).
+******************************************************************************/
+static int
+finish(Lfs_PartTx *tx, bool forward, bool rerun)
+{
+    lfs_t *lfs = &tx->lpfs->lfs;
+    char staged[LFS_PARTTX_PATH_MAX];
+    Lfs_PartTx_File *f;
+    uint32_t i;
+    int ret = 0, err;
+
+    for (i = 0; i < tx->num_files; i++)
+    {
+        f = &tx->files[i];
+        staged_path(f->path, staged);
+        if (f->op == TX_PUT)
+        {
+            err = forward ? lfs_rename(lfs, staged, f->path) :
+                lfs_remove(lfs, staged);
+        }
+        else
+        {
+            err = forward ? lfs_remove(lfs, f->path) : 0;
+        }
+        if (err == LFS_ERR_NOENT && (rerun || !forward || f->op != TX_PUT))
+        {
+            err = 0;
+        }
+        if (err < 0)
+        {
+            LOGPRINT_ERROR("Cannot %s %s (%d).",
+                forward ? "commit" : "drop", f->path, err);
+            ret = (ret < 0) ? ret : err;
+        }
+    }
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    ret = lfs_remove(lfs, LFS_PARTTX_JOURNAL);
+    return (ret == LFS_ERR_NOENT) ? 0 : ret;
+}
+
+/******************************************************************************
+    close_tx
+*//**
+    @brief Ends a transaction.
+******************************************************************************/
+static void
+close_tx(Lfs_PartTx *tx)
+{
+    if (tx->lpfs->tx == tx)
+    {
+        tx->lpfs->tx = NULL;
+    }
+    tx->id = 0;
+}
+
+/******************************************************************************
+    is_open
+*//**
+    @brief Tells if tx is the open transaction id of lpfs (called under the
+    partition lock: a stale id fails once its slot is reused).
+******************************************************************************/
+static bool
+is_open(Lfs_PartTx *tx, Lfs_Part_t *lpfs, uint32_t id)
+{
+    return id && tx->id == id && tx->lpfs == lpfs && lpfs->tx == tx;
+}
+
+/******************************************************************************
+    add_file
+*//**
+    @brief Adds a file operation to a transaction (the journal is rewritten
+    when it changes).
+    @return Returns the file entry, NULL on error (ret set).
+******************************************************************************/
+static Lfs_PartTx_File *
+add_file(
+    Lfs_PartTx *tx,
+    Lfs_Part_t *lpfs,
+    uint32_t id,
+    const char *path,
+    uint8_t op,
+    int *ret)
+{
+    Lfs_PartTx_File *f = NULL;
+    char staged[LFS_PARTTX_PATH_MAX];
+    uint8_t prev_op = 0;
+    uint32_t i;
+
+    *ret = LFS_ERR_BADF;
+    CHECK_COND_RETURN_MSG(!is_open(tx, lpfs, id), NULL,
+        "Transaction is not open.");
+    *ret = LFS_ERR_NAMETOOLONG;
+    CHECK_COND_RETURN_MSG(!path[0] || strlen(path) +
+        strlen(LFS_PARTTX_SUFFIX) >= LFS_PARTTX_PATH_MAX, NULL,
+        "Bad transaction path.");
+
+    for (i = 0; i < tx->num_files; i++)
+    {
+        if (strcmp(tx->files[i].path, path) == 0)
+        {
+            f = &tx->files[i];
+            break;
+        }
+    }
+    if (f && f->op == op)
+    {
+        *ret = 0;
+        return f;
+    }
+
+    if (!f)
+    {
+        *ret = LFS_ERR_NOSPC;
+        CHECK_COND_RETURN_MSG(tx->num_files >= LFS_PARTTX_FILES, NULL,
+            "Transaction is full.");
+        f = &tx->files[tx->num_files++];
+        strcpy(f->path, path);
+        f->op = 0;
+    }
+    else if (f->op == TX_PUT)
+    {
+        staged_path(path, staged);
+        lfs_remove(&tx->lpfs->lfs, staged);
+    }
+    prev_op = f->op;
+    f->op = op;
+    f->ready = false;
+
+    *ret = journal_write(tx, TX_OPEN);
+    if (*ret < 0)
+    {
+        /* Keep the files in step with the journal on flash. */
+        if (prev_op)
+        {
+            f->op = prev_op;
+        }
+        else
+        {
+            tx->num_files--;
+        }
+        return NULL;
+    }
+    return f;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTx_begin]
+*//**
+    @brief Opens a transaction. An unfinished transaction of the partition
+    (e.g. of a client that went away) is aborted, and a journal left by a
+    failed commit is recovered first (Lfs_PartTx_recover).
+    @param[in] tx  Transaction.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] id  Transaction id (nonzero), passed back by the caller to
+    every other call: a call with an id that is no longer open (the slot
+    reused by a later begin) fails.
+    @return Returns 0 on success, negative lfs error code otherwise (also
+    if the journal cannot be recovered).
+******************************************************************************/
+int
+Lfs_PartTx_begin(Lfs_PartTx *tx, Lfs_Part_t *lpfs, uint32_t id)
+{
+    int ret;
+
+    CHECK_COND_RETURN(!id, LFS_ERR_INVAL);
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    if (lpfs->tx)
+    {
+        LOGPRINT_WARN("Aborting unfinished transaction %u.",
+            (unsigned int)lpfs->tx->id);
+        Lfs_PartTx_abort(lpfs->tx, lpfs->tx->id);
+    }
+
+    /* The journal of a failed commit (or abort) must not be overwritten. */
+    ret = Lfs_PartTx_recover(lpfs);
+    if (ret < 0)
+    {
+        RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+        LOGPRINT_ERROR("Cannot recover the transaction journal (%d).", ret);
+        return ret;
+    }
+
+    tx->lpfs = lpfs;
+    tx->id = id;
+    tx->num_files = 0;
+    lpfs->tx = tx;
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTx_stage]
+*//**
+    @brief Adds a file write to a transaction and gets the staging file to
+    write it to. Staging the same file again starts it over.
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @param[in] path  File.
+    @param[out] staged  Staging file path (LFS_PARTTX_PATH_MAX bytes).
+    @return Returns 0 on success, LFS_ERR_BADF if tx is not open with id,
+    LFS_ERR_NOSPC if the transaction is full, other negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartTx_stage(
+    Lfs_PartTx *tx,
+    uint32_t id,
+    const char *path,
+    char *staged)
+{
+    Lfs_Part_t *lpfs = tx->lpfs;
+    Lfs_PartTx_File *f;
+    int ret;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    f = add_file(tx, lpfs, id, path, TX_PUT, &ret);
+    if (f)
+    {
+        f->ready = false;
+        staged_path(path, staged);
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTx_staged]
+*//**
+    @brief Marks the staging file of a file complete (it is closed and may
+    be committed).
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @param[in] path  File.
+    @return Returns 0 on success, LFS_ERR_BADF if tx is not open with id,
+    LFS_ERR_NOENT if path is not staged.
+******************************************************************************/
+int
+Lfs_PartTx_staged(Lfs_PartTx *tx, uint32_t id, const char *path)
+{
+    Lfs_Part_t *lpfs = tx->lpfs;
+    int ret;
+    uint32_t i;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    ret = is_open(tx, lpfs, id) ? LFS_ERR_NOENT : LFS_ERR_BADF;
+    for (i = 0; ret == LFS_ERR_NOENT && i < tx->num_files; i++)
+    {
+        if (tx->files[i].op == TX_PUT && strcmp(tx->files[i].path, path) == 0)
+        {
+            tx->files[i].ready = true;
+            ret = 0;
+        }
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTx_remove]
+*//**
+    @brief Adds a file removal to a transaction (a staged write of the file
+    is dropped).
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @param[in] path  File.
+    @return Returns 0 on success, LFS_ERR_BADF if tx is not open with id,
+    LFS_ERR_NOSPC if the transaction is full, other negative lfs error code
+    otherwise.
+******************************************************************************/
+int
+Lfs_PartTx_remove(Lfs_PartTx *tx, uint32_t id, const char *path)
+{
+    Lfs_Part_t *lpfs = tx->lpfs;
+    int ret;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    add_file(tx, lpfs, id, path, TX_DEL, &ret);
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTx_commit]
+*//**
+    @brief Commits a transaction: all its writes and removals take effect,
+    or none do. No other littlefs call of the partition runs in between.
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @return Returns the number of files on success, LFS_ERR_BADF if tx is
+    not open with id, LFS_ERR_INVAL if a staged file is not complete (the
+    transaction stays open), other negative lfs error code otherwise (after
+    the commit point Lfs_PartTx_recover is run to finish the remaining
+    renames).
+******************************************************************************/
+int
+Lfs_PartTx_commit(Lfs_PartTx *tx, uint32_t id)
+{
+    Lfs_Part_t *lpfs = tx->lpfs;
+    struct lfs_info info;
+    uint32_t i;
+    int ret = 0;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    if (!is_open(tx, lpfs, id))
+    {
+        RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+        LOGPRINT_ERROR("Transaction is not open.");
+        return LFS_ERR_BADF;
+    }
+
+    /* Nothing is changed yet: a failed check keeps the transaction. */
+    for (i = 0; i < tx->num_files && ret == 0; i++)
+    {
+        if (tx->files[i].op == TX_PUT && !tx->files[i].ready)
+        {
+            LOGPRINT_ERROR("%s is not complete.", tx->files[i].path);
+            ret = LFS_ERR_INVAL;
+        }
+        else if (lfs_stat(&lpfs->lfs, tx->files[i].path, &info) == 0 &&
+            info.type == LFS_TYPE_DIR)
+        {
+            LOGPRINT_ERROR("%s is a directory.", tx->files[i].path);
+            ret = LFS_ERR_ISDIR;
+        }
+    }
+    if (ret == 0 && tx->num_files)
+    {
+        ret = journal_write(tx, TX_COMMITTED);
+    }
+    if (ret < 0)
+    {
+        RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+        return ret;
+    }
+
+    /* Committed: the renames left by a failure are finished by recovery
+       now, or by the next begin or mount. */
+    ret = tx->num_files ? finish(tx, true, false) : 0;
+    close_tx(tx);
+    if (ret < 0 && Lfs_PartTx_recover(lpfs) < 0)
+    {
+        LOGPRINT_ERROR("Committed transaction left unfinished.");
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return (ret < 0) ? ret : (int)tx->num_files;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTx_abort]
+*//**
+    @brief Aborts a transaction and removes its staging files.
+    @param[in] tx  Transaction.
+    @param[in] id  Transaction id (from Lfs_PartTx_begin).
+    @return Returns 0 on success, LFS_ERR_BADF if tx is not open with id,
+    other negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartTx_abort(Lfs_PartTx *tx, uint32_t id)
+{
+    Lfs_Part_t *lpfs = tx->lpfs;
+    int ret = LFS_ERR_BADF;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    if (is_open(tx, lpfs, id))
+    {
+        ret = tx->num_files ? finish(tx, false, false) : 0;
+        close_tx(tx);
+    }
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTx_recover]
+*//**
+    @brief Finishes a transaction left by a reset (after mount) or by a
+    failed commit: a committed one is rolled forward, an open one is rolled
+    back. Renames done before are skipped.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @return Returns the number of files rolled forward, negative lfs error
+    code otherwise.
+******************************************************************************/
+int
+Lfs_PartTx_recover(Lfs_Part_t *lpfs)
+{
+    struct lfs_info info;
+    Lfs_PartTx *tx;
+    int state, ret;
+
+    /* Most mounts: no journal, no allocation. */
+    if (lfs_stat(&lpfs->lfs, LFS_PARTTX_JOURNAL, &info) < 0)
+    {
+        return 0;
+    }
+
+    tx = (Lfs_PartTx *)calloc(1, sizeof(Lfs_PartTx));
+    CHECK_COND_RETURN_MSG(!tx, LFS_ERR_NOMEM, "No memory for recovery.");
+    tx->lpfs = lpfs;
+
+    RTOS_MUTEX_GET_RECURSIVE(lpfs->lock);
+    state = journal_read(tx);
+    if (state == LFS_ERR_CORRUPT)
+    {
+        /* Not a journal this code wrote; nothing can be finished. */
+        lfs_remove(&lpfs->lfs, LFS_PARTTX_JOURNAL);
+    }
+    ret = (state > 0) ? finish(tx, state == TX_COMMITTED, true) : state;
+    RTOS_MUTEX_PUT_RECURSIVE(lpfs->lock);
+
+    if (ret == 0 && state > 0)
+    {
+        LOGPRINT_INFO("Transaction of %u files %s.",
+            (unsigned int)tx->num_files,
+            (state == TX_COMMITTED) ? "rolled forward" : "rolled back");
+        ret = (state == TX_COMMITTED) ? (int)tx->num_files : 0;
+    }
+    free(tx);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartTx_release]
+*//**
+    @brief Aborts the open transaction of a partition (before it is
+    unmounted).
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartTx_release(Lfs_Part_t *lpfs)
+{
+    if (lpfs->tx)
+    {
+        Lfs_PartTx_abort(lpfs->tx, lpfs->tx->id);
+    }
+}
@@ -0,0 +1,219 @@
+/*******************************************************************************
+ *  @file: Lfs_PartWb.c
+ *
+ *  @brief: Write-behind buffer for an open littlefs file.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_PartWb.h"
+#include "SwTimer.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartWb";
+
+/******************************************************************************
+    take_error
+*//**
+    @brief Returns and clears a deferred error.
+******************************************************************************/
+static int
+take_error(Lfs_PartWb *wb)
+{
+    int err = wb->error;
+    wb->error = 0;
+    return err;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartWb_flush]
+*//**
+    @brief Hands pending bytes to littlefs. Call before any other operation
+    on the file (read, seek, truncate, positioned write).
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_flush(Lfs_PartWb *wb)
+{
+    int ret;
+
+    if (wb->len == 0)
+    {
+        return take_error(wb);
+    }
+
+    ret = lfs_file_write(wb->lfs, wb->file, wb->buf, wb->len);
+    wb->flushes++;
+    wb->len = 0;
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Write-behind flush failed: %d", ret);
+        return ret;
+    }
+    return take_error(wb);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartWb_flushOlder]
+*//**
+    @brief Flushes if pending bytes are older than age_us (timeout flush).
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @param[in] age_us  Age, us.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_flushOlder(Lfs_PartWb *wb, uint64_t age_us)
+{
+    int ret;
+
+    if (wb->len == 0 || SwTimer_getCount() - wb->since_us < age_us)
+    {
+        return 0;
+    }
+
+    /* Nobody waits for this result: keep it for the next call. */
+    ret = Lfs_PartWb_flush(wb);
+    if (ret < 0)
+    {
+        wb->error = ret;
+    }
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartWb_write]
+*//**
+    @brief Writes at the current file position through the buffer.
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @param[in] data  Data.
+    @param[in] size  Number of bytes.
+    @return Returns size on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_write(Lfs_PartWb *wb, const void *data, uint32_t size)
+{
+    const uint8_t *in = (const uint8_t *)data;
+    uint32_t done = 0;
+    int ret;
+
+    CHECK_COND_RETURN(wb->error, take_error(wb));
+    wb->writes++;
+
+    /* Nothing to gather for writes of a buffer or more. */
+    if (wb->len == 0 && size >= wb->size)
+    {
+        return lfs_file_write(wb->lfs, wb->file, data, size);
+    }
+
+    while (done < size)
+    {
+        uint32_t n = wb->size - wb->len;
+
+        n = (n > size - done) ? size - done : n;
+        if (wb->len == 0)
+        {
+            wb->since_us = SwTimer_getCount();
+        }
+        memcpy(wb->buf + wb->len, in + done, n);
+        wb->len += n;
+        done += n;
+
+        if (wb->len == wb->size)
+        {
+            ret = Lfs_PartWb_flush(wb);
+            CHECK_COND_RETURN(ret < 0, ret);
+        }
+    }
+
+    return size;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartWb_sync]
+*//**
+    @brief Flushes and syncs the file: on success all accepted bytes are
+    durable.
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_sync(Lfs_PartWb *wb)
+{
+    int ret = Lfs_PartWb_flush(wb);
+    CHECK_COND_RETURN(ret < 0, ret);
+
+    return lfs_file_sync(wb->lfs, wb->file);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartWb_deinit]
+*//**
+    @brief Flushes and frees the buffer (unless supplied to
+    Lfs_PartWb_initBuf); call before closing the file.
+    @param[in] wb  Pointer to initialized Lfs_PartWb.
+    @return Returns 0 on success, the flush or deferred error otherwise.
+******************************************************************************/
+int
+Lfs_PartWb_deinit(Lfs_PartWb *wb)
+{
+    int ret = Lfs_PartWb_flush(wb);
+
+    if (wb->own_buf)
+    {
+        free(wb->buf);
+    }
+    memset(wb, 0, sizeof(Lfs_PartWb));
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartWb_initBuf]
+*//**
+    @brief Initializes a write-behind buffer for an open file on a caller
+    supplied buffer (e.g. one kept per descriptor slot, so opens do not
+    allocate).
+    @param[in] wb  Pointer to uninitialized Lfs_PartWb.
+    @param[in] lfs  Pointer to mounted lfs.
+    @param[in] file  Pointer to file open for writing.
+    @param[in] buf  Buffer, valid until Lfs_PartWb_deinit.
+    @param[in] size  Buffer size.
+******************************************************************************/
+void
+Lfs_PartWb_initBuf(
+    Lfs_PartWb *wb,
+    lfs_t *lfs,
+    lfs_file_t *file,
+    uint8_t *buf,
+    uint32_t size)
+{
+    memset(wb, 0, sizeof(Lfs_PartWb));
+    wb->lfs = lfs;
+    wb->file = file;
+    wb->buf = buf;
+    wb->size = size;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartWb_init]
+*//**
+    @brief Initializes a write-behind buffer for an open file.
+    @param[in] wb  Pointer to uninitialized Lfs_PartWb.
+    @param[in] lfs  Pointer to mounted lfs.
+    @param[in] file  Pointer to file open for writing.
+    @param[in] size  Buffer size (e.g. the block size).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+Lfs_PartWb_init(Lfs_PartWb *wb, lfs_t *lfs, lfs_file_t *file, uint32_t size)
+{
+    uint8_t *buf = (uint8_t *)malloc(size);
+
+    memset(wb, 0, sizeof(Lfs_PartWb));
+    CHECK_COND_RETURN_MSG(!buf, -1, "Error allocating memory.");
+
+    Lfs_PartWb_initBuf(wb, lfs, file, buf, size);
+    wb->own_buf = true;
+    return 0;
+}
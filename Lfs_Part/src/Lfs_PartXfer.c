@@ -0,0 +1,782 @@
+/*******************************************************************************
+ *  @file: Lfs_PartXfer.c
+ *
+ *  @brief: Whole file transfers with pipelined flash I/O.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "Lfs_Part.h"
+#include "Lfs_PartXfer.h"
+#include "Lfs_PartDigest.h"
+#include "lfs_util.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "Lfs_PartXfer";
+
+/** @brief A transfer id is the session index in the low XFER_INDEX_BITS
+    and the session generation above (never 0). */
+#define XFER_INDEX_BITS         4
+#define XFER_INDEX_MASK         ((1u << XFER_INDEX_BITS) - 1)
+#define XFER_GEN_MASK           0x7fff
+
+_Static_assert(LFS_PARTXFER_SESSIONS <= 8,
+    "A session needs an event flag (and an index).");
+
+#define MIN(x,y)  (((x) < (y)) ? (x) : (y))
+
+/** @brief Transfer session. */
+typedef struct XferSession
+{
+    uint32_t id;
+    uint16_t gen;
+    bool used;
+    bool put;
+    Lfs_Part_t *lpfs;
+    char path[LFS_PARTXFER_PATH_MAX];
+
+    lfs_file_t file;
+    struct lfs_file_config file_cfg;
+    uint8_t *file_buf;
+    uint32_t file_buf_size;
+    /** @brief Chunk buffers (get uses buf[0] for read ahead, put
+        alternates). */
+    uint8_t *buf[2];
+    uint8_t cur;
+
+    /** @brief get: offset of the read ahead chunk; put: bytes written or
+        queued. */
+    uint32_t pos;
+    /** @brief CRC32 of the file up to pos. */
+    uint32_t crc;
+    /** @brief Offset and CRC of the previous call (repeated calls). */
+    uint32_t prev_off;
+    uint32_t prev_crc;
+    /** @brief get: file size and chunk size. */
+    uint32_t file_size;
+    uint32_t chunk;
+    /** @brief get: buf[0] holds (or the pending read fills it with) the
+        chunk at pos. */
+    bool ahead;
+
+    /** @brief An I/O job is queued or running. */
+    bool pending;
+    /** @brief Result of the last read. */
+    int read_ret;
+    /** @brief put: first write error. */
+    int error;
+    uint32_t stamp;
+
+} XferSession;
+
+/** @brief Transfer task job. */
+typedef struct XferJob
+{
+    XferSession *s;
+    bool write;
+    uint8_t buf;
+    uint32_t len;
+
+} XferJob;
+
+static XferSession sessions[LFS_PARTXFER_SESSIONS];
+static uint32_t use_stamp;
+
+/** @brief Protects the sessions: the RPC servers (TCP, UDP) call in from
+    their own tasks, and a call may end another client's session. */
+static RTOS_MUTEX_STATIC_BUF xfer_lockbuf;
+static RTOS_MUTEX xfer_lock;
+
+static RTOS_QUEUE xfer_queue;
+static RTOS_FLAG_GROUP xfer_flags;
+static RTOS_TASK xfer_task_handle;
+
+#define SESSION_FLAG(s)     ((RTOS_FLAGS)1 << ((s) - sessions))
+
+/******************************************************************************
+    [docimport Lfs_PartXfer_crc32]
+*//**
+    @brief Updates a CRC32 (zlib/IEEE, as Python zlib.crc32).
+    @param[in] crc  CRC of the preceding bytes (0 to start).
+    @param[in] data  Data.
+    @param[in] len  Number of bytes.
+    @return Returns the updated CRC.
+******************************************************************************/
+uint32_t
+Lfs_PartXfer_crc32(uint32_t crc, const void *data, uint32_t len)
+{
+    /* lfs_crc is the same polynomial without the pre and post inversion. */
+    return lfs_crc(crc ^ 0xffffffff, data, len) ^ 0xffffffff;
+}
+
+/******************************************************************************
+    io_run
+*//**
+    @brief Runs an I/O job.
+******************************************************************************/
+static void
+io_run(const XferJob *job)
+{
+    XferSession *s = job->s;
+    lfs_t *lfs = &s->lpfs->lfs;
+    int ret;
+
+    if (job->write)
+    {
+        ret = lfs_file_write(lfs, &s->file, s->buf[job->buf], job->len);
+        if (ret >= 0 && (uint32_t)ret != job->len)
+        {
+            ret = LFS_ERR_NOSPC;
+        }
+        if (ret < 0 && !s->error)
+        {
+            s->error = ret;
+        }
+    }
+    else
+    {
+        s->read_ret = lfs_file_read(lfs, &s->file, s->buf[job->buf], job->len);
+    }
+}
+
+/******************************************************************************
+    xfer_task
+*//**
+    @brief Transfer task: runs the queued session I/O.
+******************************************************************************/
+static void
+xfer_task(void *p)
+{
+    XferJob job;
+
+    (void)p;
+    while (1)
+    {
+        if (RTOS_QUEUE_RECV(xfer_queue, &job) == pdTRUE)
+        {
+            io_run(&job);
+            RTOS_SET_FLAGS(xfer_flags, SESSION_FLAG(job.s));
+        }
+    }
+}
+
+/******************************************************************************
+    io_start
+*//**
+    @brief Queues an I/O job of a session (runs it if there is no task).
+******************************************************************************/
+static void
+io_start(XferSession *s, bool write, uint8_t buf, uint32_t len)
+{
+    XferJob job = {.s = s, .write = write, .buf = buf, .len = len};
+
+    if (xfer_queue)
+    {
+        RTOS_CLR_FLAGS(xfer_flags, SESSION_FLAG(s));
+        s->pending = true;
+        if (RTOS_QUEUE_SEND(xfer_queue, &job) == pdTRUE)
+        {
+            return;
+        }
+        s->pending = false;
+    }
+    io_run(&job);
+}
+
+/******************************************************************************
+    io_wait
+*//**
+    @brief Waits for the I/O job of a session.
+******************************************************************************/
+static void
+io_wait(XferSession *s)
+{
+    if (s->pending)
+    {
+        RTOS_PEND_ALL_FLAGS(xfer_flags, SESSION_FLAG(s));
+        s->pending = false;
+    }
+}
+
+/******************************************************************************
+    session_close
+*//**
+    @brief Ends a session; its id becomes stale.
+    @return Returns the lfs_file_close result.
+******************************************************************************/
+static int
+session_close(XferSession *s)
+{
+    int ret;
+
+    if (!s->used)
+    {
+        return 0;
+    }
+    io_wait(s);
+    ret = lfs_file_close(&s->lpfs->lfs, &s->file);
+    s->used = false;
+    s->gen = (s->gen + 1) & XFER_GEN_MASK;
+    return ret;
+}
+
+/******************************************************************************
+    session_find
+*//**
+    @brief Finds the session of a transfer.
+    Returns the session, NULL if id is not a transfer of path.
+******************************************************************************/
+static XferSession *
+session_find(uint32_t id, Lfs_Part_t *lpfs, const char *path, bool put)
+{
+    uint32_t idx = id & XFER_INDEX_MASK;
+    XferSession *s;
+
+    if (!id || idx >= LFS_PARTXFER_SESSIONS)
+    {
+        return NULL;
+    }
+    s = &sessions[idx];
+    if (!s->used || s->id != id || s->lpfs != lpfs || s->put != put ||
+        strcmp(s->path, path) != 0)
+    {
+        return NULL;
+    }
+    return s;
+}
+
+/******************************************************************************
+    session_open
+*//**
+    @brief Opens a file in a free session, ending the least recently used
+    one if all are in use.
+    @return Returns 0 on success, negative lfs error code otherwise.
+******************************************************************************/
+static int
+session_open(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    bool put,
+    int flags,
+    XferSession **out)
+{
+    uint32_t cache_size = lpfs->lfs.cfg->cache_size;
+    XferSession *s = NULL;
+    uint8_t *buf;
+    uint32_t i;
+    int ret;
+
+    for (i = 0; i < LFS_PARTXFER_SESSIONS; i++)
+    {
+        if (!sessions[i].used)
+        {
+            s = &sessions[i];
+            break;
+        }
+        if (!s || (int32_t)(sessions[i].stamp - s->stamp) < 0)
+        {
+            s = &sessions[i];
+        }
+    }
+    if (s->used)
+    {
+        LOGPRINT_WARN("Ending transfer of %s for %s.", s->path, path);
+        session_close(s);
+    }
+
+    /* Buffers stay with the session. */
+    if (s->file_buf_size < cache_size)
+    {
+        buf = (uint8_t *)realloc(s->file_buf, cache_size);
+        CHECK_COND_RETURN_MSG(!buf, LFS_ERR_NOMEM, "No file buffer.");
+        s->file_buf = buf;
+        s->file_buf_size = cache_size;
+    }
+    for (i = 0; i < (put ? 2u : 1u); i++)
+    {
+        if (!s->buf[i])
+        {
+            s->buf[i] = (uint8_t *)malloc(LFS_PARTXFER_CHUNK_SIZE);
+            CHECK_COND_RETURN_MSG(!s->buf[i], LFS_ERR_NOMEM,
+                "No transfer buffer.");
+        }
+    }
+
+    memset(&s->file_cfg, 0, sizeof(s->file_cfg));
+    s->file_cfg.buffer = s->file_buf;
+    if (put)
+    {
+        Lfs_PartDigest_invalidate(&s->file_cfg);
+    }
+    ret = lfs_file_opencfg(&lpfs->lfs, &s->file, path, flags, &s->file_cfg);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    if (s->gen == 0)
+    {
+        s->gen = 1;
+    }
+    s->id = ((uint32_t)s->gen << XFER_INDEX_BITS) | (uint32_t)(s - sessions);
+    s->used = true;
+    s->put = put;
+    s->lpfs = lpfs;
+    strcpy(s->path, path);
+    s->cur = 0;
+    s->pos = 0;
+    s->crc = 0;
+    s->prev_off = UINT32_MAX;
+    s->ahead = false;
+    s->pending = false;
+    s->error = 0;
+    s->stamp = use_stamp;
+
+    *out = s;
+    return 0;
+}
+
+/******************************************************************************
+    get_seek
+*//**
+    @brief Moves a get session to offset, with crc the CRC before it.
+******************************************************************************/
+static int
+get_seek(XferSession *s, uint32_t offset, uint32_t crc)
+{
+    int ret;
+
+    io_wait(s);
+    ret = lfs_file_seek(&s->lpfs->lfs, &s->file, offset, LFS_SEEK_SET);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    s->pos = offset;
+    s->crc = crc;
+    s->ahead = false;
+    return 0;
+}
+
+/******************************************************************************
+    xfer_get
+*//**
+    @brief Lfs_PartXfer_get with the sessions locked.
+******************************************************************************/
+static int
+xfer_get(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t id,
+    uint32_t offset,
+    uint32_t crc,
+    uint8_t *data,
+    uint32_t max,
+    Lfs_PartXfer_Result *res)
+{
+    XferSession *s;
+    lfs_soff_t size;
+    uint32_t len;
+    int ret = 0;
+
+    memset(res, 0, sizeof(*res));
+    CHECK_COND_RETURN_MSG(strlen(path) >= LFS_PARTXFER_PATH_MAX,
+        LFS_ERR_NAMETOOLONG, "Transfer path too long.");
+    CHECK_COND_RETURN(max == 0, LFS_ERR_INVAL);
+    max = MIN(max, LFS_PARTXFER_CHUNK_SIZE);
+
+    use_stamp++;
+    s = session_find(id, lpfs, path, false);
+    if (s && (offset != s->pos || max < s->chunk))
+    {
+        /* A repeated call continues from the previous CRC. */
+        ret = get_seek(s, offset, (offset == s->prev_off) ? s->prev_crc : crc);
+        s->chunk = max;
+    }
+    else if (!s)
+    {
+        ret = session_open(lpfs, path, false, LFS_O_RDONLY, &s);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        size = lfs_file_size(&lpfs->lfs, &s->file);
+        s->file_size = (size > 0) ? (uint32_t)size : 0;
+        s->chunk = max;
+        ret = get_seek(s, offset, crc);
+    }
+    if (ret < 0)
+    {
+        session_close(s);
+        return ret;
+    }
+    s->stamp = use_stamp;
+
+    if (!s->ahead)
+    {
+        io_start(s, false, 0, s->chunk);
+    }
+    io_wait(s);
+    if (s->read_ret < 0)
+    {
+        ret = s->read_ret;
+        session_close(s);
+        return ret;
+    }
+
+    len = (uint32_t)s->read_ret;
+    memcpy(data, s->buf[0], len);
+    s->prev_off = s->pos;
+    s->prev_crc = s->crc;
+    s->crc = Lfs_PartXfer_crc32(s->crc, data, len);
+    s->pos += len;
+
+    res->offset = s->prev_off;
+    res->len = len;
+    res->file_size = s->file_size;
+    res->crc = s->crc;
+    res->eof = (len < s->chunk) || (s->pos >= s->file_size);
+    if (res->eof)
+    {
+        session_close(s);
+        return 0;
+    }
+
+    /* Read the next chunk while this one is on its way. */
+    s->ahead = true;
+    io_start(s, false, 0, s->chunk);
+    res->id = s->id;
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartXfer_get]
+*//**
+    @brief Reads the next chunk of a file.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[in] id  Transfer id from the previous result, 0 to start.
+    @param[in] offset  Offset of the chunk.
+    @param[in] crc  CRC32 of the bytes before offset (used when a transfer
+    starts or resumes).
+    @param[out] data  Buffer for the chunk.
+    @param[in] max  Size of data (chunks are at most
+    LFS_PARTXFER_CHUNK_SIZE).
+    @param[out] res  Pointer to result to fill.
+    @return Returns 0 on success, negative lfs error code otherwise (the
+    transfer is over).
+******************************************************************************/
+int
+Lfs_PartXfer_get(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t id,
+    uint32_t offset,
+    uint32_t crc,
+    uint8_t *data,
+    uint32_t max,
+    Lfs_PartXfer_Result *res)
+{
+    int ret;
+
+    CHECK_COND_RETURN_MSG(!xfer_lock, LFS_ERR_INVAL,
+        "Transfers are not initialized.");
+    RTOS_MUTEX_GET(xfer_lock);
+    ret = xfer_get(lpfs, path, id, offset, crc, data, max, res);
+    RTOS_MUTEX_PUT(xfer_lock);
+    return ret;
+}
+
+/******************************************************************************
+    put_open
+*//**
+    @brief Starts a put session at offset: a new file at 0, otherwise the
+    existing file truncated to offset, with the CRC of the kept bytes.
+******************************************************************************/
+static int
+put_open(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t offset,
+    XferSession **out,
+    Lfs_PartXfer_Result *res)
+{
+    lfs_t *lfs = &lpfs->lfs;
+    XferSession *s;
+    lfs_soff_t size;
+    uint32_t done = 0;
+    int ret;
+
+    ret = session_open(lpfs, path, true,
+        offset ? LFS_O_RDWR : (LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC), &s);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    if (offset)
+    {
+        size = lfs_file_size(lfs, &s->file);
+        if (size < (lfs_soff_t)offset)
+        {
+            res->offset = (size > 0) ? (uint32_t)size : 0;
+            session_close(s);
+            LOGPRINT_ERROR("Cannot resume %s at %u, it has %u bytes.", path,
+                (unsigned int)offset, (unsigned int)res->offset);
+            return LFS_ERR_INVAL;
+        }
+        ret = lfs_file_truncate(lfs, &s->file, offset);
+        while (ret >= 0 && done < offset)
+        {
+            ret = lfs_file_read(lfs, &s->file, s->buf[0],
+                MIN(offset - done, LFS_PARTXFER_CHUNK_SIZE));
+            if (ret == 0)
+            {
+                ret = LFS_ERR_CORRUPT;
+            }
+            if (ret > 0)
+            {
+                s->crc = Lfs_PartXfer_crc32(s->crc, s->buf[0], ret);
+                done += ret;
+            }
+        }
+        if (ret < 0)
+        {
+            session_close(s);
+            return ret;
+        }
+        s->pos = offset;
+    }
+
+    *out = s;
+    return 0;
+}
+
+/******************************************************************************
+    put_fail
+*//**
+    @brief Ends a put session after an error; the data written so far is
+    kept and res->offset is where to resume.
+******************************************************************************/
+static int
+put_fail(XferSession *s, int err, Lfs_PartXfer_Result *res)
+{
+    struct lfs_info info;
+    Lfs_Part_t *lpfs = s->lpfs;
+
+    session_close(s);
+    res->id = 0;
+    res->offset = (lfs_stat(&lpfs->lfs, s->path, &info) == 0) ? info.size : 0;
+    LOGPRINT_ERROR("Put of %s failed (%d), %u bytes kept.", s->path, err,
+        (unsigned int)res->offset);
+    return err;
+}
+
+/******************************************************************************
+    xfer_put
+*//**
+    @brief Lfs_PartXfer_put with the sessions locked.
+******************************************************************************/
+static int
+xfer_put(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t id,
+    uint32_t offset,
+    const uint8_t *data,
+    uint32_t len,
+    bool last,
+    uint32_t crc,
+    Lfs_PartXfer_Result *res)
+{
+    XferSession *s;
+    int ret;
+
+    memset(res, 0, sizeof(*res));
+    CHECK_COND_RETURN_MSG(strlen(path) >= LFS_PARTXFER_PATH_MAX,
+        LFS_ERR_NAMETOOLONG, "Transfer path too long.");
+    CHECK_COND_RETURN(len > LFS_PARTXFER_CHUNK_SIZE, LFS_ERR_INVAL);
+
+    use_stamp++;
+    s = session_find(id, lpfs, path, true);
+    if (s && offset != s->pos)
+    {
+        if (offset == s->prev_off && offset + len == s->pos && !last)
+        {
+            /* Repeated call, the chunk is already written. */
+            res->id = s->id;
+            res->offset = s->pos;
+            res->crc = s->crc;
+            return 0;
+        }
+        session_close(s);
+        s = NULL;
+    }
+    if (!s)
+    {
+        ret = put_open(lpfs, path, offset, &s, res);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+    s->stamp = use_stamp;
+
+    /* The previous chunk is being written from the other buffer. */
+    memcpy(s->buf[s->cur], data, len);
+    io_wait(s);
+    if (s->error)
+    {
+        return put_fail(s, s->error, res);
+    }
+
+    s->prev_off = s->pos;
+    s->crc = Lfs_PartXfer_crc32(s->crc, data, len);
+    s->pos += len;
+    if (len)
+    {
+        io_start(s, true, s->cur, len);
+        s->cur ^= 1;
+    }
+
+    res->offset = s->pos;
+    res->crc = s->crc;
+    if (!last)
+    {
+        res->id = s->id;
+        return 0;
+    }
+
+    io_wait(s);
+    if (s->error)
+    {
+        return put_fail(s, s->error, res);
+    }
+    ret = session_close(s);
+    if (ret < 0)
+    {
+        return put_fail(s, ret, res);
+    }
+    if (s->crc != crc)
+    {
+        LOGPRINT_ERROR("Put of %s: CRC %08x, expected %08x. Removed.", path,
+            (unsigned int)s->crc, (unsigned int)crc);
+        lfs_remove(&lpfs->lfs, path);
+        res->offset = 0;
+        return LFS_ERR_CORRUPT;
+    }
+    return 0;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartXfer_put]
+*//**
+    @brief Writes the next chunk of a file. A put starting at offset 0
+    creates or truncates the file.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+    @param[in] path  File.
+    @param[in] id  Transfer id from the previous result, 0 to start.
+    @param[in] offset  Offset of the chunk.
+    @param[in] data  Chunk.
+    @param[in] len  Chunk size (at most LFS_PARTXFER_CHUNK_SIZE).
+    @param[in] last  The chunk ends the file: the file is committed and
+    checked against crc.
+    @param[in] crc  With last, CRC32 of the whole file.
+    @param[out] res  Pointer to result to fill.
+    @return Returns 0 on success, LFS_ERR_CORRUPT on a CRC mismatch (the file
+    is removed), other negative lfs error code otherwise (the transfer is
+    over; res->offset tells where to resume).
+******************************************************************************/
+int
+Lfs_PartXfer_put(
+    Lfs_Part_t *lpfs,
+    const char *path,
+    uint32_t id,
+    uint32_t offset,
+    const uint8_t *data,
+    uint32_t len,
+    bool last,
+    uint32_t crc,
+    Lfs_PartXfer_Result *res)
+{
+    int ret;
+
+    CHECK_COND_RETURN_MSG(!xfer_lock, LFS_ERR_INVAL,
+        "Transfers are not initialized.");
+    RTOS_MUTEX_GET(xfer_lock);
+    ret = xfer_put(lpfs, path, id, offset, data, len, last, crc, res);
+    RTOS_MUTEX_PUT(xfer_lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport Lfs_PartXfer_release]
+*//**
+    @brief Ends the transfers of a partition (before it is unmounted). Data
+    of an unfinished put is kept, so it can be resumed.
+    @param[in] lpfs  Pointer to initialized Lfs_Part_t.
+******************************************************************************/
+void
+Lfs_PartXfer_release(Lfs_Part_t *lpfs)
+{
+    uint32_t i;
+
+    /* Without Lfs_PartXfer_init (e.g. no RPC server) there is no session. */
+    if (!xfer_lock)
+    {
+        return;
+    }
+
+    RTOS_MUTEX_GET(xfer_lock);
+    for (i = 0; i < LFS_PARTXFER_SESSIONS; i++)
+    {
+        if (sessions[i].used && sessions[i].lpfs == lpfs)
+        {
+            session_close(&sessions[i]);
+        }
+    }
+    RTOS_MUTEX_PUT(xfer_lock);
+}
+
+/******************************************************************************
+    [docimport Lfs_PartXfer_init]
+*//**
+    @brief Initializes the transfers (call before the first transfer) and
+    starts the transfer task (without it, I/O runs in the caller).
+    @return Returns 0 on success, -1 on failure.
+******************************************************************************/
+int
+Lfs_PartXfer_init(void)
+{
+    if (!xfer_lock)
+    {
+        xfer_lock = RTOS_MUTEX_CREATE_STATIC(&xfer_lockbuf);
+        CHECK_COND_RETURN_MSG(!xfer_lock, -1, "Error creating transfer lock.");
+    }
+
+    if (!LFS_PARTXFER_PIPELINE || xfer_queue)
+    {
+        return 0;
+    }
+
+    xfer_flags = RTOS_FLAG_GROUP_CREATE();
+    CHECK_COND_RETURN_MSG(!xfer_flags, -1, "Error creating transfer flags.");
+    xfer_queue = RTOS_QUEUE_CREATE(LFS_PARTXFER_SESSIONS, sizeof(XferJob));
+    CHECK_COND_RETURN_MSG(!xfer_queue, -1, "Error creating transfer queue.");
+
+    if (RTOS_TASK_CREATE(
+        xfer_task,
+        "LfsXfer",
+        LFS_PARTXFER_TASK_STACK,
+        NULL,
+        LFS_PARTXFER_TASK_PRIO,
+        &xfer_task_handle) < 0)
+    {
+        /* I/O runs in the caller. */
+        xfer_queue = NULL;
+        LOGPRINT_ERROR("Error starting transfer task.");
+        return -1;
+    }
+    return 0;
+}
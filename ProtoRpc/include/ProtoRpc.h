@@ -7,6 +7,7 @@
 #define PROTORPC_H
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "ProtoRpc.pb.h"
 
 /** @brief Max size of a ProtoRpc message */
@@ -64,6 +65,20 @@ typedef struct ProtoRpc_Handler_Entry
 
 typedef ProtoRpc_Handler_Entry *ProtoRpc_handlers;
 
+/** @brief Admission control hooks (see ProtoRpc_serverAdmit).
+*/
+typedef struct ProtoRpc_Admission
+{
+    /** @brief Returns true to run the call. Otherwise the call is answered
+        with RPC_BUSY and *retry_after_ms is passed on to the client. */
+    bool (*admit)(void *ctx, uint32_t which_callset, uint32_t *retry_after_ms);
+    /** @brief Called when an admitted call has completed (may be NULL). */
+    void (*release)(void *ctx, uint32_t which_callset);
+    /** @brief User context. */
+    void *ctx;
+
+} ProtoRpc_Admission;
+
 #define PROTORPC_ADD_HANDLER(handler_tag, handler_func)\
 { .tag = (handler_tag), .handler = (handler_func) }
 
@@ -89,4 +104,28 @@ ProtoRpc_server(
     uint8_t *reply_buf,
     uint32_t reply_buf_max_size,
     uint32_t *reply_encoded_size);
+
+/******************************************************************************
+    [docexport ProtoRpc_serverAdmit]
+*//**
+    @brief Same as ProtoRpc_server, but asks the admission hooks before
+    running the handler. Rejected calls get an RPC_BUSY reply carrying the
+    retry-after hint.
+    @param[in] rpc  Pointer to initialized ProtoRpc instance.
+    @param[in] admission  Admission hooks (NULL admits every call).
+    @param[in] rcvd_buf  Pointer to the received buffer.
+    @param[in] rcvd_buf_size  Number of bytes in the recieved message.
+    @param[in] reply_buf  Pointer to the message reply buffer.
+    @param[in] reply_buf_max_size  Max size of the reply buffer.
+    @param[out] reply_encoded_size  Returned size of the packed reply message.
+******************************************************************************/
+void
+ProtoRpc_serverAdmit(
+    ProtoRpc *rpc,
+    ProtoRpc_Admission *admission,
+    uint8_t *rcvd_buf,
+    uint32_t rcvd_buf_size,
+    uint8_t *reply_buf,
+    uint32_t reply_buf_max_size,
+    uint32_t *reply_encoded_size);
 #endif
@@ -14,7 +14,8 @@ typedef enum _StatusEnum {
     StatusEnum_RPC_SUCCESS = 0,
     StatusEnum_RPC_BAD_RESOLVER_LOOKUP = 1,
     StatusEnum_RPC_BAD_HANDLER_LOOKUP = 2,
-    StatusEnum_RPC_HANDLER_ERROR = 3
+    StatusEnum_RPC_HANDLER_ERROR = 3,
+    StatusEnum_RPC_BUSY = 4
 } StatusEnum;
 
 /* Struct definitions */
@@ -22,6 +23,7 @@ typedef struct _ProtoRpcHeader {
     uint32_t seqn;
     bool no_reply;
     StatusEnum status;
+    uint32_t retry_after_ms;
 } ProtoRpcHeader;
 
 
@@ -31,26 +33,28 @@ extern "C" {
 
 /* Helper constants for enums */
 #define _StatusEnum_MIN StatusEnum_RPC_SUCCESS
-#define _StatusEnum_MAX StatusEnum_RPC_HANDLER_ERROR
-#define _StatusEnum_ARRAYSIZE ((StatusEnum)(StatusEnum_RPC_HANDLER_ERROR+1))
+#define _StatusEnum_MAX StatusEnum_RPC_BUSY
+#define _StatusEnum_ARRAYSIZE ((StatusEnum)(StatusEnum_RPC_BUSY+1))
 
 #define ProtoRpcHeader_status_ENUMTYPE StatusEnum
 
 
 /* Initializer values for message structs */
-#define ProtoRpcHeader_init_default              {0, 0, _StatusEnum_MIN}
-#define ProtoRpcHeader_init_zero                 {0, 0, _StatusEnum_MIN}
+#define ProtoRpcHeader_init_default              {0, 0, _StatusEnum_MIN, 0}
+#define ProtoRpcHeader_init_zero                 {0, 0, _StatusEnum_MIN, 0}
 
 /* Field tags (for use in manual encoding/decoding) */
 #define ProtoRpcHeader_seqn_tag                  1
 #define ProtoRpcHeader_no_reply_tag              2
 #define ProtoRpcHeader_status_tag                3
+#define ProtoRpcHeader_retry_after_ms_tag        4
 
 /* Struct field encoding specification for nanopb */
 #define ProtoRpcHeader_FIELDLIST(X, a) \
 X(a, STATIC,   SINGULAR, UINT32,   seqn,              1) \
 X(a, STATIC,   SINGULAR, BOOL,     no_reply,          2) \
-X(a, STATIC,   SINGULAR, UENUM,    status,            3)
+X(a, STATIC,   SINGULAR, UENUM,    status,            3) \
+X(a, STATIC,   SINGULAR, UINT32,   retry_after_ms,    4)
 #define ProtoRpcHeader_CALLBACK NULL
 #define ProtoRpcHeader_DEFAULT NULL
 
@@ -60,7 +64,7 @@ extern const pb_msgdesc_t ProtoRpcHeader_msg;
 #define ProtoRpcHeader_fields &ProtoRpcHeader_msg
 
 /* Maximum encoded size of messages (where known) */
-#define ProtoRpcHeader_size                      10
+#define ProtoRpcHeader_size                      16
 
 #ifdef __cplusplus
 } /* extern "C" */
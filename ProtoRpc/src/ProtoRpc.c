@@ -39,10 +39,13 @@ callset_lookup(
 }
 
 /******************************************************************************
-    [docimport ProtoRpc_server]
+    [docimport ProtoRpc_serverAdmit]
 *//**
-    @brief Decoded received ProtoRpc frame, executes the RPC, provides the reply.
+    @brief Same as ProtoRpc_server, but asks the admission hooks before
+    running the handler. Rejected calls get an RPC_BUSY reply carrying the
+    retry-after hint.
     @param[in] rpc  Pointer to initialized ProtoRpc instance.
+    @param[in] admission  Admission hooks (NULL admits every call).
     @param[in] rcvd_buf  Pointer to the received buffer.
     @param[in] rcvd_buf_size  Number of bytes in the recieved message.
     @param[in] reply_buf  Pointer to the message reply buffer.
@@ -50,8 +53,9 @@ callset_lookup(
     @param[out] reply_encoded_size  Returned size of the packed reply message.
 ******************************************************************************/
 void
-ProtoRpc_server(
+ProtoRpc_serverAdmit(
     ProtoRpc *rpc,
+    ProtoRpc_Admission *admission,
     uint8_t *rcvd_buf,
     uint32_t rcvd_buf_size,
     uint8_t *reply_buf,
@@ -79,6 +83,7 @@ ProtoRpc_server(
     which_callset = rpc->call_frame[rpc->which_callset_offset];
 
     reply_header = (ProtoRpcHeader *)&rpc->reply_frame[rpc->header_offset];
+    reply_header->retry_after_ms = 0;
 
     LOGPRINT_DEBUG("header: seqn = %u; no_reply = %u; which_callset = %u",
         (unsigned int)header->seqn,
@@ -114,11 +119,42 @@ ProtoRpc_server(
         return;
     }
 
+    /** @brief Ask admission control, if any. */
+    if (admission && admission->admit &&
+        !admission->admit(admission->ctx, which_callset,
+            &reply_header->retry_after_ms))
+    {
+        LOGPRINT_DEBUG("Call rejected (which_callset=%u, retry after %u ms).",
+            (unsigned int)which_callset,
+            (unsigned int)reply_header->retry_after_ms);
+
+        if (header->no_reply)
+        {
+            return;
+        }
+
+        /* Header only: no callset in the reply. */
+        reply_header->seqn = header->seqn;
+        reply_header->status = StatusEnum_RPC_BUSY;
+        rpc->reply_frame[0] = 1;        // set has_header in RpcFrame.
+        rpc->reply_frame[rpc->which_callset_offset] = 0;
+        *reply_encoded_size = Pb_pack(reply_buf,
+                                      reply_buf_max_size,
+                                      rpc->reply_frame,
+                                      rpc->frame_fields);
+        return;
+    }
+
     /** @brief Call the handler. */
     uint8_t *call_frame = &rpc->call_frame[rpc->callset_offset];
     uint8_t *reply_frame = &rpc->reply_frame[rpc->callset_offset];
     handler(call_frame, reply_frame, &reply_header->status);
 
+    if (admission && admission->admit && admission->release)
+    {
+        admission->release(admission->ctx, which_callset);
+    }
+
     LOGPRINT_DEBUG("Handler provided status=0x%08x", (unsigned int)reply_header->status);
 
     if (header->no_reply)
@@ -134,3 +170,33 @@ ProtoRpc_server(
                                   rpc->reply_frame,
                                   rpc->frame_fields);
 }
+
+/******************************************************************************
+    [docimport ProtoRpc_server]
+*//**
+    @brief Decoded received ProtoRpc frame, executes the RPC, provides the reply.
+    @param[in] rpc  Pointer to initialized ProtoRpc instance.
+    @param[in] rcvd_buf  Pointer to the received buffer.
+    @param[in] rcvd_buf_size  Number of bytes in the recieved message.
+    @param[in] reply_buf  Pointer to the message reply buffer.
+    @param[in] reply_buf_max_size  Max size of the reply buffer.
+    @param[out] reply_encoded_size  Returned size of the packed reply message.
+******************************************************************************/
+void
+ProtoRpc_server(
+    ProtoRpc *rpc,
+    uint8_t *rcvd_buf,
+    uint32_t rcvd_buf_size,
+    uint8_t *reply_buf,
+    uint32_t reply_buf_max_size,
+    uint32_t *reply_encoded_size)
+{
+    ProtoRpc_serverAdmit(
+        rpc,
+        NULL,
+        rcvd_buf,
+        rcvd_buf_size,
+        reply_buf,
+        reply_buf_max_size,
+        reply_encoded_size);
+}
@@ -0,0 +1,169 @@
+/*******************************************************************************
+ *  @file: RpcEngine.h
+ *
+ *  @brief: Header for RpcEngine, a transport independent ProtoRpc server.
+*******************************************************************************/
+#ifndef RPCENGINE_H
+#define RPCENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ProtoRpc.h"
+#include "RpcTransport.h"
+#include "RpcLimit.h"
+#include "Cobs_frame.h"
+#include "RtosUtils.h"
+
+/** @brief Receive timeout used by the engine task, ms. */
+#define RPCENGINE_RECV_TIMEOUT_MS   100
+
+/** @brief Engine counters. */
+typedef struct RpcEngine_Stats
+{
+    uint32_t num_calls;
+    uint32_t num_replies;
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t errors;
+
+} RpcEngine_Stats;
+
+/** @brief RpcEngine object.
+*/
+typedef struct RpcEngine
+{
+    /** @brief Pointer to the ProtoRpc instance. */
+    ProtoRpc *rpc;
+    /** @brief Pointer to the transport. */
+    RpcTransport *transport;
+
+    /** @brief Max size of an unframed message. */
+    uint32_t msg_max_size;
+    /** @brief Transport receive buffer (pull mode only, allocated on demand). */
+    uint8_t *rx_buf;
+    uint32_t rx_size;
+    /** @brief Partial frame kept at the front of rx_buf (COBS only). */
+    uint32_t rx_keep;
+    /** @brief Deframed request (COBS RpcEngine_input only). */
+    uint8_t *msg_buf;
+    /** @brief Packed reply. */
+    uint8_t *reply_buf;
+    /** @brief Framed reply (COBS only). */
+    uint8_t *tx_buf;
+    uint32_t tx_size;
+    /** @brief Stream de-framer (COBS RpcEngine_input only). */
+    Cobs_Deframer deframer;
+
+    RpcEngine_Stats stats;
+
+    /** @brief Optional admission control (see RpcEngine_setLimit). */
+    RpcLimit *limit;
+    ProtoRpc_Admission admission;
+    /** @brief Limiter key of the client being served, set by the server
+        before RpcEngine_input (e.g. IPv4 address). */
+    uint32_t client;
+
+    /** @brief Engine task (see RpcEngine_start). */
+    char taskName[16];
+    RTOS_TASK taskHandle;
+
+} RpcEngine;
+
+/** @brief Worst case COBS framed size of a message of size n. */
+#define RPCENGINE_FRAMED_SIZE(n)    ((n) + (n)/254 + 4)
+
+/******************************************************************************
+    [docexport RpcEngine_input]
+*//**
+    @brief Push-mode entry: feeds received bytes to the engine. Every complete
+    request is dispatched to ProtoRpc and its reply written to the transport.
+    For FRAMING_NONE transports data must hold exactly one message.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] data  Pointer to received data.
+    @param[in] len  Number of bytes received.
+    @return Returns the number of requests dispatched, negative on error.
+******************************************************************************/
+int
+RpcEngine_input(RpcEngine *eng, uint8_t *data, uint32_t len);
+
+/******************************************************************************
+    [docexport RpcEngine_inputInPlace]
+*//**
+    @brief Zero-copy variant of RpcEngine_input for COBS transports which own
+    a linear receive buffer: frames are decoded in place and dispatched
+    straight from buf. An incomplete trailing frame is moved to the front of
+    buf; the caller appends the next receive after it.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] buf  Pointer to the receive buffer (kept bytes + new bytes).
+    @param[in] len  Number of valid bytes in buf.
+    @param[in] size  Size of buf.
+    @return Returns the number of bytes kept at the front of buf.
+******************************************************************************/
+uint32_t
+RpcEngine_inputInPlace(
+    RpcEngine *eng,
+    uint8_t *buf,
+    uint32_t len,
+    uint32_t size);
+
+/******************************************************************************
+    [docexport RpcEngine_poll]
+*//**
+    @brief Pull-mode entry: reads once from the transport (waiting up to
+    timeout_ms) and processes whatever was received.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] timeout_ms  Receive timeout.
+    @return Returns the number of requests dispatched, negative on error.
+******************************************************************************/
+int
+RpcEngine_poll(RpcEngine *eng, uint32_t timeout_ms);
+
+/******************************************************************************
+    [docexport RpcEngine_setLimit]
+*//**
+    @brief Attaches a limiter. Rejected calls are answered with RPC_BUSY.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] limit  Pointer to initialized RpcLimit (may be shared between
+    engines), NULL to detach.
+******************************************************************************/
+void
+RpcEngine_setLimit(RpcEngine *eng, RpcLimit *limit);
+
+/******************************************************************************
+    [docexport RpcEngine_start]
+*//**
+    @brief Starts a task which runs RpcEngine_poll forever. The transport must
+    implement recv.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] name  Task name.
+    @param[in] stack_size  Task stack size.
+    @param[in] prio  Task priority.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcEngine_start(
+    RpcEngine *eng,
+    const char *name,
+    uint16_t stack_size,
+    uint8_t prio);
+
+/******************************************************************************
+    [docexport RpcEngine_init]
+*//**
+    @brief Initializes an RpcEngine. Buffers are allocated according to the
+    transport framing policy (the COBS fifo deframer only on first use of
+    RpcEngine_input).
+    @param[in] eng  Pointer to uninitialized RpcEngine.
+    @param[in] rpc  Pointer to *initialized* ProtoRpc instance.
+    @param[in] transport  Pointer to *initialized* transport.
+    @param[in] msg_max_size  Max size of an unframed request or reply (e.g.
+    PROTORPC_MSG_MAX_SIZE).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcEngine_init(
+    RpcEngine *eng,
+    ProtoRpc *rpc,
+    RpcTransport *transport,
+    uint32_t msg_max_size);
+#endif
@@ -0,0 +1,29 @@
+/*******************************************************************************
+ *  @file: RpcEngine_bench.h
+ *
+ *  @brief: Header for the RpcEngine loopback benchmark
+ *  (bench/RpcEngine_bench.c). Built with CONFIG_RPCENGINE_BENCH.
+*******************************************************************************/
+#ifndef RPCENGINE_BENCH_H
+#define RPCENGINE_BENCH_H
+
+#include <stdint.h>
+#include "ProtoRpc.h"
+
+/******************************************************************************
+    [docexport RpcEngine_bench]
+*//**
+    @brief Benchmarks the RPC stack over loopback, unframed then COBS framed.
+    @param[in] rpc  Pointer to *initialized* ProtoRpc instance.
+    @param[in] request  Packed request frame to issue repeatedly.
+    @param[in] req_len  Length of request.
+    @param[in] iterations  Calls per framing policy.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcEngine_bench(
+    ProtoRpc *rpc,
+    uint8_t *request,
+    uint32_t req_len,
+    uint32_t iterations);
+#endif
@@ -0,0 +1,158 @@
+/*******************************************************************************
+ *  @file: RpcLimit.h
+ *
+ *  @brief: Header for RpcLimit, RPC admission control (token buckets per
+ *  client and per callset, plus a max-in-flight limit).
+*******************************************************************************/
+#ifndef RPCLIMIT_H
+#define RPCLIMIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "RtosUtils.h"
+
+/** @brief Number of clients tracked (least recently seen is recycled). */
+#define RPCLIMIT_MAX_CLIENTS        8
+/** @brief Max number of callsets with their own bucket. */
+#define RPCLIMIT_MAX_CALLSETS       8
+/** @brief Retry-after hint when rejected by the in-flight limit, ms. */
+#define RPCLIMIT_INFLIGHT_RETRY_MS  10
+
+/** @brief Token bucket. Tokens are kept in 1/1000 units.
+*/
+typedef struct RpcLimit_Bucket
+{
+    /** @brief Refill rate, calls/s (0 = unlimited). */
+    uint32_t rate;
+    /** @brief Bucket size, calls. */
+    uint32_t burst;
+    /** @brief Current level, 1/1000 calls. */
+    uint32_t tokens;
+    /** @brief Time of last refill, us. */
+    uint64_t last_us;
+
+} RpcLimit_Bucket;
+
+typedef struct RpcLimit_Client
+{
+    /** @brief Client key (e.g. IPv4 address). */
+    uint32_t key;
+    /** @brief Last use stamp, for recycling. */
+    uint32_t last_use;
+    bool used;
+    RpcLimit_Bucket bucket;
+
+} RpcLimit_Client;
+
+typedef struct RpcLimit_Callset
+{
+    /** @brief Callset tag in the RpcFrame. */
+    uint32_t tag;
+    RpcLimit_Bucket bucket;
+
+} RpcLimit_Callset;
+
+/** @brief Limiter counters. */
+typedef struct RpcLimit_Stats
+{
+    uint32_t admitted;
+    uint32_t rejected_client;
+    uint32_t rejected_callset;
+    uint32_t rejected_inflight;
+    uint32_t in_flight;
+    uint32_t max_in_flight;
+
+} RpcLimit_Stats;
+
+/** @brief RpcLimit object. May be shared by several servers.
+*/
+typedef struct RpcLimit
+{
+    /** @brief Per client buckets. */
+    RpcLimit_Client clients[RPCLIMIT_MAX_CLIENTS];
+    uint32_t client_rate;
+    uint32_t client_burst;
+    uint32_t use_count;
+
+    /** @brief Per callset buckets. */
+    RpcLimit_Callset callsets[RPCLIMIT_MAX_CALLSETS];
+    uint32_t num_callsets;
+
+    /** @brief Max calls executing at once across all servers (0 = no limit). */
+    uint32_t max_in_flight;
+
+    RpcLimit_Stats stats;
+
+    RTOS_MUTEX_STATIC_BUF lockbuf;
+    RTOS_MUTEX lock;
+
+} RpcLimit;
+
+/******************************************************************************
+    [docexport RpcLimit_admit]
+*//**
+    @brief Decides whether a call may run. A token is taken from the client
+    and callset buckets only when all limits pass.
+    @param[in] lim  Pointer to initialized RpcLimit.
+    @param[in] client  Client key.
+    @param[in] which_callset  Callset tag of the call.
+    @param[out] retry_after_ms  On rejection, time until the call would pass.
+    @return Returns true if admitted (call RpcLimit_release when done).
+******************************************************************************/
+bool
+RpcLimit_admit(
+    RpcLimit *lim,
+    uint32_t client,
+    uint32_t which_callset,
+    uint32_t *retry_after_ms);
+
+/******************************************************************************
+    [docexport RpcLimit_release]
+*//**
+    @brief Marks an admitted call as complete.
+    @param[in] lim  Pointer to initialized RpcLimit.
+******************************************************************************/
+void
+RpcLimit_release(RpcLimit *lim);
+
+/******************************************************************************
+    [docexport RpcLimit_getStats]
+*//**
+    @brief Gets a snapshot of the limiter counters.
+    @param[in] lim  Pointer to initialized RpcLimit.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared (in_flight is kept).
+******************************************************************************/
+void
+RpcLimit_getStats(RpcLimit *lim, RpcLimit_Stats *stats, bool clear);
+
+/******************************************************************************
+    [docexport RpcLimit_setCallset]
+*//**
+    @brief Adds (or updates) a per callset limit, shared by all clients.
+    @param[in] lim  Pointer to initialized RpcLimit.
+    @param[in] tag  Callset tag in the RpcFrame.
+    @param[in] rate  Sustained calls/s (0 = unlimited).
+    @param[in] burst  Calls allowed back to back.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcLimit_setCallset(RpcLimit *lim, uint32_t tag, uint32_t rate, uint32_t burst);
+
+/******************************************************************************
+    [docexport RpcLimit_init]
+*//**
+    @brief Initializes a limiter.
+    @param[in] lim  Pointer to uninitialized RpcLimit.
+    @param[in] client_rate  Sustained calls/s per client (0 = unlimited).
+    @param[in] client_burst  Calls a client may issue back to back.
+    @param[in] max_in_flight  Max calls executing at once (0 = unlimited).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcLimit_init(
+    RpcLimit *lim,
+    uint32_t client_rate,
+    uint32_t client_burst,
+    uint32_t max_in_flight);
+#endif
@@ -0,0 +1,72 @@
+/*******************************************************************************
+ *  @file: RpcLoopback.h
+ *   
+ *  @brief: In-memory loopback RpcTransport. The server side is an ordinary
+ *  RpcTransport for RpcEngine; the client side is driven directly through
+ *  RpcLoopback_clientWrite/RpcLoopback_clientRead. Nothing blocks, so a
+ *  single thread can run request, RpcEngine_poll and reply in lock-step.
+*******************************************************************************/
+#ifndef RPCLOOPBACK_H
+#define RPCLOOPBACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "RpcTransport.h"
+#include "SwFifo.h"
+
+/** @brief RpcLoopback object.
+*/
+typedef struct RpcLoopback
+{
+    /** @brief Server side transport (pass to RpcEngine_init). */
+    RpcTransport transport;
+    /** @brief Client --> server bytes. */
+    SwFifo to_server;
+    /** @brief Server --> client bytes. */
+    SwFifo to_client;
+
+} RpcLoopback;
+
+/******************************************************************************
+    [docexport RpcLoopback_clientWrite]
+*//**
+    @brief Writes a request from the client side. With FRAMING_COBS the data
+    must already be framed.
+    @param[in] lb  Pointer to RpcLoopback object.
+    @param[in] buf  Pointer to data.
+    @param[in] len  Number of bytes.
+    @return Returns len on success, negative if the fifo is full.
+******************************************************************************/
+int
+RpcLoopback_clientWrite(RpcLoopback *lb, uint8_t *buf, uint32_t len);
+
+/******************************************************************************
+    [docexport RpcLoopback_clientRead]
+*//**
+    @brief Reads reply data on the client side. With FRAMING_NONE exactly one
+    message is returned; with FRAMING_COBS all pending bytes (up to size).
+    @param[in] lb  Pointer to RpcLoopback object.
+    @param[in] buf  Pointer to buffer.
+    @param[in] size  Size of buffer.
+    @return Returns number of bytes read (0 if none), negative on error.
+******************************************************************************/
+int
+RpcLoopback_clientRead(RpcLoopback *lb, uint8_t *buf, uint32_t size);
+
+/******************************************************************************
+    [docexport RpcLoopback_init]
+*//**
+    @brief Initializes a loopback transport.
+    @param[in] lb  Pointer to uninitialized RpcLoopback object.
+    @param[in] framing  Framing policy.
+    @param[in] depth  Depth of each direction's byte fifo.
+    @param[in] threadsafe  Set if client and server run in different tasks.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcLoopback_init(
+    RpcLoopback *lb,
+    RpcTransport_framing framing,
+    uint32_t depth,
+    bool threadsafe);
+#endif
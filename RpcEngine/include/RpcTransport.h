@@ -0,0 +1,41 @@
+/*******************************************************************************
+ *  @file: RpcTransport.h
+ *   
+ *  @brief: Generic transport interface used by RpcEngine.
+*******************************************************************************/
+#ifndef RPCTRANSPORT_H
+#define RPCTRANSPORT_H
+
+#include <stdint.h>
+
+/** @brief Framing the engine applies on top of the transport. */
+typedef enum {
+    /* Transport preserves message boundaries (e.g. datagrams). */
+    RPCTRANSPORT_FRAMING_NONE = 0,
+    /* Transport is a byte stream; messages are COBS framed. */
+    RPCTRANSPORT_FRAMING_COBS,
+} RpcTransport_framing;
+
+/*  recv: Pull-mode read. Returns number of bytes read, 0 on timeout, negative
+          on error. May be NULL for push-mode transports (see RpcEngine_input).
+    send: Writes len bytes. Returns number of bytes written, negative on error.
+    close: Closes the transport. May be NULL.
+*/
+#define RPC_TRANSPORT_CONTENTS()                                              \
+    /** @brief Opaque context object. */                                      \
+    void *ctx;                                                                \
+    /** @brief Framing policy. */                                             \
+    RpcTransport_framing framing;                                             \
+                                                                              \
+    /** @brief Transport operations. */                                       \
+    int (*recv)(void *ctx, uint8_t *buf, uint32_t size, uint32_t timeout_ms); \
+    int (*send)(void *ctx, uint8_t *buf, uint32_t len);                       \
+    int (*close)(void *ctx);
+
+/** @brief RpcTransport base object.
+*/
+typedef struct RpcTransport
+{
+    RPC_TRANSPORT_CONTENTS()
+} RpcTransport;
+#endif
@@ -0,0 +1,39 @@
+/*******************************************************************************
+ *  @file: RpcUart.h
+ *   
+ *  @brief: UART RpcTransport (COBS framed byte stream).
+*******************************************************************************/
+#ifndef RPCUART_H
+#define RPCUART_H
+
+#include <stdint.h>
+#include "RpcTransport.h"
+
+/** @brief Size of the UART driver rx ring buffer. */
+#define RPCUART_RX_BUF_SIZE     2048
+
+/** @brief RpcUart object.
+*/
+typedef struct RpcUart
+{
+    /** @brief Transport (pass to RpcEngine_init). */
+    RpcTransport transport;
+    /** @brief UART port number. */
+    int port;
+
+} RpcUart;
+
+/******************************************************************************
+    [docexport RpcUart_init]
+*//**
+    @brief Installs the UART driver and initializes the transport.
+    @param[in] uart  Pointer to uninitialized RpcUart object.
+    @param[in] port  UART port number.
+    @param[in] baud  Baud rate.
+    @param[in] tx_pin  TX gpio (-1 to keep the default).
+    @param[in] rx_pin  RX gpio (-1 to keep the default).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcUart_init(RpcUart *uart, int port, int baud, int tx_pin, int rx_pin);
+#endif
@@ -0,0 +1,384 @@
+/*******************************************************************************
+ *  @file: RpcEngine.c
+ *
+ *  @brief: Transport independent ProtoRpc server engine.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "RpcEngine.h"
+#include "Cobs_frame.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "RpcEngine";
+
+/******************************************************************************
+    limit_admit
+*//**
+    @brief ProtoRpc admission hook: asks the engine's limiter.
+******************************************************************************/
+static bool
+limit_admit(void *ctx, uint32_t which_callset, uint32_t *retry_after_ms)
+{
+    RpcEngine *eng = (RpcEngine *)ctx;
+    return RpcLimit_admit(eng->limit, eng->client, which_callset,
+        retry_after_ms);
+}
+
+/******************************************************************************
+    limit_release
+*//**
+    @brief ProtoRpc admission hook: call completed.
+******************************************************************************/
+static void
+limit_release(void *ctx, uint32_t which_callset)
+{
+    RpcEngine *eng = (RpcEngine *)ctx;
+    RpcLimit_release(eng->limit);
+}
+
+/******************************************************************************
+    dispatch
+*//**
+    @brief Runs one unframed request through ProtoRpc and sends the reply.
+******************************************************************************/
+static int
+dispatch(RpcEngine *eng, uint8_t *msg, uint32_t len)
+{
+    RpcTransport *t = eng->transport;
+    uint8_t *out = eng->reply_buf;
+    uint32_t reply_size;
+    int out_size;
+    int num_sent;
+
+    LOGPRINT_HEXDUMP_VERBOSE("Rpc request.", msg, len);
+
+    eng->stats.num_calls++;
+    ProtoRpc_serverAdmit(
+        eng->rpc,
+        eng->limit ? &eng->admission : NULL,
+        msg,
+        len,
+        eng->reply_buf,
+        eng->msg_max_size,
+        &reply_size);
+
+    if (reply_size == 0)
+    {
+        return 0;
+    }
+
+    out_size = reply_size;
+    if (t->framing == RPCTRANSPORT_FRAMING_COBS)
+    {
+        out_size = Cobs_framer(eng->reply_buf, reply_size, eng->tx_buf,
+            eng->tx_size);
+        if (out_size < 0)
+        {
+            LOGPRINT_ERROR("Framer error detected in RPC reply.");
+            eng->stats.errors++;
+            return -1;
+        }
+        out = eng->tx_buf;
+    }
+
+    LOGPRINT_HEXDUMP_VERBOSE("Rpc reply.", out, out_size);
+
+    num_sent = t->send(t->ctx, out, out_size);
+    if (num_sent != out_size)
+    {
+        LOGPRINT_ERROR("Error on rpc reply write (%d).", num_sent);
+        eng->stats.errors++;
+        return -1;
+    }
+
+    eng->stats.num_replies++;
+    eng->stats.tx_bytes += num_sent;
+    LOGPRINT_DEBUG("Wrote rpc reply: %d bytes.", num_sent);
+    return 0;
+}
+
+/******************************************************************************
+    [docimport RpcEngine_input]
+*//**
+    @brief Push-mode entry: feeds received bytes to the engine. Every complete
+    request is dispatched to ProtoRpc and its reply written to the transport.
+    For FRAMING_NONE transports data must hold exactly one message.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] data  Pointer to received data.
+    @param[in] len  Number of bytes received.
+    @return Returns the number of requests dispatched, negative on error.
+******************************************************************************/
+int
+RpcEngine_input(RpcEngine *eng, uint8_t *data, uint32_t len)
+{
+    Cobs_Deframer *deframer = &eng->deframer;
+    int num = 0;
+    int msg_size;
+
+    CHECK_COND_RETURN(len == 0, 0);
+    eng->stats.rx_bytes += len;
+
+    if (eng->transport->framing == RPCTRANSPORT_FRAMING_NONE)
+    {
+        dispatch(eng, data, len);
+        return 1;
+    }
+
+    /*  The fifo deframer is only needed when data cannot be decoded in place
+        (see RpcEngine_inputInPlace), so it is set up on first use.
+    */
+    if (!eng->msg_buf)
+    {
+        int ret;
+
+        eng->msg_buf = (uint8_t *)malloc(eng->msg_max_size);
+        CHECK_COND_RETURN_MSG(!eng->msg_buf, -1, "Error allocating memory.");
+
+        ret = Cobs_deframer_init(deframer, eng->tx_size);
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "Error initializing deframer.");
+    }
+
+    /*  A single read may carry several frames: keep deframing until the fifo
+        no longer holds a complete one.
+    */
+    msg_size = Cobs_deframer(deframer, data, len, eng->msg_buf,
+        eng->msg_max_size);
+    while (msg_size > 0)
+    {
+        dispatch(eng, eng->msg_buf, msg_size);
+        num++;
+
+        if (SwFifo_getCount(&deframer->fifo) == 0)
+        {
+            break;
+        }
+        msg_size = Cobs_deframer(deframer, data, 0, eng->msg_buf,
+            eng->msg_max_size);
+    }
+
+    return num;
+}
+
+/******************************************************************************
+    [docimport RpcEngine_inputInPlace]
+*//**
+    @brief Zero-copy variant of RpcEngine_input for COBS transports which own
+    a linear receive buffer: frames are decoded in place and dispatched
+    straight from buf. An incomplete trailing frame is moved to the front of
+    buf; the caller appends the next receive after it.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] buf  Pointer to the receive buffer (kept bytes + new bytes).
+    @param[in] len  Number of valid bytes in buf.
+    @param[in] size  Size of buf.
+    @return Returns the number of bytes kept at the front of buf.
+******************************************************************************/
+uint32_t
+RpcEngine_inputInPlace(
+    RpcEngine *eng,
+    uint8_t *buf,
+    uint32_t len,
+    uint32_t size)
+{
+    uint32_t pos = 0;
+
+    while (pos < len)
+    {
+        uint8_t *msg;
+        uint32_t consumed;
+        int msg_size;
+
+        msg_size = Cobs_deframeInPlace(buf + pos, len - pos, &msg, &consumed);
+        pos += consumed;
+        if (msg_size == 0)
+        {
+            break;
+        }
+        else if (msg_size < 0)
+        {
+            eng->stats.errors++;
+            continue;
+        }
+
+        dispatch(eng, msg, msg_size);
+    }
+
+    len -= pos;
+    if (len == size)
+    {
+        LOGPRINT_ERROR("Frame exceeds receive buffer (%u), dropped.",
+            (unsigned int)size);
+        eng->stats.errors++;
+        return 0;
+    }
+
+    if (len > 0 && pos > 0)
+    {
+        memmove(buf, buf + pos, len);
+    }
+
+    return len;
+}
+
+/******************************************************************************
+    [docimport RpcEngine_poll]
+*//**
+    @brief Pull-mode entry: reads once from the transport (waiting up to
+    timeout_ms) and processes whatever was received.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] timeout_ms  Receive timeout.
+    @return Returns the number of requests dispatched, negative on error.
+******************************************************************************/
+int
+RpcEngine_poll(RpcEngine *eng, uint32_t timeout_ms)
+{
+    RpcTransport *t = eng->transport;
+    uint32_t num_calls;
+    int num_read;
+
+    CHECK_COND_RETURN_MSG(!t->recv, -1, "Transport has no recv.");
+
+    if (!eng->rx_buf)
+    {
+        eng->rx_size = (t->framing == RPCTRANSPORT_FRAMING_COBS) ?
+            eng->tx_size : eng->msg_max_size;
+        eng->rx_buf = (uint8_t *)malloc(eng->rx_size);
+        CHECK_COND_RETURN_MSG(!eng->rx_buf, -1, "Error allocating memory.");
+    }
+
+    num_read = t->recv(t->ctx, eng->rx_buf + eng->rx_keep,
+        eng->rx_size - eng->rx_keep, timeout_ms);
+    if (num_read <= 0)
+    {
+        return num_read;
+    }
+
+    if (t->framing == RPCTRANSPORT_FRAMING_NONE)
+    {
+        return RpcEngine_input(eng, eng->rx_buf, num_read);
+    }
+
+    eng->stats.rx_bytes += num_read;
+    num_calls = eng->stats.num_calls;
+    eng->rx_keep = RpcEngine_inputInPlace(eng, eng->rx_buf,
+        eng->rx_keep + num_read, eng->rx_size);
+
+    return eng->stats.num_calls - num_calls;
+}
+
+/******************************************************************************
+    engine_task
+*//**
+    @brief Engine task loop.
+******************************************************************************/
+static void
+engine_task(void *p)
+{
+    RpcEngine *eng = (RpcEngine *)p;
+
+    LOGPRINT_INFO("Starting RpcEngine task: %s.", eng->taskName);
+
+    while (1)
+    {
+        int ret = RpcEngine_poll(eng, RPCENGINE_RECV_TIMEOUT_MS);
+        if (ret < 0)
+        {
+            LOGPRINT_ERROR("Transport error (%d).", ret);
+            RTOS_TASK_SLEEP_s(1);
+        }
+        else if (ret == 0)
+        {
+            /* Non-blocking transports would otherwise starve other tasks. */
+            RTOS_TASK_SLEEP_ticks(1);
+        }
+    }
+}
+
+/******************************************************************************
+    [docimport RpcEngine_setLimit]
+*//**
+    @brief Attaches a limiter. Rejected calls are answered with RPC_BUSY.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] limit  Pointer to initialized RpcLimit (may be shared between
+    engines), NULL to detach.
+******************************************************************************/
+void
+RpcEngine_setLimit(RpcEngine *eng, RpcLimit *limit)
+{
+    eng->admission.admit = limit_admit;
+    eng->admission.release = limit_release;
+    eng->admission.ctx = (void *)eng;
+    eng->limit = limit;
+}
+
+/******************************************************************************
+    [docimport RpcEngine_start]
+*//**
+    @brief Starts a task which runs RpcEngine_poll forever. The transport must
+    implement recv.
+    @param[in] eng  Pointer to initialized RpcEngine.
+    @param[in] name  Task name.
+    @param[in] stack_size  Task stack size.
+    @param[in] prio  Task priority.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcEngine_start(
+    RpcEngine *eng,
+    const char *name,
+    uint16_t stack_size,
+    uint8_t prio)
+{
+    CHECK_COND_RETURN_MSG(!eng->transport->recv, -1, "Transport has no recv.");
+
+    strncpy(eng->taskName, name, sizeof(eng->taskName) - 1);
+
+    return RTOS_TASK_CREATE(
+        engine_task,
+        eng->taskName,
+        stack_size,
+        (void *)eng,
+        prio,
+        &eng->taskHandle);
+}
+
+/******************************************************************************
+    [docimport RpcEngine_init]
+*//**
+    @brief Initializes an RpcEngine. Buffers are allocated according to the
+    transport framing policy (the COBS fifo deframer only on first use of
+    RpcEngine_input).
+    @param[in] eng  Pointer to uninitialized RpcEngine.
+    @param[in] rpc  Pointer to *initialized* ProtoRpc instance.
+    @param[in] transport  Pointer to *initialized* transport.
+    @param[in] msg_max_size  Max size of an unframed request or reply (e.g.
+    PROTORPC_MSG_MAX_SIZE).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcEngine_init(
+    RpcEngine *eng,
+    ProtoRpc *rpc,
+    RpcTransport *transport,
+    uint32_t msg_max_size)
+{
+    CHECK_COND_RETURN_MSG(!transport->send, -1, "Transport has no send.");
+
+    memset(eng, 0, sizeof(RpcEngine));
+    eng->rpc = rpc;
+    eng->transport = transport;
+    eng->msg_max_size = msg_max_size;
+
+    eng->reply_buf = (uint8_t *)malloc(msg_max_size);
+    CHECK_COND_RETURN_MSG(!eng->reply_buf, -1, "Error allocating memory.");
+
+    if (transport->framing == RPCTRANSPORT_FRAMING_COBS)
+    {
+        eng->tx_size = RPCENGINE_FRAMED_SIZE(msg_max_size);
+        eng->tx_buf = (uint8_t *)malloc(eng->tx_size);
+        CHECK_COND_RETURN_MSG(!eng->tx_buf, -1, "Error allocating memory.");
+    }
+
+    return 0;
+}
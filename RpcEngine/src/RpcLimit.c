@@ -0,0 +1,318 @@
+/*******************************************************************************
+ *  @file: RpcLimit.c
+ *
+ *  @brief: RPC admission control: token buckets per client and per callset
+ *  plus a max-in-flight limit.
+*******************************************************************************/
+#include <string.h>
+#include "RpcLimit.h"
+#include "SwTimer.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "RpcLimit";
+
+/******************************************************************************
+    bucket_init
+*//**
+    @brief Sets up a bucket, initially full.
+******************************************************************************/
+static void
+bucket_init(RpcLimit_Bucket *b, uint32_t rate, uint32_t burst)
+{
+    b->rate = rate;
+    b->burst = (burst == 0) ? 1 : burst;
+    b->tokens = b->burst*1000;
+    b->last_us = SwTimer_getCount();
+}
+
+/******************************************************************************
+    bucket_check
+*//**
+    @brief Refills the bucket and checks for a whole token.
+    @return Returns 0 if a token is available, otherwise ms until one is.
+******************************************************************************/
+static uint32_t
+bucket_check(RpcLimit_Bucket *b, uint64_t now)
+{
+    uint64_t add;
+
+    if (b->rate == 0)
+    {
+        return 0;
+    }
+
+    /*  rate calls/s == rate/1000 tokens/us in 1/1000 units. The refill stamp
+        only moves when something was added so slow rates still accumulate.
+    */
+    add = (now - b->last_us)*b->rate/1000;
+    if (add > 0)
+    {
+        uint64_t level = b->tokens + add;
+        b->tokens = (level > b->burst*1000) ? b->burst*1000 : (uint32_t)level;
+        b->last_us = now;
+    }
+
+    if (b->tokens >= 1000)
+    {
+        return 0;
+    }
+
+    return (1000 - b->tokens + b->rate - 1)/b->rate;
+}
+
+/******************************************************************************
+    bucket_take
+*//**
+    @brief Takes one token (after a successful bucket_check).
+******************************************************************************/
+static void
+bucket_take(RpcLimit_Bucket *b)
+{
+    if (b->rate)
+    {
+        b->tokens -= 1000;
+    }
+}
+
+/******************************************************************************
+    client_lookup
+*//**
+    @brief Finds the client's bucket, recycling the least recently seen slot
+    for a new client.
+******************************************************************************/
+static RpcLimit_Client *
+client_lookup(RpcLimit *lim, uint32_t key)
+{
+    RpcLimit_Client *victim = &lim->clients[0];
+    uint32_t i;
+
+    lim->use_count++;
+
+    for (i = 0; i < RPCLIMIT_MAX_CLIENTS; i++)
+    {
+        RpcLimit_Client *c = &lim->clients[i];
+        if (c->used && c->key == key)
+        {
+            c->last_use = lim->use_count;
+            return c;
+        }
+
+        if (!c->used)
+        {
+            victim = c;
+        }
+        else if (victim->used && c->last_use < victim->last_use)
+        {
+            victim = c;
+        }
+    }
+
+    victim->used = true;
+    victim->key = key;
+    victim->last_use = lim->use_count;
+    bucket_init(&victim->bucket, lim->client_rate, lim->client_burst);
+    return victim;
+}
+
+/******************************************************************************
+    callset_lookup
+*//**
+    @brief Finds the callset's bucket.
+    @return Returns NULL if the callset is not limited.
+******************************************************************************/
+static RpcLimit_Callset *
+callset_lookup(RpcLimit *lim, uint32_t tag)
+{
+    uint32_t i;
+
+    for (i = 0; i < lim->num_callsets; i++)
+    {
+        if (lim->callsets[i].tag == tag)
+        {
+            return &lim->callsets[i];
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+    [docimport RpcLimit_admit]
+*//**
+    @brief Decides whether a call may run. A token is taken from the client
+    and callset buckets only when all limits pass.
+    @param[in] lim  Pointer to initialized RpcLimit.
+    @param[in] client  Client key.
+    @param[in] which_callset  Callset tag of the call.
+    @param[out] retry_after_ms  On rejection, time until the call would pass.
+    @return Returns true if admitted (call RpcLimit_release when done).
+******************************************************************************/
+bool
+RpcLimit_admit(
+    RpcLimit *lim,
+    uint32_t client,
+    uint32_t which_callset,
+    uint32_t *retry_after_ms)
+{
+    uint64_t now = SwTimer_getCount();
+    RpcLimit_Client *c;
+    RpcLimit_Callset *cs;
+    uint32_t wait;
+    bool admitted = false;
+
+    RTOS_MUTEX_GET(lim->lock);
+
+    if (lim->max_in_flight && lim->stats.in_flight >= lim->max_in_flight)
+    {
+        lim->stats.rejected_inflight++;
+        *retry_after_ms = RPCLIMIT_INFLIGHT_RETRY_MS;
+        goto done;
+    }
+
+    c = client_lookup(lim, client);
+    wait = bucket_check(&c->bucket, now);
+    if (wait)
+    {
+        lim->stats.rejected_client++;
+        *retry_after_ms = wait;
+        goto done;
+    }
+
+    cs = callset_lookup(lim, which_callset);
+    if (cs)
+    {
+        wait = bucket_check(&cs->bucket, now);
+        if (wait)
+        {
+            lim->stats.rejected_callset++;
+            *retry_after_ms = wait;
+            goto done;
+        }
+        bucket_take(&cs->bucket);
+    }
+    bucket_take(&c->bucket);
+
+    admitted = true;
+    lim->stats.admitted++;
+    lim->stats.in_flight++;
+    if (lim->stats.in_flight > lim->stats.max_in_flight)
+    {
+        lim->stats.max_in_flight = lim->stats.in_flight;
+    }
+
+done:
+    RTOS_MUTEX_PUT(lim->lock);
+    return admitted;
+}
+
+/******************************************************************************
+    [docimport RpcLimit_release]
+*//**
+    @brief Marks an admitted call as complete.
+    @param[in] lim  Pointer to initialized RpcLimit.
+******************************************************************************/
+void
+RpcLimit_release(RpcLimit *lim)
+{
+    RTOS_MUTEX_GET(lim->lock);
+    if (lim->stats.in_flight > 0)
+    {
+        lim->stats.in_flight--;
+    }
+    RTOS_MUTEX_PUT(lim->lock);
+}
+
+/******************************************************************************
+    [docimport RpcLimit_getStats]
+*//**
+    @brief Gets a snapshot of the limiter counters.
+    @param[in] lim  Pointer to initialized RpcLimit.
+    @param[out] stats  Pointer to stats to fill.
+    @param[in] clear  If true, counters are cleared (in_flight is kept).
+******************************************************************************/
+void
+RpcLimit_getStats(RpcLimit *lim, RpcLimit_Stats *stats, bool clear)
+{
+    RTOS_MUTEX_GET(lim->lock);
+    *stats = lim->stats;
+    if (clear)
+    {
+        uint32_t in_flight = lim->stats.in_flight;
+        memset(&lim->stats, 0, sizeof(RpcLimit_Stats));
+        lim->stats.in_flight = in_flight;
+    }
+    RTOS_MUTEX_PUT(lim->lock);
+}
+
+/******************************************************************************
+    [docimport RpcLimit_setCallset]
+*//**
+    @brief Adds (or updates) a per callset limit, shared by all clients.
+    @param[in] lim  Pointer to initialized RpcLimit.
+    @param[in] tag  Callset tag in the RpcFrame.
+    @param[in] rate  Sustained calls/s (0 = unlimited).
+    @param[in] burst  Calls allowed back to back.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcLimit_setCallset(RpcLimit *lim, uint32_t tag, uint32_t rate, uint32_t burst)
+{
+    RpcLimit_Callset *cs;
+    int ret = 0;
+
+    RTOS_MUTEX_GET(lim->lock);
+
+    cs = callset_lookup(lim, tag);
+    if (!cs)
+    {
+        if (lim->num_callsets < RPCLIMIT_MAX_CALLSETS)
+        {
+            cs = &lim->callsets[lim->num_callsets++];
+            cs->tag = tag;
+        }
+        else
+        {
+            LOGPRINT_ERROR("Callset table full (%u).",
+                (unsigned)RPCLIMIT_MAX_CALLSETS);
+            ret = -1;
+        }
+    }
+
+    if (cs)
+    {
+        bucket_init(&cs->bucket, rate, burst);
+    }
+
+    RTOS_MUTEX_PUT(lim->lock);
+    return ret;
+}
+
+/******************************************************************************
+    [docimport RpcLimit_init]
+*//**
+    @brief Initializes a limiter.
+    @param[in] lim  Pointer to uninitialized RpcLimit.
+    @param[in] client_rate  Sustained calls/s per client (0 = unlimited).
+    @param[in] client_burst  Calls a client may issue back to back.
+    @param[in] max_in_flight  Max calls executing at once (0 = unlimited).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcLimit_init(
+    RpcLimit *lim,
+    uint32_t client_rate,
+    uint32_t client_burst,
+    uint32_t max_in_flight)
+{
+    memset(lim, 0, sizeof(RpcLimit));
+    lim->client_rate = client_rate;
+    lim->client_burst = client_burst;
+    lim->max_in_flight = max_in_flight;
+
+    lim->lock = RTOS_MUTEX_CREATE_STATIC(&lim->lockbuf);
+    CHECK_COND_RETURN_MSG(!lim->lock, -1, "Error creating mutex.");
+
+    return 0;
+}
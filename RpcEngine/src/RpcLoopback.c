@@ -0,0 +1,181 @@
+/*******************************************************************************
+ *  @file: RpcLoopback.c
+ *  
+ *  @brief: In-memory loopback RpcTransport.
+*******************************************************************************/
+#include <string.h>
+#include "RpcLoopback.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "RpcLoopback";
+
+/*  With FRAMING_NONE each message is stored as a 16-bit length followed by the
+    message bytes so that boundaries are preserved. */
+#define RECORD_HDR_SIZE     sizeof(uint16_t)
+
+/******************************************************************************
+    fifo_put
+*//**
+    @brief Writes a message (or raw bytes) into a direction fifo.
+******************************************************************************/
+static int
+fifo_put(RpcLoopback *lb, SwFifo *fifo, uint8_t *buf, uint32_t len)
+{
+    if (lb->transport.framing == RPCTRANSPORT_FRAMING_NONE)
+    {
+        uint16_t rec_len = (uint16_t)len;
+
+        CHECK_COND_RETURN(len > UINT16_MAX, -1);
+        CHECK_COND_RETURN(SwFifo_getAvail(fifo) < RECORD_HDR_SIZE + len, -1);
+        SwFifo_write(fifo, &rec_len, RECORD_HDR_SIZE);
+    }
+
+    CHECK_COND_RETURN(SwFifo_write(fifo, buf, len) < 0, -1);
+    return len;
+}
+
+/******************************************************************************
+    fifo_get
+*//**
+    @brief Reads a message (or all pending bytes) from a direction fifo.
+******************************************************************************/
+static int
+fifo_get(RpcLoopback *lb, SwFifo *fifo, uint8_t *buf, uint32_t size)
+{
+    uint32_t count = SwFifo_getCount(fifo);
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    if (lb->transport.framing == RPCTRANSPORT_FRAMING_NONE)
+    {
+        uint16_t rec_len;
+
+        CHECK_COND_RETURN(count < RECORD_HDR_SIZE, 0);
+        SwFifo_peek(fifo, &rec_len, RECORD_HDR_SIZE);
+        CHECK_COND_RETURN_MSG(rec_len > size, -1, "Buffer too small.");
+        /* Writer (other task) may not have finished the payload yet. */
+        CHECK_COND_RETURN(count < RECORD_HDR_SIZE + rec_len, 0);
+        SwFifo_ack(fifo, RECORD_HDR_SIZE);
+        SwFifo_read(fifo, buf, rec_len);
+        return rec_len;
+    }
+
+    if (count > size)
+    {
+        count = size;
+    }
+    SwFifo_read(fifo, buf, count);
+    return count;
+}
+
+/******************************************************************************
+    loopback_recv
+*//**
+    @brief RpcTransport recv (server side). Never blocks.
+******************************************************************************/
+static int
+loopback_recv(void *ctx, uint8_t *buf, uint32_t size, uint32_t timeout_ms)
+{
+    RpcLoopback *lb = (RpcLoopback *)ctx;
+    (void)timeout_ms;
+    return fifo_get(lb, &lb->to_server, buf, size);
+}
+
+/******************************************************************************
+    loopback_send
+*//**
+    @brief RpcTransport send (server side).
+******************************************************************************/
+static int
+loopback_send(void *ctx, uint8_t *buf, uint32_t len)
+{
+    RpcLoopback *lb = (RpcLoopback *)ctx;
+    return fifo_put(lb, &lb->to_client, buf, len);
+}
+
+/******************************************************************************
+    loopback_close
+*//**
+    @brief RpcTransport close. Drops anything in flight.
+******************************************************************************/
+static int
+loopback_close(void *ctx)
+{
+    RpcLoopback *lb = (RpcLoopback *)ctx;
+    SwFifo_flush(&lb->to_server);
+    SwFifo_flush(&lb->to_client);
+    return 0;
+}
+
+/******************************************************************************
+    [docimport RpcLoopback_clientWrite]
+*//**
+    @brief Writes a request from the client side. With FRAMING_COBS the data
+    must already be framed.
+    @param[in] lb  Pointer to RpcLoopback object.
+    @param[in] buf  Pointer to data.
+    @param[in] len  Number of bytes.
+    @return Returns len on success, negative if the fifo is full.
+******************************************************************************/
+int
+RpcLoopback_clientWrite(RpcLoopback *lb, uint8_t *buf, uint32_t len)
+{
+    return fifo_put(lb, &lb->to_server, buf, len);
+}
+
+/******************************************************************************
+    [docimport RpcLoopback_clientRead]
+*//**
+    @brief Reads reply data on the client side. With FRAMING_NONE exactly one
+    message is returned; with FRAMING_COBS all pending bytes (up to size).
+    @param[in] lb  Pointer to RpcLoopback object.
+    @param[in] buf  Pointer to buffer.
+    @param[in] size  Size of buffer.
+    @return Returns number of bytes read (0 if none), negative on error.
+******************************************************************************/
+int
+RpcLoopback_clientRead(RpcLoopback *lb, uint8_t *buf, uint32_t size)
+{
+    return fifo_get(lb, &lb->to_client, buf, size);
+}
+
+/******************************************************************************
+    [docimport RpcLoopback_init]
+*//**
+    @brief Initializes a loopback transport.
+    @param[in] lb  Pointer to uninitialized RpcLoopback object.
+    @param[in] framing  Framing policy.
+    @param[in] depth  Depth of each direction's byte fifo.
+    @param[in] threadsafe  Set if client and server run in different tasks.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcLoopback_init(
+    RpcLoopback *lb,
+    RpcTransport_framing framing,
+    uint32_t depth,
+    bool threadsafe)
+{
+    int ret;
+
+    lb->transport.ctx = (void *)lb;
+    lb->transport.framing = framing;
+    lb->transport.recv = loopback_recv;
+    lb->transport.send = loopback_send;
+    lb->transport.close = loopback_close;
+
+    ret = SwFifo_init(&lb->to_server, "lb_to_server", depth, sizeof(uint8_t),
+        NULL, 0, threadsafe);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Error initializing fifo.");
+
+    ret = SwFifo_init(&lb->to_client, "lb_to_client", depth, sizeof(uint8_t),
+        NULL, 0, threadsafe);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Error initializing fifo.");
+
+    return 0;
+}
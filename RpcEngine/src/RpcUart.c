@@ -0,0 +1,116 @@
+/*******************************************************************************
+ *  @file: RpcUart.c
+ *  
+ *  @brief: UART RpcTransport.
+*******************************************************************************/
+#include "RpcUart.h"
+#include "driver/uart.h"
+#include "RtosUtils.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "RpcUart";
+
+/******************************************************************************
+    uart_recv
+*//**
+    @brief RpcTransport recv. Returns as soon as any bytes arrive.
+******************************************************************************/
+static int
+uart_recv(void *ctx, uint8_t *buf, uint32_t size, uint32_t timeout_ms)
+{
+    RpcUart *uart = (RpcUart *)ctx;
+    size_t avail = 0;
+    int num;
+
+    /* Wait for the first byte, then take everything already buffered. */
+    num = uart_read_bytes(uart->port, buf, 1, RTOS_MS_TO_TICKS(timeout_ms));
+    if (num <= 0)
+    {
+        return num;
+    }
+
+    uart_get_buffered_data_len(uart->port, &avail);
+    if (avail > size - 1)
+    {
+        avail = size - 1;
+    }
+    if (avail > 0)
+    {
+        int more = uart_read_bytes(uart->port, buf + 1, avail, 0);
+        CHECK_COND_RETURN_MSG(more < 0, more, "UART read error.");
+        num += more;
+    }
+
+    return num;
+}
+
+/******************************************************************************
+    uart_send
+*//**
+    @brief RpcTransport send.
+******************************************************************************/
+static int
+uart_send(void *ctx, uint8_t *buf, uint32_t len)
+{
+    RpcUart *uart = (RpcUart *)ctx;
+    return uart_write_bytes(uart->port, (const char *)buf, len);
+}
+
+/******************************************************************************
+    uart_close
+*//**
+    @brief RpcTransport close.
+******************************************************************************/
+static int
+uart_close(void *ctx)
+{
+    RpcUart *uart = (RpcUart *)ctx;
+    return uart_driver_delete(uart->port);
+}
+
+/******************************************************************************
+    [docimport RpcUart_init]
+*//**
+    @brief Installs the UART driver and initializes the transport.
+    @param[in] uart  Pointer to uninitialized RpcUart object.
+    @param[in] port  UART port number.
+    @param[in] baud  Baud rate.
+    @param[in] tx_pin  TX gpio (-1 to keep the default).
+    @param[in] rx_pin  RX gpio (-1 to keep the default).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+RpcUart_init(RpcUart *uart, int port, int baud, int tx_pin, int rx_pin)
+{
+    esp_err_t ret;
+    const uart_config_t cfg = {
+        .baud_rate = baud,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    uart->port = port;
+    uart->transport.ctx = (void *)uart;
+    uart->transport.framing = RPCTRANSPORT_FRAMING_COBS;
+    uart->transport.recv = uart_recv;
+    uart->transport.send = uart_send;
+    uart->transport.close = uart_close;
+
+    ret = uart_driver_install(port, RPCUART_RX_BUF_SIZE, 0, 0, NULL, 0);
+    CHECK_COND_RETURN_MSG(ret != ESP_OK, -1, "Error installing uart driver.");
+
+    ret = uart_param_config(port, &cfg);
+    CHECK_COND_RETURN_MSG(ret != ESP_OK, -1, "Error configuring uart.");
+
+    ret = uart_set_pin(port, tx_pin, rx_pin, UART_PIN_NO_CHANGE,
+        UART_PIN_NO_CHANGE);
+    CHECK_COND_RETURN_MSG(ret != ESP_OK, -1, "Error setting uart pins.");
+
+    LOGPRINT_INFO("RpcUart on port %d @ %d baud.", port, baud);
+    return 0;
+}
@@ -31,6 +31,14 @@
 
 #define RTOS_TASK_DELETE(handle)    vTaskDelete((handle))
 
+/** @brief Handle of the calling task. */
+#define RTOS_TASK_SELF()            xTaskGetCurrentTaskHandle()
+
+/** @brief Task notification: wakes a task waiting in RTOS_TASK_NOTIFY_TAKE
+      (a notification given before the wait is not lost). */
+#define RTOS_TASK_NOTIFY_GIVE(handle)   xTaskNotifyGive((handle))
+#define RTOS_TASK_NOTIFY_TAKE()         ulTaskNotifyTake(pdTRUE, portMAX_DELAY)
+
 /** @brief Task creation pinned to core.  Returns 0 on success, -1 on error. */
 #define RTOS_TASK_CREATE_PINNED(func, name, stack, params, prio, handle, core)\
 ({                                                                            \
@@ -151,6 +159,13 @@
 #define RTOS_MUTEX_STATIC_BUF               StaticSemaphore_t
 #define RTOS_MUTEX_CREATE()                 xSemaphoreCreateMutex()
 #define RTOS_MUTEX_CREATE_STATIC(sbuf)      xSemaphoreCreateMutexStatic((sbuf))
+#define RTOS_MUTEX_DELETE(m)                vSemaphoreDelete((m))
+
+/** @brief Recursive mutex: the holder may take it again (each get needs a
+      put). Only the _RECURSIVE get/put macros may be used on it. */
+#define RTOS_MUTEX_CREATE_RECURSIVE()   xSemaphoreCreateRecursiveMutex()
+#define RTOS_MUTEX_CREATE_RECURSIVE_STATIC(sbuf)\
+    xSemaphoreCreateRecursiveMutexStatic((sbuf))
 
 /** @brief Macro to take a mutex, waiting forever. */
 #define RTOS_MUTEX_GET(m)               xSemaphoreTake((m), portMAX_DELAY) 
@@ -163,6 +178,10 @@
 /** @brief Macro to put a mutex. */
 #define RTOS_MUTEX_PUT(m)               xSemaphoreGive((m)) 
 
+/** @brief Macros to take (waiting forever) and put a recursive mutex. */
+#define RTOS_MUTEX_GET_RECURSIVE(m)     xSemaphoreTakeRecursive((m), portMAX_DELAY)
+#define RTOS_MUTEX_PUT_RECURSIVE(m)     xSemaphoreGiveRecursive((m))
+
 /** @brief Queues. */
 #define RTOS_QUEUE                              QueueHandle_t
 /*  Create a queue.
@@ -172,6 +191,8 @@
 */
 #define RTOS_QUEUE_CREATE(depth, size)\
     xQueueCreate((depth), (size));
+/*  Delete a queue. */
+#define RTOS_QUEUE_DELETE(xq)   vQueueDelete((xq))
 /*  Send to queue, wait forever.
     Returns pdTrue on success, errQUEUE_FULL otherwise.
 */
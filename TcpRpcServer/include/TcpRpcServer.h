@@ -9,7 +9,7 @@
 #include <stdint.h>
 #include "TcpServer.h"
 #include "ProtoRpc.h"
-#include "Cobs_frame.h"
+#include "RpcEngine.h"
 
 /** @brief TcpRpcServer object.
 */
@@ -19,8 +19,12 @@ typedef struct TcpRpcServer
     TcpServer tcp;
     /** @brief Pointer to the ProtoRpc instance. */
     ProtoRpc *rpc;
-    /** @brief Stream de-framer. */
-    Cobs_Deframer deframer;
+    /** @brief COBS framed transport over the active socket. */
+    RpcTransport transport;
+    /** @brief Rpc engine (de-framing, dispatch, reply). */
+    RpcEngine engine;
+    /** @brief Socket currently being served. */
+    int sock;
     
 } TcpRpcServer;
 
@@ -43,4 +47,15 @@ TcpRpcServer_init(
     uint16_t port,
     uint16_t stack_size,
     uint8_t prio);
+
+/******************************************************************************
+    [docexport TcpRpcServer_setLimit]
+*//**
+    @brief Applies admission control to the server. Clients are keyed by
+    IPv4 address.
+    @param[in] server  Pointer to initialized TcpRpcServer instance.
+    @param[in] limit  Pointer to initialized RpcLimit, NULL to remove.
+******************************************************************************/
+void
+TcpRpcServer_setLimit(TcpRpcServer *server, RpcLimit *limit);
 #endif
@@ -6,24 +6,51 @@
 #include "TcpRpcServer.h"
 #include "TcpSocket.h"
 #include "TcpServer.h"
-#include "Cobs_frame.h"
 #include "ProtoRpc.h"
+#include "CheckCond.h"
 #include "LogPrint.h"
 #include "LogPrint_local.h"
 
 static const char *TAG = "TcpRpcServer";
 
-#define TCP_BUFFER_SIZE     4*1024
+/** @brief Sized for one max size framed request, decoded in place. */
+#define TCP_BUFFER_SIZE     RPCENGINE_FRAMED_SIZE(PROTORPC_MSG_MAX_SIZE)
 
-/** @brief Static buffers used for data. */
-/* Buffer used to hold received socket data */
+/** @brief Static buffer used to hold received socket data. */
 static uint8_t tcp_rx_buf[TCP_BUFFER_SIZE];
-/* Buffer used to hold transmit socket data */
-static uint8_t tcp_tx_buf[TCP_BUFFER_SIZE];
-/* Buffer to hold the deframed (protobuf-packed) rpc received message. */
-static uint8_t rpc_rcv_msg[PROTORPC_MSG_MAX_SIZE];
-/* Buffer to hold the protobuf-packed rpc reply message. */
-static uint8_t rpc_reply_msg[PROTORPC_MSG_MAX_SIZE];
+
+/******************************************************************************
+    transport_send
+*//**
+    @brief RpcTransport send: writes to the socket currently being served.
+******************************************************************************/
+static int
+transport_send(void *ctx, uint8_t *buf, uint32_t len)
+{
+    TcpRpcServer *server = (TcpRpcServer *)ctx;
+    return TcpSocket_write(server->sock, buf, len);
+}
+
+/******************************************************************************
+    peer_key
+*//**
+    @brief Limiter key for a connection: the peer IPv4 address, so that
+    reconnecting does not reset a client's budget.
+******************************************************************************/
+static uint32_t
+peer_key(int sock)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+
+    if (getpeername(sock, (struct sockaddr *)&addr, &addr_len) == 0 &&
+        addr.ss_family == AF_INET)
+    {
+        return ((struct sockaddr_in *)&addr)->sin_addr.s_addr;
+    }
+
+    return (uint32_t)sock;
+}
 
 /******************************************************************************
     rpc_callback
@@ -40,60 +67,27 @@ rpc_callback(void *server, int sock, uint8_t *data, uint16_t len, int *finished)
 {
     /** @brief TcpRpcServer type masquerades as a TcpServer. */
     TcpRpcServer *tcprpc_server = (TcpRpcServer *)server;
-    ProtoRpc *rpc               = tcprpc_server->rpc;
-    Cobs_Deframer *deframer     = &tcprpc_server->deframer;
-    int raw_msg_size;
-    int num_sent;
-    uint32_t reply_size;
+    TcpServer *tcp              = &tcprpc_server->tcp;
 
     *finished = 1;
 
     if (len > 0)
     {
-        /*  Attempt deframe of incoming stream. A positive raw_msg_size
-            indicates a new decoded message is available.
-        */
-        raw_msg_size = Cobs_deframer(
-            deframer,
-            data,
-            len,
-            rpc_rcv_msg,
-            sizeof(rpc_rcv_msg));
-
-        if (raw_msg_size)
+        if (tcprpc_server->engine.limit)
         {
-            LOGPRINT_HEXDUMP_VERBOSE("Deframed raw message.",
-                rpc_rcv_msg, raw_msg_size);
-
-            ProtoRpc_server(
-                rpc,
-                rpc_rcv_msg,
-                raw_msg_size,
-                rpc_reply_msg,
-                sizeof(rpc_reply_msg),
-                &reply_size);
-
-            if (reply_size > 0)
-            {
-                int framed_size = Cobs_framer(
-                    rpc_reply_msg,
-                    reply_size,
-                    tcp_tx_buf,
-                    sizeof(tcp_tx_buf));
-
-                if (framed_size < 0)
-                {
-                    LOGPRINT_ERROR("Framer error detected in RPC reply.");
-                    return;
-                }
-
-                LOGPRINT_HEXDUMP_VERBOSE("Framed Tx message.",
-                    tcp_tx_buf, framed_size);
-
-                num_sent = TcpSocket_write(sock, tcp_tx_buf, framed_size);
-                LOGPRINT_DEBUG("Wrote rpc reply: %d bytes.", num_sent);
-            }
+            tcprpc_server->engine.client = peer_key(sock);
         }
+        tcprpc_server->sock = sock;
+        tcprpc_server->engine.stats.rx_bytes += len;
+
+        /*  New bytes were appended to any partial frame kept from the last
+            read; frames are decoded and parsed right in the rx buffer.
+        */
+        tcp->data_keep = RpcEngine_inputInPlace(
+            &tcprpc_server->engine,
+            tcp->data,
+            tcp->data_keep + len,
+            tcp->data_len);
     }
 }
 
@@ -116,10 +110,21 @@ TcpRpcServer_init(
     uint16_t stack_size,
     uint8_t prio)
 {
+    int ret;
+
     server->rpc = rpc;
+    server->sock = -1;
+
+    /** @brief Initialize the COBS framed transport and the engine. */
+    server->transport.ctx = (void *)server;
+    server->transport.framing = RPCTRANSPORT_FRAMING_COBS;
+    server->transport.recv = NULL;
+    server->transport.send = transport_send;
+    server->transport.close = NULL;
 
-    /** @brief Initialize the Deframer. */
-    Cobs_deframer_init(&server->deframer, sizeof(tcp_rx_buf));
+    ret = RpcEngine_init(&server->engine, rpc, &server->transport,
+        PROTORPC_MSG_MAX_SIZE);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Error initializing RpcEngine.");
 
     /** @brief Initialize the TcpServer. */
     return TcpServer_init(
@@ -132,3 +137,17 @@ TcpRpcServer_init(
         prio,
         rpc_callback);
 }
+
+/******************************************************************************
+    [docimport TcpRpcServer_setLimit]
+*//**
+    @brief Applies admission control to the server. Clients are keyed by
+    IPv4 address.
+    @param[in] server  Pointer to initialized TcpRpcServer instance.
+    @param[in] limit  Pointer to initialized RpcLimit, NULL to remove.
+******************************************************************************/
+void
+TcpRpcServer_setLimit(TcpRpcServer *server, RpcLimit *limit)
+{
+    RpcEngine_setLimit(&server->engine, limit);
+}
@@ -60,6 +60,10 @@ typedef struct TcpServer
     uint8_t *data;
     /** @brief Length of data buffer. */
     uint16_t data_len;
+    /** @brief Bytes at the front of data which the callback asks to keep
+        (e.g. a partial frame). The next read is appended after them and the
+        callback is passed the new bytes only. Reset on each connection. */
+    uint16_t data_keep;
     /** @brief User callback. */
     TcpServer_cb *cb;
 
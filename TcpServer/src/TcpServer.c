@@ -58,13 +58,23 @@ tcp_server_task(void *p)
         int read_done = 0;
         int callback_done = 0;
 
+        server->data_keep = 0;
+
         while (1)
         {
             int num_read = 0;
 
             if (!read_done)
             {
-                num_read = TcpSocket_read(sock, server->data, server->data_len);
+                if (server->data_keep >= server->data_len)
+                {
+                    LOGPRINT_ERROR("Rx buffer full, dropping kept data.");
+                    server->data_keep = 0;
+                }
+
+                num_read = TcpSocket_read(sock,
+                    server->data + server->data_keep,
+                    server->data_len - server->data_keep);
                 if (num_read < 0)
                 {
                     LOGPRINT_ERROR("Closing socket due to read error.");
@@ -91,7 +101,7 @@ tcp_server_task(void *p)
             server->cb(
                 (void *)server,
                 sock,
-                server->data,
+                server->data + server->data_keep,
                 (uint16_t)num_read,
                 &callback_done);
 
@@ -162,6 +172,7 @@ TcpServer_init(
         CHECK_COND_RETURN_MSG(!server->data, -1, "Error allocating memory.");
     }
     server->data_len = buf_len;
+    server->data_keep = 0;
 
     rc = TcpSocket_init(tcp, port);
     CHECK_COND_RETURN_MSG(rc < 0, rc, "Error initializing server.");
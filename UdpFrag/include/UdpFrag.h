@@ -0,0 +1,211 @@
+/*******************************************************************************
+ *  @file: UdpFrag.h
+ *
+ *  @brief: Header for UdpFrag, a lightweight fragmentation/reassembly layer
+ *  with selective acknowledgement for carrying large messages over UDP.
+ *
+ *  Every fragment is prefixed with an 8 byte header:
+ *
+ *    [0]    magic (0xF5)
+ *    [1]    type (UDPFRAG_TYPE_DATA or UDPFRAG_TYPE_ACK)
+ *    [2:3]  msg_id (little endian)
+ *    [4]    frag_idx
+ *    [5]    frag_count
+ *    [6:7]  payload_len (little endian)
+ *
+ *  All DATA fragments except the last carry exactly UDPFRAG_FRAG_PAYLOAD
+ *  bytes. An ACK carries a 4 byte little endian bitmap of the fragments
+ *  received so far (bit n set --> fragment n received). Datagrams not starting
+ *  with the magic byte are passed through untouched, so unfragmented clients
+ *  keep working.
+ *
+ *  Messages are reassembled one at a time and keyed on the sender's
+ *  address: fragments of another peer are dropped unacked (the peer
+ *  retransmits them) until the message in progress completes or its sender
+ *  has been silent for UDPFRAG_RX_TIMEOUT_MS. A msg_id is a duplicate only
+ *  if the same peer had it delivered within UDPFRAG_RX_TIMEOUT_MS, so a new
+ *  or restarted client may start at any msg_id.
+*******************************************************************************/
+#ifndef UDPFRAG_H
+#define UDPFRAG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "UdpSocket.h"
+#include "SwTimer.h"
+#include "RtosUtils.h"
+
+#define UDPFRAG_MAGIC               0xF5
+#define UDPFRAG_TYPE_DATA           0x01
+#define UDPFRAG_TYPE_ACK            0x02
+
+#define UDPFRAG_HDR_SIZE            8
+/** @brief Payload bytes per fragment (keeps datagrams below a 1500 MTU). */
+#define UDPFRAG_FRAG_PAYLOAD        1024
+/** @brief Max fragments per message (limited by the 32-bit SACK bitmap). */
+#define UDPFRAG_MAX_FRAGS           32
+#define UDPFRAG_MAX_MSG_SIZE        (UDPFRAG_FRAG_PAYLOAD*UDPFRAG_MAX_FRAGS)
+
+/** @brief Retransmit timeout and max number of retransmit rounds. */
+#define UDPFRAG_RETX_TIMEOUT_MS     50
+#define UDPFRAG_RETX_MAX            5
+
+/** @brief How long a sender keeps retransmitting after its last ack. */
+#define UDPFRAG_RX_TIMEOUT_MS       ((UDPFRAG_RETX_MAX + 1)*UDPFRAG_RETX_TIMEOUT_MS)
+
+/** @brief Peers whose last delivered message is remembered. */
+#define UDPFRAG_RX_PEERS            4
+
+/** @brief Return codes from UdpFrag_input. */
+#define UDPFRAG_INPUT_NONE          0
+#define UDPFRAG_INPUT_MSG           1
+#define UDPFRAG_INPUT_RAW           2
+
+/** @brief Last message delivered from a peer (used to re-ack duplicates).
+*/
+typedef struct UdpFrag_Delivered
+{
+    bool valid;
+    struct sockaddr_storage peer;
+    uint16_t msg_id;
+    uint8_t frag_count;
+    /** @brief Delivery (or last re-ack) time, us. */
+    int64_t time_us;
+
+} UdpFrag_Delivered;
+
+/** @brief Reassembly state.
+*/
+typedef struct UdpFrag_Rx
+{
+    /** @brief Reassembly buffer. */
+    uint8_t *buf;
+    uint32_t buf_size;
+    /** @brief Message currently being reassembled, and its sender. */
+    bool active;
+    struct sockaddr_storage peer;
+    uint16_t msg_id;
+    uint8_t frag_count;
+    uint32_t bitmap;
+    uint32_t msg_len;
+    /** @brief Time of its last new fragment, us. */
+    int64_t last_us;
+    UdpFrag_Delivered delivered[UDPFRAG_RX_PEERS];
+
+} UdpFrag_Rx;
+
+/** @brief Transmit state.
+*/
+typedef struct UdpFrag_Tx
+{
+    /** @brief Copy of the message being sent (owned by UdpFrag). */
+    uint8_t *buf;
+    uint32_t buf_size;
+    /** @brief Message being sent. */
+    bool active;
+    uint16_t msg_id;
+    uint8_t frag_count;
+    uint32_t msg_len;
+    /** @brief Bitmap of fragments acknowledged by the peer. */
+    uint32_t acked;
+    /** @brief Retransmit rounds remaining. */
+    uint8_t retries;
+    /** @brief Destination of the message. */
+    struct sockaddr_storage peer;
+    /** @brief Scratch datagram buffer. */
+    uint8_t frame[UDPFRAG_HDR_SIZE + UDPFRAG_FRAG_PAYLOAD];
+    /** @brief Retransmit timer. */
+    SwTimer timer;
+
+} UdpFrag_Tx;
+
+/** @brief Counters. */
+typedef struct UdpFrag_Stats
+{
+    uint32_t rx_frags;
+    uint32_t rx_msgs;
+    uint32_t rx_dups;
+    uint32_t rx_drops;
+    uint32_t tx_frags;
+    uint32_t tx_msgs;
+    uint32_t tx_retx;
+    uint32_t tx_fails;
+
+} UdpFrag_Stats;
+
+/** @brief UdpFrag object.
+*/
+typedef struct UdpFrag
+{
+    /** @brief Underlying socket (owned by the caller). */
+    UdpSocket *udp;
+    UdpFrag_Rx rx;
+    UdpFrag_Tx tx;
+    UdpFrag_Stats stats;
+    /** @brief Next outgoing msg_id. */
+    uint16_t next_msg_id;
+    /** @brief Guards tx state against the retransmit timer. */
+    RTOS_MUTEX_STATIC_BUF lockbuf;
+    RTOS_MUTEX lock;
+
+} UdpFrag;
+
+/******************************************************************************
+    [docexport UdpFrag_input]
+*//**
+    @brief Processes a received datagram. Call from the socket reader thread.
+    Fragments are acknowledged and reassembled, ACKs update the pending
+    transmit. Non-fragment datagrams are passed through.
+    @param[in] frag  Pointer to UdpFrag object.
+    @param[in] data  Pointer to the received datagram.
+    @param[in] len  Length of the datagram.
+    @param[out] msg  Set to the complete message (reassembly buffer or data).
+    @param[out] msg_len  Set to the length of the complete message.
+    @return Returns UDPFRAG_INPUT_MSG when a fragmented message completes,
+    UDPFRAG_INPUT_RAW for a pass-through datagram, UDPFRAG_INPUT_NONE when the
+    datagram was consumed, negative on error.
+******************************************************************************/
+int
+UdpFrag_input(
+    UdpFrag *frag,
+    uint8_t *data,
+    uint32_t len,
+    uint8_t **msg,
+    uint32_t *msg_len);
+
+/******************************************************************************
+    [docexport UdpFrag_send]
+*//**
+    @brief Sends a message fragmented to the current peer
+    (udp->source_addr). The message is copied, so the caller may reuse its
+    buffer on return. Missing fragments are retransmitted from the SwTimer
+    callback until acknowledged or the retry budget is exhausted. A new send
+    abandons any pending one.
+    @param[in] frag  Pointer to UdpFrag object.
+    @param[in] msg  Pointer to message.
+    @param[in] len  Length of message.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpFrag_send(UdpFrag *frag, uint8_t *msg, uint32_t len);
+
+/******************************************************************************
+    [docexport UdpFrag_init]
+*//**
+    @brief Initializes a UdpFrag object.
+    @param[in] frag  Pointer to uninitialized UdpFrag object.
+    @param[in] udp  Pointer to the socket used for writes.
+    @param[in] rx_buf  Reassembly buffer. If NULL, it is allocated.
+    @param[in] tx_buf  Transmit copy buffer. If NULL, it is allocated.
+    @param[in] max_msg_size  Size of rx_buf and tx_buf (max message size, up to
+    UDPFRAG_MAX_MSG_SIZE).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpFrag_init(
+    UdpFrag *frag,
+    UdpSocket *udp,
+    uint8_t *rx_buf,
+    uint8_t *tx_buf,
+    uint32_t max_msg_size);
+#endif
@@ -0,0 +1,609 @@
+/*******************************************************************************
+ *  @file: UdpFrag.c
+ *
+ *  @brief: Fragmentation, reassembly and selective-ack retransmission over a
+ *  UdpSocket.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "UdpFrag.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "UdpFrag";
+
+#define GET_U16(p)          ((uint16_t)((p)[0] | ((p)[1] << 8)))
+#define PUT_U16(p, v)       do { (p)[0] = (v) & 0xff; (p)[1] = ((v) >> 8) & 0xff; } while (0)
+#define GET_U32(p)          ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | \
+                             ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+#define PUT_U32(p, v)       do { PUT_U16((p), (v)); PUT_U16((p)+2, (v) >> 16); } while (0)
+
+/** @brief Bitmap with the lower 'count' bits set. */
+#define FULL_MASK(count)    (((count) >= 32) ? 0xffffffffu : ((1u << (count)) - 1))
+
+/******************************************************************************
+    put_hdr
+*//**
+    @brief Writes a fragment header.
+******************************************************************************/
+static void
+put_hdr(
+    uint8_t *p,
+    uint8_t type,
+    uint16_t msg_id,
+    uint8_t idx,
+    uint8_t count,
+    uint16_t plen)
+{
+    p[0] = UDPFRAG_MAGIC;
+    p[1] = type;
+    PUT_U16(&p[2], msg_id);
+    p[4] = idx;
+    p[5] = count;
+    PUT_U16(&p[6], plen);
+}
+
+/******************************************************************************
+    send_ack
+*//**
+    @brief Sends a selective ack to the current peer (reader thread only).
+******************************************************************************/
+static void
+send_ack(UdpFrag *frag, uint16_t msg_id, uint8_t count, uint32_t bitmap)
+{
+    uint8_t ack[UDPFRAG_HDR_SIZE + 4];
+
+    put_hdr(ack, UDPFRAG_TYPE_ACK, msg_id, 0, count, 4);
+    PUT_U32(&ack[UDPFRAG_HDR_SIZE], bitmap);
+    if (UdpSocket_write(frag->udp, ack, sizeof(ack)) != sizeof(ack))
+    {
+        LOGPRINT_ERROR("Error sending ack (msg_id=%u).", (unsigned)msg_id);
+    }
+}
+
+/******************************************************************************
+    send_frag
+*//**
+    @brief Sends fragment idx of the pending tx message. Call with lock held.
+******************************************************************************/
+static int
+send_frag(UdpFrag *frag, uint8_t idx)
+{
+    UdpFrag_Tx *tx = &frag->tx;
+    uint32_t offset = (uint32_t)idx*UDPFRAG_FRAG_PAYLOAD;
+    uint32_t plen = tx->msg_len - offset;
+    int ret;
+
+    if (plen > UDPFRAG_FRAG_PAYLOAD)
+    {
+        plen = UDPFRAG_FRAG_PAYLOAD;
+    }
+
+    put_hdr(tx->frame, UDPFRAG_TYPE_DATA, tx->msg_id, idx, tx->frag_count, plen);
+    memcpy(&tx->frame[UDPFRAG_HDR_SIZE], &tx->buf[offset], plen);
+
+    ret = UdpSocket_writeTo(frag->udp, &tx->peer, tx->frame,
+        UDPFRAG_HDR_SIZE + plen);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Error writing fragment.");
+    frag->stats.tx_frags++;
+    return 0;
+}
+
+/******************************************************************************
+    send_missing
+*//**
+    @brief Sends all fragments not yet acknowledged. Call with lock held.
+******************************************************************************/
+static void
+send_missing(UdpFrag *frag)
+{
+    UdpFrag_Tx *tx = &frag->tx;
+    uint8_t i;
+
+    for (i = 0; i < tx->frag_count; i++)
+    {
+        if (!(tx->acked & (1u << i)))
+        {
+            send_frag(frag, i);
+        }
+    }
+}
+
+/******************************************************************************
+    timer_cancel
+*//**
+    @brief Stops the retransmit timer if armed. Call with lock held.
+******************************************************************************/
+static void
+timer_cancel(UdpFrag *frag)
+{
+    if (esp_timer_is_active(frag->tx.timer.handle))
+    {
+        SwTimer_stop(&frag->tx.timer);
+    }
+}
+
+/******************************************************************************
+    timer_restart
+*//**
+    @brief (Re)arms the retransmit timer. Call with lock held.
+******************************************************************************/
+static void
+timer_restart(UdpFrag *frag)
+{
+    timer_cancel(frag);
+    SwTimer_start(&frag->tx.timer, SWTIMER_TYPE_ONE_SHOT,
+        UDPFRAG_RETX_TIMEOUT_MS*1000);
+}
+
+/******************************************************************************
+    tx_finish
+*//**
+    @brief Ends the pending transmit. Call with lock held.
+******************************************************************************/
+static void
+tx_finish(UdpFrag *frag)
+{
+    if (frag->tx.active)
+    {
+        frag->tx.active = false;
+        timer_cancel(frag);
+    }
+}
+
+/******************************************************************************
+    retx_timer_cb
+*//**
+    @brief Retransmit timer callback (esp_timer task context).
+******************************************************************************/
+static void
+retx_timer_cb(void *arg)
+{
+    UdpFrag *frag = (UdpFrag *)arg;
+    UdpFrag_Tx *tx = &frag->tx;
+
+    RTOS_MUTEX_GET(frag->lock);
+
+    if (tx->active)
+    {
+        if (tx->retries == 0)
+        {
+            LOGPRINT_WARN("Giving up on msg_id=%u (acked=0x%08x).",
+                (unsigned)tx->msg_id, (unsigned)tx->acked);
+            tx->active = false;
+            frag->stats.tx_fails++;
+        }
+        else
+        {
+            tx->retries--;
+            frag->stats.tx_retx++;
+            send_missing(frag);
+            SwTimer_start(&tx->timer, SWTIMER_TYPE_ONE_SHOT,
+                UDPFRAG_RETX_TIMEOUT_MS*1000);
+        }
+    }
+
+    RTOS_MUTEX_PUT(frag->lock);
+}
+
+/******************************************************************************
+    handle_ack
+*//**
+    @brief Applies a received selective ack to the pending transmit.
+******************************************************************************/
+static void
+handle_ack(UdpFrag *frag, uint16_t msg_id, uint32_t bitmap)
+{
+    UdpFrag_Tx *tx = &frag->tx;
+
+    RTOS_MUTEX_GET(frag->lock);
+
+    if (tx->active && msg_id == tx->msg_id)
+    {
+        tx->acked |= bitmap;
+        if (tx->acked == FULL_MASK(tx->frag_count))
+        {
+            LOGPRINT_DEBUG("msg_id=%u fully acked.", (unsigned)msg_id);
+            tx_finish(frag);
+        }
+        else
+        {
+            /* Selective ack: resend the holes now rather than waiting. */
+            send_missing(frag);
+            timer_restart(frag);
+        }
+    }
+
+    RTOS_MUTEX_PUT(frag->lock);
+}
+
+/******************************************************************************
+    same_peer
+*//**
+    @brief Compares two peer addresses (IPv4: address and port).
+******************************************************************************/
+static bool
+same_peer(const struct sockaddr_storage *a, const struct sockaddr_storage *b)
+{
+    const struct sockaddr_in *a4 = (const struct sockaddr_in *)a;
+    const struct sockaddr_in *b4 = (const struct sockaddr_in *)b;
+
+    if (a->ss_family != b->ss_family)
+    {
+        return false;
+    }
+    if (a->ss_family == AF_INET)
+    {
+        return a4->sin_addr.s_addr == b4->sin_addr.s_addr &&
+            a4->sin_port == b4->sin_port;
+    }
+    return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+/******************************************************************************
+    delivered_find
+*//**
+    @brief Finds a message of a peer delivered within UDPFRAG_RX_TIMEOUT_MS.
+    @return Returns the entry, NULL if msg_id is not a duplicate.
+******************************************************************************/
+static UdpFrag_Delivered *
+delivered_find(
+    UdpFrag_Rx *rx,
+    const struct sockaddr_storage *peer,
+    uint16_t msg_id,
+    int64_t now)
+{
+    UdpFrag_Delivered *d;
+    uint32_t i;
+
+    for (i = 0; i < UDPFRAG_RX_PEERS; i++)
+    {
+        d = &rx->delivered[i];
+        if (d->valid && d->msg_id == msg_id && same_peer(&d->peer, peer) &&
+            now - d->time_us < UDPFRAG_RX_TIMEOUT_MS*1000)
+        {
+            return d;
+        }
+    }
+    return NULL;
+}
+
+/******************************************************************************
+    delivered_add
+*//**
+    @brief Records a delivered message, in the entry of its peer or else the
+    oldest one.
+******************************************************************************/
+static void
+delivered_add(UdpFrag_Rx *rx, uint16_t msg_id, uint8_t count, int64_t now)
+{
+    UdpFrag_Delivered *d = &rx->delivered[0];
+    uint32_t i;
+
+    for (i = 0; i < UDPFRAG_RX_PEERS; i++)
+    {
+        if (rx->delivered[i].valid &&
+            same_peer(&rx->delivered[i].peer, &rx->peer))
+        {
+            d = &rx->delivered[i];
+            break;
+        }
+        if (!rx->delivered[i].valid ||
+            (d->valid && rx->delivered[i].time_us < d->time_us))
+        {
+            d = &rx->delivered[i];
+        }
+    }
+    d->valid = true;
+    memcpy(&d->peer, &rx->peer, sizeof(d->peer));
+    d->msg_id = msg_id;
+    d->frag_count = count;
+    d->time_us = now;
+}
+
+/******************************************************************************
+    handle_data
+*//**
+    @brief Stores a received DATA fragment.
+******************************************************************************/
+static int
+handle_data(
+    UdpFrag *frag,
+    uint16_t msg_id,
+    uint8_t idx,
+    uint8_t count,
+    uint8_t *payload,
+    uint16_t plen,
+    uint8_t **msg,
+    uint32_t *msg_len)
+{
+    UdpFrag_Rx *rx = &frag->rx;
+    const struct sockaddr_storage *src = &frag->udp->source_addr;
+    uint32_t offset = (uint32_t)idx*UDPFRAG_FRAG_PAYLOAD;
+    UdpFrag_Delivered *done;
+    int64_t now;
+    uint32_t full;
+
+    /* All but the last fragment must be full sized. */
+    if (count == 0 || count > UDPFRAG_MAX_FRAGS || idx >= count ||
+        plen > UDPFRAG_FRAG_PAYLOAD ||
+        (idx < count - 1 && plen != UDPFRAG_FRAG_PAYLOAD) ||
+        offset + plen > rx->buf_size)
+    {
+        LOGPRINT_ERROR("Bad fragment (msg_id=%u idx=%u count=%u len=%u).",
+            (unsigned)msg_id, (unsigned)idx, (unsigned)count, (unsigned)plen);
+        frag->stats.rx_drops++;
+        return -1;
+    }
+
+    frag->stats.rx_frags++;
+    now = esp_timer_get_time();
+
+    /* Duplicate of a message delivered to this peer: the ack was lost. */
+    done = delivered_find(rx, src, msg_id, now);
+    if (done)
+    {
+        frag->stats.rx_dups++;
+        done->time_us = now;
+        send_ack(frag, msg_id, done->frag_count, FULL_MASK(done->frag_count));
+        return UDPFRAG_INPUT_NONE;
+    }
+
+    /* Another peer's message is in progress: left unacked, this fragment
+       is retransmitted once the buffer is free. */
+    if (rx->active && !same_peer(src, &rx->peer) &&
+        now - rx->last_us < UDPFRAG_RX_TIMEOUT_MS*1000)
+    {
+        frag->stats.rx_drops++;
+        return UDPFRAG_INPUT_NONE;
+    }
+
+    if (!rx->active || msg_id != rx->msg_id || !same_peer(src, &rx->peer))
+    {
+        if (rx->active)
+        {
+            LOGPRINT_WARN("Dropping incomplete msg_id=%u.",
+                (unsigned)rx->msg_id);
+            frag->stats.rx_drops++;
+        }
+        rx->active = true;
+        memcpy(&rx->peer, src, sizeof(rx->peer));
+        rx->msg_id = msg_id;
+        rx->frag_count = count;
+        rx->bitmap = 0;
+        rx->msg_len = 0;
+    }
+    else if (count != rx->frag_count)
+    {
+        frag->stats.rx_drops++;
+        return -1;
+    }
+    rx->last_us = now;
+
+    full = FULL_MASK(count);
+
+    if (rx->bitmap & (1u << idx))
+    {
+        /* Peer is retransmitting: tell it what we already have. */
+        frag->stats.rx_dups++;
+        send_ack(frag, msg_id, count, rx->bitmap);
+        return UDPFRAG_INPUT_NONE;
+    }
+
+    memcpy(&rx->buf[offset], payload, plen);
+    rx->bitmap |= (1u << idx);
+    if (idx == count - 1)
+    {
+        rx->msg_len = offset + plen;
+    }
+
+    if (rx->bitmap == full)
+    {
+        rx->active = false;
+        delivered_add(rx, msg_id, count, now);
+        send_ack(frag, msg_id, count, full);
+
+        frag->stats.rx_msgs++;
+        *msg = rx->buf;
+        *msg_len = rx->msg_len;
+        LOGPRINT_DEBUG("Reassembled msg_id=%u: %u bytes.",
+            (unsigned)msg_id, (unsigned)rx->msg_len);
+        return UDPFRAG_INPUT_MSG;
+    }
+
+    /*  The last fragment arrived but holes remain: send a selective ack so
+        the peer can fill them without waiting for its timer.
+    */
+    if (idx == count - 1)
+    {
+        send_ack(frag, msg_id, count, rx->bitmap);
+    }
+
+    return UDPFRAG_INPUT_NONE;
+}
+
+/******************************************************************************
+    [docimport UdpFrag_input]
+*//**
+    @brief Processes a received datagram. Call from the socket reader thread.
+    Fragments are acknowledged and reassembled, ACKs update the pending
+    transmit. Non-fragment datagrams are passed through.
+    @param[in] frag  Pointer to UdpFrag object.
+    @param[in] data  Pointer to the received datagram.
+    @param[in] len  Length of the datagram.
+    @param[out] msg  Set to the complete message (reassembly buffer or data).
+    @param[out] msg_len  Set to the length of the complete message.
+    @return Returns UDPFRAG_INPUT_MSG when a fragmented message completes,
+    UDPFRAG_INPUT_RAW for a pass-through datagram, UDPFRAG_INPUT_NONE when the
+    datagram was consumed, negative on error.
+******************************************************************************/
+int
+UdpFrag_input(
+    UdpFrag *frag,
+    uint8_t *data,
+    uint32_t len,
+    uint8_t **msg,
+    uint32_t *msg_len)
+{
+    uint16_t msg_id, plen;
+
+    if (len < UDPFRAG_HDR_SIZE || data[0] != UDPFRAG_MAGIC)
+    {
+        *msg = data;
+        *msg_len = len;
+        return UDPFRAG_INPUT_RAW;
+    }
+
+    msg_id = GET_U16(&data[2]);
+    plen = GET_U16(&data[6]);
+    if (plen != len - UDPFRAG_HDR_SIZE)
+    {
+        LOGPRINT_ERROR("Fragment length mismatch (%u != %u).",
+            (unsigned)plen, (unsigned)(len - UDPFRAG_HDR_SIZE));
+        frag->stats.rx_drops++;
+        return -1;
+    }
+
+    switch (data[1])
+    {
+        case UDPFRAG_TYPE_DATA:
+            return handle_data(frag, msg_id, data[4], data[5],
+                &data[UDPFRAG_HDR_SIZE], plen, msg, msg_len);
+
+        case UDPFRAG_TYPE_ACK:
+            CHECK_COND_RETURN_MSG(plen != 4, -1, "Bad ack length.");
+            handle_ack(frag, msg_id, GET_U32(&data[UDPFRAG_HDR_SIZE]));
+            return UDPFRAG_INPUT_NONE;
+
+        default:
+            LOGPRINT_ERROR("Unknown fragment type %u.", (unsigned)data[1]);
+            frag->stats.rx_drops++;
+            return -1;
+    }
+}
+
+/******************************************************************************
+    [docimport UdpFrag_send]
+*//**
+    @brief Sends a message fragmented to the current peer
+    (udp->source_addr). The message is copied, so the caller may reuse its
+    buffer on return. Missing fragments are retransmitted from the SwTimer
+    callback until acknowledged or the retry budget is exhausted. A new send
+    abandons any pending one.
+    @param[in] frag  Pointer to UdpFrag object.
+    @param[in] msg  Pointer to message.
+    @param[in] len  Length of message.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpFrag_send(UdpFrag *frag, uint8_t *msg, uint32_t len)
+{
+    UdpFrag_Tx *tx = &frag->tx;
+
+    CHECK_COND_RETURN_MSG(len == 0 || len > tx->buf_size, -1,
+        "Invalid message length.");
+
+    RTOS_MUTEX_GET(frag->lock);
+
+    if (tx->active)
+    {
+        LOGPRINT_WARN("Abandoning pending msg_id=%u.", (unsigned)tx->msg_id);
+        tx_finish(frag);
+        frag->stats.tx_fails++;
+    }
+
+    memcpy(tx->buf, msg, len);
+    memcpy(&tx->peer, &frag->udp->source_addr, sizeof(tx->peer));
+    tx->msg_id = frag->next_msg_id++;
+    tx->msg_len = len;
+    tx->frag_count = (len + UDPFRAG_FRAG_PAYLOAD - 1)/UDPFRAG_FRAG_PAYLOAD;
+    tx->acked = 0;
+    tx->retries = UDPFRAG_RETX_MAX;
+    tx->active = true;
+    frag->stats.tx_msgs++;
+
+    send_missing(frag);
+    SwTimer_start(&tx->timer, SWTIMER_TYPE_ONE_SHOT,
+        UDPFRAG_RETX_TIMEOUT_MS*1000);
+
+    RTOS_MUTEX_PUT(frag->lock);
+
+    LOGPRINT_DEBUG("Sent msg_id=%u: %u bytes in %u fragments.",
+        (unsigned)tx->msg_id, (unsigned)len, (unsigned)tx->frag_count);
+    return 0;
+}
+
+/******************************************************************************
+    [docimport UdpFrag_init]
+*//**
+    @brief Initializes a UdpFrag object.
+    @param[in] frag  Pointer to uninitialized UdpFrag object.
+    @param[in] udp  Pointer to the socket used for writes.
+    @param[in] rx_buf  Reassembly buffer. If NULL, it is allocated.
+    @param[in] tx_buf  Transmit copy buffer. If NULL, it is allocated.
+    @param[in] max_msg_size  Size of rx_buf and tx_buf (max message size, up to
+    UDPFRAG_MAX_MSG_SIZE).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpFrag_init(
+    UdpFrag *frag,
+    UdpSocket *udp,
+    uint8_t *rx_buf,
+    uint8_t *tx_buf,
+    uint32_t max_msg_size)
+{
+    int ret;
+
+    CHECK_COND_RETURN_MSG(max_msg_size > UDPFRAG_MAX_MSG_SIZE, -1,
+        "Max message size too large.");
+
+    memset(frag, 0, sizeof(UdpFrag));
+    frag->udp = udp;
+
+    frag->rx.buf = rx_buf ? rx_buf : (uint8_t *)malloc(max_msg_size);
+    CHECK_COND_RETURN_MSG(!frag->rx.buf, -1, "Error allocating rx buffer.");
+    frag->rx.buf_size = max_msg_size;
+
+    frag->tx.buf = tx_buf ? tx_buf : (uint8_t *)malloc(max_msg_size);
+    if (!frag->tx.buf)
+    {
+        LOGPRINT_ERROR("Error allocating tx buffer.");
+        ret = -1;
+        goto fail_tx;
+    }
+    frag->tx.buf_size = max_msg_size;
+
+    frag->lock = RTOS_MUTEX_CREATE_STATIC(&frag->lockbuf);
+    if (!frag->lock)
+    {
+        LOGPRINT_ERROR("Error creating mutex.");
+        ret = -1;
+        goto fail_lock;
+    }
+
+    ret = SwTimer_create(&frag->tx.timer, retx_timer_cb, (void *)frag);
+    if (ret < 0)
+    {
+        LOGPRINT_ERROR("Error creating retransmit timer.");
+        goto fail_timer;
+    }
+
+    return 0;
+
+fail_timer:
+    RTOS_MUTEX_DELETE(frag->lock);
+fail_lock:
+    if (!tx_buf)
+    {
+        free(frag->tx.buf);
+    }
+fail_tx:
+    if (!rx_buf)
+    {
+        free(frag->rx.buf);
+    }
+    memset(frag, 0, sizeof(UdpFrag));
+    return ret;
+}
@@ -9,6 +9,8 @@
 #include <stdint.h>
 #include "UdpServer.h"
 #include "ProtoRpc.h"
+#include "UdpFrag.h"
+#include "RpcEngine.h"
 
 /** @brief TcpRpcServer object.
 */
@@ -18,6 +20,15 @@ typedef struct UdpRpcServer
     UdpServer udp_server;
     /** @brief Pointer to the ProtoRpc instance. */
     ProtoRpc *rpc;
+    /** @brief Unframed datagram transport and its engine. */
+    RpcTransport transport;
+    RpcEngine engine;
+
+    /** @brief Optional fragmentation layer (see UdpRpcServer_enableFrag). */
+    UdpFrag *frag;
+    /** @brief Transport/engine for reassembled requests (fragmented reply). */
+    RpcTransport frag_transport;
+    RpcEngine frag_engine;
     
 } UdpRpcServer;
 
@@ -40,4 +51,34 @@ UdpRpcServer_init(
     uint16_t port,
     uint16_t stack_size,
     uint8_t prio);
+
+/******************************************************************************
+    [docexport UdpRpcServer_enableFrag]
+*//**
+    @brief Enables the UdpFrag fragmentation/reassembly layer so that requests
+    and replies larger than a single datagram can be exchanged. Clients that
+    send unfragmented datagrams are still served as before. Call after
+    UdpRpcServer_init.
+    @param[in] server  Pointer to initialized UdpRpcServer instance.
+    @param[in] frag  Pointer to uninitialized UdpFrag instance.
+    @param[in] max_msg_size  Largest request or reply to support (up to
+    UDPFRAG_MAX_MSG_SIZE). Buffers are allocated.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpRpcServer_enableFrag(
+    UdpRpcServer *server,
+    UdpFrag *frag,
+    uint32_t max_msg_size);
+
+/******************************************************************************
+    [docexport UdpRpcServer_setLimit]
+*//**
+    @brief Applies admission control to the server (plain and fragmented
+    requests). Clients are keyed by source IPv4 address.
+    @param[in] server  Pointer to initialized UdpRpcServer instance.
+    @param[in] limit  Pointer to initialized RpcLimit, NULL to remove.
+******************************************************************************/
+void
+UdpRpcServer_setLimit(UdpRpcServer *server, RpcLimit *limit);
 #endif
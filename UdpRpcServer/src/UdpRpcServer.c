@@ -5,6 +5,7 @@
 *******************************************************************************/
 #include "UdpRpcServer.h"
 #include "UdpSocket.h"
+#include "CheckCond.h"
 #include "LogPrint.h"
 #include "LogPrint_local.h"
 
@@ -12,63 +13,98 @@ const char *TAG = "UdpRpcServer";
 
 #define UDP_READ_TIMEOUT    10
 
-/** @brief Raw UDP frame buffers. */
+/** @brief Raw UDP frame buffer. */
 static uint8_t rcv_msg[PROTORPC_MSG_MAX_SIZE];
-static uint8_t reply_msg[PROTORPC_MSG_MAX_SIZE];
+
+/******************************************************************************
+    transport_send
+*//**
+    @brief RpcTransport send for plain datagrams. Queued and flushed per batch
+    when UdpServer batching is on.
+******************************************************************************/
+static int
+transport_send(void *ctx, uint8_t *buf, uint32_t len)
+{
+    UdpRpcServer *server = (UdpRpcServer *)ctx;
+    return UdpServer_send(&server->udp_server, buf, len);
+}
+
+/******************************************************************************
+    frag_transport_send
+*//**
+    @brief RpcTransport send for reassembled requests: replies are fragmented.
+******************************************************************************/
+static int
+frag_transport_send(void *ctx, uint8_t *buf, uint32_t len)
+{
+    UdpRpcServer *server = (UdpRpcServer *)ctx;
+    int ret = UdpFrag_send(server->frag, buf, len);
+    return (ret < 0) ? ret : (int)len;
+}
+
+/******************************************************************************
+    transport_setup
+*//**
+    @brief Fills in an unframed, push-only transport.
+******************************************************************************/
+static void
+transport_setup(
+    RpcTransport *t,
+    UdpRpcServer *server,
+    int (*send)(void *ctx, uint8_t *buf, uint32_t len))
+{
+    t->ctx = (void *)server;
+    t->framing = RPCTRANSPORT_FRAMING_NONE;
+    t->recv = NULL;
+    t->send = send;
+    t->close = NULL;
+}
 
 /******************************************************************************
     rpc_callback
 *//**
     @brief UdpServer callback. Handles RPC server interface.
-    @param[in] server  Reference to the underlying TcpServer object.
-    @param[in] sock  The accepted socket.
-    @param[in] data  Pointer to data buffer to send.
-    @param[in] len  Length of data to send.
+    @param[in] server  Reference to the underlying UdpServer object.
+    @param[in] data  Pointer to received datagram.
+    @param[in] len  Length of received datagram.
 ******************************************************************************/
 static void
 rpc_callback(void *server, uint8_t *data, uint16_t len)
 {
     /** @brief UdpRpcServer type masquerades as a UdpServer. */
     UdpRpcServer *udprpc_server = (UdpRpcServer *)server;
-    ProtoRpc *rpc               = udprpc_server->rpc;
-    UdpServer *udp_server       = &udprpc_server->udp_server;
-    UdpSocket *udp              = &udp_server->udpsock;
+    UdpFrag *frag               = udprpc_server->frag;
+    uint8_t *msg;
+    uint32_t msg_len;
+    int frag_ret;
+
+    if (udprpc_server->engine.limit)
+    {
+        /* Limiter key: the datagram's source IPv4 address. */
+        struct sockaddr_in *src = (struct sockaddr_in *)
+            &udprpc_server->udp_server.udpsock.source_addr;
+        udprpc_server->engine.client = src->sin_addr.s_addr;
+        udprpc_server->frag_engine.client = src->sin_addr.s_addr;
+    }
 
-    if (len > 0)
+    if (frag)
     {
-        int num_sent;
-        uint32_t reply_size;
-
-        ProtoRpc_server(
-            rpc,
-            data,
-            len,
-            reply_msg,
-            sizeof(reply_msg),
-            &reply_size);
-
-        if (reply_size > 0)
+        frag_ret = UdpFrag_input(frag, data, len, &msg, &msg_len);
+        if (frag_ret <= UDPFRAG_INPUT_NONE)
         {
-            LOGPRINT_HEXDUMP_VERBOSE("Reply message.",
-                reply_msg, reply_size);
-
-            num_sent = UdpSocket_write(udp, reply_msg, reply_size);
-
-            if (num_sent < 0)
-            {
-                LOGPRINT_ERROR("Error on rpc reply write.");
-                return;
-            }
-            else if (num_sent != reply_size)
-            {
-                LOGPRINT_ERROR("Number of bytes send != reply_size.");
-                return;
-            }
-
-            LOGPRINT_DEBUG("Wrote rpc reply: %d bytes.",
-                (unsigned int)reply_size);
+            /* Ack, partial message or error: nothing to dispatch yet. */
+            return;
+        }
+
+        /* Reply in the same form the request arrived in. */
+        if (frag_ret == UDPFRAG_INPUT_MSG)
+        {
+            RpcEngine_input(&udprpc_server->frag_engine, msg, msg_len);
+            return;
         }
     }
+
+    RpcEngine_input(&udprpc_server->engine, data, len);
 }
 
 /******************************************************************************
@@ -90,7 +126,15 @@ UdpRpcServer_init(
     uint16_t stack_size,
     uint8_t prio)
 {
+    int ret;
+
     server->rpc = rpc;
+    server->frag = NULL;
+
+    transport_setup(&server->transport, server, transport_send);
+    ret = RpcEngine_init(&server->engine, rpc, &server->transport,
+        PROTORPC_MSG_MAX_SIZE);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Error initializing RpcEngine.");
 
     /** @brief Initialize the UdpServer. */
     return UdpServer_init(
@@ -104,3 +148,57 @@ UdpRpcServer_init(
         UDP_READ_TIMEOUT,
         rpc_callback);
 }
+
+/******************************************************************************
+    [docimport UdpRpcServer_enableFrag]
+*//**
+    @brief Enables the UdpFrag fragmentation/reassembly layer so that requests
+    and replies larger than a single datagram can be exchanged. Clients that
+    send unfragmented datagrams are still served as before. Call after
+    UdpRpcServer_init.
+    @param[in] server  Pointer to initialized UdpRpcServer instance.
+    @param[in] frag  Pointer to uninitialized UdpFrag instance.
+    @param[in] max_msg_size  Largest request or reply to support (up to
+    UDPFRAG_MAX_MSG_SIZE). Buffers are allocated.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpRpcServer_enableFrag(
+    UdpRpcServer *server,
+    UdpFrag *frag,
+    uint32_t max_msg_size)
+{
+    int ret;
+
+    ret = UdpFrag_init(frag, &server->udp_server.udpsock, NULL, NULL,
+        max_msg_size);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Error initializing UdpFrag.");
+
+    transport_setup(&server->frag_transport, server, frag_transport_send);
+    ret = RpcEngine_init(&server->frag_engine, server->rpc,
+        &server->frag_transport, max_msg_size);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Error initializing RpcEngine.");
+    if (server->engine.limit)
+    {
+        RpcEngine_setLimit(&server->frag_engine, server->engine.limit);
+    }
+
+    /* Publish last: the server task may already be running. */
+    server->frag = frag;
+    return 0;
+}
+
+/******************************************************************************
+    [docimport UdpRpcServer_setLimit]
+*//**
+    @brief Applies admission control to the server (plain and fragmented
+    requests). Clients are keyed by source IPv4 address.
+    @param[in] server  Pointer to initialized UdpRpcServer instance.
+    @param[in] limit  Pointer to initialized RpcLimit, NULL to remove.
+******************************************************************************/
+void
+UdpRpcServer_setLimit(UdpRpcServer *server, RpcLimit *limit)
+{
+    RpcEngine_setLimit(&server->frag_engine, limit);
+    RpcEngine_setLimit(&server->engine, limit);
+}
@@ -0,0 +1,171 @@
+/*******************************************************************************
+ *  @file: UdpServer_bench.c
+ *
+ *  @brief: Loopback benchmark comparing datagrams/s through UdpServer with and
+ *  without batched I/O. Runs on the linux (host) target or on device.
+ *
+ *  Usage (e.g. from app_main):
+ *
+ *      #include "UdpServer_bench.h"
+ *      UdpServer_bench(5000, 20000, 64, 16);
+*******************************************************************************/
+#include <string.h>
+#include "UdpServer.h"
+#include "SwTimer.h"
+#include "UdpServer_bench.h"
+#include "CheckCond.h"
+#include "LogPrint.h"
+#include "LogPrint_local.h"
+
+static const char *TAG = "UdpServer_bench";
+
+#define BENCH_BUF_SIZE          1500
+#define BENCH_RX_SLOTS          16
+#define BENCH_TX_SLOTS          16
+#define BENCH_REPLY_TIMEOUT_US  200000
+
+static UdpServer bench_server;
+static uint8_t bench_rx_buf[BENCH_BUF_SIZE];
+static bool bench_started = false;
+
+/******************************************************************************
+    bench_echo
+*//**
+    @brief Server callback: echo through UdpServer_send.
+******************************************************************************/
+static void
+bench_echo(void *server, uint8_t *data, uint16_t len)
+{
+    UdpServer_send((UdpServer *)server, data, len);
+}
+
+/******************************************************************************
+    bench_pass
+*//**
+    @brief Runs one pass: keeps 'window' datagrams in flight until num_msgs
+    echoes have been received.
+    @return Returns the datagram rate (echoes/s), negative on error.
+******************************************************************************/
+static int
+bench_pass(
+    UdpSocket *client,
+    struct sockaddr_storage *server_addr,
+    uint32_t num_msgs,
+    uint16_t msg_size,
+    uint8_t window)
+{
+    static uint8_t tx[BENCH_BUF_SIZE];
+    static uint8_t rx[BENCH_BUF_SIZE];
+    struct sockaddr_storage from;
+    uint32_t sent = 0, rcvd = 0, lost = 0;
+    uint64_t elapsed_us;
+    SwTimer swt, idle;
+
+    memset(tx, 0xa5, msg_size);
+    SwTimer_tic(&swt);
+    SwTimer_tic(&idle);
+
+    while (rcvd + lost < num_msgs)
+    {
+        int len;
+
+        while (sent < num_msgs && sent - rcvd - lost < window)
+        {
+            CHECK_COND_RETURN_MSG(
+                UdpSocket_writeTo(client, server_addr, tx, msg_size) < 0,
+                -1, "Client write failed.");
+            sent++;
+        }
+
+        len = UdpSocket_readFrom(client, rx, sizeof(rx), &from, true);
+        if (len > 0)
+        {
+            rcvd++;
+            SwTimer_tic(&idle);
+        }
+        else if (SwTimer_toc(&idle) > BENCH_REPLY_TIMEOUT_US)
+        {
+            /* Whatever is still in flight was dropped. */
+            lost += sent - rcvd - lost;
+            SwTimer_tic(&idle);
+        }
+    }
+
+    elapsed_us = SwTimer_toc(&swt);
+    if (elapsed_us == 0)
+    {
+        elapsed_us = 1;
+    }
+
+    if (lost)
+    {
+        LOGPRINT_WARN("%u of %u datagrams lost.", (unsigned)lost,
+            (unsigned)num_msgs);
+    }
+
+    return (int)((uint64_t)rcvd*1000000/elapsed_us);
+}
+
+/******************************************************************************
+    [docimport UdpServer_bench]
+*//**
+    @brief Runs the loopback benchmark, unbatched then batched.
+    @param[in] port  Server port.
+    @param[in] num_msgs  Datagrams per pass.
+    @param[in] msg_size  Datagram size.
+    @param[in] window  Datagrams kept in flight by the client (burst depth).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpServer_bench(
+    uint16_t port,
+    uint32_t num_msgs,
+    uint16_t msg_size,
+    uint8_t window)
+{
+    UdpSocket client;
+    struct sockaddr_storage server_addr;
+    struct sockaddr_in *sin = (struct sockaddr_in *)&server_addr;
+    int rate_single, rate_batch;
+    int ret;
+
+    CHECK_COND_RETURN_MSG(msg_size > BENCH_BUF_SIZE, -1, "msg_size too large.");
+
+    if (!bench_started)
+    {
+        ret = UdpServer_init(&bench_server, port, bench_rx_buf,
+            sizeof(bench_rx_buf), 4096, "UdpBench", 5, 1, bench_echo);
+        CHECK_COND_RETURN_MSG(ret < 0, ret, "Error starting bench server.");
+        bench_started = true;
+    }
+
+    /* Ephemeral client port. */
+    ret = UdpSocket_init(&client, 0, 1);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Error creating client socket.");
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    sin->sin_family = AF_INET;
+    sin->sin_port = htons(port);
+    sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    UdpServer_enableBatch(&bench_server, 0, 0, 0);
+    rate_single = bench_pass(&client, &server_addr, num_msgs, msg_size, window);
+
+    ret = UdpServer_enableBatch(&bench_server, BENCH_RX_SLOTS, BENCH_TX_SLOTS,
+        BENCH_BUF_SIZE);
+    CHECK_COND_RETURN_MSG(ret < 0, ret, "Error enabling batching.");
+    rate_batch = bench_pass(&client, &server_addr, num_msgs, msg_size, window);
+
+    UdpServer_enableBatch(&bench_server, 0, 0, 0);
+    close(client.sock);
+
+    LOGPRINT_INFO("UDP bench: %u x %u B, window %u",
+        (unsigned)num_msgs, (unsigned)msg_size, (unsigned)window);
+    LOGPRINT_INFO("  unbatched: %d datagrams/s", rate_single);
+    LOGPRINT_INFO("  batched:   %d datagrams/s (max batch %u, avg %u)",
+        rate_batch, (unsigned)bench_server.batch->max_batch,
+        (unsigned)(bench_server.batch->num_datagrams /
+            (bench_server.batch->num_batches ? bench_server.batch->num_batches : 1)));
+
+    return (rate_single < 0 || rate_batch < 0) ? -1 : 0;
+}
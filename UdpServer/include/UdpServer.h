@@ -48,6 +48,43 @@ typedef struct UdpTask
 
 } UdpTask;
 
+/** @brief A datagram slot used by the batched I/O mode.
+*/
+typedef struct UdpSlot
+{
+    /** @brief Peer address (source on rx, destination on tx). */
+    struct sockaddr_storage addr;
+    /** @brief Datagram buffer and length. */
+    uint8_t *data;
+    uint16_t len;
+
+} UdpSlot;
+
+/** @brief Batched I/O state (see UdpServer_enableBatch).
+*/
+typedef struct UdpBatch
+{
+    /** @brief Receive slots filled per wakeup. */
+    UdpSlot *rx;
+    uint8_t rx_num;
+    /** @brief Reply slots flushed after the batch is dispatched. */
+    UdpSlot *tx;
+    uint8_t tx_num;
+    uint8_t tx_count;
+    uint16_t tx_slot_size;
+    /** @brief Batching enabled. */
+    bool enabled;
+    /** @brief Set while the rx batch is being dispatched. */
+    bool dispatching;
+
+    /** @brief Counters. */
+    uint32_t num_batches;
+    uint32_t num_datagrams;
+    uint32_t max_batch;
+    uint32_t num_flushes;
+
+} UdpBatch;
+
 typedef struct UdpServer
 {
     /** @brief Udp socket instance. */
@@ -72,6 +109,9 @@ typedef struct UdpServer
     /** @brief Udp task object. */
     UdpTask task;
 
+    /** @brief Batched I/O state. NULL when batching is disabled. */
+    UdpBatch *batch;
+
 } UdpServer;
 
 /** @brief Convert sender's IP to string. */
@@ -107,4 +147,42 @@ UdpServer_init(
     uint8_t task_prio,
     uint16_t timeout,
     UdpServer_cb *cb);
+
+/******************************************************************************
+    [docexport UdpServer_send]
+*//**
+    @brief Sends a reply to the sender of the datagram being handled. Call from
+    the server callback. In batched mode the reply is queued and written
+    together with the other replies once the whole rx batch is dispatched;
+    otherwise it is written immediately. A reply larger than a reply slot is
+    written immediately, after the replies already queued.
+    @param[in] server  Pointer to the UdpServer object.
+    @param[in] buf  Pointer to data to send.
+    @param[in] len  Length of data to send.
+    @return Returns the number of bytes sent (or queued), negative on error.
+******************************************************************************/
+int
+UdpServer_send(UdpServer *server, uint8_t *buf, uint32_t len);
+
+/******************************************************************************
+    [docexport UdpServer_enableBatch]
+*//**
+    @brief Enables batched datagram I/O. After each blocking read the server
+    drains every datagram already queued on the socket (up to rx_num) before
+    dispatching them, and replies sent with UdpServer_send are flushed once per
+    batch. Passing rx_num == 0 disables batching. Slots are allocated on the
+    first call and kept, so the mode can be toggled at runtime; later calls
+    reuse the original slot counts.
+    @param[in] server  Pointer to initialized UdpServer object.
+    @param[in] rx_num  Number of receive slots (each of the server buf_len).
+    @param[in] tx_num  Number of reply slots.
+    @param[in] tx_slot_size  Size of each reply slot.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpServer_enableBatch(
+    UdpServer *server,
+    uint8_t rx_num,
+    uint8_t tx_num,
+    uint16_t tx_slot_size);
 #endif
@@ -0,0 +1,28 @@
+/*******************************************************************************
+ *  @file: UdpServer_bench.h
+ *
+ *  @brief: Header for the UdpServer loopback benchmark
+ *  (bench/UdpServer_bench.c). Built with CONFIG_UDPSERVER_BENCH.
+*******************************************************************************/
+#ifndef UDPSERVER_BENCH_H
+#define UDPSERVER_BENCH_H
+
+#include <stdint.h>
+
+/******************************************************************************
+    [docexport UdpServer_bench]
+*//**
+    @brief Runs the loopback benchmark, unbatched then batched.
+    @param[in] port  Server port.
+    @param[in] num_msgs  Datagrams per pass.
+    @param[in] msg_size  Datagram size.
+    @param[in] window  Datagrams kept in flight by the client (burst depth).
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpServer_bench(
+    uint16_t port,
+    uint32_t num_msgs,
+    uint16_t msg_size,
+    uint8_t window);
+#endif
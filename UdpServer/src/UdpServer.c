@@ -4,6 +4,7 @@
  *  @brief: Library implementing a udp server.
 *******************************************************************************/
 #include <string.h>
+#include <stdlib.h>
 #include "CheckCond.h"
 #include "UdpServer.h"
 #include "LogPrint.h"
@@ -13,6 +14,89 @@
 
 static const char *TAG = "UdpServer";
 
+/******************************************************************************
+    batch_flush
+*//**
+    @brief Writes all queued replies.
+******************************************************************************/
+static void
+batch_flush(UdpServer *server, UdpBatch *batch)
+{
+    uint8_t i;
+
+    for (i = 0; i < batch->tx_count; i++)
+    {
+        UdpSlot *slot = &batch->tx[i];
+        int ret = UdpSocket_writeTo(&server->udpsock, &slot->addr,
+            slot->data, slot->len);
+        if (ret != slot->len)
+        {
+            LOGPRINT_ERROR("Error on batched write (%d).", ret);
+        }
+    }
+
+    if (batch->tx_count > 0)
+    {
+        batch->num_flushes++;
+    }
+    batch->tx_count = 0;
+}
+
+/******************************************************************************
+    batch_recv_dispatch
+*//**
+    @brief Waits for a datagram, drains everything else already queued on the
+    socket into the rx slots, then dispatches the batch and flushes replies.
+    @return Returns the number of datagrams dispatched, negative on error.
+******************************************************************************/
+static int
+batch_recv_dispatch(UdpServer *server, UdpBatch *batch)
+{
+    UdpSocket *udp = &server->udpsock;
+    uint8_t num = 0;
+    uint8_t i;
+    int len;
+
+    /* Block (up to the socket timeout) for the first datagram only. */
+    len = UdpSocket_readFrom(udp, batch->rx[0].data, server->data_len,
+        &batch->rx[0].addr, false);
+    if (len <= 0)
+    {
+        return len;
+    }
+    batch->rx[num++].len = len;
+
+    while (num < batch->rx_num)
+    {
+        len = UdpSocket_readFrom(udp, batch->rx[num].data, server->data_len,
+            &batch->rx[num].addr, true);
+        if (len <= 0)
+        {
+            break;
+        }
+        batch->rx[num++].len = len;
+    }
+
+    batch->num_batches++;
+    batch->num_datagrams += num;
+    if (num > batch->max_batch)
+    {
+        batch->max_batch = num;
+    }
+
+    batch->dispatching = true;
+    for (i = 0; i < num; i++)
+    {
+        /* Replies (UdpServer_send/UdpSocket_write) target this sender. */
+        memcpy(&udp->source_addr, &batch->rx[i].addr, sizeof(udp->source_addr));
+        server->cb((void *)server, batch->rx[i].data, batch->rx[i].len);
+    }
+    batch->dispatching = false;
+
+    batch_flush(server, batch);
+    return num;
+}
+
 /******************************************************************************
     udp_server_task
 *//**
@@ -30,8 +114,19 @@ udp_server_task(void *p)
 
     while (1)
     {
+        UdpBatch *batch = server->batch;
         int num_read;
 
+        if (batch && batch->enabled)
+        {
+            if (batch_recv_dispatch(server, batch) < 0)
+            {
+                LOGPRINT_ERROR("Closing socket due to read error.");
+                RTOS_TASK_SLEEP_s(1);
+            }
+            continue;
+        }
+
         /** @brief Receive socket data. */
         num_read = UdpSocket_read(udp, server->data, server->data_len);
 
@@ -56,6 +151,148 @@ udp_server_task(void *p)
     } /* end outer while */
 }
 
+/******************************************************************************
+    [docimport UdpServer_send]
+*//**
+    @brief Sends a reply to the sender of the datagram being handled. Call from
+    the server callback. In batched mode the reply is queued and written
+    together with the other replies once the whole rx batch is dispatched;
+    otherwise it is written immediately. A reply larger than a reply slot is
+    written immediately, after the replies already queued.
+    @param[in] server  Pointer to the UdpServer object.
+    @param[in] buf  Pointer to data to send.
+    @param[in] len  Length of data to send.
+    @return Returns the number of bytes sent (or queued), negative on error.
+******************************************************************************/
+int
+UdpServer_send(UdpServer *server, uint8_t *buf, uint32_t len)
+{
+    UdpBatch *batch = server->batch;
+    UdpSlot *slot;
+
+    if (!batch || !batch->dispatching)
+    {
+        return UdpSocket_write(&server->udpsock, buf, len);
+    }
+
+    if (len > batch->tx_slot_size)
+    {
+        /* Too large to queue: the queued replies go first, in order. */
+        batch_flush(server, batch);
+        return UdpSocket_write(&server->udpsock, buf, len);
+    }
+
+    if (batch->tx_count == batch->tx_num)
+    {
+        batch_flush(server, batch);
+    }
+
+    slot = &batch->tx[batch->tx_count++];
+    memcpy(&slot->addr, &server->udpsock.source_addr, sizeof(slot->addr));
+    memcpy(slot->data, buf, len);
+    slot->len = len;
+    return len;
+}
+
+/******************************************************************************
+    [docimport UdpServer_enableBatch]
+*//**
+    @brief Enables batched datagram I/O. After each blocking read the server
+    drains every datagram already queued on the socket (up to rx_num) before
+    dispatching them, and replies sent with UdpServer_send are flushed once per
+    batch. Passing rx_num == 0 disables batching. Slots are allocated on the
+    first call and kept, so the mode can be toggled at runtime; later calls
+    reuse the original slot counts.
+    @param[in] server  Pointer to initialized UdpServer object.
+    @param[in] rx_num  Number of receive slots (each of the server buf_len).
+    @param[in] tx_num  Number of reply slots.
+    @param[in] tx_slot_size  Size of each reply slot.
+    @return Returns 0 on success, negative on error.
+******************************************************************************/
+int
+UdpServer_enableBatch(
+    UdpServer *server,
+    uint8_t rx_num,
+    uint8_t tx_num,
+    uint16_t tx_slot_size)
+{
+    UdpBatch *batch = server->batch;
+    uint8_t *rx_mem = NULL;
+    uint8_t *tx_mem;
+    uint8_t i;
+
+    if (rx_num == 0)
+    {
+        if (batch)
+        {
+            batch->enabled = false;
+        }
+        return 0;
+    }
+
+    if (batch)
+    {
+        batch->enabled = true;
+        return 0;
+    }
+
+    CHECK_COND_RETURN_MSG(tx_num == 0, -1, "At least one tx slot required.");
+
+    batch = (UdpBatch *)calloc(1, sizeof(UdpBatch));
+    CHECK_COND_RETURN_MSG(!batch, -1, "Error allocating memory.");
+
+    batch->rx = (UdpSlot *)calloc(rx_num, sizeof(UdpSlot));
+    batch->tx = (UdpSlot *)calloc(tx_num, sizeof(UdpSlot));
+    if (!batch->rx || !batch->tx)
+    {
+        goto fail_slots;
+    }
+
+    /*  Slot 0 reuses the server rx buffer. The remaining rx and all the tx
+        slots are carved out of one allocation each.
+    */
+    batch->rx[0].data = server->data;
+    if (rx_num > 1)
+    {
+        rx_mem = (uint8_t *)malloc((rx_num - 1)*server->data_len);
+        if (!rx_mem)
+        {
+            goto fail_slots;
+        }
+        for (i = 1; i < rx_num; i++)
+        {
+            batch->rx[i].data = rx_mem + (i - 1)*server->data_len;
+        }
+    }
+
+    tx_mem = (uint8_t *)malloc(tx_num*tx_slot_size);
+    if (!tx_mem)
+    {
+        goto fail_mem;
+    }
+    for (i = 0; i < tx_num; i++)
+    {
+        batch->tx[i].data = tx_mem + i*tx_slot_size;
+    }
+
+    batch->rx_num = rx_num;
+    batch->tx_num = tx_num;
+    batch->tx_slot_size = tx_slot_size;
+    batch->enabled = true;
+
+    /* Publish last: the server task may already be running. */
+    server->batch = batch;
+    return 0;
+
+fail_mem:
+    free(rx_mem);
+fail_slots:
+    free(batch->tx);
+    free(batch->rx);
+    free(batch);
+    LOGPRINT_ERROR("Error allocating memory.");
+    return -1;
+}
 
 /******************************************************************************
     [docimport UdpServer_init]
@@ -93,6 +330,7 @@ UdpServer_init(
 
     CHECK_COND_RETURN_MSG(!cb, -1, "A callback must be provided.");
     server->cb = cb;
+    server->batch = NULL;
 
     task->stackSize = task_stackSize;
     task->prio = task_prio;
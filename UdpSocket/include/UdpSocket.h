@@ -6,6 +6,7 @@
 #ifndef UDP_SOCKET_H
 #define UDP_SOCKET_H
 
+#include <stdbool.h>
 #include "lwip/sockets.h"
 
 typedef struct UdpSocket
@@ -37,6 +38,27 @@ typedef struct UdpSocket
 int
 UdpSocket_read(UdpSocket *udp_sock, uint8_t *buffer, uint32_t size);
 
+/******************************************************************************
+    [docexport UdpSocket_readFrom]
+*//**
+    @brief Reads one datagram, storing its source in addr.
+    @param[in] udp_sock  Pointer to UdpSocket object.
+    @param[in] buffer  Pointer to buffer.
+    @param[in] size  Size of buffer.
+    @param[out] addr  Source address of the datagram.
+    @param[in] nonblock  If true, return immediately when no datagram is queued
+    rather than waiting up to the socket timeout.
+    @return Returns positive length on success, 0 if nothing was read, negative
+    error code on failure.
+******************************************************************************/
+int
+UdpSocket_readFrom(
+    UdpSocket *udp_sock,
+    uint8_t *buffer,
+    uint32_t size,
+    struct sockaddr_storage *addr,
+    bool nonblock);
+
 /******************************************************************************
     [docexport UdpSocket_write]
 *//**
@@ -51,6 +73,26 @@ UdpSocket_read(UdpSocket *udp_sock, uint8_t *buffer, uint32_t size);
 int
 UdpSocket_write(UdpSocket *udp_sock, uint8_t *buffer, uint32_t size);
 
+/******************************************************************************
+    [docexport UdpSocket_writeTo]
+*//**
+    @brief Writes to a UDP socket at an explicit destination address.
+    Useful when the destination must not follow udp_sock->source_addr (i.e.
+    when writing from a thread other than the reader).
+
+    @param[in] udp_sock  Pointer to UdpSocket object.
+    @param[in] addr  Pointer to the destination address.
+    @param[in] buffer  Pointer to buffer to send.
+    @param[in] size  Size of buffer to send.
+    @return Returns the number of bytes written on success, negative on failure.
+******************************************************************************/
+int
+UdpSocket_writeTo(
+    UdpSocket *udp_sock,
+    const struct sockaddr_storage *addr,
+    uint8_t *buffer,
+    uint32_t size);
+
 /******************************************************************************
     [docexport UdpSocket_init]
 *//**
@@ -27,29 +27,53 @@ static const char *TAG = "UdpSocket";
 int
 UdpSocket_read(UdpSocket *udp_sock, uint8_t *buffer, uint32_t size)
 {
-    struct sockaddr_storage *source_addr = &udp_sock->source_addr;
+    return UdpSocket_readFrom(udp_sock, buffer, size,
+        &udp_sock->source_addr, false);
+}
+
+/******************************************************************************
+    [docimport UdpSocket_readFrom]
+*//**
+    @brief Reads one datagram, storing its source in addr.
+    @param[in] udp_sock  Pointer to UdpSocket object.
+    @param[in] buffer  Pointer to buffer.
+    @param[in] size  Size of buffer.
+    @param[out] addr  Source address of the datagram.
+    @param[in] nonblock  If true, return immediately when no datagram is queued
+    rather than waiting up to the socket timeout.
+    @return Returns positive length on success, 0 if nothing was read, negative
+    error code on failure.
+******************************************************************************/
+int
+UdpSocket_readFrom(
+    UdpSocket *udp_sock,
+    uint8_t *buffer,
+    uint32_t size,
+    struct sockaddr_storage *addr,
+    bool nonblock)
+{
     socklen_t socklen = sizeof(struct sockaddr_storage);
     int len;
 
-    len = recvfrom(udp_sock->sock, buffer, size, 0,
-        (struct sockaddr *)source_addr, &socklen);
+    len = recvfrom(udp_sock->sock, buffer, size, nonblock ? MSG_DONTWAIT : 0,
+        (struct sockaddr *)addr, &socklen);
     if (len < 0)
     {
-        if (errno != EAGAIN)
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
         {
             LOGPRINT_ERROR("recvfrom failed: errno %d", errno);
             return len;
         }
         else
         {
-            /* Read timeout */
+            /* Read timeout (or nothing queued) */
             return 0;
         }
     }
 
 #ifdef LOCAL_DEBUG
     char addr_str[128];
-    UDPSOCKET_GET_ADDR(*source_addr, addr_str);
+    UDPSOCKET_GET_ADDR(*addr, addr_str);
     LOGPRINT_DEBUG("UDP read %d bytes from %s", len, addr_str);
 #endif
     return len;
@@ -69,12 +93,34 @@ UdpSocket_read(UdpSocket *udp_sock, uint8_t *buffer, uint32_t size)
 int
 UdpSocket_write(UdpSocket *udp_sock, uint8_t *buffer, uint32_t size)
 {
-    struct sockaddr_storage *source_addr = &udp_sock->source_addr;
+    return UdpSocket_writeTo(udp_sock, &udp_sock->source_addr, buffer, size);
+}
+
+/******************************************************************************
+    [docimport UdpSocket_writeTo]
+*//**
+    @brief Writes to a UDP socket at an explicit destination address.
+    Useful when the destination must not follow udp_sock->source_addr (i.e.
+    when writing from a thread other than the reader).
+
+    @param[in] udp_sock  Pointer to UdpSocket object.
+    @param[in] addr  Pointer to the destination address.
+    @param[in] buffer  Pointer to buffer to send.
+    @param[in] size  Size of buffer to send.
+    @return Returns the number of bytes written on success, negative on failure.
+******************************************************************************/
+int
+UdpSocket_writeTo(
+    UdpSocket *udp_sock,
+    const struct sockaddr_storage *addr,
+    uint8_t *buffer,
+    uint32_t size)
+{
     socklen_t socklen = sizeof(struct sockaddr_storage);
     int ret;
 
     ret = sendto(udp_sock->sock, buffer, size, 0,
-        (struct sockaddr *)source_addr, socklen);
+        (const struct sockaddr *)addr, socklen);
     if (ret < 0)
     {
         LOGPRINT_ERROR("Error occurred during writing: errno %d", errno);
@@ -20,6 +20,8 @@ static const char *TAG = "lua_thread";
 #define close(fs, fd)           (fs)->close((fs)->ctx, (fd))
 #define read(fs, fd, buf, size) (fs)->read((fs)->ctx, (fd), (buf), (size))
 #define filesize(fs, fd)        (fs)->fsize((fs)->ctx, (fd))
+#define map(fs, pth, m)         (fs)->map((fs)->ctx, (pth), (m))
+#define unmap(fs, m)            (fs)->unmap((fs)->ctx, (m))
 
 #define STACK_ABS2REL(_abs, top)   ((_abs)-(top)-1)
 
@@ -89,15 +91,48 @@ report(lua_State *L, int status)
     return status;
 }
 
+/** @brief lua_Reader state: script pieces handed to the parser in turn. */
+typedef struct ScriptReader
+{
+    const Fs_Api_Extent *extents;
+    int num_extents;
+    int next;
+} ScriptReader;
+
+/******************************************************************************
+    script_reader
+*//**
+    @brief lua_Reader over the script pieces (no copies).
+******************************************************************************/
+static const char *
+script_reader(lua_State *L, void *data, size_t *size)
+{
+    ScriptReader *r = (ScriptReader *)data;
+    (void)L;
+
+    while (r->next < r->num_extents)
+    {
+        const Fs_Api_Extent *ext = &r->extents[r->next++];
+        if (ext->size > 0)
+        {
+            *size = ext->size;
+            return ext->data;
+        }
+    }
+    *size = 0;
+    return NULL;
+}
+
 /******************************************************************************
     exec_script
 *//**
-    @brief Loads the provided script file as a string into the vm buffer and
-    executes the chunk.
+    @brief Loads the provided script (one or more pieces, e.g. the extents of
+    a mapped file) into the vm and executes the chunk.
 ******************************************************************************/
 static int
-exec_script(const char *s, int size)
+exec_script(const Fs_Api_Extent *extents, int num_extents)
 {
+    ScriptReader reader = {extents, num_extents, 0};
     int status;
     lua_State *L = luaL_newstate();
 
@@ -108,7 +143,7 @@ exec_script(const char *s, int size)
     lua_pushcfunction(L, msghandler);
 
     /* Compile and load script as function to the stack. */
-    status = luaL_loadbuffer(L, s, size, "=(script)");
+    status = lua_load(L, script_reader, &reader, "=(script)", NULL);
     if (status != LUA_OK)
     {
         goto exit0;
@@ -146,6 +181,8 @@ lua_thread_main(void *p)
         BaseType_t qret;
         int fd, fsize, nread; 
         Lua_Thread_sQueueItem item;
+        Fs_Api_Map fmap;
+        Fs_Api_Extent ext;
 
         /*  Wait here for a script file to be provided. */
         LOGPRINT_DEBUG("Waiting for script.");
@@ -157,6 +194,17 @@ lua_thread_main(void *p)
         }
 
         LOGPRINT_DEBUG("Received file %s to execute.", item.script_file);
+
+        /* Zero-copy: parse the script straight from mapped flash. */
+        if (fs->map && map(fs, item.script_file, &fmap) == 0)
+        {
+            LOGPRINT_DEBUG("Mapped %d bytes in %d extents.", fmap.size,
+                fmap.num_extents);
+            exec_script(fmap.extents, fmap.num_extents);
+            unmap(fs, &fmap);
+            continue;
+        }
+
         fd = open(fs, item.script_file, FSAPI_O_RDONLY);
         if (fd < 0)
         {
@@ -182,7 +230,9 @@ lua_thread_main(void *p)
         LOGPRINT_DEBUG("Read %d bytes from file.", nread);
 
         /* Execute. */
-        ret = exec_script(script, nread);
+        ext.data = script;
+        ext.size = nread;
+        ret = exec_script(&ext, 1);
 
 cleanup_1:
         LOGPRINT_DEBUG("Freeing file buffer.");